@@ -0,0 +1,134 @@
+/* ----------------------------------------------------------------------
+   MUSE - MUltibody System dynamics Engine
+
+   Zhang He, zhanghecalt@163.com
+   Science and Technology on Space Physics Laboratory, Beijing
+
+   This software is distributed under the GNU General Public License.
+   Copyright (c) 2023 Zhang He. All rights reserved.
+------------------------------------------------------------------------- */
+
+// Monte Carlo dispersion of a 3-body pendulum with EnsembleRunner
+// usage: main [members] [workers] [steps]
+
+#include "mpi.h"
+#include "muse.h"
+#include "body.h"
+#include "joint.h"
+#include "joint_enums.h"
+#include "MUSEsystem.h"
+#include "ensemble.h"
+#include "ensemble_runner.h"
+#include "random_mars.h"
+#include "Eigen/Eigen"
+
+#include <cstdlib>
+#include <cmath>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+/////////////////
+using namespace MUSE_NS;
+using namespace std;
+
+// perturb the initial angular velocity of the last body, one stream per member
+
+static void perturb(MUSE *member, int imember, void *ptr)
+{
+	double sigma = *(double *)ptr;
+	RanMars *ran = member->ensemble->ranmaster;
+	Body *tip = member->body[member->nBodies - 1];
+	tip->set_Omega(sigma * ran->gaussian(), sigma * ran->gaussian(), sigma * ran->gaussian());
+}
+
+int main(int argc, char **argv){
+
+	MPI_Init(&argc,&argv);
+
+	int nmembers = argc > 1 ? atoi(argv[1]) : 64;
+	int nworkers = argc > 2 ? atoi(argv[2]) : 4;
+	int nsteps   = argc > 3 ? atoi(argv[3]) : 1000;
+
+	char *noarg[] = { argv[0] };
+	MUSE *muse = new MUSE(1,noarg,MPI_COMM_WORLD);
+
+	char name1[] = "good1";
+	char name2[] = "good2";
+	char name3[] = "good3";
+
+	muse->add_Body(name1);
+	muse->add_Body(name2);
+	muse->add_Body(name3);
+
+	muse->add_Joint(name1);
+	muse->add_Joint(name2);
+	muse->add_Joint(name3);
+
+	muse->body[0]->pos << 0, 0, 0;
+	muse->body[1]->pos << 1, 0, 0;
+	muse->body[2]->pos << 2, 0, 0;
+	muse->body[0]->quat << 0, 0, 0, 1;
+	muse->body[1]->quat << 0, 0, 0, 1;
+	muse->body[2]->quat << 0, 0, 0, 1;
+
+	muse->joint[0]->body[0] = muse->body[0];
+	muse->joint[0]->body[1] = muse->body[1];
+	muse->joint[0]->set_type(SPHERE);
+	muse->joint[0]->point1 << 0.5, 0, 0;
+	muse->joint[0]->point2 << -0.5, 0, 0;
+
+	muse->joint[1]->body[0] = muse->body[1];
+	muse->joint[1]->body[1] = muse->body[2];
+	muse->joint[1]->set_type(SPHERE);
+	muse->joint[1]->point1 << 0.5, 0, 0;
+	muse->joint[1]->point2 << -0.5, 0, 0;
+
+	muse->joint[2]->body[0] = muse->body[0];
+	muse->joint[2]->set_type(GROUND);
+
+	muse->system->add_Body(muse->body[0]);
+	muse->system->add_Body(muse->body[1]);
+	muse->system->add_Body(muse->body[2]);
+
+	muse->system->add_Joint(muse->joint[0]);
+	muse->system->add_Joint(muse->joint[1]);
+	muse->system->add_Joint(muse->joint[2]);
+
+	muse->system->dt = 1E-3;
+
+	EnsembleRunner *runner = new EnsembleRunner(muse, nmembers, nworkers, 12345);
+
+	double sigma = 0.1;
+	double start = MPI_Wtime();
+	runner->run(nsteps, perturb, &sigma);
+	double wall = MPI_Wtime() - start;
+
+	// statistics of the tip body position (x of body 3 at column 1+14)
+
+	double mean = 0, var = 0, cpu = 0;
+	for (int i = 0; i < nmembers; i++) {
+		mean += runner->result[i][1 + 14];
+		cpu += runner->cpu[i];
+	}
+	mean /= nmembers;
+	for (int i = 0; i < nmembers; i++)
+		var += pow(runner->result[i][1 + 14] - mean, 2);
+	var /= nmembers;
+
+	cout << nmembers << " members on " << nworkers << " workers, " << nsteps << " steps" << endl;
+	cout << "tip x mean: " << setprecision(10) << mean << "  std: " << sqrt(var) << endl;
+	cout << "wall time: " << fixed << setprecision(2) << 1000 * wall << "ms, "
+	     << "member cpu sum: " << 1000 * cpu << "ms" << endl;
+
+	ofstream out;
+	out.open("./ensemble.txt", ios::out);
+	out << setprecision(16);
+	for (int i = 0; i < nmembers; i++) {
+		for (int k = 0; k < runner->ncol; k++) out << runner->result[i][k] << " ";
+		out << endl;
+	}
+
+	delete runner;
+	delete muse;
+	MPI_Finalize();
+}
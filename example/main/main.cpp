@@ -20,6 +20,8 @@
 #include "MUSEsystem.h"
 #include "math_extra.h"
 #include "memory.h"
+#include "output.h"
+#include "trajectory.h"
 #include "Eigen/Eigen"
 #include "Eigen/SparseQR"
 
@@ -92,6 +94,7 @@ int main(int argc, char **argv){
 	muse->system->add_Joint(muse->joint[2]);
 
 
+	muse->output->traj->set_file("./resat.txt");  // trajectory is streamed here during solve
 	muse->system->setup();
 	muse->system->dt = 1E-3;
 
@@ -102,12 +105,6 @@ int main(int argc, char **argv){
 
 	cout << "run time: " << fixed << setprecision(2) << 1000 * (double)(end - start) / CLOCKS_PER_SEC << "ms" << endl;
 
-	ofstream out;
-	out.open("./resat.txt",  ios::out);
-	for (int i = 0; i < muse->system->xlog.size();i++)
-	{
-		out << muse->system->xlog[i].transpose() << endl;
-	}
 	delete muse;
 	MPI_Finalize();
 }
\ No newline at end of file
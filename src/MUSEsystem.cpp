@@ -18,8 +18,22 @@
 #include "joint_enums.h"
 #include "input.h"
 #include "timer.h"
+#include "trace.h"
 #include "output.h"
 #include "modify.h"
+#include "trajectory.h"
+#include "shm_ring.h"
+#include "snapshot.h"
+#include "coupling.h"
+#include "event.h"
+#include "table.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#define THREAD_ID omp_get_thread_num()
+#else
+#define THREAD_ID 0
+#endif
 
 //////test
 #include <iostream>
@@ -48,14 +62,30 @@ System::System(MUSE *muse) : Pointers(muse)
 	ga << 0, -9.8, 0;
 
 	logflag = true;
+	coupling = NULL;
+	event = NULL;
+	changed = CHANGE_ALL;
+
+	nthreads = 1;
+	integrator = INTEGRATE_RK4;
+	jrow = NULL;
+
+	nsnapshot = maxsnapshot = 0;
+	snapshot = NULL;
 }
 
 /* ---------------------------------------------------------------------- */
 
 System::~System()
 {
+	for (int ibody = 0; ibody < nBodies; ibody++) body[ibody]->detach();
 	memory->sfree(body);
 	memory->sfree(joint);
+	memory->destroy(jrow);
+	for (int i = 0; i < nsnapshot; i++) delete snapshot[i];
+	memory->sfree(snapshot);
+	delete coupling;
+	delete event;
 }
 
 
@@ -80,13 +110,31 @@ void System::command(int narg, char** arg)
 			muse->system->ga << px, py, pz;
 			iarg = iarg + 4;
 		}
+		else if (strcmp(arg[iarg], "threads") == 0) {
+			if (narg <= iarg + 1) error->all(FLERR, "Illegal change system command");
+			nthreads = input->inumeric(FLERR, arg[iarg + 1]);
+			if (nthreads < 1) error->all(FLERR, "The number of threads must be a positive value");
+#ifdef _OPENMP
+			Eigen::setNbThreads(nthreads);
+#else
+			if (nthreads > 1)
+				error->warning(FLERR, "MUSE was built without OpenMP, system threads is ignored");
+			nthreads = 1;
+#endif
+			iarg = iarg + 2;
+		}
+		else if (strcmp(arg[iarg], "integrator") == 0) {
+			if (narg <= iarg + 1) error->all(FLERR, "Illegal change system command");
+			if (strcmp(arg[iarg + 1], "rk4") == 0) integrator = INTEGRATE_RK4;
+			else if (strcmp(arg[iarg + 1], "euler") == 0) integrator = INTEGRATE_EULER;
+			else error->all(FLERR, "Illegal system integrator, must be rk4 or euler");
+			iarg = iarg + 2;
+		}
 		else if (strcmp(arg[iarg], "addbody") == 0) {
 			if (narg <= iarg + 1) error->all(FLERR, "Illegal change system command");
-			int ibody;
-			for (ibody = 0; ibody < muse->nBodies; ibody++)
-				if (strcmp(arg[iarg + 1], muse->body[ibody]->name) == 0) break;
+			int ibody = muse->find_Body(arg[iarg + 1]);
 
-			if (ibody < muse->nBodies) {
+			if (ibody >= 0) {
 				muse->system->add_Body(muse->body[ibody]);
 			}
 			else {
@@ -103,12 +151,9 @@ void System::command(int narg, char** arg)
 				if (narg <= iarg + count) error->all(FLERR, "Illegal change system command");
 				if (strcmp(arg[iarg + count], "/addbodys") == 0) break;
 
-				int ibody;
-
-				for (ibody = 0; ibody < muse->nBodies; ibody++)
-					if (strcmp(arg[iarg + count], muse->body[ibody]->name) == 0) break;
+				int ibody = muse->find_Body(arg[iarg + count]);
 
-				if (ibody < muse->nBodies) {
+				if (ibody >= 0) {
 					muse->system->add_Body(muse->body[ibody]);
 				}
 				else {
@@ -122,11 +167,9 @@ void System::command(int narg, char** arg)
 		}
 		else if (strcmp(arg[iarg], "addjoint") == 0) {
 			if (narg <= iarg + 1) error->all(FLERR, "Illegal change system command");
-			int ijoint;
-			for (ijoint = 0; ijoint < muse->nJoints; ijoint++)
-				if (strcmp(arg[iarg + 1], muse->joint[ijoint]->name) == 0) break;
+			int ijoint = muse->find_Joint(arg[iarg + 1]);
 
-			if (ijoint < muse->nJoints) {
+			if (ijoint >= 0) {
 				muse->system->add_Joint(muse->joint[ijoint]);
 			}
 			else {
@@ -143,12 +186,9 @@ void System::command(int narg, char** arg)
 				if (narg <= iarg + count) error->all(FLERR, "Illegal change system command");
 				if (strcmp(arg[iarg + count], "/addjoints") == 0) break;
 
-				int ijoint;
-
-				for (ijoint = 0; ijoint < muse->nJoints; ijoint++)
-					if (strcmp(arg[iarg + count], muse->joint[ijoint]->name) == 0) break;
+				int ijoint = muse->find_Joint(arg[iarg + count]);
 
-				if (ijoint < muse->nJoints) {
+				if (ijoint >= 0) {
 					muse->system->add_Joint(muse->joint[ijoint]);
 				}
 				else {
@@ -162,11 +202,9 @@ void System::command(int narg, char** arg)
 		}
 		else if (strcmp(arg[iarg], "removebody") == 0) {
 			if (narg <= iarg + 1) error->all(FLERR, "Illegal change system command");
-			int ibody;
-			for (ibody = 0; ibody < muse->nBodies; ibody++)
-				if (strcmp(arg[iarg + 1], muse->body[ibody]->name) == 0) break;
+			int ibody = muse->find_Body(arg[iarg + 1]);
 
-			if (ibody < muse->nBodies) {
+			if (ibody >= 0) {
 				muse->system->remove_Body(muse->body[ibody]);
 			}
 			else {
@@ -183,12 +221,9 @@ void System::command(int narg, char** arg)
 				if (narg <= iarg + count) error->all(FLERR, "Illegal change system command");
 				if (strcmp(arg[iarg + count], "/removebodys") == 0) break;
 
-				int ibody;
+				int ibody = muse->find_Body(arg[iarg + count]);
 
-				for (ibody = 0; ibody < muse->nBodies; ibody++)
-					if (strcmp(arg[iarg + count], muse->body[ibody]->name) == 0) break;
-
-				if (ibody < muse->nBodies) {
+				if (ibody >= 0) {
 					muse->system->remove_Body(muse->body[ibody]);
 				}
 				else {
@@ -202,11 +237,9 @@ void System::command(int narg, char** arg)
 		}
 		else if (strcmp(arg[iarg], "removejoint") == 0) {
 			if (narg <= iarg + 1) error->all(FLERR, "Illegal change system command");
-			int ijoint;
-			for (ijoint = 0; ijoint < muse->nJoints; ijoint++)
-				if (strcmp(arg[iarg + 1], muse->joint[ijoint]->name) == 0) break;
+			int ijoint = muse->find_Joint(arg[iarg + 1]);
 
-			if (ijoint < muse->nJoints) {
+			if (ijoint >= 0) {
 				muse->system->remove_Joint(muse->joint[ijoint]);
 			}
 			else {
@@ -223,12 +256,9 @@ void System::command(int narg, char** arg)
 				if (narg <= iarg + count) error->all(FLERR, "Illegal change system command");
 				if (strcmp(arg[iarg + count], "/removejoints") == 0) break;
 
-				int ijoint;
-
-				for (ijoint = 0; ijoint < muse->nJoints; ijoint++)
-					if (strcmp(arg[iarg + count], muse->joint[ijoint]->name) == 0) break;
+				int ijoint = muse->find_Joint(arg[iarg + count]);
 
-				if (ijoint < muse->nJoints) {
+				if (ijoint >= 0) {
 					muse->system->remove_Joint(muse->joint[ijoint]);
 				}
 				else {
@@ -254,30 +284,32 @@ void System::solve(int nsteps)
 	int n_end_of_step = modify->n_end_of_step;
 	
 	first_run = 1; 
-	int ibody, ijoint;
 
-	for (ibody = 0; ibody < nBodies; ibody++) body[ibody]->refresh();
-	for (ijoint = 0; ijoint < nJoints; ijoint++) joint[ijoint]->getconstrainteq();
+	// events due before the first step, e.g. defined for a passed step
 
-	
-	
+	if (event && event->nevent) event->check();
 
-	for (ibody = 0; ibody < nBodies; ibody++) {
-		x.segment(ibody * 7, 3) = body[ibody]->pos;
-		x.segment(ibody * 7+3, 4) = body[ibody]->quat;
-		xd.segment(ibody * 7, 3) = body[ibody]->vel;
-		xd.segment(ibody * 7 + 3, 4) = body[ibody]->quatd;
-	}
-	calxdd();
+	timer->stamp();
+	prepare();
+	timer->stamp(TIME_SOLVE);
+
+	Trajectory *traj = output->traj;
+	ShmRing *shm = output->shm;
 
-	if (logflag)
-	{
-		xlognow << timenow, x, xd, xdd;
-		xlog.clear();
-		xlog.push_back(xlognow);
-	}
 	for (int i = 0; i < nsteps; i++) {
 
+		double tstep = timer->span_start();
+
+		// a coupling step starts on multiples of coupling->every,
+		// new loads change the accelerations the step starts from
+
+		if (coupling && ntimestep % coupling->every == 0) {
+			timer->stamp();
+			coupling->exchange();
+			calxdd();
+			timer->stamp(TIME_COMM);
+		}
+
 		ntimestep++;
 		timer->stamp();
 
@@ -287,15 +319,14 @@ void System::solve(int nsteps)
 		}
 
 
-//		update_euler();
-		update_RK4();
+		if (integrator == INTEGRATE_EULER) update_euler();
+		else update_RK4();
+		timer->stamp(TIME_SOLVE);
 		//using namespace std;
 		//cout << setprecision(2) << x.transpose() << endl << endl;
-		if (logflag)
-		{
-			xlognow << timenow, x, xd, xdd;
-			xlog.push_back(xlognow);
-		}
+		if (logflag && ntimestep % traj->every == 0) traj->log();
+		if (shm && ntimestep % shm->every == 0) shm->publish();
+		timer->stamp(TIME_OUTPUT);
 
 		if (n_end_of_step) {
 			modify->end_of_step();
@@ -308,16 +339,61 @@ void System::solve(int nsteps)
 			timer->stamp(TIME_OUTPUT);
 		}
 
+		// events run their commands between two steps without a new
+		// setup, prepare() redoes only what they changed
+
+		if (event && event->nevent) {
+			if (event->check()) prepare();
+			timer->stamp(TIME_MODIFY);
+		}
+
+		timer->step_stop(tstep, ntimestep);
 	}
-	
+
+	// frames still in the ring or the writer queue go to disk
+	// at the end of every solve
+
+	if (logflag) traj->flush();
+	output->drain();
+	timer->stamp(TIME_OUTPUT);
+	if (coupling) coupling->report();
+}
+
+/* ----------------------------------------------------------------------
+   bring everything the next step starts from up to date with x/xd
+   x/xd are rebound and output layouts resized only if bodies or joints
+   were added or removed; body state already lives in x/xd, refresh()
+   normalizes it in place, then constraint equations, coupling layout
+   and accelerations follow
+   nothing is redone if nothing changed since the last step, so
+   consecutive runs continue exactly like a single one
+------------------------------------------------------------------------- */
+
+void System::prepare()
+{
+	if (changed & (CHANGE_BODY | CHANGE_JOINT)) {
+		setup_minimal();
+		output->setup_layout();
+	}
+	if (!changed) return;
+
+	x2body();
+
+	if (coupling) coupling->setup();
+
+	calxdd();
+	changed = 0;
 }
 
 void System::calxdd()
 {
 	using namespace Eigen;
+	double t0 = timer->phase_start();
 	makeBigM();
 	makeBigF();
 	makeBigAb();
+	timer->phase_stop(TIME_ASSEMBLE, t0);
+	t0 = timer->phase_start();
 
 #ifdef SPARSE
 	JacobiSVD<MatrixXd> svdA(MatrixXd(A), ComputeThinU | ComputeThinV);
@@ -345,6 +421,7 @@ void System::calxdd()
 	longb << F, b;
 
 	xdd = svdMbar.solve(longb);
+	timer->phase_stop(TIME_FACTOR, t0);
 }
 
 void System::update_euler()
@@ -352,9 +429,11 @@ void System::update_euler()
 	int ibody, ijoint;
 	x +=  xd * dt;
 	xd += xdd * dt;
+	timenow += dt;
+	double t0 = timer->span_start();
 	x2body();
 	calxdd();
-	timenow += dt;
+	timer->span_stop("K1 next", t0, TRACK_SOLVER);
 
 }
 
@@ -372,16 +451,20 @@ void System::update_RK4()
 	x  = x0 + xd0  * halfdt;
 	xd = xd0 + xdd0 * halfdt;
 	timenow += halfdt;
+	double t0 = timer->span_start();
 	x2body();
 	calxdd();
+	timer->span_stop("K2", t0, TRACK_SOLVER);
 	xd1 = xd;
 	xdd1 = xdd; //K2
 	
 
 	x = x0 + xd1 * halfdt;
 	xd = xd0 + xdd1 * halfdt;
+	t0 = timer->span_start();
 	x2body();
 	calxdd();
+	timer->span_stop("K3", t0, TRACK_SOLVER);
 	xd2 = xd;
 	xdd2 = xdd;  //K3
 	
@@ -389,54 +472,73 @@ void System::update_RK4()
 	x = x0 + xd2 * dt;
 	xd = xd0 + xdd2 * dt;
 	timenow += halfdt;
+	t0 = timer->span_start();
 	x2body();
 	calxdd();
+	timer->span_stop("K4", t0, TRACK_SOLVER);
 	xd3 = xd;
 	xdd3 = xdd;  //K4
 
 	x  = x0  + (xd0  + 2 * xd1  + 2 * xd2  + xd3)  * (dt / 6.0);
 	xd = xd0 + (xdd0 + 2 * xdd1 + 2 * xdd2 + xdd3) * (dt / 6.0);
+	t0 = timer->span_start();
 	x2body();
 	calxdd();
+	timer->span_stop("K1 next", t0, TRACK_SOLVER);
 }
 
+/* ----------------------------------------------------------------------
+   bring body kinematics and joint equations up to date with x/xd
+   bodies are views into x/xd, so no state is copied here
+   with threads and a trace, each thread's share of a loop is a span,
+   nowait lets a span end when that thread is done, not at the barrier
+------------------------------------------------------------------------- */
+
 void System::x2body()
 {
-	int ibody, ijoint, ibegin=0;
-	for (ibody = 0; ibody < nBodies; ibody++)
+	int ibody, ijoint;
+	int omptrace = timer->tracing && nthreads > 1;
+	double t0 = timer->phase_start();
+	#pragma omp parallel num_threads(nthreads) if(nthreads > 1)
 	{
-		body[ibody]->pos  = x.segment(ibegin, 3);
-		body[ibody]->vel = xd.segment(ibegin, 3);
-		ibegin += 3;
-		body[ibody]->quat  =  x.segment(ibegin, 4);
-	//	body[ibody]->quat.normalize(); //ע�⽫��������x��
-
-		body[ibody]->quatd = xd.segment(ibegin, 4);
-		ibegin += 4;
+		double t1 = omptrace ? Timer::wtime() : 0.0;
+		#pragma omp for schedule(static) nowait
+		for (ibody = 0; ibody < nBodies; ibody++) body[ibody]->refresh();
+		if (omptrace) timer->span_stop("refresh", t1, TRACK_OMP + THREAD_ID);
 	}
-	for (ibody = 0; ibody < nBodies; ibody++) body[ibody]->refresh();
-	for (ijoint = 0; ijoint < nJoints; ijoint++) joint[ijoint]->getconstrainteq();
+	timer->phase_stop(TIME_REFRESH, t0);
+	t0 = timer->phase_start();
+	#pragma omp parallel num_threads(nthreads) if(nthreads > 1)
+	{
+		double t1 = omptrace ? Timer::wtime() : 0.0;
+		#pragma omp for schedule(static) nowait
+		for (ijoint = 0; ijoint < nJoints; ijoint++) joint[ijoint]->getconstrainteq();
+		if (omptrace) timer->span_stop("kernels", t1, TRACK_OMP + THREAD_ID);
+	}
+	timer->phase_stop(TIME_KERNEL, t0);
 }
 
+/* ----------------------------------------------------------------------
+   membership is checked through IDinSystem, arrays grow geometrically
+------------------------------------------------------------------------- */
+
 int System::add_Body(Body *bodynow)
 {
-	int ibody;
-
-	for (ibody = 0; ibody < nBodies; ibody++)
-		if (strcmp(bodynow->name, body[ibody]->name) == 0) break;
+	int ibody = bodynow->IDinSystem;
 
-	if (ibody < nBodies) {
+	if (ibody >= 0 && ibody < nBodies && body[ibody] == bodynow)
 		error->all(FLERR, "Repeatedly added the same body into the system!");
+
+	if (nBodies == maxBodies) {
+		maxBodies = maxBodies ? 2 * maxBodies : DELTA;
+		body = (Body**)memory->srealloc(body, maxBodies * sizeof(Body*), "muse:body");
 	}
-	else {
-		if (nBodies == maxBodies) {
-			maxBodies += DELTA;
-			body = (Body**)memory->srealloc(body, maxBodies * sizeof(Body*), "muse:body");
-		}
-	}
+
+	ibody = nBodies;
 	body[ibody] = bodynow;
 	body[ibody]->IDinSystem = ibody;
 	nBodies++;
+	changed |= CHANGE_BODY;
 	return ibody;
 }
 
@@ -454,6 +556,7 @@ int MUSE_NS::System::remove_Body(Body *bodynow)
 	}
 
 	body[ibody]->IDinSystem = -1;
+	body[ibody]->detach();
 
 
 	for (ibody1 = ibody; ibody1 < nBodies - 1; ibody1++)
@@ -463,33 +566,45 @@ int MUSE_NS::System::remove_Body(Body *bodynow)
 	}
 	nBodies--;
 	body[nBodies] = NULL;
+	changed |= CHANGE_BODY;
 	return ibody;
 }
 
 int System::add_Joint(Joint *jointnow)
 {
-	int ijoint;
+	int ijoint = jointnow->IDinSystem;
 
-	for (ijoint = 0; ijoint < nJoints; ijoint++)
-		if (strcmp(jointnow->name, joint[ijoint]->name) == 0) break;
-
-	if (ijoint < nJoints) {
+	if (ijoint >= 0 && ijoint < nJoints && joint[ijoint] == jointnow)
 		error->all(FLERR, "Repeatedly added the same joint into the system!");
-	}
-	else {
-		if (nJoints == maxJoints) {
-			maxJoints += DELTA;
-			joint = (Joint**)memory->srealloc(joint, maxJoints * sizeof(Joint*), "muse:joint");
-		}
+
+	if (nJoints == maxJoints) {
+		maxJoints = maxJoints ? 2 * maxJoints : DELTA;
+		joint = (Joint**)memory->srealloc(joint, maxJoints * sizeof(Joint*), "muse:joint");
 	}
 
+	ijoint = nJoints;
 	joint[ijoint] = jointnow;
 	joint[ijoint]->IDinSystem = ijoint;
 
 	nJoints++;
+	changed |= CHANGE_JOINT;
 	return ijoint;
 }
 
+/* ---------------------------------------------------------------------- */
+
+void System::reserve(int nbody, int njoint)
+{
+	if (nBodies + nbody > maxBodies) {
+		maxBodies = nBodies + nbody;
+		body = (Body**)memory->srealloc(body, maxBodies * sizeof(Body*), "muse:body");
+	}
+	if (nJoints + njoint > maxJoints) {
+		maxJoints = nJoints + njoint;
+		joint = (Joint**)memory->srealloc(joint, maxJoints * sizeof(Joint*), "muse:joint");
+	}
+}
+
 int MUSE_NS::System::remove_Joint(Joint *jointnow)
 {
 	int ijoint, ijoint1;
@@ -512,43 +627,111 @@ int MUSE_NS::System::remove_Joint(Joint *jointnow)
 	}
 	nJoints--;
 	joint[nJoints] = NULL;
+	changed |= CHANGE_JOINT;
 	return ijoint;
 }
 
 void System::setup()
 {
-	//std::cout << "setup!!!" << std::endl;
-	int rowsum, ijoint;
-	rowsum = 0;
-	for (ijoint = 0; ijoint < nJoints; ijoint++)
-		rowsum += joint[ijoint]->A1.rows();
+	changed = CHANGE_ALL;
+	setup_minimal();
+	output->setup(1);
+}
 
-	A.resize(rowsum+ nBodies, 7 * nBodies);
-	b.resize(rowsum + nBodies);
-	M.resize(7 * nBodies, 7 * nBodies);
-	F.resize(7 * nBodies);
-	x.resize(7 * nBodies);
-	xd.resize(7 * nBodies);
-	xdd.resize(7 * nBodies);
-	xlognow.resize(21 * nBodies + 1);
+/* ----------------------------------------------------------------------
+   setup() before a run, redoing only what changed since the last one:
+   nothing for parameter changes, whose effect prepare() picks up,
+   joint rows only for added/removed joints, x/xd for added/removed bodies
+------------------------------------------------------------------------- */
 
+void System::setup_changed()
+{
+	if (changed & (CHANGE_BODY | CHANGE_JOINT)) setup_minimal();
 	output->setup(1);
 }
 
+/* ----------------------------------------------------------------------
+   size the system arrays and bind the bodies into x/xd
+------------------------------------------------------------------------- */
+
+void System::setup_minimal()
+{
+	//std::cout << "setup!!!" << std::endl;
+	int ijoint, ibody;
+
+	// row offset of each joint block in A, so assembly can run per joint
+
+	if (changed & CHANGE_JOINT) {
+		memory->destroy(jrow);
+		memory->create(jrow, nJoints + 1, "system:jrow");
+		int rowsum = 0;
+		for (ijoint = 0; ijoint < nJoints; ijoint++) {
+			jrow[ijoint] = rowsum;
+			rowsum += joint[ijoint]->A1.rows();
+		}
+		jrow[nJoints] = rowsum;
+	}
+
+	A.resize(jrow[nJoints] + nBodies, 7 * nBodies);
+	b.resize(jrow[nJoints] + nBodies);
+
+	// move body state out of x/xd before they may be reallocated,
+	// then make each body a view into its 7-wide segment of x/xd
+
+	if (changed & CHANGE_BODY) {
+		for (ibody = 0; ibody < nBodies; ibody++) body[ibody]->detach();
+
+		M.resize(7 * nBodies, 7 * nBodies);
+		F.resize(7 * nBodies);
+		x.resize(7 * nBodies);
+		xd.resize(7 * nBodies);
+		xdd.resize(7 * nBodies);
+
+		for (ibody = 0; ibody < nBodies; ibody++)
+			body[ibody]->attach(x.data() + 7 * ibody, xd.data() + 7 * ibody);
+	}
+
+	changed = CHANGE_STATE;
+}
+
 void System::makeBigF()
 {
 	int ibody;
 	F.setZero();
+	#pragma omp parallel for schedule(static) num_threads(nthreads) if(nthreads > 1)
 	for (ibody = 0; ibody < nBodies; ibody++) {
-		// Translational force: gravity
-		F.segment(ibody * 7, 3) << body[ibody]->mass * ga;
+		// Translational force: gravity plus external force
+		F.segment(ibody * 7, 3) << body[ibody]->mass * ga + body[ibody]->force;
 		// Rotational generalized force in quaternion form:
-		// Must include gyroscopic torque: -T^T * (omega x (I * omega))
+		// Must include gyroscopic torque: T^T * (torque - omega x (I * omega))
 		Eigen::Vector3d gyro = body[ibody]->omega.cross(body[ibody]->inertia * body[ibody]->omega);
-		F.segment(ibody * 7 + 3, 4) = -body[ibody]->T.transpose() * gyro;
+		F.segment(ibody * 7 + 3, 4) = body[ibody]->T.transpose() * (body[ibody]->torque - gyro);
 	}
+
+	// time dependent loads from a coupled solver and from tables
+
+	if (coupling) coupling->loads(timenow);
+	for (int itable = 0; itable < modify->ntable; itable++)
+		modify->table[itable]->loads(timenow);
+}
+
+/* ----------------------------------------------------------------------
+   add a force (inertial frame) and a torque (body frame) acting on
+   body ibody of the system to its generalized force
+------------------------------------------------------------------------- */
+
+void System::add_load(int ibody, const double *f, const double *tau)
+{
+	F.segment(ibody * 7, 3) += Eigen::Map<const Eigen::Vector3d>(f);
+	F.segment(ibody * 7 + 3, 4) += body[ibody]->T.transpose() * Eigen::Map<const Eigen::Vector3d>(tau);
 }
 
+/* ----------------------------------------------------------------------
+   each body owns one 7x7 diagonal block of M
+   sparse: every thread collects triplets in its own list,
+   lists are merged in thread order so the pattern is deterministic
+------------------------------------------------------------------------- */
+
 void System::makeBigM()
 {
 	int ibody,ibegin,i,j;
@@ -557,9 +740,11 @@ void System::makeBigM()
 	M.setZero();
 
 #ifdef SPARSE
-	std::vector < Eigen::Triplet <double> > triplets;
+	std::vector < std::vector < Eigen::Triplet <double> > > tlist(nthreads);
+	#pragma omp parallel for schedule(static) num_threads(nthreads) if(nthreads > 1) private(ibegin,i,j,nowdata)
 	for (ibody = 0; ibody < nBodies; ibody++)
 	{
+		std::vector < Eigen::Triplet <double> > &triplets = tlist[THREAD_ID];
 		ibegin = ibody * 7;
 		triplets.emplace_back(ibegin, ibegin, body[ibody]->mass);
 		ibegin++;
@@ -574,8 +759,11 @@ void System::makeBigM()
 				if (nowdata != 0) triplets.emplace_back(ibegin + i, ibegin + j, nowdata);
 			}
 	}
+	std::vector < Eigen::Triplet <double> > triplets;
+	for (i = 0; i < nthreads; i++) triplets.insert(triplets.end(), tlist[i].begin(), tlist[i].end());
 	M.setFromTriplets(triplets.begin(), triplets.end());
 #else
+	#pragma omp parallel for schedule(static) num_threads(nthreads) if(nthreads > 1) private(ibegin)
 	for (ibody = 0; ibody < nBodies; ibody++)
 	{
 		ibegin = ibody * 7;
@@ -590,60 +778,74 @@ void System::makeBigM()
 #endif // SPARSE
 }
 
+/* ----------------------------------------------------------------------
+   joint ijoint owns rows jrow[ijoint] to jrow[ijoint+1]-1 of A and b,
+   body ibody owns quaternion-norm row jrow[nJoints]+ibody,
+   so both loops write disjoint rows and run in parallel
+------------------------------------------------------------------------- */
+
 void System::makeBigAb()
 {
 	int ibody, ijoint, ibegin, i, j, nowrows, b1, b2;
 	double nowdata;
 	A.setZero();
 #ifdef SPARSE
-	std::vector < Eigen::Triplet <double> > triplets;
-	ibegin = 0;
-	for (ijoint = 0; ijoint < nJoints; ijoint++)
+	std::vector < std::vector < Eigen::Triplet <double> > > tlist(nthreads);
+	#pragma omp parallel num_threads(nthreads) if(nthreads > 1) private(ibody,ijoint,ibegin,i,j,nowrows,b1,b2,nowdata)
 	{
-		nowrows = joint[ijoint]->A1.rows();
-		b1 = 7 * joint[ijoint]->body[0]->IDinSystem;
-		if (joint[ijoint]->get_type() == GROUND)
-		{
-			for (i = 0; i < nowrows; i++)
-				for (j = 0; j < 7; j++)
-				{
-					nowdata = joint[ijoint]->A1(i, j);
-					if (nowdata != 0) triplets.emplace_back(ibegin + i, b1 + j, nowdata);
-				}
-		}
-		else
-		{
-			b2 = 7 * joint[ijoint]->body[1]->IDinSystem;
-			for (i = 0; i < nowrows; i++)
-				for (j = 0; j < 7; j++)
-				{
-					nowdata = joint[ijoint]->A1(i, j);
-					if (nowdata != 0) triplets.emplace_back(ibegin + i, b1 + j, nowdata);
-					nowdata = joint[ijoint]->A2(i, j);
-					if (nowdata != 0) triplets.emplace_back(ibegin + i, b2 + j, nowdata);
-				}
-		}
-		b.segment(ibegin, nowrows) << joint[ijoint]->b;
+		std::vector < Eigen::Triplet <double> > &triplets = tlist[THREAD_ID];
 
-		ibegin += nowrows;
-	}
-	for (ibody = 0; ibody < nBodies; ibody++)
-	{
-		for (j = 0; j < 4; j++)
+		#pragma omp for schedule(static) nowait
+		for (ijoint = 0; ijoint < nJoints; ijoint++)
 		{
-			nowdata = 2 * body[ibody]->quat(j);
-			if (nowdata != 0) triplets.emplace_back(ibegin, 3 + j + 7 * ibody, nowdata);
+			ibegin = jrow[ijoint];
+			nowrows = joint[ijoint]->A1.rows();
+			b1 = 7 * joint[ijoint]->body[0]->IDinSystem;
+			if (joint[ijoint]->get_type() == GROUND)
+			{
+				for (i = 0; i < nowrows; i++)
+					for (j = 0; j < 7; j++)
+					{
+						nowdata = joint[ijoint]->A1(i, j);
+						if (nowdata != 0) triplets.emplace_back(ibegin + i, b1 + j, nowdata);
+					}
+			}
+			else
+			{
+				b2 = 7 * joint[ijoint]->body[1]->IDinSystem;
+				for (i = 0; i < nowrows; i++)
+					for (j = 0; j < 7; j++)
+					{
+						nowdata = joint[ijoint]->A1(i, j);
+						if (nowdata != 0) triplets.emplace_back(ibegin + i, b1 + j, nowdata);
+						nowdata = joint[ijoint]->A2(i, j);
+						if (nowdata != 0) triplets.emplace_back(ibegin + i, b2 + j, nowdata);
+					}
+			}
+			b.segment(ibegin, nowrows) << joint[ijoint]->b;
 		}
 
-		b(ibegin) = -2.0 * body[ibody]->quatd.dot(body[ibody]->quatd);
+		#pragma omp for schedule(static)
+		for (ibody = 0; ibody < nBodies; ibody++)
+		{
+			ibegin = jrow[nJoints] + ibody;
+			for (j = 0; j < 4; j++)
+			{
+				nowdata = 2 * body[ibody]->quat(j);
+				if (nowdata != 0) triplets.emplace_back(ibegin, 3 + j + 7 * ibody, nowdata);
+			}
 
-		ibegin++;
+			b(ibegin) = -2.0 * body[ibody]->quatd.dot(body[ibody]->quatd);
+		}
 	}
+	std::vector < Eigen::Triplet <double> > triplets;
+	for (i = 0; i < nthreads; i++) triplets.insert(triplets.end(), tlist[i].begin(), tlist[i].end());
 	A.setFromTriplets(triplets.begin(), triplets.end());
 #else	
-	ibegin = 0;
+	#pragma omp parallel for schedule(static) num_threads(nthreads) if(nthreads > 1) private(ibegin,nowrows,b1,b2)
 	for (ijoint = 0; ijoint < nJoints; ijoint++)
 	{
+		ibegin = jrow[ijoint];
 		nowrows = joint[ijoint]->A1.rows();
 		b1 = 7 * joint[ijoint]->body[0]->IDinSystem;
 		A.block(ibegin, b1, nowrows, 7) = joint[ijoint]->A1;
@@ -653,17 +855,74 @@ void System::makeBigAb()
 			A.block(ibegin, b2, nowrows, 7) = joint[ijoint]->A2;
 		}
 		b.segment(ibegin, nowrows) << joint[ijoint]->b;
-		ibegin += nowrows;
 	}
+	#pragma omp parallel for schedule(static) num_threads(nthreads) if(nthreads > 1) private(ibegin,j)
 	for (ibody = 0; ibody < nBodies; ibody++)
 	{
+		ibegin = jrow[nJoints] + ibody;
 		for (j = 0; j < 4; j++)
 		{
 			A(ibegin, 3 + j + 7 * ibody) = 2 * body[ibody]->quat(j);
 		}
 		b(ibegin) = -2.0 * body[ibody]->quatd.dot(body[ibody]->quatd);
-		ibegin++;
 	}
 
 #endif // SPARSE
-}
\ No newline at end of file
+}
+
+/* ----------------------------------------------------------------------
+   save the current state under name, overwriting an existing snapshot
+   return index of the snapshot
+------------------------------------------------------------------------- */
+
+int System::save_snapshot(const char *name)
+{
+	int isnap = find_snapshot(name);
+	if (isnap < 0) {
+		if (nsnapshot == maxsnapshot) {
+			maxsnapshot += DELTA;
+			snapshot = (Snapshot **)memory->srealloc(snapshot, maxsnapshot * sizeof(Snapshot *), "system:snapshot");
+		}
+		isnap = nsnapshot++;
+		snapshot[isnap] = new Snapshot(muse, name);
+	}
+	snapshot[isnap]->save();
+	return isnap;
+}
+
+/* ---------------------------------------------------------------------- */
+
+void System::restore_snapshot(const char *name)
+{
+	int isnap = find_snapshot(name);
+	if (isnap < 0) {
+		char str[128];
+		sprintf(str, "Cannot find snapshot with name: %s", name);
+		error->all(FLERR, str);
+	}
+	snapshot[isnap]->restore();
+}
+
+/* ---------------------------------------------------------------------- */
+
+void System::delete_snapshot(const char *name)
+{
+	int isnap = find_snapshot(name);
+	if (isnap < 0) {
+		char str[128];
+		sprintf(str, "Cannot find snapshot with name: %s", name);
+		error->all(FLERR, str);
+	}
+	delete snapshot[isnap];
+	for (int i = isnap; i < nsnapshot - 1; i++) snapshot[i] = snapshot[i + 1];
+	nsnapshot--;
+}
+
+/* ---------------------------------------------------------------------- */
+
+int System::find_snapshot(const char *name)
+{
+	for (int isnap = 0; isnap < nsnapshot; isnap++)
+		if (strcmp(name, snapshot[isnap]->name) == 0) return isnap;
+	return -1;
+}
@@ -18,6 +18,14 @@
 
 namespace MUSE_NS {
 
+// what changed since the solution in x/xd/xdd was computed
+
+enum{CHANGE_STATE=1,CHANGE_JOINT=2,CHANGE_BODY=4,CHANGE_ALL=7};
+
+// time integration of System::solve()
+
+enum{INTEGRATE_RK4,INTEGRATE_EULER};
+
 class System : protected Pointers {
 public:
 
@@ -51,9 +59,16 @@ public:
 	int nBodies;
 	int nJoints;
 
-	bool logflag;
-	Eigen::VectorXd xlognow;
-	std::vector<Eigen::VectorXd> xlog;
+	int nthreads;                  // threads for body/joint/assembly loops
+	int integrator;                // INTEGRATE_RK4 (default) or INTEGRATE_EULER
+	int *jrow;                     // first row of each joint's block in A
+	                               // jrow[nJoints] = first quaternion row
+
+	bool logflag;                  // write trajectory frames during solve
+	class Coupling *coupling;      // external solver coupling, NULL if off
+	class Event *event;            // timeline of events, NULL if none
+	int changed;                   // CHANGE_* bits, 0 = xdd and the body
+	                               // kinematics match x/xd, see prepare()
 
 	class Body **body;
 	class Joint **joint;
@@ -66,16 +81,29 @@ public:
 	int remove_Body(Body*);
 	int add_Joint(Joint *);
 	int remove_Joint(Joint*);
+	void reserve(int, int);        // room for N more bodies and M more joints
 
 	void setup();
+	void setup_changed();          // setup() redoing only what changed
+	void setup_minimal();          // setup() without the initial output
 	void makeBigAb();
 	void makeBigM();
 	void makeBigF();
+	void add_load(int, const double *, const double *);
 	void update_euler();
 	void update_RK4();
 	void calxdd();
 	void x2body();
 	void solve(int);
+	void prepare();                // derived state the next step starts from,
+	                               // skipped if nothing changed
+
+	// named in-memory copies of the system state, see snapshot.h
+
+	int save_snapshot(const char *);
+	void restore_snapshot(const char *);
+	void delete_snapshot(const char *);
+	int find_snapshot(const char *);
 
 
 
@@ -86,6 +114,9 @@ private:
 
 	int maxBodies;
 	int maxJoints;
+
+	int nsnapshot,maxsnapshot;
+	class Snapshot **snapshot;
 public:
 	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 	
@@ -23,6 +23,7 @@ extern "C" {
 /* Dummy defs for MPI stubs */
 
 #define MPI_COMM_WORLD 0
+#define MPI_COMM_SELF 1
 
 #define MPI_SUCCESS   0
 #define MPI_ERR_ARG  -1
@@ -0,0 +1,162 @@
+/* ----------------------------------------------------------------------
+   MUSE - MUltibody System dynamics Engine
+   https://github.com/zhangh3/MUSE
+
+   Zhang He, zhanghecalt@163.com
+   Science and Technology on Space Physics Laboratory, Beijing
+
+   This software is distributed under the GNU General Public License.
+   Copyright (c) 2023 Zhang He. All rights reserved.
+------------------------------------------------------------------------- */
+
+#include "stdio.h"
+#include "async_writer.h"
+#include "output.h"
+#include "stats.h"
+#include "trajectory.h"
+#include "memory.h"
+#include "error.h"
+#include "timer.h"
+#include "trace.h"
+
+using namespace MUSE_NS;
+
+/* ---------------------------------------------------------------------- */
+
+AsyncWriter::AsyncWriter(MUSE *muse, int nslot_in) : Pointers(muse)
+{
+  if (nslot_in <= 0) error->all(FLERR,"Illegal output queue value");
+
+  nslot = nslot_in;
+  width = 0;
+  slot = NULL;
+
+  head = 0;
+  tail = 0;
+  sleeping = 0;
+  draining = false;
+  stop = false;
+
+  writer = std::thread(&AsyncWriter::loop,this);
+}
+
+/* ---------------------------------------------------------------------- */
+
+AsyncWriter::~AsyncWriter()
+{
+  drain();
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    stop = true;
+  }
+  cv_work.notify_one();
+  writer.join();
+  memory->destroy(slot);
+}
+
+/* ----------------------------------------------------------------------
+   grow slots to hold n values, called between runs when the ring is empty
+------------------------------------------------------------------------- */
+
+void AsyncWriter::setup(int n)
+{
+  if (n + 3 <= width) return;
+  width = n + 3;
+  memory->destroy(slot);
+  memory->create(slot,nslot,width,"async:slot");
+}
+
+/* ----------------------------------------------------------------------
+   solver side: return the next free slot with its header filled in
+   spins only when the writer has fallen nslot records behind
+------------------------------------------------------------------------- */
+
+double *AsyncWriter::claim(int type, int step, double time)
+{
+  long h = head.load(std::memory_order_relaxed);
+  while (h - tail.load(std::memory_order_acquire) >= nslot)
+    std::this_thread::yield();
+
+  double *s = slot[h % nslot];
+  s[0] = type;
+  s[1] = step;
+  s[2] = time;
+  return s;
+}
+
+/* ----------------------------------------------------------------------
+   solver side: publish the claimed slot
+   the writer is only woken up through the mutex when it is asleep
+------------------------------------------------------------------------- */
+
+void AsyncWriter::commit()
+{
+  head.store(head.load(std::memory_order_relaxed) + 1);
+  if (sleeping.load()) {
+    std::lock_guard<std::mutex> guard(lock);
+    cv_work.notify_one();
+  }
+}
+
+/* ----------------------------------------------------------------------
+   solver side: block until every committed slot is written and flushed
+   called at the end of each run and before anything else prints
+------------------------------------------------------------------------- */
+
+void AsyncWriter::drain()
+{
+  std::unique_lock<std::mutex> guard(lock);
+  draining = true;
+  cv_work.notify_one();
+  cv_idle.wait(guard, [&] { return !draining; });
+}
+
+/* ----------------------------------------------------------------------
+   writer thread: format and write slots in order
+   streams are flushed only on drain(), so file buffering is kept
+------------------------------------------------------------------------- */
+
+void AsyncWriter::loop()
+{
+  while (1) {
+    long t = tail.load(std::memory_order_relaxed);
+    if (t != head.load(std::memory_order_acquire)) {
+      write(slot[t % nslot]);
+      tail.store(t + 1, std::memory_order_release);
+      continue;
+    }
+
+    std::unique_lock<std::mutex> guard(lock);
+    if (draining && head.load() == t) {
+      fflush(NULL);
+      draining = false;
+      cv_idle.notify_all();
+    }
+    sleeping = 1;
+    cv_work.wait(guard, [&] { return stop || draining || head.load() != t; });
+    sleeping = 0;
+    if (stop && head.load() == t) return;
+  }
+}
+
+/* ---------------------------------------------------------------------- */
+
+void AsyncWriter::write(double *s)
+{
+  Trace *trace = timer->trace;
+  int traced = trace && trace->writing();
+  double t0 = traced ? Timer::wtime() : 0.0;
+
+  switch (static_cast<int>(s[0])) {
+  case ASYNC_STATS:
+    output->stats->write_values(&s[3]);
+    if (traced) trace->add(TRACK_WRITER,"write stats",t0,Timer::wtime(),
+                           static_cast<int>(s[1]));
+    break;
+  case ASYNC_TRAJ:
+    output->traj->write_frame(&s[3],static_cast<int>(s[1]),s[2]);
+    if (traced) trace->add(TRACK_WRITER,"write frame",t0,Timer::wtime(),
+                           static_cast<int>(s[1]));
+    break;
+  }
+}
@@ -0,0 +1,61 @@
+/* ----------------------------------------------------------------------
+   MUSE - MUltibody System dynamics Engine
+   https://github.com/zhangh3/MUSE
+
+   Zhang He, zhanghecalt@163.com
+   Science and Technology on Space Physics Laboratory, Beijing
+
+   This software is distributed under the GNU General Public License.
+   Copyright (c) 2023 Zhang He. All rights reserved.
+------------------------------------------------------------------------- */
+
+#ifndef MUSE_ASYNC_WRITER_H
+#define MUSE_ASYNC_WRITER_H
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include "pointers.h"
+
+namespace MUSE_NS {
+
+enum{ASYNC_STATS,ASYNC_TRAJ};
+
+/* background writer for "output async yes"
+   the solver thread snapshots the values of a stats line or trajectory
+   frame into a slot of a single-producer/single-consumer ring and
+   returns, the writer thread formats the slot and does the file I/O
+   slot layout: [0] record type, [1] step, [2] time, [3...] values */
+
+class AsyncWriter : protected Pointers {
+ public:
+  int nslot;                   // # of slots in the ring
+  int width;                   // # of doubles in one slot
+
+  AsyncWriter(class MUSE *, int);
+  ~AsyncWriter();
+  void setup(int);             // size slots for N values, ring must be empty
+  double *claim(int, int, double);  // next free slot, waits if ring is full
+  void commit();               // hand the claimed slot to the writer
+  void drain();                // wait until every slot is written
+
+ private:
+  double **slot;
+  std::atomic<long> head;      // next slot the solver fills
+  std::atomic<long> tail;      // next slot the writer reads
+  std::atomic<int> sleeping;   // 1 while the writer waits for work
+  bool draining;               // solver waits in drain()
+  bool stop;
+
+  std::mutex lock;
+  std::condition_variable cv_work,cv_idle;
+  std::thread writer;
+
+  void loop();
+  void write(double *);
+};
+
+}
+
+#endif
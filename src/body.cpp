@@ -10,6 +10,7 @@
 ------------------------------------------------------------------------- */
 
 #include "string.h"
+#include <new>
 #include "body.h"
 #include "math_extra.h"
 #include "error.h"
@@ -17,8 +18,15 @@
 
 using namespace MUSE_NS;
 
-Body::Body(MUSE *muse) : Pointers(muse)
+/* ----------------------------------------------------------------------
+   the Maps are declared before xlocal/xdlocal, so they start empty and
+   are seated on the local storage here, like attach() does
+------------------------------------------------------------------------- */
+
+Body::Body(MUSE *muse) : Pointers(muse),
+	pos(NULL), vel(NULL), quat(NULL), quatd(NULL)
 {
+	bind(xlocal, xdlocal);
 	name=NULL;
 	pos   << 0,0,0 ;
 	vel   << 0,0,0 ;
@@ -26,6 +34,8 @@ Body::Body(MUSE *muse) : Pointers(muse)
 	omega << 0, 0, 0;
 	quatd << 0, 0, 0, 0;
 	mass = 1;
+	force << 0, 0, 0;
+	torque << 0, 0, 0;
 	set_Inertia(1,1,1,0,0,0);
 
 	IDinSystem = -1;
@@ -36,6 +46,41 @@ Body::~Body()
 	delete [] name;
 }
 
+/* ----------------------------------------------------------------------
+   point pos/quat at x[0..6] and vel/quatd at xd[0..6]
+   placement new is the Eigen way of re-seating a Map
+------------------------------------------------------------------------- */
+
+void Body::bind(double *x, double *xd)
+{
+	new (&pos) Eigen::Map<Eigen::Vector3d>(x);
+	new (&quat) Eigen::Map<Eigen::Vector4d>(x + 3);
+	new (&vel) Eigen::Map<Eigen::Vector3d>(xd);
+	new (&quatd) Eigen::Map<Eigen::Vector4d>(xd + 3);
+}
+
+/* ----------------------------------------------------------------------
+   copy current state into external storage and make it the body state
+   called by System::setup() with the body's segments of x/xd
+------------------------------------------------------------------------- */
+
+void Body::attach(double *x, double *xd)
+{
+	if (x != pos.data()) memmove(x, pos.data(), 7 * sizeof(double));
+	if (xd != vel.data()) memmove(xd, vel.data(), 7 * sizeof(double));
+	bind(x, xd);
+}
+
+/* ----------------------------------------------------------------------
+   copy current state back into local storage
+   called before System reallocates x/xd or when body leaves the system
+------------------------------------------------------------------------- */
+
+void Body::detach()
+{
+	attach(xlocal, xdlocal);
+}
+
 void Body::set_Name(char *newname)
 {
   int n = strlen(newname) + 1;
@@ -99,12 +144,12 @@ void Body::set_Inertia(double Ixx,double Iyy,double Izz,double Ixy,double Ixz,do
 
 void Body::refresh()
 {
-	quat.normalize();// FIXME:��һ��quat��Ӧ�÷���x
+	quat.normalize();                 // writes through to System::x
 	T  << 2 * ( quat(3) * Eigen::Matrix3d::Identity() - MathExtra::crs( quat.head(3))), -2 *  quat.head(3);
 	DCM = (quat(3) * quat(3) - quat.head(3).transpose() * quat.head(3)) * Eigen::Matrix3d::Identity() 
 		 + 2 * quat.head(3) * quat.head(3).transpose() + 2 * quat(3) * MathExtra::crs(quat.head(3));
 	omega = T * quatd;
-	quatd = 0.25 * T.transpose() * omega; // FIXME:��һ��quatd��Ӧ�÷���xd
+	quatd = 0.25 * T.transpose() * omega; // writes through to System::xd
 	Td << 2 * (quatd(3) * Eigen::Matrix3d::Identity() - MathExtra::crs(quatd.head(3))), -2 * quatd.head(3);
 	inertia4 = T.transpose() * inertia * T;
 }
\ No newline at end of file
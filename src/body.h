@@ -26,18 +26,28 @@ public:
 
     char *name;                        //body name
 
-	Eigen::Vector3d pos;               //centroid position in inertial frame
-	Eigen::Vector3d vel;               //centroid velocity in inertial frame
-	Eigen::Vector4d quat;              //pose quaternion
+/* pos/quat and vel/quatd are views into 7 contiguous doubles each
+   they point to xlocal/xdlocal while the body is outside a system
+   System::setup() rebinds them into System::x/xd via attach() */
+
+	Eigen::Map<Eigen::Vector3d> pos;   //centroid position in inertial frame
+	Eigen::Map<Eigen::Vector3d> vel;   //centroid velocity in inertial frame
+	Eigen::Map<Eigen::Vector4d> quat;  //pose quaternion
 
 /* omega is calculated according to quatd
    the quatd must be modified when setting omega */
 
-	Eigen::Vector4d quatd;             //time derivative quat
+	Eigen::Map<Eigen::Vector4d> quatd; //time derivative quat
 	Eigen::Vector3d omega;             //angular velocity in body frame
 	double mass;
 	Eigen::Matrix3d inertia;           //inertia in body frame
 
+/* constant external loads added to gravity in System::makeBigF()
+   set by "change body", coupling and table loads are added on top */
+
+	Eigen::Vector3d force;             //external force in inertial frame
+	Eigen::Vector3d torque;            //external torque in body frame
+
 
 	Eigen::Matrix<double, 3, 4> T,Td;  //T: transformation matrix from quatd to omega
 	                                   //Td: time derivative of T
@@ -50,6 +60,9 @@ public:
 	Body(class MUSE *);
 	~Body();
 
+	void attach(double *, double *);   //move state into external x/xd storage
+	void detach();                     //move state back into local storage
+
 
 
 
@@ -62,6 +75,9 @@ public:
 	
 
 private:
+	double xlocal[7];                  //local pos/quat storage when detached
+	double xdlocal[7];                 //local vel/quatd storage when detached
+	void bind(double *, double *);
 public:
 	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 };
@@ -52,9 +52,8 @@ void Change::command(int narg, char** arg)
 void Change::change_body(int narg, char** arg)
 {
     if (narg < 1) error->all(FLERR, "Illegal create body command");
-    for (id = 0; id < muse->nBodies; id++)
-        if (strcmp(arg[0], muse->body[id]->name) == 0) break;
-    if (id == muse->nBodies)
+    id = muse->find_Body(arg[0]);
+    if (id < 0)
     {
         char str[128];
         sprintf(str, "Cannot find body with name: %s", arg[0]);
@@ -119,6 +118,22 @@ void Change::change_body(int narg, char** arg)
             muse->body[id]->set_Omega(wx, wy, wz);
             iarg = iarg + 4;
         }
+        else if (strcmp(arg[iarg], "force") == 0) {
+            if (narg <= iarg + 3) error->all(FLERR, "Illegal change body command");
+            double fx = input->numeric(FLERR, arg[iarg + 1]);
+            double fy = input->numeric(FLERR, arg[iarg + 2]);
+            double fz = input->numeric(FLERR, arg[iarg + 3]);
+            muse->body[id]->force << fx, fy, fz;
+            iarg = iarg + 4;
+        }
+        else if (strcmp(arg[iarg], "torque") == 0) {
+            if (narg <= iarg + 3) error->all(FLERR, "Illegal change body command");
+            double tx = input->numeric(FLERR, arg[iarg + 1]);
+            double ty = input->numeric(FLERR, arg[iarg + 2]);
+            double tz = input->numeric(FLERR, arg[iarg + 3]);
+            muse->body[id]->torque << tx, ty, tz;
+            iarg = iarg + 4;
+        }
         else error->all(FLERR, "Illegal change body command");
     }
 }
@@ -126,9 +141,8 @@ void Change::change_body(int narg, char** arg)
 void Change::change_joint(int narg, char** arg)
 {
     if (narg < 1) error->all(FLERR, "Illegal change joint command");
-    for (id = 0; id < muse->nJoints; id++)
-        if (strcmp(arg[0], muse->joint[id]->name) == 0) break;
-    if (id == muse->nJoints)
+    id = muse->find_Joint(arg[0]);
+    if (id < 0)
     {
         char str[128];
         sprintf(str, "Cannot find joint with name: %s", arg[0]);
@@ -145,10 +159,8 @@ void Change::change_joint(int narg, char** arg)
         }
         else if (strcmp(arg[iarg], "body1") == 0) {
             if (narg <= iarg + 1) error->all(FLERR, "Illegal change joint command");
-            int ibody;
-            for (ibody = 0; ibody < muse->nBodies; ibody++)
-                if (strcmp(arg[iarg + 1], muse->body[ibody]->name) == 0) break;
-            if (ibody < muse->nBodies) {
+            int ibody = muse->find_Body(arg[iarg + 1]);
+            if (ibody >= 0) {
                 muse->joint[id]->body[0] = muse->body[ibody];
             }
             else {
@@ -160,10 +172,8 @@ void Change::change_joint(int narg, char** arg)
         }
         else if (strcmp(arg[iarg], "body2") == 0) {
             if (narg <= iarg + 1) error->all(FLERR, "Illegal change joint command");
-            int ibody;
-            for (ibody = 0; ibody < muse->nBodies; ibody++)
-                if (strcmp(arg[iarg + 1], muse->body[ibody]->name) == 0) break;
-            if (ibody < muse->nBodies) {
+            int ibody = muse->find_Body(arg[iarg + 1]);
+            if (ibody >= 0) {
                 muse->joint[id]->body[1] = muse->body[ibody];
             }
             else {
@@ -44,6 +44,13 @@ Compute::Compute(MUSE *muse, int narg, char **arg) : Pointers(muse)
   style = new char[n];
   strcpy(style, arg[1]);
 
+  nargs = narg;
+  args = new char*[narg];
+  for (int i = 0; i < narg; i++) {
+    args[i] = new char[strlen(arg[i]) + 1];
+    strcpy(args[i],arg[i]);
+  }
+
   // set child class defaults
 
   scalar_flag = vector_flag = array_flag = 0;
@@ -68,6 +75,8 @@ Compute::~Compute()
 
   delete [] name;
   delete [] style;
+  for (int i = 0; i < nargs; i++) delete [] args[i];
+  delete [] args;
   memory->destroy(tlist);
 }
 
@@ -20,6 +20,8 @@ class Compute : protected Pointers {
  public:
 
   char *name,*style;
+  int nargs;                // # of args of the compute command
+  char **args;              // copy of the args, kept for restart files
 
   double scalar;            // computed global scalar
   double *vector;           // computed global vector
@@ -0,0 +1,424 @@
+/* ----------------------------------------------------------------------
+   MUSE - MUltibody System dynamics Engine
+   https://github.com/zhangh3/MUSE
+
+   Zhang He, zhanghecalt@163.com
+   Science and Technology on Space Physics Laboratory, Beijing
+
+   This software is distributed under the GNU General Public License.
+   Copyright (c) 2023 Zhang He. All rights reserved.
+------------------------------------------------------------------------- */
+
+#include "mpi.h"
+#include "stdio.h"
+#include "string.h"
+#include "coupling.h"
+#include "muse.h"
+#include "MUSEsystem.h"
+#include "body.h"
+#include "input.h"
+#include "memory.h"
+#include "error.h"
+
+#ifndef _WIN32
+#include "errno.h"
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "coupling_format.h"
+#endif
+
+using namespace MUSE_NS;
+
+#define SPIN 200.0             // microseconds of polling before blocking
+#define TIMEOUT 60.0
+
+/* ---------------------------------------------------------------------- */
+
+Coupling::Coupling(MUSE *muse) : Pointers(muse)
+{
+  int nprocs;
+  MPI_Comm_size(world,&nprocs);
+  if (nprocs > 1) error->all(FLERR,"Coupling requires a single process");
+
+  every = 1;
+  name = NULL;
+  linear = 1;
+  replace = 0;
+  timeout = TIMEOUT;
+
+  nbody = 0;
+  bodyid = NULL;
+  fd = -1;
+  base = NULL;
+  size = 0;
+  header = NULL;
+  nexchange = 0;
+
+  load0 = load1 = NULL;
+  time0 = time1 = 0.0;
+  nsample = 0;
+
+  ncount = 0;
+  wait_sum = wait_max = 0.0;
+
+  // polling only pays off when the peer runs on another core
+
+  spin = 0.0;
+#ifndef _WIN32
+  if (sysconf(_SC_NPROCESSORS_ONLN) > 1) spin = SPIN;
+#endif
+}
+
+/* ---------------------------------------------------------------------- */
+
+Coupling::~Coupling()
+{
+  destroy();
+  delete [] name;
+  memory->destroy(bodyid);
+  memory->destroy(load0);
+  memory->destroy(load1);
+}
+
+/* ----------------------------------------------------------------------
+   coupling name keyword value ...
+     every N = exchange with the peer every N steps (sub-cycling)
+     loads hold = keep the last loads until the next exchange
+     loads linear = line through the last two load samples, which
+                    interpolates if the peer answers with loads at the end
+                    of the coupling step and extrapolates if it answers
+                    with loads at its start
+     spin US = microseconds to poll for the peer before blocking,
+               default 0 on a single core
+     timeout T = seconds to wait for the peer, 0 = forever
+     replace yes/no = take over a segment of this name left by another
+                      run, default no = error if it exists
+   the segment is created on the next run, all bodies in the system
+   are coupled
+------------------------------------------------------------------------- */
+
+void Coupling::command(int narg, char **arg)
+{
+  if (narg < 1) error->all(FLERR,"Illegal coupling command");
+
+#ifdef _WIN32
+  error->all(FLERR,"Coupling requires POSIX shared memory");
+#endif
+
+  int n = strlen(arg[0]) + 2;
+  char *newname = new char[n];
+  if (arg[0][0] == '/') strcpy(newname,arg[0]);
+  else sprintf(newname,"/%s",arg[0]);
+  if (strchr(newname+1,'/'))
+    error->all(FLERR,"Coupling name cannot contain '/'");
+
+  // a new name starts a new segment, the old peer is let go
+
+  if (name && strcmp(name,newname) != 0) destroy();
+  delete [] name;
+  name = newname;
+
+  int iarg = 1;
+  while (iarg < narg) {
+    if (strcmp(arg[iarg],"every") == 0) {
+      if (iarg+2 > narg) error->all(FLERR,"Illegal coupling command");
+      every = input->inumeric(FLERR,arg[iarg+1]);
+      if (every <= 0) error->all(FLERR,"Illegal coupling every value");
+      iarg += 2;
+    } else if (strcmp(arg[iarg],"loads") == 0) {
+      if (iarg+2 > narg) error->all(FLERR,"Illegal coupling command");
+      if (strcmp(arg[iarg+1],"hold") == 0) linear = 0;
+      else if (strcmp(arg[iarg+1],"linear") == 0) linear = 1;
+      else error->all(FLERR,"Illegal coupling loads value");
+      iarg += 2;
+    } else if (strcmp(arg[iarg],"spin") == 0) {
+      if (iarg+2 > narg) error->all(FLERR,"Illegal coupling command");
+      spin = input->numeric(FLERR,arg[iarg+1]);
+      if (spin < 0.0) error->all(FLERR,"Illegal coupling spin value");
+      iarg += 2;
+    } else if (strcmp(arg[iarg],"timeout") == 0) {
+      if (iarg+2 > narg) error->all(FLERR,"Illegal coupling command");
+      timeout = input->numeric(FLERR,arg[iarg+1]);
+      if (timeout < 0.0) error->all(FLERR,"Illegal coupling timeout value");
+      iarg += 2;
+    } else if (strcmp(arg[iarg],"replace") == 0) {
+      if (iarg+2 > narg) error->all(FLERR,"Illegal coupling command");
+      if (strcmp(arg[iarg+1],"yes") == 0) replace = 1;
+      else if (strcmp(arg[iarg+1],"no") == 0) replace = 0;
+      else error->all(FLERR,"Illegal coupling replace value");
+      iarg += 2;
+    } else error->all(FLERR,"Illegal coupling command");
+  }
+
+  if (base) header->every = every;
+}
+
+/* ----------------------------------------------------------------------
+   called at the start of every solve
+   the peer is built around one set of bodies, so they cannot change
+   while the segment exists
+------------------------------------------------------------------------- */
+
+void Coupling::setup()
+{
+  if (base && !same_layout())
+    error->all(FLERR,"Coupled bodies changed since the coupling started");
+  if (base == NULL) create();
+}
+
+/* ----------------------------------------------------------------------
+   one coupling step: write the state, wake the peer, wait for its loads
+   the loads become the newest sample, the previous one is kept for
+   linear loads
+------------------------------------------------------------------------- */
+
+void Coupling::exchange()
+{
+#ifndef _WIN32
+  System *s = muse->system;
+  int i;
+
+  double *state = (double *) (base + header->state_offset);
+  for (i = 0; i < nbody; i++) {
+    Body *b = s->body[i];
+    double *p = &state[CPL_STATE*i];
+    memcpy(p,b->pos.data(),7*sizeof(double));
+    memcpy(p+7,b->vel.data(),3*sizeof(double));
+    memcpy(p+10,b->omega.data(),3*sizeof(double));
+  }
+  header->exchange = nexchange;
+  header->step = s->ntimestep;
+  header->time = s->timenow;
+
+  struct timespec t0,t1;
+  clock_gettime(CLOCK_MONOTONIC,&t0);
+  sem_post(&header->to_peer);
+  wait_peer();
+  clock_gettime(CLOCK_MONOTONIC,&t1);
+
+  double wait = (t1.tv_sec - t0.tv_sec) + 1.0e-9*(t1.tv_nsec - t0.tv_nsec);
+  wait_sum += wait;
+  wait_max = MAX(wait_max,wait);
+  ncount++;
+
+  double *tmp = load0;
+  load0 = load1;
+  load1 = tmp;
+  time0 = time1;
+  memcpy(load1,base + header->load_offset,CPL_LOAD*nbody*sizeof(double));
+  time1 = header->load_time;
+  if (nsample < 2) nsample++;
+  nexchange++;
+#endif
+}
+
+/* ----------------------------------------------------------------------
+   add the loads of the coupled bodies at time t to the generalized forces
+   called by System::makeBigF() at every RK stage
+------------------------------------------------------------------------- */
+
+void Coupling::loads(double t)
+{
+#ifndef _WIN32
+  if (nsample == 0) return;
+
+  System *s = muse->system;
+  double w = 0.0;
+  if (linear && nsample == 2 && time1 > time0)
+    w = (t - time1) / (time1 - time0);
+
+  double f[CPL_LOAD];
+  for (int i = 0; i < nbody; i++) {
+    const double *p0 = &load0[CPL_LOAD*i];
+    const double *p1 = &load1[CPL_LOAD*i];
+    for (int k = 0; k < CPL_LOAD; k++) f[k] = p1[k] + w*(p1[k] - p0[k]);
+    s->add_load(i,f,f+3);
+  }
+#endif
+}
+
+/* ----------------------------------------------------------------------
+   print handshake statistics since the last report, called after a solve
+   the wait includes the time the peer spends on its own step
+------------------------------------------------------------------------- */
+
+void Coupling::report()
+{
+  if (ncount == 0) return;
+
+  char str[256];
+  snprintf(str,256,"Coupling: %lld exchanges, peer wait %.3g us avg, "
+           "%.3g us max\n",(long long) ncount,1.0e6*wait_sum/ncount,
+           1.0e6*wait_max);
+  if (screen) fputs(str,screen);
+  if (logfile) fputs(str,logfile);
+
+  ncount = 0;
+  wait_sum = wait_max = 0.0;
+}
+
+/* ---------------------------------------------------------------------- */
+
+int Coupling::same_layout()
+{
+  System *s = muse->system;
+
+  if (s->nBodies != nbody) return 0;
+  for (int i = 0; i < nbody; i++)
+    if (s->body[i]->IDinMuse != bodyid[i]) return 0;
+  return 1;
+}
+
+/* ----------------------------------------------------------------------
+   create and map the segment, write its header
+   the magic is written last, a peer that sees it sees a full header
+------------------------------------------------------------------------- */
+
+void Coupling::create()
+{
+#ifndef _WIN32
+  System *s = muse->system;
+  int i;
+
+  nbody = s->nBodies;
+  if (nbody == 0) error->all(FLERR,"Coupling with no bodies in the system");
+
+  int namelen = 8;
+  for (i = 0; i < nbody; i++) {
+    int n = strlen(s->body[i]->name) + 1;
+    if (n > namelen) namelen = (n + 7) / 8 * 8;
+  }
+
+  int64_t name_offset = sizeof(CplHeader);
+  int64_t state_offset = name_offset + (int64_t) nbody*namelen;
+  state_offset = (state_offset + CPL_ALIGN - 1) / CPL_ALIGN * CPL_ALIGN;
+  int64_t load_offset = state_offset + CPL_STATE*nbody*sizeof(double);
+  load_offset = (load_offset + CPL_ALIGN - 1) / CPL_ALIGN * CPL_ALIGN;
+  size = load_offset + CPL_LOAD*nbody*sizeof(double);
+
+  // a peer may still be attached to a segment of this name,
+  // it is only unlinked on request
+
+  if (replace) shm_unlink(name);
+  fd = shm_open(name,O_CREAT | O_EXCL | O_RDWR,0600);
+  if (fd < 0 && errno == EEXIST) {
+    char str[128];
+    snprintf(str,128,"Shared memory segment %s exists, "
+             "use coupling replace yes",name);
+    error->one(FLERR,str);
+  }
+  if (fd < 0 || ftruncate(fd,size) != 0) {
+    char str[128];
+    snprintf(str,128,"Cannot create shared memory segment %s",name);
+    error->one(FLERR,str);
+  }
+  void *ptr = mmap(NULL,size,PROT_READ | PROT_WRITE,MAP_SHARED,fd,0);
+  if (ptr == MAP_FAILED) {
+    char str[128];
+    snprintf(str,128,"Cannot map shared memory segment %s",name);
+    error->one(FLERR,str);
+  }
+  base = (char *) ptr;
+  header = (CplHeader *) base;
+
+  header->version = CPL_VERSION;
+  header->nbody = nbody;
+  header->namelen = namelen;
+  header->every = every;
+  header->dt = s->dt;
+  header->name_offset = name_offset;
+  header->state_offset = state_offset;
+  header->load_offset = load_offset;
+  header->exchange = -1;
+  header->step = s->ntimestep;
+  header->time = s->timenow;
+  header->load_time = s->timenow;
+  header->live.store(1,std::memory_order_relaxed);
+  if (sem_init(&header->to_peer,1,0) != 0 ||
+      sem_init(&header->to_muse,1,0) != 0)
+    error->one(FLERR,"Cannot create coupling semaphores");
+
+  memory->destroy(bodyid);
+  memory->create(bodyid,nbody,"coupling:bodyid");
+  for (i = 0; i < nbody; i++) {
+    strncpy(base + name_offset + (int64_t) i*namelen,s->body[i]->name,
+            namelen);
+    bodyid[i] = s->body[i]->IDinMuse;
+  }
+
+  memory->destroy(load0);
+  memory->destroy(load1);
+  memory->create(load0,CPL_LOAD*nbody,"coupling:load0");
+  memory->create(load1,CPL_LOAD*nbody,"coupling:load1");
+  nsample = 0;
+  nexchange = 0;
+
+  std::atomic_thread_fence(std::memory_order_release);
+  memcpy(header->magic,CPL_MAGIC,8);
+#endif
+}
+
+/* ----------------------------------------------------------------------
+   tell the peer MUSE is gone, unmap the segment and remove its name
+   the semaphores are left alone, the peer may still be waiting on one
+------------------------------------------------------------------------- */
+
+void Coupling::destroy()
+{
+  if (base == NULL) return;
+
+#ifndef _WIN32
+  header->live.store(0,std::memory_order_release);
+  sem_post(&header->to_peer);
+  munmap(base,size);
+  ::close(fd);
+  shm_unlink(name);
+#endif
+  base = NULL;
+  header = NULL;
+  fd = -1;
+  size = 0;
+}
+
+/* ----------------------------------------------------------------------
+   wait until the peer posts its loads
+   polling first keeps the handshake in user space while the peer is
+   quick, a blocked wait costs a futex wake-up on the other side
+------------------------------------------------------------------------- */
+
+void Coupling::wait_peer()
+{
+#ifndef _WIN32
+  struct timespec ts;
+  if (spin > 0.0) {
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    double t0 = ts.tv_sec + 1.0e-9*ts.tv_nsec;
+    for (int i = 0; ; i++) {
+      if (sem_trywait(&header->to_muse) == 0) return;
+      if (i % 64) continue;
+      clock_gettime(CLOCK_MONOTONIC,&ts);
+      if (ts.tv_sec + 1.0e-9*ts.tv_nsec - t0 > 1.0e-6*spin) break;
+    }
+  }
+
+  if (timeout == 0.0) {
+    while (sem_wait(&header->to_muse) != 0)
+      if (errno != EINTR) error->one(FLERR,"Coupling wait failed");
+    return;
+  }
+
+  clock_gettime(CLOCK_REALTIME,&ts);
+  double t = ts.tv_nsec*1.0e-9 + timeout;
+  ts.tv_sec += (time_t) t;
+  ts.tv_nsec = (long) ((t - (time_t) t)*1.0e9);
+
+  while (sem_timedwait(&header->to_muse,&ts) != 0) {
+    if (errno == EINTR) continue;
+    if (errno == ETIMEDOUT)
+      error->one(FLERR,"Coupling peer did not answer within the timeout");
+    error->one(FLERR,"Coupling wait failed");
+  }
+#endif
+}
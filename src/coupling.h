@@ -0,0 +1,71 @@
+/* ----------------------------------------------------------------------
+   MUSE - MUltibody System dynamics Engine
+   https://github.com/zhangh3/MUSE
+
+   Zhang He, zhanghecalt@163.com
+   Science and Technology on Space Physics Laboratory, Beijing
+
+   This software is distributed under the GNU General Public License.
+   Copyright (c) 2023 Zhang He. All rights reserved.
+------------------------------------------------------------------------- */
+
+#ifndef MUSE_COUPLING_H
+#define MUSE_COUPLING_H
+
+#include "stdint.h"
+#include "pointers.h"
+
+struct CplHeader;
+
+namespace MUSE_NS {
+
+/* co-simulation with an external solver, e.g. unsteady CFD
+   every N steps the body states are handed to the peer process through
+   POSIX shared memory and the solver waits for the loads it returns,
+   see coupling_format.h; between exchanges the loads are held or
+   interpolated/extrapolated linearly in time at every RK stage */
+
+class Coupling : protected Pointers {
+ public:
+  int every;                   // MUSE steps per coupling step
+
+  Coupling(class MUSE *);
+  ~Coupling();
+  void command(int, char **);
+  void setup();                // create the segment on the first run
+  void exchange();             // hand over the state, wait for the loads
+  void loads(double);          // add the loads at a given time to F
+  void report();               // handshake statistics of the last solve
+
+ private:
+  char *name;                  // segment name, starts with '/'
+  int linear;                  // 1 = linear in time, 0 = hold last loads
+  int replace;                 // 1 = unlink an existing segment of this name
+  double spin;                 // microseconds to poll before blocking
+  double timeout;              // seconds to wait for the peer, 0 = forever
+
+  int nbody;                   // layout of the mapped segment
+  int *bodyid;                 // IDinMuse of the coupled bodies
+
+  int fd;
+  char *base;                  // mapped segment, NULL if none
+  int64_t size;
+  CplHeader *header;
+  int64_t nexchange;           // # of exchanges done
+
+  double *load0,*load1;        // last two load samples, CPL_LOAD per body
+  double time0,time1;          // and their times
+  int nsample;
+
+  int64_t ncount;              // handshakes since the last report
+  double wait_sum,wait_max;    // and their wall time in seconds
+
+  int same_layout();
+  void create();
+  void destroy();
+  void wait_peer();
+};
+
+}
+
+#endif
@@ -0,0 +1,67 @@
+/* ----------------------------------------------------------------------
+   MUSE - MUltibody System dynamics Engine
+   https://github.com/zhangh3/MUSE
+
+   Zhang He, zhanghecalt@163.com
+   Science and Technology on Space Physics Laboratory, Beijing
+
+   This software is distributed under the GNU General Public License.
+   Copyright (c) 2023 Zhang He. All rights reserved.
+------------------------------------------------------------------------- */
+
+#ifndef MUSE_COUPLING_FORMAT_H
+#define MUSE_COUPLING_FORMAT_H
+
+#include "stdint.h"
+#include <atomic>
+#include <semaphore.h>
+
+/* layout of the POSIX shared memory segment of the "coupling" command,
+   shared by Coupling and the peer process (tools/muse_cfd_mock)
+
+     CplHeader                       at offset 0
+     char name[nbody][namelen]       at name_offset
+     double state[nbody][CPL_STATE]  at state_offset, written by MUSE
+     double load[nbody][CPL_LOAD]    at load_offset, written by the peer
+
+   one exchange per coupling step, k = 0,1,...
+     MUSE  writes step, time, exchange = k and state, posts to_peer
+     peer  waits on to_peer, reads the state, writes load_time and load,
+           posts to_muse
+     MUSE  waits on to_muse and reads the loads
+   the semaphores order the two sides, so the arrays need no locking
+   live = 0 and a last post on to_peer tell the peer MUSE is gone
+
+   state per body: pos(3) quat(4) vel(3) omega(3), as in Body
+   load per body:  force(3) in inertial frame, torque(3) in body frame
+   load_time is the simulation time the loads belong to */
+
+#define CPL_MAGIC "MUSECPL"
+#define CPL_VERSION 1
+#define CPL_ALIGN 64
+#define CPL_STATE 13
+#define CPL_LOAD 6
+
+struct CplHeader {
+  char magic[8];                 // CPL_MAGIC, set last
+  int32_t version;               // CPL_VERSION
+  int32_t nbody;                 // # of coupled bodies
+  int32_t namelen;               // bytes per body name
+  int32_t every;                 // MUSE steps per coupling step
+  double dt;                     // MUSE timestep
+  int64_t name_offset;           // offset of the body names
+  int64_t state_offset;          // offset of state[0][0]
+  int64_t load_offset;           // offset of load[0][0]
+
+  int64_t exchange;              // index k of the current exchange
+  int64_t step;                  // MUSE timestep of the state
+  double time;                   // simulation time of the state
+  double load_time;              // simulation time of the loads
+
+  std::atomic<int32_t> live;     // 1 while MUSE is attached
+  int32_t pad;
+  alignas(CPL_ALIGN) sem_t to_peer;   // posted by MUSE, state is ready
+  alignas(CPL_ALIGN) sem_t to_muse;   // posted by the peer, loads are ready
+};
+
+#endif
@@ -19,6 +19,8 @@
 #include "MUSEsystem.h"
 #include "input.h"
 #include "joint_enums.h"
+#include "muse.h"
+#include "memory.h"
 
 #include <iostream>
 
@@ -42,6 +44,8 @@ void Create::command(int narg, char** arg)
     if (narg < 1) error->all(FLERR, "Illegal change command");
     if (strcmp(arg[0], "body") == 0) create_body(narg - 1, &arg[1]);
     else if (strcmp(arg[0], "joint") == 0)  create_joint(narg - 1, &arg[1]);
+    else if (strcmp(arg[0], "chain") == 0)  create_chain(narg - 1, &arg[1]);
+    else if (strcmp(arg[0], "replicate") == 0)  create_replicate(narg - 1, &arg[1]);
     else {
         char str[128];
         sprintf(str, "Illegal create type: %s", arg[1]);
@@ -139,10 +143,8 @@ void Create::create_joint(int narg, char** arg)
     while (iarg < narg) {
         if (strcmp(arg[iarg], "body1") == 0) {
             if (narg <= iarg + 1) error->all(FLERR, "Illegal create joint command");
-            int ibody;
-            for (ibody = 0; ibody < muse->nBodies; ibody++)
-                if (strcmp(arg[iarg + 1], muse->body[ibody]->name) == 0) break;
-            if (ibody < muse->nBodies) {
+            int ibody = muse->find_Body(arg[iarg + 1]);
+            if (ibody >= 0) {
                 muse->joint[id]->body[0] = muse->body[ibody];
             }
             else {
@@ -154,10 +156,8 @@ void Create::create_joint(int narg, char** arg)
         }
         else if (strcmp(arg[iarg], "body2") == 0) {
             if (narg <= iarg + 1) error->all(FLERR, "Illegal create joint command");
-            int ibody;
-            for (ibody = 0; ibody < muse->nBodies; ibody++)
-                if (strcmp(arg[iarg + 1], muse->body[ibody]->name) == 0) break;
-            if (ibody < muse->nBodies) {
+            int ibody = muse->find_Body(arg[iarg + 1]);
+            if (ibody >= 0) {
                 muse->joint[id]->body[1] = muse->body[ibody];
             }
             else {
@@ -204,4 +204,251 @@ void Create::create_joint(int narg, char** arg)
 
 }
 
+/* ----------------------------------------------------------------------
+   create chain ID N template B offset dx dy dz keyword values ...
+     N links ID_1 ... ID_N copy body B, link k sits at B's position
+     plus (k-1) times the offset
+     joint type = joint ID_jk links ID_k (body1) to ID_k+1 (body2)
+     point1/point2/axis1/axis2 x y z = joint geometry as in create joint
+     system yes/no = add links and joints to the system, default yes
+   all names are generated, nothing is looked up per link
+------------------------------------------------------------------------- */
+
+void Create::create_chain(int narg, char** arg)
+{
+    if (narg < 8) error->all(FLERR, "Illegal create chain command");
+    check_name(arg[0]);
+    int nlink = input->inumeric(FLERR, arg[1]);
+    if (nlink < 1) error->all(FLERR, "Illegal create chain link count");
+    if (strcmp(arg[2], "template") != 0 || strcmp(arg[4], "offset") != 0)
+        error->all(FLERR, "Illegal create chain command");
+    int itemplate = muse->find_Body(arg[3]);
+    if (itemplate < 0) {
+        char str[128];
+        sprintf(str, "Cannot find body with name: %s", arg[3]);
+        error->all(FLERR, str);
+    }
+    Eigen::Vector3d offset;
+    offset << input->numeric(FLERR, arg[5]),
+              input->numeric(FLERR, arg[6]),
+              input->numeric(FLERR, arg[7]);
+
+    // joint pattern, kept in a joint that is not part of the model
+
+    Joint pattern(muse);
+    int jointflag = 0;
+    int systemflag = 1;
+
+    int iarg = 8;
+    while (iarg < narg) {
+        if (strcmp(arg[iarg], "joint") == 0) {
+            if (narg <= iarg + 1) error->all(FLERR, "Illegal create chain command");
+            pattern.set_type_by_name(arg[iarg + 1]);
+            if (pattern.get_type() == GROUND)
+                error->all(FLERR, "Create chain joint cannot be ground");
+            jointflag = 1;
+            iarg = iarg + 2;
+        }
+        else if (strcmp(arg[iarg], "point1") == 0 || strcmp(arg[iarg], "point2") == 0 ||
+                 strcmp(arg[iarg], "axis1") == 0 || strcmp(arg[iarg], "axis2") == 0) {
+            if (narg <= iarg + 3) error->all(FLERR, "Illegal create chain command");
+            double px = input->numeric(FLERR, arg[iarg + 1]);
+            double py = input->numeric(FLERR, arg[iarg + 2]);
+            double pz = input->numeric(FLERR, arg[iarg + 3]);
+            if (strcmp(arg[iarg], "point1") == 0) pattern.point1 << px, py, pz;
+            else if (strcmp(arg[iarg], "point2") == 0) pattern.point2 << px, py, pz;
+            else if (strcmp(arg[iarg], "axis1") == 0) pattern.set_axis(px, py, pz, 1);
+            else pattern.set_axis(px, py, pz, 2);
+            iarg = iarg + 4;
+        }
+        else if (strcmp(arg[iarg], "system") == 0) {
+            if (narg <= iarg + 1) error->all(FLERR, "Illegal create chain command");
+            if (strcmp(arg[iarg + 1], "yes") == 0) systemflag = 1;
+            else if (strcmp(arg[iarg + 1], "no") == 0) systemflag = 0;
+            else error->all(FLERR, "Illegal create chain command");
+            iarg = iarg + 2;
+        }
+        else error->all(FLERR, "Illegal create chain command");
+    }
+
+    int njoint = jointflag ? nlink - 1 : 0;
+    muse->reserve(nlink, njoint);
+    if (systemflag) muse->system->reserve(nlink, njoint);
+
+    int n = strlen(arg[0]) + 16;
+    char *name = new char[n];
+    int ibody0 = muse->nBodies;
+
+    for (int k = 0; k < nlink; k++) {
+        sprintf(name, "%s_%d", arg[0], k + 1);
+        id = muse->add_Body(name);
+        copy_body(muse->body[itemplate], muse->body[id], k * offset);
+        if (systemflag) muse->system->add_Body(muse->body[id]);
+    }
+
+    for (int k = 0; k < njoint; k++) {
+        sprintf(name, "%s_j%d", arg[0], k + 1);
+        id = muse->add_Joint(name);
+        copy_joint(&pattern, muse->joint[id]);
+        muse->joint[id]->body[0] = muse->body[ibody0 + k];
+        muse->joint[id]->body[1] = muse->body[ibody0 + k + 1];
+        if (systemflag) muse->system->add_Joint(muse->joint[id]);
+    }
+
+    delete[] name;
+}
+
+/* ----------------------------------------------------------------------
+   create replicate N offset dx dy dz bodies B ... /bodies
+                                      [joints J ... /joints] [system yes/no]
+     copy k = 1 ... N of the pattern is shifted by k times the offset,
+     copies are named NAME_k after the originals
+     a joint between pattern bodies joins their copies, a joint to a body
+     outside the pattern, e.g. a hub or ground, keeps that body
+     system yes/no = add the copies to the system, default yes
+------------------------------------------------------------------------- */
+
+void Create::create_replicate(int narg, char** arg)
+{
+    if (narg < 6) error->all(FLERR, "Illegal create replicate command");
+    int ncopy = input->inumeric(FLERR, arg[0]);
+    if (ncopy < 1) error->all(FLERR, "Illegal create replicate copy count");
+    if (strcmp(arg[1], "offset") != 0) error->all(FLERR, "Illegal create replicate command");
+    Eigen::Vector3d offset;
+    offset << input->numeric(FLERR, arg[2]),
+              input->numeric(FLERR, arg[3]),
+              input->numeric(FLERR, arg[4]);
+
+    int nbody = 0, njoint = 0;
+    int *bodies = NULL, *joints = NULL;
+    int systemflag = 1;
 
+    int iarg = 5;
+    while (iarg < narg) {
+        if (strcmp(arg[iarg], "bodies") == 0 || strcmp(arg[iarg], "joints") == 0) {
+            int bodyflag = (arg[iarg][0] == 'b');
+            const char *end = bodyflag ? "/bodies" : "/joints";
+            int count = 1;
+            while (iarg + count < narg && strcmp(arg[iarg + count], end) != 0) count++;
+            if (iarg + count == narg) error->all(FLERR, "Illegal create replicate command");
+            int *list;
+            memory->create(list, count - 1, "create:list");
+            for (int i = 1; i < count; i++) {
+                list[i - 1] = bodyflag ? muse->find_Body(arg[iarg + i]) :
+                    muse->find_Joint(arg[iarg + i]);
+                if (list[i - 1] < 0) {
+                    char str[128];
+                    sprintf(str, "Cannot find %s with name: %s",
+                            bodyflag ? "body" : "joint", arg[iarg + i]);
+                    error->all(FLERR, str);
+                }
+            }
+            if (bodyflag) {
+                memory->destroy(bodies);
+                bodies = list;
+                nbody = count - 1;
+            } else {
+                memory->destroy(joints);
+                joints = list;
+                njoint = count - 1;
+            }
+            iarg = iarg + count + 1;
+        }
+        else if (strcmp(arg[iarg], "system") == 0) {
+            if (narg <= iarg + 1) error->all(FLERR, "Illegal create replicate command");
+            if (strcmp(arg[iarg + 1], "yes") == 0) systemflag = 1;
+            else if (strcmp(arg[iarg + 1], "no") == 0) systemflag = 0;
+            else error->all(FLERR, "Illegal create replicate command");
+            iarg = iarg + 2;
+        }
+        else error->all(FLERR, "Illegal create replicate command");
+    }
+    if (nbody == 0) error->all(FLERR, "Create replicate needs at least one body");
+
+    // copy of pattern body i is at ibody0 + k*nbody + i,
+    // slot[] maps a body's IDinMuse to its place in the pattern
+
+    int *slot;
+    memory->create(slot, muse->nBodies, "create:slot");
+    for (int i = 0; i < muse->nBodies; i++) slot[i] = -1;
+    for (int i = 0; i < nbody; i++) slot[bodies[i]] = i;
+
+    muse->reserve(ncopy * nbody, ncopy * njoint);
+    if (systemflag) muse->system->reserve(ncopy * nbody, ncopy * njoint);
+
+    int maxname = 0;
+    for (int i = 0; i < nbody; i++)
+        maxname = MAX(maxname, (int) strlen(muse->body[bodies[i]]->name));
+    for (int i = 0; i < njoint; i++)
+        maxname = MAX(maxname, (int) strlen(muse->joint[joints[i]]->name));
+    char *name = new char[maxname + 16];
+    int ibody0 = muse->nBodies;
+
+    for (int k = 0; k < ncopy; k++) {
+        for (int i = 0; i < nbody; i++) {
+            Body *from = muse->body[bodies[i]];
+            sprintf(name, "%s_%d", from->name, k + 1);
+            id = muse->add_Body(name);
+            copy_body(from, muse->body[id], (k + 1) * offset);
+            if (systemflag) muse->system->add_Body(muse->body[id]);
+        }
+        for (int i = 0; i < njoint; i++) {
+            Joint *from = muse->joint[joints[i]];
+            sprintf(name, "%s_%d", from->name, k + 1);
+            id = muse->add_Joint(name);
+            Joint *to = muse->joint[id];
+            copy_joint(from, to);
+            for (int m = 0; m < 2; m++) {
+                if (!from->body[m]) continue;
+                int islot = slot[from->body[m]->IDinMuse];
+                to->body[m] = (islot >= 0) ? muse->body[ibody0 + k * nbody + islot] :
+                    from->body[m];
+            }
+            if (systemflag) muse->system->add_Joint(to);
+        }
+    }
+
+    delete[] name;
+    memory->destroy(slot);
+    memory->destroy(bodies);
+    memory->destroy(joints);
+}
+
+/* ----------------------------------------------------------------------
+   name check shared by generated models
+------------------------------------------------------------------------- */
+
+void Create::check_name(const char *name)
+{
+    for (int i = 0; name[i]; i++)
+        if (!isalnum(name[i]) && name[i] != '_')
+            error->all(FLERR, "Name must be alphanumeric or underscore characters");
+}
+
+/* ----------------------------------------------------------------------
+   copy mass properties, state and loads, shifted by an offset
+------------------------------------------------------------------------- */
+
+void Create::copy_body(Body *from, Body *to, const Eigen::Vector3d &offset)
+{
+    to->mass = from->mass;
+    to->inertia = from->inertia;
+    to->pos = from->pos + offset;
+    to->vel = from->vel;
+    to->quat = from->quat;
+    to->quatd = from->quatd;
+    to->omega = from->omega;
+    to->force = from->force;
+    to->torque = from->torque;
+}
+
+/* ---------------------------------------------------------------------- */
+
+void Create::copy_joint(Joint *from, Joint *to)
+{
+    to->set_type(from->get_type());
+    to->point1 = from->point1;
+    to->point2 = from->point2;
+    to->axis1 = from->axis1;
+    to->axis2 = from->axis2;
+}
@@ -19,6 +19,7 @@ CommandStyle(create,Create)
 #define MUSE_CREATE_H
 
 #include "pointers.h"
+#include "Eigen/Eigen"
 
 namespace MUSE_NS {
 
@@ -29,6 +30,13 @@ class Create : protected Pointers {
 	 void command(int, char**);
 	 void create_body(int, char**);
 	 void create_joint(int, char**);
+	 void create_chain(int, char**);      // N linked copies of a template body
+	 void create_replicate(int, char**);  // N shifted copies of bodies and joints
+
+ private:
+	 void check_name(const char *);
+	 void copy_body(class Body *, class Body *, const Eigen::Vector3d &);
+	 void copy_joint(class Joint *, class Joint *);
 };
 
 }
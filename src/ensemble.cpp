@@ -11,9 +11,13 @@
 
 
 #include "mpi.h"
+#include "stdlib.h"
+#include "string.h"
+#include "stdio.h"
 #include "ensemble.h"
 #include "memory.h"
 #include "random_mars.h"
+#include "error.h"
 
 using namespace MUSE_NS;
 
@@ -25,7 +29,13 @@ Ensemble::Ensemble(MUSE *muse, MPI_Comm communicator) : Pointers(muse)
 
   uscreen = stdout;
   ulogfile = NULL;
-  nSim = 1;
+  existflag = 0;
+  nSim = 0;
+  iSim = 0;
+  procs_per_sim = NULL;
+  root_proc = NULL;
+  strcpy(resfile,"res.txt");
+
   ranmaster = new RanMars(muse);
 
 }
@@ -35,4 +45,63 @@ Ensemble::Ensemble(MUSE *muse, MPI_Comm communicator) : Pointers(muse)
 Ensemble::~Ensemble()
 {
 	delete ranmaster;
+	memory->sfree(procs_per_sim);
+	memory->sfree(root_proc);
+}
+
+/* ----------------------------------------------------------------------
+   add 1 or more simulations to universe
+   str == NULL -> add 1 simulation with all procs in universe
+   str = NxM -> add N simulations, each with M procs
+   str = P -> add 1 simulation with P procs
+------------------------------------------------------------------------- */
+
+void Ensemble::add_sim(char *str)
+{
+  int n,nper;
+  char *ptr;
+
+  if (str == NULL) {
+    n = 1;
+    nper = nprocs;
+  } else if ((ptr = strchr(str,'x')) != NULL) {
+    *ptr = '\0';
+    n = atoi(str);
+    nper = atoi(ptr+1);
+    *ptr = 'x';
+  } else {
+    n = 1;
+    nper = atoi(str);
+  }
+
+  if (n < 1 || nper < 1) error->all(FLERR,"Invalid command-line argument");
+
+  procs_per_sim = (int *) memory->srealloc(procs_per_sim,(nSim+n)*sizeof(int),
+                                           "ensemble:procs_per_sim");
+  root_proc = (int *) memory->srealloc(root_proc,(nSim+n)*sizeof(int),
+                                       "ensemble:root_proc");
+
+  for (int i = 0; i < n; i++) {
+    procs_per_sim[nSim] = nper;
+    if (nSim) root_proc[nSim] = root_proc[nSim-1] + procs_per_sim[nSim-1];
+    else root_proc[nSim] = 0;
+
+    if (me >= root_proc[nSim] && me < root_proc[nSim] + procs_per_sim[nSim])
+      iSim = nSim;
+    nSim++;
+  }
+
+  if (nSim > 1) sprintf(resfile,"res.txt.%d",iSim);
+}
+
+/* ----------------------------------------------------------------------
+   check if total procs in all simulations = procs in universe
+------------------------------------------------------------------------- */
+
+int Ensemble::consistent()
+{
+  int n = 0;
+  for (int i = 0; i < nSim; i++) n += procs_per_sim[i];
+  if (n == nprocs) return 1;
+  else return 0;
 }
@@ -25,12 +25,19 @@ class Ensemble : protected Pointers {
   FILE *uscreen;          // universe screen output
   FILE *ulogfile;         // universe logfile
 
-  int nSim;            // Simulations number
+  int existflag;          // 1 if -partition was used on command line
+  int nSim;               // # of simulations (partitions) in universe
+  int iSim;               // which simulation I belong to
+  int *procs_per_sim;     // # of procs in each simulation
+  int *root_proc;         // root proc of each simulation in universe
+  char resfile[32];       // result file of my simulation
 
   class RanMars* ranmaster;   // master random number generator
 
   Ensemble(class MUSE *, MPI_Comm);
   ~Ensemble();
+  void add_sim(char *);
+  int consistent();
 };
 
 }
@@ -0,0 +1,139 @@
+/* ----------------------------------------------------------------------
+   MUSE - MUltibody System dynamics Engine
+   https://github.com/zhangh3/MUSE
+
+   Zhang He, zhanghecalt@163.com
+   Science and Technology on Space Physics Laboratory, Beijing
+
+   This software is distributed under the GNU General Public License.
+   Copyright (c) 2023 Zhang He. All rights reserved.
+------------------------------------------------------------------------- */
+
+#include "mpi.h"
+#include "ensemble_runner.h"
+#include "thread_pool.h"
+#include "muse.h"
+#include "MUSEsystem.h"
+#include "ensemble.h"
+#include "random_mars.h"
+#include "timer.h"
+#include "memory.h"
+#include "error.h"
+#include "Eigen/Eigen"
+
+using namespace MUSE_NS;
+
+/* ----------------------------------------------------------------------
+   clone the model of muse into nmembers instances
+   member i gets RanMars seed + i
+------------------------------------------------------------------------- */
+
+EnsembleRunner::EnsembleRunner(MUSE *muse, int nmember_in, int nworker_in,
+                               int seed) : Pointers(muse)
+{
+  if (nmember_in < 1) error->all(FLERR,"Ensemble must have at least one member");
+  if (nworker_in < 1) error->all(FLERR,"Ensemble must have at least one worker");
+  if (seed <= 0) error->all(FLERR,"Ensemble seed must be a positive value");
+
+  nmembers = nmember_in;
+  nworkers = nworker_in;
+  nsteps = 0;
+
+  // Eigen keeps lazily initialized statics, set them up before threads start
+
+  Eigen::initParallel();
+
+  // clones are built on this thread, input/variable code is not reentrant
+
+  member = new MUSE*[nmembers];
+  for (int i = 0; i < nmembers; i++) {
+    member[i] = new MUSE(muse,MPI_COMM_SELF);
+    member[i]->ensemble->ranmaster->init(seed + i);
+  }
+
+  ncol = 21 * muse->system->nBodies + 1;
+  memory->create(cpu,nmembers,"ensemble:cpu");
+  memory->create(result,nmembers,ncol,"ensemble:result");
+  for (int i = 0; i < nmembers; i++) cpu[i] = 0.0;
+
+  pool = new ThreadPool(nworkers);
+}
+
+/* ---------------------------------------------------------------------- */
+
+EnsembleRunner::~EnsembleRunner()
+{
+  delete pool;
+  for (int i = 0; i < nmembers; i++) delete member[i];
+  delete [] member;
+  memory->destroy(cpu);
+  memory->destroy(result);
+}
+
+/* ----------------------------------------------------------------------
+   advance every member by n steps
+   prerun(member,i,ptr) is called for each member before its setup,
+   typically to perturb the initial state with member->ensemble->ranmaster
+   setup runs serially, only the time integration runs on the pool
+------------------------------------------------------------------------- */
+
+void EnsembleRunner::run(int n, MemberFn prerun, void *ptr)
+{
+  if (n < 0) error->all(FLERR,"Invalid ensemble run N value");
+  nsteps = n;
+
+  for (int i = 0; i < nmembers; i++) {
+    MUSE *m = member[i];
+    System *s = m->system;
+    if (prerun) prerun(m,i,ptr);
+
+    s->nsteps = nsteps;
+    s->firststep = s->ntimestep;
+    s->laststep = s->ntimestep + nsteps;
+    s->beginstep = s->firststep;
+    s->endstep = s->laststep;
+    s->nthreads = 1;
+
+    m->init();
+    s->setup();
+    m->timer->init();
+
+    // result rows are sized from the source model
+
+    if (3 * s->x.size() + 1 != ncol)
+      error->all(FLERR,"Ensemble member changed its number of bodies");
+  }
+
+  // members already fill the cores, keep Eigen itself single threaded
+
+  int eigen_threads = Eigen::nbThreads();
+  Eigen::setNbThreads(1);
+  pool->run(nmembers,solve_member,this);
+  Eigen::setNbThreads(eigen_threads);
+
+  for (int i = 0; i < nmembers; i++) {
+    System *s = member[i]->system;
+    int nstate = s->x.size();
+    result[i][0] = s->timenow;
+    for (int k = 0; k < nstate; k++) {
+      result[i][1 + k] = s->x(k);
+      result[i][1 + nstate + k] = s->xd(k);
+      result[i][1 + 2 * nstate + k] = s->xdd(k);
+    }
+    cpu[i] = member[i]->timer->array[TIME_LOOP];
+  }
+}
+
+/* ----------------------------------------------------------------------
+   pool task: integrate one member, touches only that member's data
+------------------------------------------------------------------------- */
+
+void EnsembleRunner::solve_member(int imember, int /*iworker*/, void *ptr)
+{
+  EnsembleRunner *runner = (EnsembleRunner *) ptr;
+  MUSE *m = runner->member[imember];
+
+  double t0 = MPI_Wtime();
+  m->system->solve(runner->nsteps);
+  m->timer->array[TIME_LOOP] = MPI_Wtime() - t0;
+}
@@ -0,0 +1,47 @@
+/* ----------------------------------------------------------------------
+   MUSE - MUltibody System dynamics Engine
+   https://github.com/zhangh3/MUSE
+
+   Zhang He, zhanghecalt@163.com
+   Science and Technology on Space Physics Laboratory, Beijing
+
+   This software is distributed under the GNU General Public License.
+   Copyright (c) 2023 Zhang He. All rights reserved.
+------------------------------------------------------------------------- */
+
+#ifndef MUSE_ENSEMBLE_RUNNER_H
+#define MUSE_ENSEMBLE_RUNNER_H
+
+#include "pointers.h"
+
+namespace MUSE_NS {
+
+/* runs nmembers independent copies of a set-up model on a thread pool
+   every member is a full MUSE instance with its own System, x/xd/xdd
+   and RanMars stream (seed + imember), so members share no mutable state */
+
+class EnsembleRunner : protected Pointers {
+ public:
+  typedef void (*MemberFn)(MUSE *member, int imember, void *ptr);
+
+  int nmembers;
+  int nworkers;
+  MUSE **member;               // independent model copies
+  double *cpu;                 // solve time of each member (sec)
+  int ncol;                    // length of one result row
+  double **result;             // final [timenow, x, xd, xdd] of each member
+
+  EnsembleRunner(class MUSE *, int, int, int);
+  ~EnsembleRunner();
+  void run(int, MemberFn = NULL, void * = NULL);
+
+ private:
+  class ThreadPool *pool;
+  int nsteps;
+
+  static void solve_member(int, int, void *);
+};
+
+}
+
+#endif
@@ -12,6 +12,7 @@
 #include "mpi.h"
 #include "error.h"
 #include "ensemble.h"
+#include "output.h"
 
 using namespace MUSE_NS;
 Error::Error(MUSE *muse) : Pointers(muse) {}
@@ -24,6 +25,10 @@ void Error::all(const char *file, int line, const char *str)
   int me;
   MPI_Comm_rank(world,&me);
 
+  // lines still queued for the background writer come first
+
+  if (output) output->drain();
+
   if (me == 0) {
     if (screen) fprintf(screen,"ERROR: %s (%s:%d)\n",str,file,line);
     if (logfile) fprintf(logfile,"ERROR: %s (%s:%d)\n",str,file,line);
@@ -32,6 +37,15 @@ void Error::all(const char *file, int line, const char *str)
   if (screen && screen != stdout) fclose(screen);
   if (logfile) fclose(logfile);
 
+  // other partitions may still be running, finalize would hang
+
+  if (ensemble->nSim > 1) {
+    if (me == 0 && ensemble->uscreen)
+      fprintf(ensemble->uscreen,"ERROR on partition %d: %s (%s:%d)\n",
+              ensemble->iSim,str,file,line);
+    MPI_Abort(ensemble->world,1);
+  }
+
   MPI_Finalize();
   exit(1);
 }
@@ -41,9 +55,10 @@ void Error::one(const char *file, int line, const char *str)
 {
   int me;
   MPI_Comm_rank(world,&me);
+  if (output) output->drain();
   if (screen) fprintf(screen,"ERROR on proc %d: %s (%s:%d)\n",me,str,file,line);
   if (logfile) fprintf(logfile,"ERROR on proc %d: %s (%s:%d)\n",me,str,file,line);
-  MPI_Abort(world,1);
+  MPI_Abort(ensemble->world,1);
 }
 
 
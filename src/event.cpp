@@ -0,0 +1,256 @@
+/* ----------------------------------------------------------------------
+   MUSE - MUltibody System dynamics Engine
+   https://github.com/zhangh3/MUSE
+
+   Zhang He, zhanghecalt@163.com
+   Science and Technology on Space Physics Laboratory, Beijing
+
+   This software is distributed under the GNU General Public License.
+   Copyright (c) 2023 Zhang He. All rights reserved.
+------------------------------------------------------------------------- */
+
+#include "stdio.h"
+#include "string.h"
+#include "math.h"
+#include "event.h"
+#include "muse.h"
+#include "MUSEsystem.h"
+#include "input.h"
+#include "variable.h"
+#include "modify.h"
+#include "output.h"
+#include "trajectory.h"
+#include "memory.h"
+#include "error.h"
+
+using namespace MUSE_NS;
+
+enum{STEP,TIME,WHEN};
+
+#define DELTA 4
+#define TIMETOL 1.0e-6         // fraction of dt a time trigger may be early
+
+/* ---------------------------------------------------------------------- */
+
+Event::Event(MUSE *muse) : Pointers(muse)
+{
+  nevent = maxevent = 0;
+  events = NULL;
+  nwhen = 0;
+  firing = 0;
+}
+
+/* ---------------------------------------------------------------------- */
+
+Event::~Event()
+{
+  while (nevent) remove(nevent-1);
+  memory->sfree(events);
+}
+
+/* ----------------------------------------------------------------------
+   event ID step N [every M] command1 command2 ...
+   event ID time T [every DT] command1 command2 ...
+   event ID when v_name command1 command2 ...
+   event ID delete
+     step = fire at the end of step N, then every M steps if given
+     time = fire at the end of the first step reaching time T,
+            then every DT if given
+     when = fire at the end of each step where the equal-style variable
+            turns nonzero
+   a step or time already passed fires at the next check, i.e. at the
+   start of the next run; an existing ID is replaced
+------------------------------------------------------------------------- */
+
+void Event::command(int narg, char **arg)
+{
+  if (firing) error->all(FLERR,"Event command cannot be used in an event");
+  if (narg < 2) error->all(FLERR,"Illegal event command");
+
+  int ievent = find(arg[0]);
+
+  if (strcmp(arg[1],"delete") == 0) {
+    if (narg != 2) error->all(FLERR,"Illegal event command");
+    if (ievent < 0) error->all(FLERR,"Could not find event ID to delete");
+    remove(ievent);
+    return;
+  }
+
+  if (narg < 4) error->all(FLERR,"Illegal event command");
+
+  OneEvent one;
+  one.step = one.nevery = 0;
+  one.time = one.tevery = 0.0;
+  one.var = NULL;
+  one.last = one.done = 0;
+
+  int iarg = 3;
+  if (strcmp(arg[1],"step") == 0) {
+    one.trigger = STEP;
+    one.step = input->inumeric(FLERR,arg[2]);
+    if (one.step < 0) error->all(FLERR,"Illegal event step value");
+    if (strcmp(arg[3],"every") == 0) {
+      if (narg < 6) error->all(FLERR,"Illegal event command");
+      one.nevery = input->inumeric(FLERR,arg[4]);
+      if (one.nevery <= 0) error->all(FLERR,"Illegal event every value");
+      iarg = 5;
+    }
+  } else if (strcmp(arg[1],"time") == 0) {
+    one.trigger = TIME;
+    one.time = input->numeric(FLERR,arg[2]);
+    if (strcmp(arg[3],"every") == 0) {
+      if (narg < 6) error->all(FLERR,"Illegal event command");
+      one.tevery = input->numeric(FLERR,arg[4]);
+      if (one.tevery <= 0.0) error->all(FLERR,"Illegal event every value");
+      iarg = 5;
+    }
+  } else if (strcmp(arg[1],"when") == 0) {
+    one.trigger = WHEN;
+    if (strncmp(arg[2],"v_",2) != 0)
+      error->all(FLERR,"Illegal event when value");
+    int n = strlen(&arg[2][2]) + 1;
+    one.var = new char[n];
+    strcpy(one.var,&arg[2][2]);
+  } else error->all(FLERR,"Illegal event command");
+
+  // copy the commands, input->one() wipes out args when they run
+
+  one.ncommand = narg - iarg;
+  one.commands = new char*[one.ncommand];
+  for (int i = 0; i < one.ncommand; i++) {
+    int n = strlen(arg[iarg+i]) + 1;
+    one.commands[i] = new char[n];
+    strcpy(one.commands[i],arg[iarg+i]);
+  }
+
+  int n = strlen(arg[0]) + 1;
+  one.id = new char[n];
+  strcpy(one.id,arg[0]);
+
+  // a replaced event keeps its place in the firing order
+
+  if (ievent >= 0) destroy(&events[ievent]);
+  else {
+    if (nevent == maxevent) {
+      maxevent += DELTA;
+      events = (OneEvent *)
+        memory->srealloc(events,maxevent*sizeof(OneEvent),"event:events");
+    }
+    ievent = nevent++;
+  }
+
+  events[ievent] = one;
+  if (one.trigger == WHEN) nwhen++;
+}
+
+/* ----------------------------------------------------------------------
+   called by System::solve at the start of a run and after each step
+   events fire in the order they were defined, commands are wrapped with
+   clearstep/addstep since they and WHEN variables may invoke computes
+------------------------------------------------------------------------- */
+
+int Event::check()
+{
+  int wrap = 0;
+  if (nwhen) {
+    modify->clearstep_compute();
+    wrap = 1;
+  }
+
+  int nfired = 0;
+  for (int i = 0; i < nevent; i++) {
+    if (!due(&events[i])) continue;
+    if (!wrap) {
+      modify->clearstep_compute();
+      wrap = 1;
+    }
+    fire(&events[i]);
+    nfired++;
+  }
+
+  if (wrap) modify->addstep_compute(output->next);
+  return nfired;
+}
+
+/* ----------------------------------------------------------------------
+   return 1 if an event fires now and advance it to its next firing
+------------------------------------------------------------------------- */
+
+int Event::due(OneEvent *one)
+{
+  System *s = muse->system;
+
+  if (one->trigger == STEP) {
+    if (one->done || s->ntimestep < one->step) return 0;
+    if (one->nevery)
+      one->step += ((s->ntimestep - one->step) / one->nevery + 1) * one->nevery;
+    else one->done = 1;
+    return 1;
+  }
+
+  if (one->trigger == TIME) {
+    double now = s->timenow + TIMETOL*s->dt;
+    if (one->done || now < one->time) return 0;
+    if (one->tevery > 0.0)
+      one->time += (floor((now - one->time) / one->tevery) + 1.0) * one->tevery;
+    else one->done = 1;
+    return 1;
+  }
+
+  // variable is looked up each time, event commands may redefine it
+
+  int ivar = input->variable->find(one->var);
+  if (ivar < 0)
+    error->all(FLERR,"Variable name for event when does not exist");
+  if (!input->variable->equal_style(ivar))
+    error->all(FLERR,"Variable for event when is invalid style");
+
+  int value = (input->variable->compute_equal(ivar) != 0.0);
+  int flag = (value && !one->last);
+  one->last = value;
+  return flag;
+}
+
+/* ---------------------------------------------------------------------- */
+
+void Event::fire(OneEvent *one)
+{
+  // buffered frames are written for the current bodies,
+  // get them out before the commands may add or remove some
+
+  if (muse->system->logflag) output->traj->flush();
+  output->drain();
+
+  firing = 1;
+  for (int i = 0; i < one->ncommand; i++) input->one(one->commands[i]);
+  firing = 0;
+}
+
+/* ---------------------------------------------------------------------- */
+
+int Event::find(const char *id)
+{
+  for (int i = 0; i < nevent; i++)
+    if (strcmp(id,events[i].id) == 0) return i;
+  return -1;
+}
+
+/* ---------------------------------------------------------------------- */
+
+void Event::remove(int ievent)
+{
+  destroy(&events[ievent]);
+  for (int i = ievent; i < nevent-1; i++) events[i] = events[i+1];
+  nevent--;
+}
+
+/* ---------------------------------------------------------------------- */
+
+void Event::destroy(OneEvent *one)
+{
+  if (one->trigger == WHEN) nwhen--;
+  delete [] one->id;
+  delete [] one->var;
+  for (int i = 0; i < one->ncommand; i++) delete [] one->commands[i];
+  delete [] one->commands;
+}
@@ -0,0 +1,61 @@
+/* ----------------------------------------------------------------------
+   MUSE - MUltibody System dynamics Engine
+   https://github.com/zhangh3/MUSE
+
+   Zhang He, zhanghecalt@163.com
+   Science and Technology on Space Physics Laboratory, Beijing
+
+   This software is distributed under the GNU General Public License.
+   Copyright (c) 2023 Zhang He. All rights reserved.
+------------------------------------------------------------------------- */
+
+#ifndef MUSE_EVENT_H
+#define MUSE_EVENT_H
+
+#include "pointers.h"
+
+namespace MUSE_NS {
+
+/* timeline of events, each runs input commands at the end of a step
+   inside System::solve, triggered by an absolute step, a time or an
+   equal-style variable turning nonzero
+   the run goes on after the commands, System re-binds x/xd and output
+   layouts only if they added or removed bodies or joints */
+
+class Event : protected Pointers {
+ public:
+  int nevent;
+  int firing;                  // 1 while event commands execute
+
+  Event(class MUSE *);
+  ~Event();
+  void command(int, char **);
+  int check();                 // fire the due events, return # fired
+
+ private:
+  struct OneEvent {
+    char *id;
+    int trigger;               // STEP, TIME or WHEN
+    int step,nevery;           // next step to fire, 0 = once
+    double time,tevery;        // next time to fire, 0.0 = once
+    char *var;                 // name of the WHEN variable
+    int last;                  // 1 if the WHEN variable was nonzero
+    int done;                  // 1 once a one-shot event has fired
+    int ncommand;
+    char **commands;
+  };
+
+  int maxevent;
+  OneEvent *events;
+  int nwhen;                   // # of WHEN events
+
+  int find(const char *);
+  void remove(int);
+  void destroy(OneEvent *);
+  int due(OneEvent *);
+  void fire(OneEvent *);
+};
+
+}
+
+#endif
@@ -17,6 +17,7 @@
 #include "MUSEunistd.h"
 #include "sys/stat.h"
 #include "input.h"
+#include "muse.h"
 #include "stats.h"
 #include "math_extra.h"
 #include "error.h"
@@ -27,6 +28,11 @@
 #include "compute.h"
 #include "MUSEsystem.h"
 #include "output.h"
+#include "trajectory.h"
+#include "coupling.h"
+#include "event.h"
+#include "name_map.h"
+#include "timer.h"
 
 using namespace MUSE_NS;
 
@@ -53,11 +59,13 @@ Input::Input(MUSE *muse, int argc, char **argv) : Pointers(muse)
   jump_skip = 0;
   ifthenelse_flag = 0;
 
-  if (me == 0) {
-    nfile = maxfile = 1;
-    infiles = (FILE **) memory->smalloc(sizeof(FILE *),"input:infiles");
-    infiles[0] = infile;
-  } else infiles = NULL;
+  nscript = maxscript = 0;
+  scripts = NULL;
+  scriptmap = new NameMap(muse);
+
+  nframe = maxframe = 0;
+  frame_script = frame_line = NULL;
+  push(-1,0);
   variable = new Variable(muse);
 
   int iarg = 0;
@@ -93,22 +101,82 @@ Input::~Input()
   memory->sfree(work);
   if (labelstr) delete [] labelstr;
   memory->sfree(arg);
-  memory->sfree(infiles);
+
+  for (int i = 0; i < nscript; i++) {
+    for (int j = 0; j < scripts[i].nline; j++) {
+      delete [] scripts[i].lines[j].text;
+      delete [] scripts[i].lines[j].words;
+      delete [] scripts[i].lines[j].offset;
+    }
+    memory->sfree(scripts[i].lines);
+    delete scripts[i].labels;
+    delete [] scripts[i].name;
+  }
+  memory->sfree(scripts);
+  delete scriptmap;
+  memory->destroy(frame_script);
+  memory->destroy(frame_line);
   delete variable;
 }
 
 /* ----------------------------------------------------------------------
    process all input from infile
    infile = stdin or file if command-line arg "-in" was used
+   a script file is read into memory once, see load(), and its lines are
+     executed from there; jump and include only switch between scripts
+   stdin is read line by line as it comes
 ------------------------------------------------------------------------- */
 
 void Input::file()
 {
   int m,n;
 
-  while (1) {
+  // load the main input unless it is stdin or file(filename) did it
+
+  int stream = 0;
+  if (me == 0 && infile == stdin) stream = 1;
+  MPI_Bcast(&stream,1,MPI_INT,0,world);
+  if (nframe == 1 && frame_script[0] < 0 && !stream)
+    frame_script[0] = load(NULL);
+
+  while (nframe) {
+    int iscript = frame_script[nframe-1];
+
+    // next line of a loaded script
+    // end of script returns to the script that included it
+
+    if (iscript >= 0) {
+      Script *s = &scripts[iscript];
+      if (frame_line[nframe-1] == s->nline) {
+        nframe--;
+        continue;
+      }
+      Line *l = &s->lines[frame_line[nframe-1]++];
+
+      n = strlen(l->text) + 1;
+      if (n > maxline) reallocate(line,maxline,n);
+      strcpy(line,l->text);
 
-    // read a line from input script
+      if (me == 0) {
+        if (echo_screen && screen) fprintf(screen,"%s\n",line);
+        if (echo_log && logfile) fprintf(logfile,"%s\n",line);
+      }
+
+      // lines without $ were split into words when loaded
+
+      if (l->dollar) parse();
+      else words(l);
+      if (command == NULL) continue;
+
+      if (execute_command()) {
+        char *str = new char[maxline+32];
+        sprintf(str,"Unknown command: %s",line);
+        error->all(FLERR,str);
+      }
+      continue;
+    }
+
+    // read a line from stdin
     // n = length of line including str terminator, 0 if end of file
     // if line ends in continuation char '&', concatenate next line
 
@@ -125,8 +193,7 @@ void Input::file()
         if (line[m-1] != '\n') continue;
 
         m--;
-        std::locale::global(std::locale(""));//޸isspace
-        while (m >= 0 && isspace(line[m])) m--;
+        while (m >= 0 && isspace((unsigned char) line[m])) m--;
         if (m < 0 || line[m] != '&') {
           line[m+1] = '\0';
           n = m+2;
@@ -138,22 +205,12 @@ void Input::file()
     // bcast the line
     // if n = 0, end-of-file
     // error if label_active is set, since label wasn't encountered
-    // if original input file, code is done
     // else go back to previous input file
 
     MPI_Bcast(&n,1,MPI_INT,0,world);
     if (n == 0) {
       if (label_active) error->all(FLERR,"Label wasn't found in input script");
-      if (me == 0) {
-        if (infile != stdin) {
-          fclose(infile);
-          infile = NULL;
-        }
-        nfile--;
-      }
-      MPI_Bcast(&nfile,1,MPI_INT,0,world);
-      if (nfile == 0) break;
-      if (me == 0) infile = infiles[nfile-1];
+      nframe--;
       continue;
     }
 
@@ -195,24 +252,12 @@ void Input::file()
 void Input::file(const char *filename)
 {
   // error if another nested file still open, should not be possible
-  // open new filename and set infile, infiles[0], nfile
-  // call to file() will close filename and decrement nfile
 
-  if (me == 0) {
-    if (nfile > 1)
-      error->one(FLERR,"Invalid use of library file() function");
-
-    if (infile && infile != stdin) fclose(infile);
-    infile = fopen(filename,"r");
-    if (infile == NULL) {
-      char str[128];
-      sprintf(str,"Cannot open input script %s",filename);
-      error->one(FLERR,str);
-    }
-    infiles[0] = infile;
-    nfile = 1;
-  }
+  if (nframe > 1)
+    error->all(FLERR,"Invalid use of library file() function");
 
+  nframe = 0;
+  push(load(filename),0);
   file();
 }
 
@@ -339,8 +384,7 @@ char *Input::nextword(char *str, char **next)
   if (*start == '"' || *start == '\'') {
     stop = strchr(&start[1],*start);
     if (!stop) error->all(FLERR,"Unbalanced quotes in input line");
-    std::locale::global(std::locale(""));//޸isspace
-    if (stop[1] && !isspace(stop[1]))
+    if (stop[1] && !isspace((unsigned char) stop[1]))
       error->all(FLERR,"Input line quote not followed by whitespace");
     start++;
   } else stop = &start[strcspn(start," \t\n\v\f\r")];
@@ -495,7 +539,8 @@ int Input::expand_args(int narg, char** arg, int mode, char**& earg)
     for (iarg = 0; iarg < narg; iarg++) {
         expandflag = 0;
 
-        if (strncmp(arg[iarg], "c_", 2) == 0 ) {
+        if (strncmp(arg[iarg], "c_", 2) == 0 ||
+            strncmp(arg[iarg], "v_", 2) == 0) {
 
             ptr1 = strchr(&arg[iarg][2], '[');
             if (ptr1) {
@@ -522,6 +567,18 @@ int Input::expand_args(int narg, char** arg, int mode, char**& earg)
                                 }
                             }
                         }
+                        else if (arg[iarg][0] == 'v') {
+                            *ptr1 = '\0';
+                            int ivar = variable->find(&arg[iarg][2]);
+                            *ptr1 = '[';
+
+                            // body-style variable, one value per body
+
+                            if (ivar >= 0 && mode == 0 && variable->body_style(ivar)) {
+                                nmax = muse->nBodies;
+                                expandflag = 1;
+                            }
+                        }
                     }
                     *ptr2 = ']';
                 }
@@ -567,6 +624,212 @@ int Input::expand_args(int narg, char** arg, int mode, char**& earg)
     return newarg;
 }
 
+/* ----------------------------------------------------------------------
+   return index of script filename, read it on first use
+   filename = NULL reads the main input from infile
+   proc 0 reads the whole file and bcasts it, every proc keeps its lines
+------------------------------------------------------------------------- */
+
+int Input::load(const char *filename)
+{
+  if (filename) {
+    int iscript = scriptmap->find(filename);
+    if (iscript >= 0) return iscript;
+  }
+
+  int n = 0;
+  char *text = NULL;
+
+  if (me == 0) {
+    FILE *fp = infile;
+    if (filename) {
+      fp = fopen(filename,"r");
+      if (fp == NULL) {
+        char str[128];
+        sprintf(str,"Cannot open input script %s",filename);
+        error->one(FLERR,str);
+      }
+    }
+
+    int max = 0;
+    while (1) {
+      if (max-n < DELTALINE) {
+        max += 16*DELTALINE;
+        text = (char *) memory->srealloc(text,max,"input:text");
+      }
+      int m = fread(&text[n],1,max-n-1,fp);
+      if (m <= 0) break;
+      n += m;
+    }
+    text[n++] = '\0';
+
+    fclose(fp);
+    if (filename == NULL) infile = NULL;
+  }
+
+  MPI_Bcast(&n,1,MPI_INT,0,world);
+  if (me) text = (char *) memory->smalloc(n,"input:text");
+  MPI_Bcast(text,n,MPI_CHAR,0,world);
+
+  if (nscript == maxscript) {
+    maxscript += DELTA;
+    scripts = (Script *)
+      memory->srealloc(scripts,maxscript*sizeof(Script),"input:scripts");
+  }
+  Script *s = &scripts[nscript];
+  s->name = NULL;
+  if (filename) {
+    s->name = new char[strlen(filename)+1];
+    strcpy(s->name,filename);
+    scriptmap->insert(s->name,nscript);
+  }
+  split(s,text,n);
+  memory->sfree(text);
+
+  return nscript++;
+}
+
+/* ----------------------------------------------------------------------
+   split text of n chars into the lines of script s
+   lines ending in '&' are joined and trailing whitespace dropped as in file()
+   each line is stripped of its comment and split into words once,
+     lines with $ are parsed again when run since words depend on variables
+------------------------------------------------------------------------- */
+
+void Input::split(Script *s, char *text, int n)
+{
+  int maxl = 0;
+  s->nline = 0;
+  s->lines = NULL;
+  s->labels = new NameMap(muse);
+
+  char *buf = new char[n];
+  char *ptr = text;
+
+  while (*ptr) {
+    int len = 0;
+    while (1) {
+      char *eol = strchr(ptr,'\n');
+      if (eol == NULL) {
+        strcpy(&buf[len],ptr);
+        len += strlen(ptr);
+        ptr += strlen(ptr);
+        break;
+      }
+      memcpy(&buf[len],ptr,eol-ptr);
+      len += eol-ptr;
+      ptr = eol+1;
+      while (len > 0 && isspace((unsigned char) buf[len-1])) len--;
+      if (len == 0 || buf[len-1] != '&' || *ptr == '\0') break;
+      len--;
+    }
+    buf[len] = '\0';
+
+    if (s->nline == maxl) {
+      maxl = maxl ? 2*maxl : 64;
+      s->lines = (Line *)
+        memory->srealloc(s->lines,maxl*sizeof(Line),"input:lines");
+    }
+    Line *l = &s->lines[s->nline];
+    l->text = new char[len+1];
+    strcpy(l->text,buf);
+
+    // strip comment as in parse()
+
+    l->words = new char[len+1];
+    l->nbytes = len+1;
+    strcpy(l->words,l->text);
+    char quote = '\0';
+    char *p = l->words;
+    while (*p) {
+      if (*p == '#' && !quote) {
+        *p = '\0';
+        break;
+      }
+      if (*p == quote) quote = '\0';
+      else if (*p == '"' || *p == '\'') quote = *p;
+      p++;
+    }
+    l->dollar = (strchr(l->words,'$') != NULL);
+
+    // split into words as nextword() does, at most (len+1)/2 of them
+    // a line with bad quotes is left to parse() to report when it runs
+
+    l->nword = 0;
+    l->offset = new int[(len+1)/2 + 1];
+    p = l->words;
+    while (1) {
+      char *w = &p[strspn(p," \t\n\v\f\r")];
+      if (*w == '\0') break;
+      char *end;
+      if (*w == '"' || *w == '\'') {
+        end = strchr(&w[1],*w);
+        if (!end || (end[1] && !isspace((unsigned char) end[1]))) {
+          l->dollar = 1;
+          break;
+        }
+        w++;
+      } else end = &w[strcspn(w," \t\n\v\f\r")];
+      l->offset[l->nword++] = w - l->words;
+      if (*end == '\0') break;
+      *end = '\0';
+      p = end+1;
+    }
+
+    // label table holds the 1st line with each label
+    // labels are matched before $ substitution, as when scanning for them
+
+    if (l->nword == 2 && strcmp(l->words,"label") == 0) {
+      char *label = &l->words[l->offset[1]];
+      if (s->labels->find(label) < 0) s->labels->insert(label,s->nline);
+    }
+
+    s->nline++;
+  }
+
+  delete [] buf;
+}
+
+/* ----------------------------------------------------------------------
+   push script iscript on the frame stack, starting at line iline
+------------------------------------------------------------------------- */
+
+void Input::push(int iscript, int iline)
+{
+  if (nframe == maxframe) {
+    maxframe += DELTA;
+    memory->grow(frame_script,maxframe,"input:frame_script");
+    memory->grow(frame_line,maxframe,"input:frame_line");
+  }
+  frame_script[nframe] = iscript;
+  frame_line[nframe] = iline;
+  nframe++;
+}
+
+/* ----------------------------------------------------------------------
+   set command, narg, arg from the words of a loaded line
+   words are copied since commands may modify their args
+------------------------------------------------------------------------- */
+
+void Input::words(Line *l)
+{
+  if (l->nbytes > maxcopy) reallocate(copy,maxcopy,l->nbytes);
+  memcpy(copy,l->words,l->nbytes);
+
+  if (l->nword == 0) {
+    command = NULL;
+    return;
+  }
+  command = &copy[l->offset[0]];
+
+  narg = l->nword - 1;
+  if (narg > maxarg) {
+    maxarg = narg + DELTA;
+    arg = (char **) memory->srealloc(arg,maxarg*sizeof(char *),"input:arg");
+  }
+  for (int i = 0; i < narg; i++) arg[i] = &copy[l->offset[i+1]];
+}
+
 /* ----------------------------------------------------------------------
    rellocate a string
    if n > 0: set max >= n in increments of DELTALINE
@@ -587,6 +850,11 @@ int Input::execute_command()
 {
     int flag = 1;
 
+    // any other command may change what the last solution depends on,
+    // the next step then starts from a freshly computed one
+
+    if (!readonly(command)) muse->system->changed |= CHANGE_STATE;
+
     if (!strcmp(command, "echo")) echo();
     else if (!strcmp(command, "shell")) shell();
     else if (!strcmp(command, "print")) print();
@@ -595,11 +863,20 @@ int Input::execute_command()
     else if (!strcmp(command, "if")) ifthenelse();
     else if (!strcmp(command, "next")) next_command();
     else if (!strcmp(command, "jump")) jump();
+    else if (!strcmp(command, "include")) include();
     else if (!strcmp(command, "compute")) compute();
+    else if (!strcmp(command, "table")) table();
     else if (!strcmp(command, "system")) system_command();
     else if (!strcmp(command, "stats")) stats();
     else if (!strcmp(command, "stats_modify")) stats_modify();
     else if (!strcmp(command, "stats_style")) stats_style();
+    else if (!strcmp(command, "trajectory")) trajectory();
+    else if (!strcmp(command, "output")) output_command();
+    else if (!strcmp(command, "restart")) restart();
+    else if (!strcmp(command, "snapshot")) snapshot();
+    else if (!strcmp(command, "coupling")) coupling();
+    else if (!strcmp(command, "event")) event();
+    else if (!strcmp(command, "timer")) timer_command();
 
     else flag = 0;
 
@@ -631,6 +908,25 @@ int Input::execute_command()
 
 
 
+/* ----------------------------------------------------------------------
+   1 if a command leaves bodies, joints and loads as they are
+   commands run by if/include/events are checked on their own,
+   snapshot restore sets System::changed itself
+------------------------------------------------------------------------- */
+
+int Input::readonly(const char *name)
+{
+    static const char *names[] = {
+        "echo", "print", "label", "variable", "if", "next", "jump",
+        "include", "compute", "stats", "stats_modify", "stats_style",
+        "trajectory", "output", "restart", "write_restart", "snapshot",
+        "event", "timer", "run", NULL};
+
+    for (int i = 0; names[i]; i++)
+        if (strcmp(name, names[i]) == 0) return 1;
+    return 0;
+}
+
 /* ---------------------------------------------------------------------- */
 
 void Input::echo()
@@ -785,20 +1081,7 @@ void Input::include()
   if (ifthenelse_flag)
     error->all(FLERR,"Cannot use include command within an if command");
 
-  if (me == 0) {
-    if (nfile == maxfile) {
-      maxfile++;
-      infiles = (FILE **)
-        memory->srealloc(infiles,maxfile*sizeof(FILE *),"input:infiles");
-    }
-    infile = fopen(arg[0],"r");
-    if (infile == NULL) {
-      char str[128];
-      sprintf(str,"Cannot open input script %s",arg[0]);
-      error->one(FLERR,str);
-    }
-    infiles[nfile++] = infile;
-  }
+  push(load(arg[0]),0);
 }
 
 /* ---------------------------------------------------------------------- */
@@ -812,27 +1095,34 @@ void Input::jump()
     return;
   }
 
-  if (me == 0) {
-    if (strcmp(arg[0],"SELF") == 0) rewind(infile);
-    else {
-      if (infile && infile != stdin) fclose(infile);
-      infile = fopen(arg[0],"r");
-      if (infile == NULL) {
-        char str[128];
-        sprintf(str,"Cannot open input script %s",arg[0]);
-        error->one(FLERR,str);
-      }
-      infiles[nfile-1] = infile;
+  // jump SELF on stdin rewinds it and scans for the label line by line
+
+  int iscript = frame_script[nframe-1];
+  if (strcmp(arg[0],"SELF") == 0 && iscript < 0) {
+    if (me == 0) rewind(infile);
+    if (narg == 2) {
+      label_active = 1;
+      if (labelstr) delete [] labelstr;
+      int n = strlen(arg[1]) + 1;
+      labelstr = new char[n];
+      strcpy(labelstr,arg[1]);
     }
+    return;
   }
 
+  // a loaded script continues after the label line, found in its table
+
+  if (strcmp(arg[0],"SELF") != 0) iscript = load(arg[0]);
+
+  int iline = 0;
   if (narg == 2) {
-    label_active = 1;
-    if (labelstr) delete [] labelstr;
-    int n = strlen(arg[1]) + 1;
-    labelstr = new char[n];
-    strcpy(labelstr,arg[1]);
+    iline = scripts[iscript].labels->find(arg[1]);
+    if (iline < 0) error->all(FLERR,"Label wasn't found in input script");
+    iline++;
   }
+
+  frame_script[nframe-1] = iscript;
+  frame_line[nframe-1] = iline;
 }
 
 /* ---------------------------------------------------------------------- */
@@ -991,6 +1281,16 @@ void Input::compute()
     modify->add_compute(narg, arg);
 }
 
+/* ----------------------------------------------------------------------
+   table name file F ... / table name keyword ... / table name delete
+------------------------------------------------------------------------- */
+
+void Input::table()
+{
+    if (narg == 2 && !strcmp(arg[1], "delete")) modify->delete_table(arg[0]);
+    else modify->add_table(narg, arg);
+}
+
 void Input::system_command()
 {
     muse->system->command(narg, arg);
@@ -1017,6 +1317,91 @@ void Input::stats_style()
     output->create_stats(narg, arg);
 }
 
+/* ---------------------------------------------------------------------- */
+
+void Input::trajectory()
+{
+    output->traj->command(narg, arg);
+}
+
+/* ---------------------------------------------------------------------- */
+
+void Input::output_command()
+{
+    output->modify_params(narg, arg);
+}
+
+/* ---------------------------------------------------------------------- */
+
+void Input::restart()
+{
+    output->create_restart(narg, arg);
+}
+
+/* ----------------------------------------------------------------------
+   snapshot save/restore/delete name
+------------------------------------------------------------------------- */
+
+void Input::snapshot()
+{
+    if (narg != 2) error->all(FLERR, "Illegal snapshot command");
+    if (!strcmp(arg[0], "save")) muse->system->save_snapshot(arg[1]);
+    else if (!strcmp(arg[0], "restore")) muse->system->restore_snapshot(arg[1]);
+    else if (!strcmp(arg[0], "delete")) muse->system->delete_snapshot(arg[1]);
+    else error->all(FLERR, "Illegal snapshot command");
+}
+
+/* ----------------------------------------------------------------------
+   coupling none
+   coupling name ...
+     exchange loads and states with an external solver, see Coupling
+------------------------------------------------------------------------- */
+
+void Input::coupling()
+{
+    if (narg < 1) error->all(FLERR, "Illegal coupling command");
+    System *s = muse->system;
+    if (!strcmp(arg[0], "none")) {
+        if (narg != 1) error->all(FLERR, "Illegal coupling command");
+        delete s->coupling;
+        s->coupling = NULL;
+        return;
+    }
+    if (!s->coupling) s->coupling = new Coupling(muse);
+    s->coupling->command(narg, arg);
+}
+
+/* ----------------------------------------------------------------------
+   event none
+   event ID ...
+     commands fired inside the run at a step, time or condition, see Event
+------------------------------------------------------------------------- */
+
+void Input::event()
+{
+    if (narg < 1) error->all(FLERR, "Illegal event command");
+    System *s = muse->system;
+    if (!strcmp(arg[0], "none")) {
+        if (narg != 1) error->all(FLERR, "Illegal event command");
+        if (s->event && s->event->firing)
+            error->all(FLERR, "Event command cannot be used in an event");
+        delete s->event;
+        s->event = NULL;
+        return;
+    }
+    if (!s->event) s->event = new Event(muse);
+    s->event->command(narg, arg);
+}
+
+/* ----------------------------------------------------------------------
+   timer normal/full, see Timer
+------------------------------------------------------------------------- */
+
+void Input::timer_command()
+{
+    timer->command(narg, arg);
+}
+
 /* ----------------------------------------------------------------------
    read a floating point value from a string
    generate an error if not a legitimate floating point value
@@ -47,18 +47,44 @@ namespace MUSE_NS {
         int maxline, maxcopy, maxwork; // max lengths of char strings
         int echo_screen;             // 0 = no, 1 = yes
         int echo_log;                // 0 = no, 1 = yes
-        int nfile, maxfile;           // current # and max # of open input files
         int label_active;            // 0 = no label, 1 = looking for label
         char* labelstr;              // label string being looked for
         int jump_skip;               // 1 if skipping next jump, 0 otherwise
         int ifthenelse_flag;         // 1 if executing commands inside an if-then-else
 
-        FILE** infiles;              // list of open input files
+        struct Line {                // one command line of a loaded script
+            char* text;              // as read, '&' continuation lines joined
+            char* words;             // comment stripped, words split by 0
+            int nbytes;              // length of words
+            int dollar;              // 1 = parse() again when run, has $
+            int nword;               // # of words, command included
+            int* offset;             // offset of each word in words
+        };
+
+        struct Script {              // input script read once into memory
+            char* name;              // file name, NULL for the main input
+            int nline;
+            Line* lines;
+            class NameMap* labels;   // label -> index of its line
+        };
+
+        int nscript, maxscript;      // scripts loaded so far
+        Script* scripts;
+        class NameMap* scriptmap;    // file name -> script
+
+        int nframe, maxframe;        // stack of scripts being executed
+        int* frame_script;           // script of each frame, -1 = infile
+        int* frame_line;             // next line to execute in it
 
         void parse();                          // parse an input text line
         char* nextword(char*, char**);       // find next word in string with quotes
         void reallocate(char*&, int&, int);  // reallocate a char string
         int execute_command();                 // execute a single command
+        int readonly(const char *);            // 1 if a command changes nothing
+        int load(const char*);                 // read a script into memory
+        void split(Script*, char*, int);       // split its text into lines
+        void push(int, int);                   // start executing a script
+        void words(Line*);                     // set command/arg from a line
 
         //void clear();                // input script commands
         void echo();
@@ -75,10 +101,18 @@ namespace MUSE_NS {
 
         // MUSE commands
         void compute();
+        void table();
         void system_command();
         void stats();
         void stats_modify();
         void stats_style();
+        void trajectory();
+        void output_command();
+        void restart();
+        void snapshot();
+        void coupling();
+        void event();
+        void timer_command();
     };
 
 }
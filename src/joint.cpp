@@ -10,6 +10,8 @@
 ------------------------------------------------------------------------- */
 
 #include "joint.h"
+#include "muse.h"
+#include "MUSEsystem.h"
 #include "joint_enums.h"
 #include "error.h"
 
@@ -60,6 +62,9 @@ void Joint::set_type_by_name(char* type_name)
 
 void Joint::set_type(int newtype)
 {
+	// the rows of this joint in A may change
+	if (IDinSystem >= 0) muse->system->changed |= CHANGE_JOINT;
+
 	switch (newtype)
 	{
 	case SPHERE:
@@ -29,11 +29,6 @@ int main(int argc, char **argv){
 	
 	MUSE *muse = new MUSE(argc,argv,MPI_COMM_WORLD);
 
-	ofstream out;
-	out.open("./res.txt", ios::trunc);
-	out << "MUSE OUTPUT:" << endl;
-	out.close();
-
 	muse->input->file();
 
 
@@ -14,6 +14,7 @@
 #include "modify.h"
 
 #include "compute.h"
+#include "table.h"
 #include "style_compute.h"
 #include "memory.h"
 #include "error.h"
@@ -42,6 +43,9 @@ Modify::Modify(MUSE* muse) : Pointers(muse)
 	ncompute = maxcompute = 0;
 	compute = NULL;
 
+	ntable = maxtable = 0;
+	table = NULL;
+
 	// n_pergrid needs to be initialized here because ReadSurf calls
 	//  Modify::reset_grid_count without calling Modify::init
 
@@ -57,6 +61,9 @@ Modify::~Modify()
 	for (int i = 0; i < ncompute; i++) delete compute[i];
 	memory->sfree(compute);
 
+	for (int i = 0; i < ntable; i++) delete table[i];
+	memory->sfree(table);
+
 	delete[] list_start_of_step;
 	delete[] list_end_of_step;
 
@@ -185,6 +192,58 @@ int Modify::find_compute(const char* id)
 	return icompute;
 }
 
+/* ----------------------------------------------------------------------
+   table name file ... creates a Table, a name that is already a table
+   only changes its settings, see Table
+------------------------------------------------------------------------- */
+
+void Modify::add_table(int narg, char** arg)
+{
+	if (narg < 2) error->all(FLERR, "Illegal table command");
+
+	int itable = find_table(arg[0]);
+	if (itable >= 0) {
+		if (strcmp(arg[1], "file") == 0)
+			error->all(FLERR, "Reuse of table name");
+		table[itable]->modify_params(narg - 1, &arg[1]);
+		return;
+	}
+
+	if (ntable == maxtable) {
+		maxtable += DELTA;
+		table = (Table**)
+			memory->srealloc(table, maxtable * sizeof(Table*), "modify:table");
+	}
+	table[ntable] = new Table(muse, narg, arg);
+	ntable++;
+}
+
+/* ----------------------------------------------------------------------
+   delete a Table from list of Tables
+------------------------------------------------------------------------- */
+
+void Modify::delete_table(const char* id)
+{
+	int itable = find_table(id);
+	if (itable < 0) error->all(FLERR, "Could not find table ID to delete");
+	delete table[itable];
+
+	for (int i = itable + 1; i < ntable; i++) table[i - 1] = table[i];
+	ntable--;
+}
+
+/* ----------------------------------------------------------------------
+   find a table by ID
+   return index of table or -1 if not found
+------------------------------------------------------------------------- */
+
+int Modify::find_table(const char* id)
+{
+	for (int itable = 0; itable < ntable; itable++)
+		if (strcmp(id, table[itable]->name) == 0) return itable;
+	return -1;
+}
+
 /* ----------------------------------------------------------------------
    clear invoked flag of all computes
    called everywhere that computes are used, before computes are invoked
@@ -25,6 +25,9 @@ class Modify : protected Pointers {
   int ncompute,maxcompute;   // list of computes
   class Compute **compute;
 
+  int ntable,maxtable;       // list of time tables
+  class Table **table;
+
   Modify(class MUSE *);
   ~Modify();
   void init();
@@ -37,6 +40,10 @@ class Modify : protected Pointers {
   void delete_compute(const char *);
   int find_compute(const char *);
 
+  void add_table(int, char **);
+  void delete_table(const char *);
+  int find_table(const char *);
+
   void clearstep_compute();
   void addstep_compute(int);
   void addstep_compute_all();
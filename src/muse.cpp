@@ -23,6 +23,7 @@
 #include "timer.h"
 #include "modify.h"
 #include "output.h"
+#include "name_map.h"
 
 
 #define DELTA 5
@@ -51,7 +52,56 @@ MUSE::MUSE(int narg, char **arg, MPI_Comm communicator)
 
   memory = new Memory(this);
   error = new Error(this);
+  bodymap = new NameMap(this);
+  jointmap = new NameMap(this);
   ensemble = new Ensemble(this,communicator);
+
+  int iarg = 1;
+  while (iarg < narg) {
+	  if (strcmp(arg[iarg], "-in") == 0 ||
+		  strcmp(arg[iarg], "-i") == 0) {
+		  if (iarg + 2 > narg)
+			  error->all(FLERR, "Invalid command-line argument");
+		  inflag = iarg + 1;
+		  iarg += 2;
+	  }
+	  else if (strcmp(arg[iarg], "-partition") == 0 ||
+		  strcmp(arg[iarg], "-p") == 0) {
+		  ensemble->existflag = 1;
+		  iarg++;
+		  while (iarg < narg && arg[iarg][0] != '-') {
+			  ensemble->add_sim(arg[iarg]);
+			  iarg++;
+		  }
+	  }
+	  else error->all(FLERR, "Invalid command-line argument");
+  }
+
+  // one simulation per partition, world becomes my partition's communicator
+  // universe proc 0 prints to screen, each partition root to screen.N
+
+  if (ensemble->existflag == 0) ensemble->add_sim(NULL);
+  if (!ensemble->consistent())
+	  error->all(FLERR, "Processor partitions do not match number of allocated processors");
+
+  if (ensemble->nSim > 1) {
+	  if (inflag == 0)
+		  error->all(FLERR, "Must use -in switch with multiple partitions");
+	  MPI_Comm_split(ensemble->world, ensemble->iSim, 0, &world);
+	  MPI_Comm_rank(world, &me);
+
+	  if (ensemble->me != 0) ensemble->uscreen = NULL;
+	  screen = NULL;
+	  if (me == 0) {
+		  char str[128];
+		  sprintf(str, "screen.%d", ensemble->iSim);
+		  screen = fopen(str, "w");
+		  if (screen == NULL) error->one(FLERR, "Cannot open screen file");
+	  }
+	  if (ensemble->uscreen)
+		  fprintf(ensemble->uscreen, "Running on %d partitions of processors\n", ensemble->nSim);
+  }
+
   system = new System(this);
 
   ///////creat
@@ -59,7 +109,6 @@ MUSE::MUSE(int narg, char **arg, MPI_Comm communicator)
   output = new Output(this);
   timer = new Timer(this);
 
-
   if (me == 0) {
 	  if (screen) fprintf(screen, "================================================\n");
 	  if (screen) fprintf(screen, "   __       __  __    __   ______   ________  \n");
@@ -76,18 +125,6 @@ MUSE::MUSE(int narg, char **arg, MPI_Comm communicator)
 	  if (logfile) fprintf(logfile, "VERSION: (%s)\n\n", MUSE_VERSION);
   }
 
-  int iarg = 1;
-  while (iarg < narg) {
-	  if (strcmp(arg[iarg], "-in") == 0 ||
-		  strcmp(arg[iarg], "-i") == 0) {
-		  if (iarg + 2 > narg)
-			  error->all(FLERR, "Invalid command-line argument");
-		  inflag = iarg + 1;
-		  iarg += 2;
-	  }
-	  else error->all(FLERR, "Invalid command-line argument");
-  }
-
   if (me == 0) {
 	  if (inflag == 0) infile = stdin;
 	  else infile = fopen(arg[inflag], "r");
@@ -105,8 +142,87 @@ MUSE::MUSE(int narg, char **arg, MPI_Comm communicator)
 
 }
 
+/* ----------------------------------------------------------------------
+   quiet copy of the model held by src, used by EnsembleRunner
+   bodies, joints and system membership/settings are copied,
+   no banner, no screen output and no input script
+   computes, variables and stats/result settings are not copied
+------------------------------------------------------------------------- */
+
+MUSE::MUSE(MUSE *src, MPI_Comm communicator)
+{
+	world = communicator;
+	MPI_Comm_rank(world, &me);
+
+	screen = NULL;
+	logfile = NULL;
+	infile = NULL;
+	output = NULL;
+
+	nBodies  = maxBodies  = 0;
+	nJoints  = maxJoints  = 0;
+
+	body   = NULL;
+	joint  = NULL;
+	system = NULL;
+
+	memory = new Memory(this);
+	error = new Error(this);
+	bodymap = new NameMap(this);
+	jointmap = new NameMap(this);
+	ensemble = new Ensemble(this, communicator);
+	system = new System(this);
+	modify = new Modify(this);
+	output = new Output(this);
+	timer = new Timer(this);
+	input = new Input(this, 0, NULL);
+	ensemble->add_sim(NULL);
+
+	int i;
+
+	for (i = 0; i < src->nBodies; i++) {
+		Body *from = src->body[i];
+		int ibody = add_Body(from->name);
+		Body *to = body[ibody];
+		to->mass = from->mass;
+		to->inertia = from->inertia;
+		to->pos = from->pos;
+		to->vel = from->vel;
+		to->quat = from->quat;
+		to->quatd = from->quatd;
+		to->omega = from->omega;
+		to->force = from->force;
+		to->torque = from->torque;
+	}
+
+	for (i = 0; i < src->nJoints; i++) {
+		Joint *from = src->joint[i];
+		int ijoint = add_Joint(from->name);
+		Joint *to = joint[ijoint];
+		to->set_type(from->get_type());
+		to->point1 = from->point1;
+		to->point2 = from->point2;
+		to->axis1 = from->axis1;
+		to->axis2 = from->axis2;
+		for (int k = 0; k < 2; k++)
+			if (from->body[k]) to->body[k] = body[from->body[k]->IDinMuse];
+	}
+
+	System *ssrc = src->system;
+	for (i = 0; i < ssrc->nBodies; i++) system->add_Body(body[ssrc->body[i]->IDinMuse]);
+	for (i = 0; i < ssrc->nJoints; i++) system->add_Joint(joint[ssrc->joint[i]->IDinMuse]);
+	system->dt = ssrc->dt;
+	system->integrator = ssrc->integrator;
+	system->ga = ssrc->ga;
+	system->ntimestep = ssrc->ntimestep;
+	system->timenow = ssrc->timenow;
+	system->logflag = false;                 // copies never write trajectories
+}
+
 MUSE::~MUSE()
 {
+	delete bodymap;
+	delete jointmap;
 	delete ensemble;
 	delete error;
 	delete memory;
@@ -140,26 +256,25 @@ void MUSE_NS::MUSE::init()
 	timer->init();
 }
 
+/* ----------------------------------------------------------------------
+   names are hashed, arrays grow geometrically
+   so building large models is linear in the number of bodies/joints
+------------------------------------------------------------------------- */
+
 int MUSE::add_Body(char *name)
 {
-  int ibody;
-
-  for (ibody = 0; ibody < nBodies; ibody++)
-	  if (strcmp(name,body[ibody]->name) == 0) break;
-
-  if (ibody < nBodies) {
-      error->all(FLERR,"Bodies with same name!");
-  } else {
-    if (nBodies == maxBodies) {
-      maxBodies += DELTA;
-      body = (Body **) memory->srealloc(body,maxBodies*sizeof(Body *),"muse:body");
-    }
+  if (bodymap->find(name) >= 0) error->all(FLERR,"Bodies with same name!");
+
+  if (nBodies == maxBodies) {
+    maxBodies = maxBodies ? 2*maxBodies : DELTA;
+    body = (Body **) memory->srealloc(body,maxBodies*sizeof(Body *),"muse:body");
   }
+
+  int ibody = nBodies;
   body[ibody] = new Body(this);
   body[ibody]->set_Name(name);
   body[ibody]->IDinMuse = ibody;
-
-
+  bodymap->insert(body[ibody]->name,ibody);
 
   nBodies++;
   return ibody;
@@ -167,23 +282,48 @@ int MUSE::add_Body(char *name)
 
 int MUSE::add_Joint(char* name)
 {
-	int ijoint;
-
-	for (ijoint = 0; ijoint < nJoints; ijoint++)
-		if (strcmp(name, joint[ijoint]->name) == 0) break;
+	if (jointmap->find(name) >= 0) error->all(FLERR, "Joints with same name!");
 
-	if (ijoint < nJoints) {
-		error->all(FLERR, "Joints with same name!");
-	}
-	else {
-		if (nJoints == maxJoints) {
-			maxJoints += DELTA;
-			joint = (Joint**)memory->srealloc(joint, maxJoints * sizeof(Joint*), "muse:joint");
-		}
+	if (nJoints == maxJoints) {
+		maxJoints = maxJoints ? 2 * maxJoints : DELTA;
+		joint = (Joint**)memory->srealloc(joint, maxJoints * sizeof(Joint*), "muse:joint");
 	}
+
+	int ijoint = nJoints;
 	joint[ijoint] = new Joint(this);
 	joint[ijoint]->set_Name(name);
 	joint[ijoint]->IDinMuse = ijoint;
+	jointmap->insert(joint[ijoint]->name, ijoint);
 	nJoints++;
 	return ijoint;
 }
+
+/* ----------------------------------------------------------------------
+   allocate once for nbody more bodies and njoint more joints,
+   e.g. before a generated model is created
+------------------------------------------------------------------------- */
+
+void MUSE::reserve(int nbody, int njoint)
+{
+	if (nBodies + nbody > maxBodies) {
+		maxBodies = nBodies + nbody;
+		body = (Body **) memory->srealloc(body,maxBodies*sizeof(Body *),"muse:body");
+	}
+	if (nJoints + njoint > maxJoints) {
+		maxJoints = nJoints + njoint;
+		joint = (Joint **) memory->srealloc(joint,maxJoints*sizeof(Joint *),"muse:joint");
+	}
+	bodymap->reserve(nbody);
+	jointmap->reserve(njoint);
+}
+
+int MUSE::find_Body(const char *name)
+{
+	return bodymap->find(name);
+}
+
+int MUSE::find_Joint(const char *name)
+{
+	return jointmap->find(name);
+}
+
@@ -48,17 +48,23 @@ namespace MUSE_NS{
 
 
 		MUSE(int, char **, MPI_Comm);
+		MUSE(MUSE *, MPI_Comm);        // quiet copy of another instance's model
 		~MUSE();
 
 		void init();
 
 		int add_Body(char *);
 		int add_Joint(char*);
+		int find_Body(const char *);   // index of a body by name, -1 if none
+		int find_Joint(const char *);  // index of a joint by name, -1 if none
+		void reserve(int, int);        // room for N more bodies and M more joints
 
 	private:
 
 		int maxBodies;
 		int maxJoints;
+		class NameMap *bodymap;        // hashed body and joint names
+		class NameMap *jointmap;
 
 	};
 
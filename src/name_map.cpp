@@ -0,0 +1,117 @@
+/* ----------------------------------------------------------------------
+   MUSE - MUltibody System dynamics Engine
+   https://github.com/zhangh3/MUSE
+
+   Zhang He, zhanghecalt@163.com
+   Science and Technology on Space Physics Laboratory, Beijing
+
+   This software is distributed under the GNU General Public License.
+   Copyright (c) 2023 Zhang He. All rights reserved.
+------------------------------------------------------------------------- */
+
+#include "string.h"
+#include "stdint.h"
+#include "name_map.h"
+#include "memory.h"
+
+using namespace MUSE_NS;
+
+#define MINSIZE 64
+
+/* ----------------------------------------------------------------------
+   FNV-1a hash of a string
+------------------------------------------------------------------------- */
+
+static uint32_t hash(const char *str)
+{
+  uint32_t h = 2166136261u;
+  while (*str) {
+    h ^= (unsigned char) *str++;
+    h *= 16777619u;
+  }
+  return h;
+}
+
+/* ---------------------------------------------------------------------- */
+
+NameMap::NameMap(MUSE *muse) : Pointers(muse)
+{
+  size = count = 0;
+  key = NULL;
+  value = NULL;
+}
+
+/* ---------------------------------------------------------------------- */
+
+NameMap::~NameMap()
+{
+  memory->sfree(key);
+  memory->destroy(value);
+}
+
+/* ---------------------------------------------------------------------- */
+
+int NameMap::find(const char *name)
+{
+  if (count == 0) return -1;
+
+  int mask = size - 1;
+  for (int i = hash(name) & mask; key[i]; i = (i+1) & mask)
+    if (strcmp(key[i],name) == 0) return value[i];
+  return -1;
+}
+
+/* ----------------------------------------------------------------------
+   add a name not yet in the map
+------------------------------------------------------------------------- */
+
+void NameMap::insert(const char *name, int index)
+{
+  if (2*(count+1) > size) grow(size ? 2*size : MINSIZE);
+
+  int mask = size - 1;
+  int i = hash(name) & mask;
+  while (key[i]) i = (i+1) & mask;
+  key[i] = name;
+  value[i] = index;
+  count++;
+}
+
+/* ----------------------------------------------------------------------
+   grow once so that N more keys keep the table at most half full
+------------------------------------------------------------------------- */
+
+void NameMap::reserve(int n)
+{
+  int newsize = size ? size : MINSIZE;
+  while (2*(count+n) > newsize) newsize *= 2;
+  if (newsize > size) grow(newsize);
+}
+
+/* ----------------------------------------------------------------------
+   re-insert all keys into newsize slots, a power of 2
+------------------------------------------------------------------------- */
+
+void NameMap::grow(int newsize)
+{
+  int oldsize = size;
+  const char **oldkey = key;
+  int *oldvalue = value;
+
+  size = newsize;
+  key = (const char **) memory->smalloc(size*sizeof(char *),"namemap:key");
+  memset(key,0,size*sizeof(char *));
+  memory->create(value,size,"namemap:value");
+
+  int mask = size - 1;
+  for (int j = 0; j < oldsize; j++) {
+    if (!oldkey[j]) continue;
+    int i = hash(oldkey[j]) & mask;
+    while (key[i]) i = (i+1) & mask;
+    key[i] = oldkey[j];
+    value[i] = oldvalue[j];
+  }
+
+  memory->sfree(oldkey);
+  memory->destroy(oldvalue);
+}
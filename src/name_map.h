@@ -0,0 +1,42 @@
+/* ----------------------------------------------------------------------
+   MUSE - MUltibody System dynamics Engine
+   https://github.com/zhangh3/MUSE
+
+   Zhang He, zhanghecalt@163.com
+   Science and Technology on Space Physics Laboratory, Beijing
+
+   This software is distributed under the GNU General Public License.
+   Copyright (c) 2023 Zhang He. All rights reserved.
+------------------------------------------------------------------------- */
+
+#ifndef MUSE_NAME_MAP_H
+#define MUSE_NAME_MAP_H
+
+#include "pointers.h"
+
+namespace MUSE_NS {
+
+/* hashed name -> index lookup, used for the bodies and joints of MUSE
+   open addressing with linear probing, the table doubles at half full
+   keys are not copied, they must live as long as the map */
+
+class NameMap : protected Pointers {
+ public:
+  NameMap(class MUSE *);
+  ~NameMap();
+  int find(const char *);            // index of a name, -1 if none
+  void insert(const char *, int);
+  void reserve(int);                 // room for N more keys
+
+ private:
+  int size;                          // # of slots, power of 2
+  int count;                         // # of keys
+  const char **key;                  // NULL = empty slot
+  int *value;
+
+  void grow(int);
+};
+
+}
+
+#endif
@@ -22,12 +22,17 @@
 #include "muse.h"
 #include "MUSEsystem.h"
 #include "modify.h"
+#include "trajectory.h"
+#include "async_writer.h"
+#include "shm_ring.h"
+#include "write_restart.h"
 
 
 #include <iostream>
 using namespace MUSE_NS;
 
 #define DELTA 1
+#define NSLOT 4096
 
 /* ---------------------------------------------------------------------- */
 
@@ -47,18 +52,24 @@ Output::Output(MUSE* muse) : Pointers(muse)
     ivar_result = NULL;
     result = NULL;
 
-    //restart_flag = 0;
-    //restart_every = 0;
-    //last_restart = -1;
-    //restartf = NULL;
-    //var_restart = NULL;
-    //restart = NULL;
+    traj = new Trajectory(muse);
+    async = NULL;
+    shm = NULL;
+
+    restart_flag = 0;
+    restart_every = 0;
+    last_restart = -1;
+    restart_toggle = 0;
+    restart1 = restart2 = NULL;
+    restart = NULL;
 }
 
 /* ---------------------------------------------------------------------- */
 
 Output::~Output()
 {
+    delete async;
+    delete shm;
     if (stats) delete stats;
     delete[] var_stats;
 
@@ -70,6 +81,11 @@ Output::~Output()
     memory->destroy(ivar_result);
     for (int i = 0; i < nresult; i++) delete result[i];
     memory->sfree(result);
+    delete traj;
+
+    delete restart;
+    delete[] restart1;
+    delete[] restart2;
 }
 void Output::init()
 {
@@ -107,6 +123,8 @@ void Output::setup(int memflag)
     // insure stats output on last step of run
     // stats may invoke computes so wrap with clear/add
 
+    setup_layout();
+
     modify->clearstep_compute();
 
     stats->header();
@@ -127,10 +145,14 @@ void Output::setup(int memflag)
 
     modify->addstep_compute(next_stats);
 
+    // restart files are written on multiples of restart_every
+
+    if (restart_flag)
+        next_restart = (ntimestep / restart_every) * restart_every + restart_every;
+    else next_restart = muse->system->laststep + 1;
+
     // next = next timestep any output will be done
-    next = next_stats;
-    //next = MIN(next_dump_any, next_restart);
-    //next = MIN(next, next_stats);
+    next = MIN(next_stats, next_restart);
 }
 
 /* ----------------------------------------------------------------------
@@ -145,6 +167,11 @@ void Output::write(int ntimestep)
     // insure next_thermo forces output on last step of run
     // thermo may invoke computes so wrap with clear/add
 
+    if (next_restart == ntimestep) {
+        if (last_restart != ntimestep) write_restart(ntimestep);
+        next_restart += restart_every;
+    }
+
     if (next_stats == ntimestep) {
         modify->clearstep_compute();
         if (last_stats != ntimestep) stats->compute(1);
@@ -163,7 +190,7 @@ void Output::write(int ntimestep)
 
     // next = next timestep any output will be done
     //FIXME:����ȱ�����������
-    next = next_stats;
+    next = MIN(next_stats, next_restart);
 }
 
 /* ----------------------------------------------------------------------
@@ -199,7 +226,12 @@ void Output::reset_timestep(int ntimestep)
     else next_stats = muse->system->laststep;
 
     //FIXME:����ȱ�����������
-    next = next_stats;
+    if (restart_flag) {
+        next_restart = (ntimestep / restart_every) * restart_every;
+        if (next_restart < ntimestep) next_restart += restart_every;
+    }
+
+    next = MIN(next_stats, next_restart);
 }
 
 void MUSE_NS::Output::add_result(int narg, char** arg)
@@ -275,3 +307,159 @@ void Output::create_stats(int narg, char** arg)
     if (narg < 1) error->all(FLERR, "Illegal stats_style command");
     stats->set_fields(narg, arg);
 }
+
+/* ----------------------------------------------------------------------
+   size the trajectory ring, writer slots and shared-memory frames for
+   the current bodies, also between two steps when an event changed them
+   the writer queue is emptied first, queued frames still refer to the
+   old trajectory layout and the slots are reallocated
+------------------------------------------------------------------------- */
+
+void Output::setup_layout()
+{
+    if (async) async->drain();
+    traj->setup();
+    if (async) async->setup(MAX(stats->nfield, traj->ncol));
+    if (shm) shm->setup();
+}
+
+/* ----------------------------------------------------------------------
+   block until background writers have written everything queued
+   called at the end of each run and before an error message
+------------------------------------------------------------------------- */
+
+void Output::drain()
+{
+    if (async) async->drain();
+    if (restart) restart->wait();
+}
+
+/* ----------------------------------------------------------------------
+   output async yes/no queue N
+     async yes = stats lines and trajectory frames written by a background
+                 thread, the solver only copies their values into a queue
+     queue N = # of lines/frames the queue holds
+   output shm none
+   output shm name ...
+     publish body states into a shared memory ring, see ShmRing::command()
+     all remaining args belong to shm
+------------------------------------------------------------------------- */
+
+void Output::modify_params(int narg, char** arg)
+{
+    if (narg < 2) error->all(FLERR, "Illegal output command");
+
+    int asyncflag = (async != NULL);
+    int nslot = async ? async->nslot : NSLOT;
+
+    int iarg = 0;
+    while (iarg < narg) {
+        if (strcmp(arg[iarg], "async") == 0) {
+            if (iarg + 2 > narg) error->all(FLERR, "Illegal output command");
+            if (strcmp(arg[iarg + 1], "yes") == 0) asyncflag = 1;
+            else if (strcmp(arg[iarg + 1], "no") == 0) asyncflag = 0;
+            else error->all(FLERR, "Illegal output command");
+            iarg += 2;
+        }
+        else if (strcmp(arg[iarg], "queue") == 0) {
+            if (iarg + 2 > narg) error->all(FLERR, "Illegal output command");
+            nslot = input->inumeric(FLERR, arg[iarg + 1]);
+            if (nslot <= 0) error->all(FLERR, "Illegal output queue value");
+            iarg += 2;
+        }
+        else if (strcmp(arg[iarg], "shm") == 0) {
+            if (iarg + 2 > narg) error->all(FLERR, "Illegal output command");
+            if (strcmp(arg[iarg + 1], "none") == 0) {
+                if (iarg + 2 != narg) error->all(FLERR, "Illegal output command");
+                delete shm;
+                shm = NULL;
+            }
+            else {
+                if (!shm) shm = new ShmRing(muse);
+                shm->command(narg - iarg - 1, &arg[iarg + 1]);
+            }
+            iarg = narg;
+        }
+        else error->all(FLERR, "Illegal output command");
+    }
+
+    // the writer thread is restarted for a new queue size
+
+    if (async && (!asyncflag || nslot != async->nslot)) {
+        delete async;
+        async = NULL;
+    }
+    if (asyncflag && !async) async = new AsyncWriter(muse, nslot);
+}
+
+/* ----------------------------------------------------------------------
+   restart N file1 [file2]
+   restart 0 = no more restart files
+   a * in file1 is replaced by the timestep, two files are alternated
+------------------------------------------------------------------------- */
+
+void Output::create_restart(int narg, char** arg)
+{
+    if (narg < 1) error->all(FLERR, "Illegal restart command");
+
+    int every = input->inumeric(FLERR, arg[0]);
+    if (every < 0) error->all(FLERR, "Illegal restart command");
+
+    if (every == 0) {
+        if (narg != 1) error->all(FLERR, "Illegal restart command");
+        restart_flag = 0;
+        return;
+    }
+    if (narg != 2 && narg != 3) error->all(FLERR, "Illegal restart command");
+
+    restart_flag = 1;
+    restart_every = every;
+
+    delete[] restart1;
+    delete[] restart2;
+    restart1 = new char[strlen(arg[1]) + 1];
+    strcpy(restart1, arg[1]);
+    restart2 = NULL;
+    restart_toggle = 0;
+    if (narg == 3) {
+        restart2 = new char[strlen(arg[2]) + 1];
+        strcpy(restart2, arg[2]);
+        restart_toggle = 1;
+    }
+
+    if (restart == NULL) restart = new WriteRestart(muse);
+}
+
+/* ----------------------------------------------------------------------
+   write a periodic restart file for this timestep
+   the model is copied here, the file is written in the background
+------------------------------------------------------------------------- */
+
+void Output::write_restart(int ntimestep)
+{
+    char* file;
+
+    if (restart_toggle == 0) {
+        char* ptr = strchr(restart1, '*');
+        if (ptr) {
+            file = new char[strlen(restart1) + 16];
+            *ptr = '\0';
+            sprintf(file, "%s%d%s", restart1, ntimestep, ptr + 1);
+            *ptr = '*';
+        }
+        else {
+            file = new char[strlen(restart1) + 1];
+            strcpy(file, restart1);
+        }
+    }
+    else {
+        char* name = (restart_toggle == 1) ? restart1 : restart2;
+        file = new char[strlen(name) + 1];
+        strcpy(file, name);
+        restart_toggle = (restart_toggle == 1) ? 2 : 1;
+    }
+
+    restart->write(file);
+    delete[] file;
+    last_restart = ntimestep;
+}
@@ -38,23 +38,30 @@ namespace MUSE_NS {
 		int* ivar_result;                // variable index for result frequency
 		class Result** result;           // list of defined results
 
-		//int restart_flag;             // 1 if restart files are written
-		//int restart_every;            // restart file write freq, 0 if var
-		//int next_restart;             // next timestep to write restart file
-		//int last_restart;             // last timestep restart file was output
-		//char* var_restart;            // variable name for restart freq
-		//int ivar_restart;             // index of var_restart_double
-		//char* restartf;               // name restart file
-		//class WriteRestart* restart;  // class for writing restart files
+		class Trajectory* traj;          // streaming trajectory logger
+		class AsyncWriter* async;        // background writer, NULL if off
+		class ShmRing* shm;              // shared memory publisher, NULL if off
+
+		int restart_flag;                // 1 if restart files are written
+		int restart_every;               // restart file write freq
+		int next_restart;                // next timestep to write restart file
+		int last_restart;                // last timestep restart file was output
+		int restart_toggle;              // 0 = use restart1, 1/2 = alternate
+		char* restart1;                  // name of restart file, * = timestep
+		char* restart2;                  // second file when alternating
+		class WriteRestart* restart;     // class for writing restart files
 
 		Output(class MUSE*);
 		~Output();
 		void init();
 		void setup(int);                   // initial output before run/min
+		void setup_layout();               // size buffers for the current bodies
 		void write(int);                   // output for current timestep
 		void write_result(int);            // force output of result snapshots
 		void write_restart(int);           // force output of a restart file
 		void reset_timestep(int);          // reset next timestep for all output
+		void drain();                      // wait for background writes
+		void modify_params(int, char**);   // output keyword settings
 
 		void add_result(int, char**);       // add a result to result list
 		void modify_result(int, char**);    // modify a result
@@ -22,6 +22,7 @@ using namespace MUSE_NS;
 RanMars::RanMars(MUSE *muse) : Pointers(muse)
 {
   initflag = 0;
+  save = 0;
   u = NULL;
 }
 
@@ -40,12 +41,14 @@ void RanMars::init(int seed)
   double s,t;
 
   initflag = 1;
+  save = 0;
 
   // assume input seed is positive value > 0
   // insure seed is from 1 to 900,000,000 inclusive
 
   while (seed > 900000000) seed -= 900000000;
 
+  delete [] u;
   u = new double[97+1];
 
   ij = (seed-1)/30082;
@@ -124,3 +127,48 @@ double RanMars::gaussian()
   }
   return first;
 }
+
+/* ----------------------------------------------------------------------
+   # of values in the generator state, 0 if not seeded
+------------------------------------------------------------------------- */
+
+int RanMars::size_restart()
+{
+  if (!initflag) return 0;
+  return 8 + 97;
+}
+
+/* ----------------------------------------------------------------------
+   copy generator state to buf, so a restarted run draws the same numbers
+------------------------------------------------------------------------- */
+
+void RanMars::pack_restart(double *buf)
+{
+  if (!initflag) return;
+  buf[0] = initflag;
+  buf[1] = save;
+  buf[2] = i97;
+  buf[3] = j97;
+  buf[4] = c;
+  buf[5] = cd;
+  buf[6] = cm;
+  buf[7] = second;
+  for (int i = 1; i <= 97; i++) buf[7+i] = u[i];
+}
+
+/* ---------------------------------------------------------------------- */
+
+void RanMars::unpack_restart(double *buf)
+{
+  initflag = static_cast<int>(buf[0]);
+  save = static_cast<int>(buf[1]);
+  i97 = static_cast<int>(buf[2]);
+  j97 = static_cast<int>(buf[3]);
+  c = buf[4];
+  cd = buf[5];
+  cm = buf[6];
+  second = buf[7];
+  delete [] u;
+  u = new double[97+1];
+  for (int i = 1; i <= 97; i++) u[i] = buf[7+i];
+}
@@ -23,6 +23,9 @@ class RanMars : protected Pointers {
   void init(int);
   double uniform();
   double gaussian();
+  int size_restart();
+  void pack_restart(double *);
+  void unpack_restart(double *);
 
  private:
   int initflag,save;
@@ -0,0 +1,454 @@
+/* ----------------------------------------------------------------------
+   MUSE - MUltibody System dynamics Engine
+   https://github.com/zhangh3/MUSE
+
+   Zhang He, zhanghecalt@163.com
+   Science and Technology on Space Physics Laboratory, Beijing
+
+   This software is distributed under the GNU General Public License.
+   Copyright (c) 2023 Zhang He. All rights reserved.
+------------------------------------------------------------------------- */
+
+#include "mpi.h"
+#include "ctype.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "limits.h"
+#include "read_model.h"
+#include "muse.h"
+#include "MUSEsystem.h"
+#include "body.h"
+#include "joint.h"
+#include "memory.h"
+#include "error.h"
+
+using namespace MUSE_NS;
+
+#define MAXWORD 22                   // fields of a full body record
+#define DELTA 1024
+
+/* ---------------------------------------------------------------------- */
+
+ReadModel::ReadModel(MUSE *muse) : Pointers(muse)
+{
+  MPI_Comm_rank(world,&me);
+  buf = NULL;
+  nbuf = 0;
+}
+
+/* ---------------------------------------------------------------------- */
+
+ReadModel::~ReadModel()
+{
+  memory->sfree(buf);
+}
+
+/* ----------------------------------------------------------------------
+   read_model file keyword value ...
+     system yes/no = add the bodies and joints read to the system
+     save FILE = write the bodies and joints read as a binary model file
+   files starting with MODEL_MAGIC are binary, others are CSV
+------------------------------------------------------------------------- */
+
+void ReadModel::command(int narg, char **arg)
+{
+  if (narg < 1) error->all(FLERR,"Illegal read_model command");
+
+  int sysflag = 1;
+  char *savefile = NULL;
+
+  int iarg = 1;
+  while (iarg < narg) {
+    if (strcmp(arg[iarg],"system") == 0) {
+      if (iarg+2 > narg) error->all(FLERR,"Illegal read_model command");
+      if (strcmp(arg[iarg+1],"yes") == 0) sysflag = 1;
+      else if (strcmp(arg[iarg+1],"no") == 0) sysflag = 0;
+      else error->all(FLERR,"Illegal read_model command");
+      iarg += 2;
+    } else if (strcmp(arg[iarg],"save") == 0) {
+      if (iarg+2 > narg) error->all(FLERR,"Illegal read_model command");
+      savefile = arg[iarg+1];
+      iarg += 2;
+    } else error->all(FLERR,"Illegal read_model command");
+  }
+
+  // proc 0 reads the whole file, others get a copy
+  // one extra byte terminates the text of a CSV file
+
+  if (me == 0) {
+    FILE *fp = fopen(arg[0],"rb");
+    if (fp == NULL) {
+      char str[128];
+      snprintf(str,128,"Cannot open model file %s",arg[0]);
+      error->one(FLERR,str);
+    }
+    fseek(fp,0,SEEK_END);
+    long n = ftell(fp);
+    fseek(fp,0,SEEK_SET);
+    if (n < 0 || n >= INT_MAX) error->one(FLERR,"Model file is too large");
+    nbuf = n;
+    buf = (char *) memory->smalloc(nbuf+1,"read_model:buf");
+    if ((int) fread(buf,1,nbuf,fp) != nbuf)
+      error->one(FLERR,"Cannot read model file");
+    fclose(fp);
+  }
+  MPI_Bcast(&nbuf,1,MPI_INT,0,world);
+  if (me != 0) buf = (char *) memory->smalloc(nbuf+1,"read_model:buf");
+  MPI_Bcast(buf,nbuf,MPI_CHAR,0,world);
+  buf[nbuf] = '\0';
+
+  nbody0 = muse->nBodies;
+  njoint0 = muse->nJoints;
+
+  if (nbuf >= (int) sizeof(ModelHeader) && strncmp(buf,MODEL_MAGIC,8) == 0)
+    read_binary();
+  else read_csv();
+
+  memory->sfree(buf);
+  buf = NULL;
+
+  if (sysflag) {
+    System *s = muse->system;
+    for (int i = nbody0; i < muse->nBodies; i++) s->add_Body(muse->body[i]);
+    for (int i = njoint0; i < muse->nJoints; i++) s->add_Joint(muse->joint[i]);
+  }
+
+  if (savefile) save(savefile);
+
+  if (me == 0) {
+    if (screen)
+      fprintf(screen,"Read model file %s: %d bodies, %d joints\n",arg[0],
+              muse->nBodies-nbody0,muse->nJoints-njoint0);
+    if (logfile)
+      fprintf(logfile,"Read model file %s: %d bodies, %d joints\n",arg[0],
+              muse->nBodies-nbody0,muse->nJoints-njoint0);
+  }
+}
+
+/* ----------------------------------------------------------------------
+   binary model, records are fixed size
+------------------------------------------------------------------------- */
+
+void ReadModel::read_binary()
+{
+  ModelHeader h;
+  memcpy(&h,buf,sizeof(ModelHeader));
+  if (h.version != MODEL_VERSION || h.namelen != MODEL_NAMELEN)
+    error->all(FLERR,"Model file version does not match this MUSE");
+  if (h.nbody < 0 || h.njoint < 0 || h.nbody > INT_MAX || h.njoint > INT_MAX ||
+      h.body_offset < (int64_t) sizeof(ModelHeader) ||
+      h.joint_offset < (int64_t) sizeof(ModelHeader) ||
+      h.body_offset + h.nbody*(int64_t) sizeof(ModelBody) > nbuf ||
+      h.joint_offset + h.njoint*(int64_t) sizeof(ModelJoint) > nbuf)
+    error->all(FLERR,"Model file is truncated");
+
+  char name[MODEL_NAMELEN+1],body1[MODEL_NAMELEN+1],body2[MODEL_NAMELEN+1];
+  name[MODEL_NAMELEN] = body1[MODEL_NAMELEN] = body2[MODEL_NAMELEN] = '\0';
+  double v[20];
+
+  for (int64_t i = 0; i < h.nbody; i++) {
+    ModelBody b;
+    memcpy(&b,&buf[h.body_offset + i*sizeof(ModelBody)],sizeof(ModelBody));
+    memcpy(name,b.name,MODEL_NAMELEN);
+    check_name(name,"Body");
+    int id = muse->add_Body(name);
+    v[0] = b.mass;
+    memcpy(&v[1],b.inertia,6*sizeof(double));
+    memcpy(&v[7],b.pos,3*sizeof(double));
+    memcpy(&v[10],b.quat,4*sizeof(double));
+    memcpy(&v[14],b.vel,3*sizeof(double));
+    memcpy(&v[17],b.omega,3*sizeof(double));
+    body_values(id,v,20);
+  }
+
+  for (int64_t i = 0; i < h.njoint; i++) {
+    ModelJoint j;
+    memcpy(&j,&buf[h.joint_offset + i*sizeof(ModelJoint)],sizeof(ModelJoint));
+    memcpy(name,j.name,MODEL_NAMELEN);
+    memcpy(body1,j.body1,MODEL_NAMELEN);
+    memcpy(body2,j.body2,MODEL_NAMELEN);
+    check_name(name,"Joint");
+    int id = muse->add_Joint(name);
+    muse->joint[id]->set_type(j.type);
+    memcpy(&v[0],j.point1,3*sizeof(double));
+    memcpy(&v[3],j.point2,3*sizeof(double));
+    memcpy(&v[6],j.axis1,3*sizeof(double));
+    memcpy(&v[9],j.axis2,3*sizeof(double));
+    joint_values(id,body1,body2,v,12);
+  }
+}
+
+/* ----------------------------------------------------------------------
+   CSV model, one record per line, '#' starts a comment
+     body,NAME,mass,Ixx,Iyy,Izz,Ixy,Ixz,Iyz,x,y,z,q1,q2,q3,q4,vx,vy,vz,wx,wy,wz
+     joint,NAME,TYPE,BODY1,BODY2,p1x,p1y,p1z,p2x,p2y,p2z,a1x,a1y,a1z,a2x,a2y,a2z
+   trailing groups may be left out and keep their defaults
+   bodies are created first, so joints may refer to bodies further down
+------------------------------------------------------------------------- */
+
+void ReadModel::read_csv()
+{
+  char *words[MAXWORD+1];
+  double v[MAXWORD];
+  char str[128];
+
+  int njline = 0;
+  int maxjline = 0;
+  char **jline = NULL;
+  int *jlineno = NULL;
+
+  char *next = buf;
+  int lineno = 0;
+
+  while (*next) {
+    char *line = next;
+    char *eol = strchr(line,'\n');
+    if (eol) {
+      *eol = '\0';
+      next = eol + 1;
+    } else next = line + strlen(line);
+    lineno++;
+
+    char *ptr = line;
+    while (*ptr == ' ' || *ptr == '\t') ptr++;
+    if (strncmp(ptr,"joint",5) == 0) {
+      if (njline == maxjline) {
+        maxjline = maxjline ? 2*maxjline : DELTA;
+        jline = (char **)
+          memory->srealloc(jline,maxjline*sizeof(char *),"read_model:jline");
+        memory->grow(jlineno,maxjline,"read_model:jlineno");
+      }
+      jline[njline] = line;
+      jlineno[njline++] = lineno;
+      continue;
+    }
+
+    int nword = split(line,words,MAXWORD);
+    if (nword == 0) continue;
+    if (strcmp(words[0],"body") != 0 || nword < 2) {
+      snprintf(str,128,"Invalid record in model file line %d",lineno);
+      error->all(FLERR,str);
+    }
+    for (int i = 2; i < nword; i++) {
+      char *end;
+      v[i-2] = strtod(words[i],&end);
+      if (end == words[i] || *end != '\0') {
+        snprintf(str,128,"Invalid number in model file line %d",lineno);
+        error->all(FLERR,str);
+      }
+    }
+    check_name(words[1],"Body");
+    body_values(muse->add_Body(words[1]),v,nword-2);
+  }
+
+  for (int k = 0; k < njline; k++) {
+    int nword = split(jline[k],words,MAXWORD);
+    if (strcmp(words[0],"joint") != 0 || nword < 3) {
+      snprintf(str,128,"Invalid record in model file line %d",jlineno[k]);
+      error->all(FLERR,str);
+    }
+    for (int i = 5; i < nword; i++) {
+      char *end;
+      v[i-5] = strtod(words[i],&end);
+      if (end == words[i] || *end != '\0') {
+        snprintf(str,128,"Invalid number in model file line %d",jlineno[k]);
+        error->all(FLERR,str);
+      }
+    }
+    check_name(words[1],"Joint");
+    int id = muse->add_Joint(words[1]);
+    muse->joint[id]->set_type_by_name(words[2]);
+    joint_values(id,(nword > 3) ? words[3] : "",(nword > 4) ? words[4] : "",
+                 v,(nword > 5) ? nword-5 : 0);
+  }
+
+  memory->sfree(jline);
+  memory->destroy(jlineno);
+}
+
+/* ----------------------------------------------------------------------
+   split a line in place at commas, fields are trimmed of blanks
+   return # of fields, 0 for a blank or comment line
+------------------------------------------------------------------------- */
+
+int ReadModel::split(char *line, char **words, int maxword)
+{
+  char *ptr = strchr(line,'#');
+  if (ptr) *ptr = '\0';
+
+  int nword = 0;
+  ptr = line;
+  while (1) {
+    while (*ptr == ' ' || *ptr == '\t') ptr++;
+    char *word = ptr;
+    while (*ptr && *ptr != ',') ptr++;
+    int last = (*ptr == '\0');
+    char *end = ptr;
+    while (end > word && isspace(end[-1])) end--;
+    *end = '\0';
+    if (nword == maxword) error->all(FLERR,"Too many fields in model file");
+    words[nword++] = word;
+    if (last) break;
+    ptr++;
+  }
+
+  if (nword == 1 && words[0][0] == '\0') return 0;
+  return nword;
+}
+
+/* ----------------------------------------------------------------------
+   set a body from n values in the order of a body record
+   n stops at the end of a group: mass, inertia, pos, quat, vel, omega
+------------------------------------------------------------------------- */
+
+void ReadModel::body_values(int id, double *v, int n)
+{
+  Body *b = muse->body[id];
+  if (n != 0 && n != 1 && n != 7 && n != 10 && n != 14 && n != 17 && n != 20) {
+    char str[128];
+    snprintf(str,128,"Incomplete values of body %s in model file",b->name);
+    error->all(FLERR,str);
+  }
+
+  if (n >= 1) b->set_Mass(v[0]);
+  if (n >= 7) b->set_Inertia(v[1],v[2],v[3],v[4],v[5],v[6]);
+  if (n >= 10) b->pos << v[7],v[8],v[9];
+  if (n >= 14) b->set_Quaternion(&v[10]);
+  if (n >= 17) b->vel << v[14],v[15],v[16];
+  if (n >= 20) b->set_Omega(v[17],v[18],v[19]);
+}
+
+/* ----------------------------------------------------------------------
+   set a joint from its body names and n values in the order of a
+   joint record: point1, point2, axis1, axis2
+   an empty or "none" body name leaves the body unset
+------------------------------------------------------------------------- */
+
+void ReadModel::joint_values(int id, const char *body1, const char *body2,
+                             double *v, int n)
+{
+  Joint *j = muse->joint[id];
+  char str[128];
+  if (n % 3) {
+    snprintf(str,128,"Incomplete values of joint %s in model file",j->name);
+    error->all(FLERR,str);
+  }
+
+  const char *bname[2] = {body1,body2};
+  for (int k = 0; k < 2; k++) {
+    if (bname[k][0] == '\0' || strcmp(bname[k],"none") == 0) continue;
+    int ibody = muse->find_Body(bname[k]);
+    if (ibody < 0) {
+      snprintf(str,128,"Cannot find body with name: %s",bname[k]);
+      error->all(FLERR,str);
+    }
+    j->body[k] = muse->body[ibody];
+  }
+
+  if (n >= 3) j->point1 << v[0],v[1],v[2];
+  if (n >= 6) j->point2 << v[3],v[4],v[5];
+  if (n >= 9) j->set_axis(v[6],v[7],v[8],1);
+  if (n >= 12) j->set_axis(v[9],v[10],v[11],2);
+}
+
+/* ---------------------------------------------------------------------- */
+
+void ReadModel::check_name(const char *name, const char *kind)
+{
+  int n = strlen(name);
+  for (int i = 0; i < n; i++)
+    if (!isalnum(name[i]) && name[i] != '_') {
+      char str[128];
+      snprintf(str,128,"%s name must be alphanumeric or underscore characters",
+               kind);
+      error->all(FLERR,str);
+    }
+}
+
+/* ----------------------------------------------------------------------
+   write the bodies and joints read as a binary model file
+------------------------------------------------------------------------- */
+
+void ReadModel::save(const char *file)
+{
+  int i;
+  char str[128];
+
+  for (i = nbody0; i < muse->nBodies; i++)
+    if (strlen(muse->body[i]->name) >= MODEL_NAMELEN) {
+      snprintf(str,128,"Name %s is too long for a binary model file",
+               muse->body[i]->name);
+      error->all(FLERR,str);
+    }
+  for (i = njoint0; i < muse->nJoints; i++) {
+    Joint *j = muse->joint[i];
+    const char *name = j->name;
+    for (int k = 0; k < 2; k++)
+      if (j->body[k] && strlen(j->body[k]->name) >= MODEL_NAMELEN)
+        name = j->body[k]->name;
+    if (strlen(name) >= MODEL_NAMELEN) {
+      snprintf(str,128,"Name %s is too long for a binary model file",name);
+      error->all(FLERR,str);
+    }
+  }
+
+  if (me != 0) return;
+
+  FILE *fp = fopen(file,"wb");
+  if (fp == NULL) {
+    snprintf(str,128,"Cannot open model file %s",file);
+    error->one(FLERR,str);
+  }
+
+  ModelHeader h;
+  memset(&h,0,sizeof(ModelHeader));
+  strncpy(h.magic,MODEL_MAGIC,8);
+  h.version = MODEL_VERSION;
+  h.namelen = MODEL_NAMELEN;
+  h.nbody = muse->nBodies - nbody0;
+  h.njoint = muse->nJoints - njoint0;
+  h.body_offset = sizeof(ModelHeader);
+  h.joint_offset = h.body_offset + h.nbody*sizeof(ModelBody);
+  int flag = (fwrite(&h,sizeof(ModelHeader),1,fp) != 1);
+
+  for (i = nbody0; i < muse->nBodies; i++) {
+    Body *b = muse->body[i];
+    ModelBody r;
+    memset(&r,0,sizeof(ModelBody));
+    strcpy(r.name,b->name);
+    r.mass = b->mass;
+    r.inertia[0] = b->inertia(0,0);
+    r.inertia[1] = b->inertia(1,1);
+    r.inertia[2] = b->inertia(2,2);
+    r.inertia[3] = b->inertia(0,1);
+    r.inertia[4] = b->inertia(0,2);
+    r.inertia[5] = b->inertia(1,2);
+    memcpy(r.pos,b->pos.data(),3*sizeof(double));
+    memcpy(r.quat,b->quat.data(),4*sizeof(double));
+    memcpy(r.vel,b->vel.data(),3*sizeof(double));
+    memcpy(r.omega,b->omega.data(),3*sizeof(double));
+    flag |= (fwrite(&r,sizeof(ModelBody),1,fp) != 1);
+  }
+
+  for (i = njoint0; i < muse->nJoints; i++) {
+    Joint *j = muse->joint[i];
+    ModelJoint r;
+    memset(&r,0,sizeof(ModelJoint));
+    strcpy(r.name,j->name);
+    if (j->body[0]) strcpy(r.body1,j->body[0]->name);
+    if (j->body[1]) strcpy(r.body2,j->body[1]->name);
+    r.type = j->get_type();
+    memcpy(r.point1,j->point1.data(),3*sizeof(double));
+    memcpy(r.point2,j->point2.data(),3*sizeof(double));
+    memcpy(r.axis1,j->axis1.data(),3*sizeof(double));
+    memcpy(r.axis2,j->axis2.data(),3*sizeof(double));
+    flag |= (fwrite(&r,sizeof(ModelJoint),1,fp) != 1);
+  }
+
+  if (fclose(fp) != 0) flag = 1;
+  if (flag) {
+    snprintf(str,128,"Cannot write model file %s",file);
+    error->one(FLERR,str);
+  }
+}
@@ -0,0 +1,90 @@
+/* ----------------------------------------------------------------------
+   MUSE - MUltibody System dynamics Engine
+   https://github.com/zhangh3/MUSE
+
+   Zhang He, zhanghecalt@163.com
+   Science and Technology on Space Physics Laboratory, Beijing
+
+   This software is distributed under the GNU General Public License.
+   Copyright (c) 2023 Zhang He. All rights reserved.
+------------------------------------------------------------------------- */
+
+#ifdef COMMAND_CLASS
+
+CommandStyle(read_model,ReadModel)
+
+#else
+
+#ifndef MUSE_READ_MODEL_H
+#define MUSE_READ_MODEL_H
+
+#include "stdint.h"
+#include "pointers.h"
+
+/* binary model file, written by "read_model ... save"
+
+     ModelHeader                     at offset 0
+     ModelBody body[nbody]           at body_offset
+     ModelJoint joint[njoint]        at joint_offset
+
+   names are NUL padded, a joint body name may be empty (none) */
+
+#define MODEL_MAGIC "MUSEMDL"
+#define MODEL_VERSION 1
+#define MODEL_NAMELEN 32
+
+struct ModelHeader {
+  char magic[8];                     // MODEL_MAGIC
+  int32_t version;                   // MODEL_VERSION
+  int32_t namelen;                   // MODEL_NAMELEN
+  int64_t nbody,njoint;
+  int64_t body_offset,joint_offset;
+};
+
+struct ModelBody {
+  char name[MODEL_NAMELEN];
+  double mass;
+  double inertia[6];                 // Ixx Iyy Izz Ixy Ixz Iyz
+  double pos[3];
+  double quat[4];
+  double vel[3];
+  double omega[3];
+};
+
+struct ModelJoint {
+  char name[MODEL_NAMELEN];
+  char body1[MODEL_NAMELEN];
+  char body2[MODEL_NAMELEN];
+  int32_t type;                      // joint_enums.h
+  int32_t pad;
+  double point1[3],point2[3];
+  double axis1[3],axis2[3];
+};
+
+namespace MUSE_NS {
+
+class ReadModel : protected Pointers {
+ public:
+  ReadModel(class MUSE *);
+  ~ReadModel();
+  void command(int, char **);
+
+ private:
+  int me;
+  char *buf;                         // whole model file
+  int nbuf;
+  int nbody0,njoint0;                // first body/joint read
+
+  void read_binary();
+  void read_csv();
+  int split(char *, char **, int);
+  void body_values(int, double *, int);
+  void joint_values(int, const char *, const char *, double *, int);
+  void check_name(const char *, const char *);
+  void save(const char *);
+};
+
+}
+
+#endif
+#endif
@@ -0,0 +1,250 @@
+/* ----------------------------------------------------------------------
+   MUSE - MUltibody System dynamics Engine
+   https://github.com/zhangh3/MUSE
+
+   Zhang He, zhanghecalt@163.com
+   Science and Technology on Space Physics Laboratory, Beijing
+
+   This software is distributed under the GNU General Public License.
+   Copyright (c) 2023 Zhang He. All rights reserved.
+------------------------------------------------------------------------- */
+
+#include "mpi.h"
+#include "stdio.h"
+#include "string.h"
+#include "read_restart.h"
+#include "write_restart.h"
+#include "muse.h"
+#include "MUSEsystem.h"
+#include "body.h"
+#include "joint.h"
+#include "modify.h"
+#include "ensemble.h"
+#include "random_mars.h"
+#include "memory.h"
+#include "error.h"
+
+using namespace MUSE_NS;
+
+/* ---------------------------------------------------------------------- */
+
+ReadRestart::ReadRestart(MUSE *muse) : Pointers(muse)
+{
+  MPI_Comm_rank(world,&me);
+  buf = NULL;
+  nbuf = ibuf = 0;
+}
+
+/* ---------------------------------------------------------------------- */
+
+ReadRestart::~ReadRestart()
+{
+  memory->sfree(buf);
+}
+
+/* ----------------------------------------------------------------------
+   read_restart file
+   rebuild bodies, joints, system, computes and RNG state
+   layout is documented in WriteRestart::snapshot()
+------------------------------------------------------------------------- */
+
+void ReadRestart::command(int narg, char **arg)
+{
+  if (narg != 1) error->all(FLERR,"Illegal read_restart command");
+  if (muse->nBodies || muse->nJoints || modify->ncompute)
+    error->all(FLERR,"Read_restart command before bodies, joints "
+               "or computes are defined");
+
+  // proc 0 reads the whole file, others get a copy
+
+  if (me == 0) {
+    FILE *fp = fopen(arg[0],"rb");
+    if (fp == NULL) {
+      char str[128];
+      sprintf(str,"Cannot open restart file %s",arg[0]);
+      error->one(FLERR,str);
+    }
+    fseek(fp,0,SEEK_END);
+    nbuf = ftell(fp);
+    fseek(fp,0,SEEK_SET);
+    buf = (char *) memory->smalloc(nbuf,"read_restart:buf");
+    if ((int) fread(buf,1,nbuf,fp) != nbuf)
+      error->one(FLERR,"Cannot read restart file");
+    fclose(fp);
+  }
+  MPI_Bcast(&nbuf,1,MPI_INT,0,world);
+  if (me != 0) buf = (char *) memory->smalloc(nbuf,"read_restart:buf");
+  MPI_Bcast(buf,nbuf,MPI_CHAR,0,world);
+
+  need(8);
+  if (strncmp(&buf[ibuf],RESTART_MAGIC,8) != 0)
+    error->all(FLERR,"File is not a MUSE restart file");
+  ibuf += 8;
+  if (unpack_int() != RESTART_VERSION)
+    error->all(FLERR,"Restart file version does not match this MUSE");
+
+  System *s = muse->system;
+  int ntimestep = unpack_int();
+  double timenow = unpack_double();
+  s->dt = unpack_double();
+  unpack_doubles(s->ga.data(),3);
+
+  int i,n,id;
+
+  n = unpack_int();
+  for (i = 0; i < n; i++) {
+    char *name = unpack_string();
+    id = muse->add_Body(name);
+    delete [] name;
+    Body *b = muse->body[id];
+    b->mass = unpack_double();
+    unpack_doubles(b->inertia.data(),9);
+    unpack_doubles(b->pos.data(),3);
+    unpack_doubles(b->vel.data(),3);
+    unpack_doubles(b->quat.data(),4);
+    unpack_doubles(b->quatd.data(),4);
+    unpack_doubles(b->omega.data(),3);
+    unpack_doubles(b->force.data(),3);
+    unpack_doubles(b->torque.data(),3);
+  }
+
+  n = unpack_int();
+  for (i = 0; i < n; i++) {
+    char *name = unpack_string();
+    id = muse->add_Joint(name);
+    delete [] name;
+    Joint *j = muse->joint[id];
+    j->set_type(unpack_int());
+    unpack_doubles(j->point1.data(),3);
+    unpack_doubles(j->point2.data(),3);
+    unpack_doubles(j->axis1.data(),3);
+    unpack_doubles(j->axis2.data(),3);
+    for (int k = 0; k < 2; k++) {
+      id = unpack_int();
+      if (id < -1 || id >= muse->nBodies)
+        error->all(FLERR,"Invalid body index in restart file");
+      j->body[k] = (id >= 0) ? muse->body[id] : NULL;
+    }
+  }
+
+  n = unpack_int();
+  for (i = 0; i < n; i++) {
+    id = unpack_int();
+    if (id < 0 || id >= muse->nBodies)
+      error->all(FLERR,"Invalid body index in restart file");
+    s->add_Body(muse->body[id]);
+  }
+  n = unpack_int();
+  for (i = 0; i < n; i++) {
+    id = unpack_int();
+    if (id < 0 || id >= muse->nJoints)
+      error->all(FLERR,"Invalid joint index in restart file");
+    s->add_Joint(muse->joint[id]);
+  }
+
+  // bind the bodies into x/xd now and take the saved xdd,
+  // body state, omega and xdd are then exactly those of the writing run,
+  // so the first run skips prepare() unless something was changed
+  // before the file was written, see System::prepare()
+
+  int changed = unpack_int();
+  n = unpack_int();
+  if (s->nBodies) s->setup_minimal();
+  if (s->nBodies && n == (int) s->xdd.size()) {
+    unpack_doubles(s->xdd.data(),n);
+    s->changed = changed;
+  } else {
+    need(n*sizeof(double));
+    ibuf += n*sizeof(double);
+    s->changed = CHANGE_ALL;
+  }
+
+  // computes are re-created from their command, after system membership
+
+  n = unpack_int();
+  for (i = 0; i < n; i++) {
+    int nargs = unpack_int();
+    char **args = new char*[nargs];
+    for (int k = 0; k < nargs; k++) args[k] = unpack_string();
+    modify->add_compute(nargs,args);
+    for (int k = 0; k < nargs; k++) delete [] args[k];
+    delete [] args;
+  }
+
+  n = unpack_int();
+  if (n) {
+    if (n != ensemble->ranmaster->size_restart())
+      error->all(FLERR,"Invalid random number state in restart file");
+    double *state = new double[n];
+    unpack_doubles(state,n);
+    ensemble->ranmaster->unpack_restart(state);
+    delete [] state;
+  }
+
+  need(8);
+  if (strncmp(&buf[ibuf],RESTART_END,8) != 0)
+    error->all(FLERR,"Restart file is corrupt");
+
+  s->ntimestep = ntimestep;
+  s->timenow = timenow;
+
+  if (me == 0) {
+    if (screen)
+      fprintf(screen,"Read restart file %s: %d bodies, %d joints, "
+              "step %d, time %g\n",arg[0],muse->nBodies,muse->nJoints,
+              ntimestep,timenow);
+    if (logfile)
+      fprintf(logfile,"Read restart file %s: %d bodies, %d joints, "
+              "step %d, time %g\n",arg[0],muse->nBodies,muse->nJoints,
+              ntimestep,timenow);
+  }
+}
+
+/* ---------------------------------------------------------------------- */
+
+void ReadRestart::need(int n)
+{
+  if (n < 0 || ibuf + n > nbuf) error->all(FLERR,"Restart file is truncated");
+}
+
+/* ---------------------------------------------------------------------- */
+
+int ReadRestart::unpack_int()
+{
+  int value;
+  need(sizeof(int));
+  memcpy(&value,&buf[ibuf],sizeof(int));
+  ibuf += sizeof(int);
+  return value;
+}
+
+/* ---------------------------------------------------------------------- */
+
+double ReadRestart::unpack_double()
+{
+  double value;
+  unpack_doubles(&value,1);
+  return value;
+}
+
+/* ---------------------------------------------------------------------- */
+
+void ReadRestart::unpack_doubles(double *values, int n)
+{
+  need(n*sizeof(double));
+  memcpy(values,&buf[ibuf],n*sizeof(double));
+  ibuf += n*sizeof(double);
+}
+
+/* ---------------------------------------------------------------------- */
+
+char *ReadRestart::unpack_string()
+{
+  int n = unpack_int();
+  need(n);
+  char *str = new char[n+1];
+  memcpy(str,&buf[ibuf],n);
+  str[n] = '\0';
+  ibuf += n;
+  return str;
+}
@@ -0,0 +1,46 @@
+/* ----------------------------------------------------------------------
+   MUSE - MUltibody System dynamics Engine
+   https://github.com/zhangh3/MUSE
+
+   Zhang He, zhanghecalt@163.com
+   Science and Technology on Space Physics Laboratory, Beijing
+
+   This software is distributed under the GNU General Public License.
+   Copyright (c) 2023 Zhang He. All rights reserved.
+------------------------------------------------------------------------- */
+
+#ifdef COMMAND_CLASS
+
+CommandStyle(read_restart,ReadRestart)
+
+#else
+
+#ifndef MUSE_READ_RESTART_H
+#define MUSE_READ_RESTART_H
+
+#include "pointers.h"
+
+namespace MUSE_NS {
+
+class ReadRestart : protected Pointers {
+ public:
+  ReadRestart(class MUSE *);
+  ~ReadRestart();
+  void command(int, char **);
+
+ private:
+  int me;
+  char *buf;                   // whole restart file
+  int nbuf,ibuf;
+
+  void need(int);
+  int unpack_int();
+  double unpack_double();
+  void unpack_doubles(double *, int);
+  char *unpack_string();
+};
+
+}
+
+#endif
+#endif
@@ -30,7 +30,7 @@ using namespace MUSE_NS;
 
 // customize a new keyword by adding to this list:
 
-// step,elapsed,elaplong,dt,cpu,tpcpu,spcpu,wall,
+// step,elapsed,elaplong,dt,cpu,tpcpu,spcpu,wall,t_solve,t_assemble,...
 // np,ntouch,ncomm,nbound,nexit,nscoll,nscheck,ncoll,nattempt,nreact,nsreact,
 // npave,ntouchave,ncommave,nboundave,nexitave,nscollave,nscheckave,
 // ncollave,nattemptave,nreactave,nsreactave,
@@ -425,6 +425,12 @@ void Result::set_fields(int narg, char **arg)
     } else if (strcmp(arg[i],"wall") == 0) {
       addfield("WALL",&Result::compute_wall,FLOAT);
 
+    // t_solve, t_assemble, ... = phase times of this run, see Timer
+
+    } else if (timer->keyword(arg[i]) >= 0) {
+      argindex1[nfield] = timer->keyword(arg[i]);
+      addfield(arg[i],&Result::compute_timer,FLOAT);
+
     // compute value = c_ID,  variable value = v_ID
     // count trailing [] and store int arguments
     // copy = at most 8 chars of ID to pass to addfield
@@ -603,6 +609,8 @@ int Result::evaluate_keyword(char *word, double *answer)
 
   } else if (strcmp(word,"wall") == 0) {
     compute_wall();
+  } else if (timer->keyword(word) >= 0) {
+    dvalue = timer->array[timer->keyword(word)];
   } 
   else return 1;
 
@@ -728,3 +736,10 @@ void Result::compute_wall()
 {
   dvalue = MPI_Wtime() - wall0;
 }
+
+/* ---------------------------------------------------------------------- */
+
+void Result::compute_timer()
+{
+  dvalue = timer->array[argindex1[ifield]];
+}
@@ -103,6 +103,7 @@ class Result : protected Pointers {
   void compute_tpcpu();
   void compute_spcpu();
   void compute_wall();
+  void compute_timer();
 
 };
 
@@ -19,6 +19,7 @@
 #include "timer.h"
 #include "modify.h"
 #include "output.h"
+#include "event.h"
 
 #include <iostream>
 #include <fstream>
@@ -37,6 +38,8 @@ Run::Run(MUSE *muse) : Pointers(muse) {
 void Run::command(int narg, char **arg)
 {
   if (narg < 1) error->all(FLERR,"Illegal run command");
+  if (muse->system->event && muse->system->event->firing)
+    error->all(FLERR,"Run command cannot be used in an event");
 
   int nsteps_input = input->inumeric(FLERR, arg[0]);
 
@@ -167,7 +170,7 @@ void Run::command(int narg, char **arg)
     //һҪõĶ
         //muse->system->first_run = 1;//FIXME
         muse->init();
-        muse->system->setup();
+        muse->system->setup_changed();
     }
     else output->setup(0);
 
@@ -177,19 +180,10 @@ void Run::command(int narg, char **arg)
     timer->barrier_start(TIME_LOOP);
     muse->system->solve(nsteps);
     timer->barrier_stop(TIME_LOOP);
+    timer->report(nsteps);
     //std::cout << "Iterated " << nsteps << " steps and ";
     //std::cout << "took " << std::fixed << std::setprecision(2) << 1000 * timer->array[TIME_LOOP] << " milliseconds" << std::endl;
 
-
-
-    std::ofstream fout;
-    fout.open("./res.txt", std::ios::app);
-    for (int i = 1; i < muse->system->xlog.size();i++)
-    {
-        fout << muse->system->xlog[i].transpose() << std::endl;
-    }
-    fout.close();
-
   // perform multiple runs optionally interleaved with invocation command(s)
   // use start/stop to set begin/end step
   // if pre or 1st iteration of multiple runs, do System init/setup,
@@ -218,7 +212,7 @@ void Run::command(int narg, char **arg)
       if (preflag || iter == 0) {
           //muse->system->first_run = 1;//FIXME
           muse->init();
-          muse->system->setup();
+          muse->system->setup_changed();
       }
       else output->setup(0);
 
@@ -226,18 +220,12 @@ void Run::command(int narg, char **arg)
       timer->barrier_start(TIME_LOOP);
       muse->system->solve(nsteps);
       timer->barrier_stop(TIME_LOOP);
+      timer->report(nsteps);
       //std::cout << "Iterated "<< nsteps <<" steps and ";
       //std::cout << "took " << std::fixed << std::setprecision(2) << 1000 * timer->array[TIME_LOOP] << " milliseconds" << std::endl;
 
 
 
-      std::ofstream fout;
-      fout.open("./res.txt", std::ios::app);
-      for (int i = 1; i < muse->system->xlog.size();i++)
-      {
-          fout << muse->system->xlog[i].transpose() << std::endl;
-      }
-      fout.close();
  
 
       // wrap command invocation with clearstep/addstep
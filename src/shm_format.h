@@ -0,0 +1,94 @@
+/* ----------------------------------------------------------------------
+   MUSE - MUltibody System dynamics Engine
+   https://github.com/zhangh3/MUSE
+
+   Zhang He, zhanghecalt@163.com
+   Science and Technology on Space Physics Laboratory, Beijing
+
+   This software is distributed under the GNU General Public License.
+   Copyright (c) 2023 Zhang He. All rights reserved.
+------------------------------------------------------------------------- */
+
+#ifndef MUSE_SHM_FORMAT_H
+#define MUSE_SHM_FORMAT_H
+
+#include "stdint.h"
+#include "string.h"
+#include <atomic>
+#include "trajectory_format.h"
+
+/* layout of the POSIX shared memory segment written by "output shm",
+   shared by ShmRing and the tools/muse_shm reader
+
+     ShmHeader                       at offset 0
+     TrajField[nfield]               at field_offset, as in trajectory
+                                     files, offsets index ShmSlot values
+     char name[nbody][namelen]       at name_offset
+     slot[nslot]                     at slot_offset, slot_size bytes
+                                     each: ShmSlot + double[ncol]
+
+   frame k (k = 0,1,...) is written into slot k % nslot
+   a slot is a seqlock: seq = 2k+1 while frame k is written and 2k+2
+   once it is complete, so a reader knows both whether the copy it
+   took is torn and whether the slot already holds a later frame
+   head = # of frames published, live = 0 once the publisher let go
+   of the segment (end of MUSE, new layout or output shm none) */
+
+#define SHM_MAGIC "MUSESHM"
+#define SHM_VERSION 1
+#define SHM_ALIGN 64
+
+struct ShmHeader {
+  char magic[8];                 // SHM_MAGIC, set last
+  int32_t version;               // SHM_VERSION
+  int32_t nbody;                 // # of bodies in the system
+  int32_t nfield;                // # of TrajField entries
+  int32_t ncol;                  // # of doubles in one frame
+  int32_t nslot;                 // # of slots in the ring
+  int32_t every;                 // steps between frames
+  int32_t namelen;               // bytes per body name
+  int32_t pad;
+  double dt;                     // timestep
+  int64_t field_offset;          // offset of TrajField[0]
+  int64_t name_offset;           // offset of the body names
+  int64_t slot_offset;           // offset of slot 0
+  int64_t slot_size;             // bytes per slot
+  std::atomic<int64_t> head;     // # of frames published
+  std::atomic<int32_t> live;     // 1 while the publisher is attached
+};
+
+struct ShmSlot {
+  std::atomic<uint64_t> seq;     // seqlock version, odd while written
+  int64_t step;                  // timestep of the frame
+  double time;                   // simulation time of the frame
+  double pad;                    // frame values follow
+};
+
+/* ----------------------------------------------------------------------
+   copy frame k out of the ring into values, step and time
+   returns 0 on success, 1 if frame k is not written yet,
+   -1 if its slot was overwritten by a later frame
+------------------------------------------------------------------------- */
+
+static inline int shm_read_frame(const ShmHeader *h, int64_t k,
+                                 double *values, int64_t *step, double *time)
+{
+  const char *base = (const char *) h;
+  const ShmSlot *slot =
+    (const ShmSlot *) (base + h->slot_offset + (k % h->nslot)*h->slot_size);
+  uint64_t expect = 2*(uint64_t) k + 2;
+
+  uint64_t s1 = slot->seq.load(std::memory_order_acquire);
+  if (s1 < expect) return 1;
+  if (s1 != expect) return -1;
+
+  *step = slot->step;
+  *time = slot->time;
+  memcpy(values,slot + 1,h->ncol*sizeof(double));
+
+  std::atomic_thread_fence(std::memory_order_acquire);
+  uint64_t s2 = slot->seq.load(std::memory_order_relaxed);
+  return (s2 == s1) ? 0 : -1;
+}
+
+#endif
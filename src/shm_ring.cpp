@@ -0,0 +1,315 @@
+/* ----------------------------------------------------------------------
+   MUSE - MUltibody System dynamics Engine
+   https://github.com/zhangh3/MUSE
+
+   Zhang He, zhanghecalt@163.com
+   Science and Technology on Space Physics Laboratory, Beijing
+
+   This software is distributed under the GNU General Public License.
+   Copyright (c) 2023 Zhang He. All rights reserved.
+------------------------------------------------------------------------- */
+
+#include "mpi.h"
+#include "stdio.h"
+#include "string.h"
+#include "shm_ring.h"
+#include "shm_format.h"
+#include "muse.h"
+#include "MUSEsystem.h"
+#include "body.h"
+#include "input.h"
+#include "output.h"
+#include "trajectory.h"
+#include "memory.h"
+#include "error.h"
+
+#ifndef _WIN32
+#include "errno.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+using namespace MUSE_NS;
+
+#define NSLOT 256
+
+/* ---------------------------------------------------------------------- */
+
+ShmRing::ShmRing(MUSE *muse) : Pointers(muse)
+{
+  MPI_Comm_rank(world,&me);
+
+  every = 1;
+  name = NULL;
+  nslot = NSLOT;
+  replace = 0;
+  ncol = 0;
+
+  // default frame: pose and velocities of every body
+
+  nfield = maxfield = 4;
+  memory->create(field,maxfield,"shm:field");
+  field[0] = Trajectory::find_fieldname("pos");
+  field[1] = Trajectory::find_fieldname("quat");
+  field[2] = Trajectory::find_fieldname("vel");
+  field[3] = Trajectory::find_fieldname("omega");
+
+  nbody_map = ncol_map = nslot_map = 0;
+  bodyid = NULL;
+  fd = -1;
+  base = NULL;
+  size = 0;
+  header = NULL;
+  head = 0;
+}
+
+/* ---------------------------------------------------------------------- */
+
+ShmRing::~ShmRing()
+{
+  destroy();
+  delete [] name;
+  memory->destroy(field);
+  memory->destroy(bodyid);
+}
+
+/* ----------------------------------------------------------------------
+   output shm name keyword value ...
+     every N = publish a frame every N steps
+     fields f1 f2 ... = same field names as the trajectory command
+     ring N = # of frames kept in the segment
+     replace yes/no = take over a segment of this name left by another
+                      run, default no = error if it exists
+   the segment is created on the next run, a segment published
+   before is released first so its readers see live = 0
+------------------------------------------------------------------------- */
+
+void ShmRing::command(int narg, char **arg)
+{
+  if (narg < 1) error->all(FLERR,"Illegal output shm command");
+
+  destroy();
+
+  delete [] name;
+  int n = strlen(arg[0]) + 2;
+  name = new char[n];
+  if (arg[0][0] == '/') strcpy(name,arg[0]);
+  else sprintf(name,"/%s",arg[0]);
+  if (strchr(name+1,'/'))
+    error->all(FLERR,"Output shm name cannot contain '/'");
+
+  int iarg = 1;
+  while (iarg < narg) {
+    if (strcmp(arg[iarg],"every") == 0) {
+      if (iarg+2 > narg) error->all(FLERR,"Illegal output shm command");
+      every = input->inumeric(FLERR,arg[iarg+1]);
+      if (every <= 0) error->all(FLERR,"Illegal output shm every value");
+      iarg += 2;
+    } else if (strcmp(arg[iarg],"ring") == 0) {
+      if (iarg+2 > narg) error->all(FLERR,"Illegal output shm command");
+      nslot = input->inumeric(FLERR,arg[iarg+1]);
+      if (nslot <= 0) error->all(FLERR,"Illegal output shm ring value");
+      iarg += 2;
+    } else if (strcmp(arg[iarg],"replace") == 0) {
+      if (iarg+2 > narg) error->all(FLERR,"Illegal output shm command");
+      if (strcmp(arg[iarg+1],"yes") == 0) replace = 1;
+      else if (strcmp(arg[iarg+1],"no") == 0) replace = 0;
+      else error->all(FLERR,"Illegal output shm replace value");
+      iarg += 2;
+    } else if (strcmp(arg[iarg],"fields") == 0) {
+      nfield = 0;
+      iarg++;
+      while (iarg < narg) {
+        int which = Trajectory::find_fieldname(arg[iarg]);
+        if (which < 0) break;
+        if (nfield == maxfield) {
+          maxfield += 4;
+          memory->grow(field,maxfield,"shm:field");
+        }
+        field[nfield++] = which;
+        iarg++;
+      }
+      if (nfield == 0) error->all(FLERR,"Illegal output shm fields");
+    } else error->all(FLERR,"Illegal output shm command");
+  }
+}
+
+/* ----------------------------------------------------------------------
+   called from Output::setup() before every run
+   the segment is kept, and its frame count continues, as long as the
+   bodies in the system stay the same
+------------------------------------------------------------------------- */
+
+void ShmRing::setup()
+{
+  if (me != 0) return;
+
+  Trajectory *traj = output->traj;
+  ncol = 0;
+  for (int i = 0; i < nfield; i++) ncol += traj->field_cols(field[i]);
+
+  if (base && !same_layout()) destroy();
+  if (base == NULL) create();
+}
+
+/* ----------------------------------------------------------------------
+   write the selected fields of the current state into the next slot
+   the values go straight into shared memory, no system calls
+------------------------------------------------------------------------- */
+
+void ShmRing::publish()
+{
+  if (header == NULL) return;
+
+  System *s = muse->system;
+  ShmSlot *slot = (ShmSlot *)
+    (base + header->slot_offset + (head % nslot_map)*header->slot_size);
+
+  slot->seq.store(2*(uint64_t) head + 1,std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  slot->step = s->ntimestep;
+  slot->time = s->timenow;
+  output->traj->pack(nfield,field,(double *) (slot + 1));
+
+  slot->seq.store(2*(uint64_t) head + 2,std::memory_order_release);
+  head++;
+  header->head.store(head,std::memory_order_release);
+}
+
+/* ---------------------------------------------------------------------- */
+
+int ShmRing::same_layout()
+{
+  System *s = muse->system;
+
+  if (s->nBodies != nbody_map || ncol != ncol_map) return 0;
+  for (int i = 0; i < nbody_map; i++)
+    if (s->body[i]->IDinMuse != bodyid[i]) return 0;
+  return 1;
+}
+
+/* ----------------------------------------------------------------------
+   create and map the segment, write its header
+   the magic is written last, a reader that sees it sees a full header
+------------------------------------------------------------------------- */
+
+void ShmRing::create()
+{
+  if (name == NULL) error->one(FLERR,"Output shm has no segment name");
+
+#ifdef _WIN32
+  error->one(FLERR,"Output shm requires POSIX shared memory");
+#else
+  System *s = muse->system;
+  Trajectory *traj = output->traj;
+  int nbody = s->nBodies;
+  int i;
+
+  int namelen = TRAJ_NAMELEN;
+  for (i = 0; i < nbody; i++) {
+    int n = strlen(s->body[i]->name) + 1;
+    if (n > namelen) namelen = (n + 7) / 8 * 8;
+  }
+
+  int64_t field_offset = sizeof(ShmHeader);
+  int64_t name_offset = field_offset + nfield*sizeof(TrajField);
+  int64_t slot_offset = name_offset + (int64_t) nbody*namelen;
+  slot_offset = (slot_offset + SHM_ALIGN - 1) / SHM_ALIGN * SHM_ALIGN;
+  int64_t slot_size = sizeof(ShmSlot) + ncol*sizeof(double);
+  slot_size = (slot_size + SHM_ALIGN - 1) / SHM_ALIGN * SHM_ALIGN;
+  size = slot_offset + nslot*slot_size;
+
+  // a segment of this name may belong to another live run, it is only
+  // replaced on request, readers still mapping it keep their copy
+
+  if (replace) shm_unlink(name);
+  fd = shm_open(name,O_CREAT | O_EXCL | O_RDWR,0644);
+  if (fd < 0 && errno == EEXIST) {
+    char str[128];
+    snprintf(str,128,"Shared memory segment %s exists, "
+             "use output shm replace yes",name);
+    error->one(FLERR,str);
+  }
+  if (fd < 0 || ftruncate(fd,size) != 0) {
+    char str[128];
+    snprintf(str,128,"Cannot create shared memory segment %s",name);
+    error->one(FLERR,str);
+  }
+  void *ptr = mmap(NULL,size,PROT_READ | PROT_WRITE,MAP_SHARED,fd,0);
+  if (ptr == MAP_FAILED) {
+    char str[128];
+    snprintf(str,128,"Cannot map shared memory segment %s",name);
+    error->one(FLERR,str);
+  }
+  base = (char *) ptr;
+  header = (ShmHeader *) base;
+
+  header->version = SHM_VERSION;
+  header->nbody = nbody;
+  header->nfield = nfield;
+  header->ncol = ncol;
+  header->nslot = nslot;
+  header->every = every;
+  header->namelen = namelen;
+  header->dt = s->dt;
+  header->field_offset = field_offset;
+  header->name_offset = name_offset;
+  header->slot_offset = slot_offset;
+  header->slot_size = slot_size;
+  header->head.store(0,std::memory_order_relaxed);
+  header->live.store(1,std::memory_order_relaxed);
+
+  TrajField *f = (TrajField *) (base + field_offset);
+  int offset = 0;
+  for (i = 0; i < nfield; i++) {
+    memset(&f[i],0,sizeof(TrajField));
+    strcpy(f[i].name,Trajectory::fieldname(field[i]));
+    f[i].offset = offset;
+    f[i].perbody = traj->field_perbody(field[i]);
+    f[i].width = traj->field_cols(field[i]);
+    if (f[i].perbody && nbody) f[i].width /= nbody;
+    f[i].quant = TRAJ_DOUBLE;
+    f[i].scale = 1.0;
+    offset += traj->field_cols(field[i]);
+  }
+
+  memory->destroy(bodyid);
+  memory->create(bodyid,nbody+1,"shm:bodyid");
+  for (i = 0; i < nbody; i++) {
+    strncpy(base + name_offset + (int64_t) i*namelen,s->body[i]->name,
+            namelen);
+    bodyid[i] = s->body[i]->IDinMuse;
+  }
+
+  std::atomic_thread_fence(std::memory_order_release);
+  memcpy(header->magic,SHM_MAGIC,8);
+
+  nbody_map = nbody;
+  ncol_map = ncol;
+  nslot_map = nslot;
+  head = 0;
+#endif
+}
+
+/* ----------------------------------------------------------------------
+   mark the segment as abandoned and remove its name
+   readers that have it mapped can still read the frames in it
+------------------------------------------------------------------------- */
+
+void ShmRing::destroy()
+{
+  if (base == NULL) return;
+
+#ifndef _WIN32
+  header->live.store(0,std::memory_order_release);
+  munmap(base,size);
+  ::close(fd);
+  shm_unlink(name);
+#endif
+  base = NULL;
+  header = NULL;
+  fd = -1;
+  size = 0;
+}
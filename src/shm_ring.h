@@ -0,0 +1,64 @@
+/* ----------------------------------------------------------------------
+   MUSE - MUltibody System dynamics Engine
+   https://github.com/zhangh3/MUSE
+
+   Zhang He, zhanghecalt@163.com
+   Science and Technology on Space Physics Laboratory, Beijing
+
+   This software is distributed under the GNU General Public License.
+   Copyright (c) 2023 Zhang He. All rights reserved.
+------------------------------------------------------------------------- */
+
+#ifndef MUSE_SHM_RING_H
+#define MUSE_SHM_RING_H
+
+#include "stdint.h"
+#include "pointers.h"
+
+struct ShmHeader;
+
+namespace MUSE_NS {
+
+/* live publisher for "output shm"
+   every N steps the selected fields are written straight into the
+   next slot of a ring in POSIX shared memory, readers in other
+   processes map the same segment and follow the frames, see
+   shm_format.h, the solver never waits for them */
+
+class ShmRing : protected Pointers {
+ public:
+  int every;                   // publish a frame every this many steps
+
+  ShmRing(class MUSE *);
+  ~ShmRing();
+  void command(int, char **);
+  void setup();                // (re)create the segment if needed
+  void publish();              // write the current state into the ring
+
+ private:
+  int me;
+  char *name;                  // segment name, starts with '/'
+  int nslot;                   // # of slots requested
+  int replace;                 // 1 = unlink an existing segment of this name
+  int nfield,maxfield;
+  int *field;                  // Trajectory field ids
+  int ncol;                    // # of doubles in one frame
+
+  int nbody_map;               // layout of the mapped segment
+  int *bodyid;                 // IDinMuse of the bodies in it
+  int ncol_map,nslot_map;
+
+  int fd;
+  char *base;                  // mapped segment, NULL if none
+  int64_t size;
+  ShmHeader *header;
+  int64_t head;                // # of frames published
+
+  int same_layout();
+  void create();
+  void destroy();
+};
+
+}
+
+#endif
@@ -0,0 +1,298 @@
+/* ----------------------------------------------------------------------
+   MUSE - MUltibody System dynamics Engine
+   https://github.com/zhangh3/MUSE
+
+   Zhang He, zhanghecalt@163.com
+   Science and Technology on Space Physics Laboratory, Beijing
+
+   This software is distributed under the GNU General Public License.
+   Copyright (c) 2023 Zhang He. All rights reserved.
+------------------------------------------------------------------------- */
+
+#include "string.h"
+#include "snapshot.h"
+#include "muse.h"
+#include "MUSEsystem.h"
+#include "body.h"
+#include "joint.h"
+#include "modify.h"
+#include "compute.h"
+#include "output.h"
+#include "ensemble.h"
+#include "random_mars.h"
+#include "memory.h"
+#include "error.h"
+
+using namespace MUSE_NS;
+
+#define BODYSIZE 33            // x(7) xd(7) omega(3) mass(1) inertia(9)
+                               // force(3) torque(3)
+#define JOINTSIZE 12           // point1 point2 axis1 axis2
+
+/* ---------------------------------------------------------------------- */
+
+Snapshot::Snapshot(MUSE *muse, const char *id) : Pointers(muse)
+{
+  int n = strlen(id) + 1;
+  name = new char[n];
+  strcpy(name,id);
+
+  nbody = njoint = maxbody = maxjoint = 0;
+  bodyid = jointid = jtype = jbody = NULL;
+  bstate = jstate = NULL;
+
+  ncompute = 0;
+  cname = NULL;
+  cinvoked = NULL;
+
+  nresult = 0;
+  onext_result = olast_result = NULL;
+
+  nran = 0;
+  ran = NULL;
+}
+
+/* ---------------------------------------------------------------------- */
+
+Snapshot::~Snapshot()
+{
+  delete [] name;
+  memory->destroy(bodyid);
+  memory->destroy(jointid);
+  memory->destroy(jtype);
+  memory->destroy(jbody);
+  memory->destroy(bstate);
+  memory->destroy(jstate);
+  for (int i = 0; i < ncompute; i++) delete [] cname[i];
+  memory->sfree(cname);
+  memory->destroy(cinvoked);
+  memory->destroy(onext_result);
+  memory->destroy(olast_result);
+  memory->destroy(ran);
+}
+
+/* ----------------------------------------------------------------------
+   copy the current system state into this snapshot
+   buffers only grow, so saving the same name again does not allocate
+------------------------------------------------------------------------- */
+
+void Snapshot::save()
+{
+  System *s = muse->system;
+  int i,k;
+
+  nbody = s->nBodies;
+  njoint = s->nJoints;
+  if (nbody > maxbody) {
+    maxbody = nbody;
+    memory->grow(bodyid,maxbody,"snapshot:bodyid");
+    memory->grow(bstate,BODYSIZE*maxbody,"snapshot:bstate");
+  }
+  if (njoint > maxjoint) {
+    maxjoint = njoint;
+    memory->grow(jointid,maxjoint,"snapshot:jointid");
+    memory->grow(jtype,maxjoint,"snapshot:jtype");
+    memory->grow(jbody,2*maxjoint,"snapshot:jbody");
+    memory->grow(jstate,JOINTSIZE*maxjoint,"snapshot:jstate");
+  }
+
+  // pos/quat and vel/quatd are 7 contiguous doubles each,
+  // inside x/xd once the system is set up
+
+  for (i = 0; i < nbody; i++) {
+    Body *b = s->body[i];
+    double *p = &bstate[BODYSIZE*i];
+    bodyid[i] = b->IDinMuse;
+    memcpy(p,b->pos.data(),7*sizeof(double));
+    memcpy(p+7,b->vel.data(),7*sizeof(double));
+    memcpy(p+14,b->omega.data(),3*sizeof(double));
+    p[17] = b->mass;
+    memcpy(p+18,b->inertia.data(),9*sizeof(double));
+    memcpy(p+27,b->force.data(),3*sizeof(double));
+    memcpy(p+30,b->torque.data(),3*sizeof(double));
+  }
+
+  for (i = 0; i < njoint; i++) {
+    Joint *j = s->joint[i];
+    double *p = &jstate[JOINTSIZE*i];
+    jointid[i] = j->IDinMuse;
+    jtype[i] = j->get_type();
+    for (k = 0; k < 2; k++)
+      jbody[2*i+k] = j->body[k] ? j->body[k]->IDinMuse : -1;
+    memcpy(p,j->point1.data(),3*sizeof(double));
+    memcpy(p+3,j->point2.data(),3*sizeof(double));
+    memcpy(p+6,j->axis1.data(),3*sizeof(double));
+    memcpy(p+9,j->axis2.data(),3*sizeof(double));
+  }
+
+  xdd = s->xdd;
+  changed = s->changed;
+  ntimestep = s->ntimestep;
+  timenow = s->timenow;
+  dt = s->dt;
+  for (k = 0; k < 3; k++) ga[k] = s->ga(k);
+
+  // computes are matched by name on restore
+
+  for (i = 0; i < ncompute; i++) delete [] cname[i];
+  ncompute = modify->ncompute;
+  cname = (char **)
+    memory->srealloc(cname,ncompute*sizeof(char *),"snapshot:cname");
+  memory->grow(cinvoked,4*ncompute+1,"snapshot:cinvoked");
+  for (i = 0; i < ncompute; i++) {
+    Compute *c = modify->compute[i];
+    cname[i] = new char[strlen(c->name)+1];
+    strcpy(cname[i],c->name);
+    cinvoked[4*i] = c->invoked_scalar;
+    cinvoked[4*i+1] = c->invoked_vector;
+    cinvoked[4*i+2] = c->invoked_array;
+    cinvoked[4*i+3] = c->invoked_per_body;
+  }
+
+  onext = output->next;
+  onext_stats = output->next_stats;
+  olast_stats = output->last_stats;
+  onext_restart = output->next_restart;
+  olast_restart = output->last_restart;
+  onext_result_any = output->next_result_any;
+  nresult = output->nresult;
+  memory->grow(onext_result,nresult+1,"snapshot:next_result");
+  memory->grow(olast_result,nresult+1,"snapshot:last_result");
+  for (i = 0; i < nresult; i++) {
+    onext_result[i] = output->next_result[i];
+    olast_result[i] = output->last_result[i];
+  }
+
+  nran = ensemble->ranmaster->size_restart();
+  if (nran) {
+    memory->grow(ran,nran,"snapshot:ran");
+    ensemble->ranmaster->pack_restart(ran);
+  }
+}
+
+/* ----------------------------------------------------------------------
+   copy the snapshot back into the system
+   x/xd are written in place, setup() is skipped unless
+   the system membership or a joint type changed since save(),
+   the next run reuses the saved xdd if nothing else can differ
+------------------------------------------------------------------------- */
+
+void Snapshot::restore()
+{
+  System *s = muse->system;
+  int i,k;
+
+  for (i = 0; i < nbody; i++)
+    if (bodyid[i] >= muse->nBodies)
+      error->all(FLERR,"Snapshot body no longer exists");
+  for (i = 0; i < njoint; i++)
+    if (jointid[i] >= muse->nJoints)
+      error->all(FLERR,"Snapshot joint no longer exists");
+
+  int rebuilt = topology_changed();
+  if (rebuilt) rebuild();
+
+  for (i = 0; i < njoint; i++) {
+    Joint *j = s->joint[i];
+    double *p = &jstate[JOINTSIZE*i];
+    for (k = 0; k < 2; k++)
+      j->body[k] = (jbody[2*i+k] >= 0) ? muse->body[jbody[2*i+k]] : NULL;
+    memcpy(j->point1.data(),p,3*sizeof(double));
+    memcpy(j->point2.data(),p+3,3*sizeof(double));
+    memcpy(j->axis1.data(),p+6,3*sizeof(double));
+    memcpy(j->axis2.data(),p+9,3*sizeof(double));
+  }
+
+  for (i = 0; i < nbody; i++) {
+    Body *b = s->body[i];
+    double *p = &bstate[BODYSIZE*i];
+    memcpy(b->pos.data(),p,7*sizeof(double));
+    memcpy(b->vel.data(),p+7,7*sizeof(double));
+    memcpy(b->omega.data(),p+14,3*sizeof(double));
+    b->mass = p[17];
+    memcpy(b->inertia.data(),p+18,9*sizeof(double));
+    memcpy(b->force.data(),p+27,3*sizeof(double));
+    memcpy(b->torque.data(),p+30,3*sizeof(double));
+  }
+
+  if (s->xdd.size() == xdd.size()) s->xdd = xdd;
+
+  // the saved xdd still belongs to the restored state, unless the
+  // system was rebuilt or tables and coupling add loads from outside
+
+  s->changed = changed;
+  if (rebuilt || modify->ntable || s->coupling) s->changed |= CHANGE_STATE;
+  s->ntimestep = ntimestep;
+  s->timenow = timenow;
+  s->dt = dt;
+  s->ga << ga[0],ga[1],ga[2];
+
+  for (i = 0; i < modify->ncompute; i++) {
+    Compute *c = modify->compute[i];
+    for (k = 0; k < ncompute; k++)
+      if (strcmp(c->name,cname[k]) == 0) break;
+    if (k == ncompute) continue;
+    c->invoked_scalar = cinvoked[4*k];
+    c->invoked_vector = cinvoked[4*k+1];
+    c->invoked_array = cinvoked[4*k+2];
+    c->invoked_per_body = cinvoked[4*k+3];
+  }
+
+  output->next = onext;
+  output->next_stats = onext_stats;
+  output->last_stats = olast_stats;
+  output->next_restart = onext_restart;
+  output->last_restart = olast_restart;
+  output->next_result_any = onext_result_any;
+  if (output->nresult == nresult)
+    for (i = 0; i < nresult; i++) {
+      output->next_result[i] = onext_result[i];
+      output->last_result[i] = olast_result[i];
+    }
+
+  if (nran) ensemble->ranmaster->unpack_restart(ran);
+}
+
+/* ---------------------------------------------------------------------- */
+
+int Snapshot::topology_changed()
+{
+  System *s = muse->system;
+  int i;
+
+  if (s->nBodies != nbody || s->nJoints != njoint) return 1;
+  if (s->x.size() != 7*nbody) return 1;
+  for (i = 0; i < nbody; i++)
+    if (s->body[i]->IDinMuse != bodyid[i]) return 1;
+  for (i = 0; i < njoint; i++)
+    if (s->joint[i]->IDinMuse != jointid[i] ||
+        s->joint[i]->get_type() != jtype[i]) return 1;
+  return 0;
+}
+
+/* ----------------------------------------------------------------------
+   put the saved bodies and joints back into the system, in saved order,
+   and rebuild the system arrays
+------------------------------------------------------------------------- */
+
+void Snapshot::rebuild()
+{
+  System *s = muse->system;
+  int i;
+
+  for (i = 0; i < s->nBodies; i++) {
+    s->body[i]->IDinSystem = -1;
+    s->body[i]->detach();
+  }
+  for (i = 0; i < s->nJoints; i++) s->joint[i]->IDinSystem = -1;
+  s->nBodies = s->nJoints = 0;
+
+  for (i = 0; i < nbody; i++) s->add_Body(muse->body[bodyid[i]]);
+  for (i = 0; i < njoint; i++) {
+    Joint *j = muse->joint[jointid[i]];
+    if (j->get_type() != jtype[i]) j->set_type(jtype[i]);
+    s->add_Joint(j);
+  }
+
+  s->setup_minimal();
+}
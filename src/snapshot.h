@@ -0,0 +1,67 @@
+/* ----------------------------------------------------------------------
+   MUSE - MUltibody System dynamics Engine
+   https://github.com/zhangh3/MUSE
+
+   Zhang He, zhanghecalt@163.com
+   Science and Technology on Space Physics Laboratory, Beijing
+
+   This software is distributed under the GNU General Public License.
+   Copyright (c) 2023 Zhang He. All rights reserved.
+------------------------------------------------------------------------- */
+
+#ifndef MUSE_SNAPSHOT_H
+#define MUSE_SNAPSHOT_H
+
+#include "pointers.h"
+#include "Eigen/Eigen"
+
+namespace MUSE_NS {
+
+/* in-memory copy of the system state, owned by System
+   save() copies state into buffers that are reused by the next save(),
+   restore() copies it back and only rebuilds the system (setup)
+   when bodies, joints or joint types differ from the saved ones */
+
+class Snapshot : protected Pointers {
+ public:
+  char *name;
+
+  Snapshot(class MUSE *, const char *);
+  ~Snapshot();
+  void save();
+  void restore();
+
+ private:
+  int nbody,njoint;            // system size when saved
+  int maxbody,maxjoint;
+  int *bodyid;                 // IDinMuse of each system body
+  int *jointid;                // IDinMuse of each system joint
+  int *jtype;                  // joint types
+  int *jbody;                  // IDinMuse of body1/2 of each joint, -1 = none
+  double *bstate;              // per body: x, xd, omega, mass, inertia
+  double *jstate;              // per joint: point1, point2, axis1, axis2
+  Eigen::VectorXd xdd;
+
+  int changed;                 // System::changed at save()
+  int ntimestep;
+  double timenow,dt;
+  double ga[3];
+
+  int ncompute;                // compute invocation counters
+  char **cname;
+  int *cinvoked;
+
+  int onext,onext_stats,olast_stats,onext_restart,olast_restart;
+  int onext_result_any,nresult;
+  int *onext_result,*olast_result;
+
+  int nran;                    // RanMars state, 0 if not seeded
+  double *ran;
+
+  int topology_changed();
+  void rebuild();
+};
+
+}
+
+#endif
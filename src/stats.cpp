@@ -14,6 +14,7 @@
 #include "stdlib.h"
 #include "string.h"
 #include "stats.h"
+#include "muse.h"
 #include "MUSEsystem.h"
 
 #include "modify.h"
@@ -22,6 +23,7 @@
 #include "input.h"
 #include "variable.h"
 #include "output.h"
+#include "async_writer.h"
 #include "timer.h"
 #include "memory.h"
 #include "error.h"
@@ -30,7 +32,7 @@ using namespace MUSE_NS;
 
 // customize a new keyword by adding to this list:
 
-// step,elapsed,elaplong,dt,cpu,tpcpu,spcpu,wall,
+// step,elapsed,elaplong,dt,cpu,tpcpu,spcpu,wall,t_solve,t_assemble,...
 // np,ntouch,ncomm,nbound,nexit,nscoll,nscheck,ncoll,nattempt,nreact,nsreact,
 // npave,ntouchave,ncommave,nboundave,nexitave,nscollave,nscheckave,
 // ncollave,nattemptave,nreactave,nsreactave,
@@ -208,18 +210,44 @@ void Stats::compute(int flag)
       }
     }
 
-  // add each stat value to line with its specific format
+  // evaluate body-style variables once for all their v_name[i] fields
+
+  for (i = 0; i < nvariable; i++)
+    if (input->variable->body_style(variables[i]))
+      bodyvalues[i] = input->variable->compute_body(variables[i]);
+
+  // evaluate each stat value, straight into a writer slot if async
+
+  AsyncWriter *async = output->async;
+  double *v = value;
+  if (async) v = async->claim(ASYNC_STATS,muse->system->ntimestep,
+                              muse->system->timenow) + 3;
 
-  int loc = 0;
   for (ifield = 0; ifield < nfield; ifield++) {
     (this->*vfunc[ifield])();
-    if (vtype[ifield] == FLOAT)
-      loc += sprintf(&line[loc],format[ifield],dvalue);
-    else if (vtype[ifield] == INT)
-      loc += sprintf(&line[loc],format[ifield],ivalue);
+    if (vtype[ifield] == FLOAT) v[ifield] = dvalue;
+    else v[ifield] = ivalue;
   }
 
-  // print line to screen and logfile
+  if (async) async->commit();
+  else write_values(value);
+}
+
+/* ----------------------------------------------------------------------
+   add each stat value to line with its specific format
+   and print line to screen and logfile
+   runs on the writer thread with output async
+------------------------------------------------------------------------- */
+
+void Stats::write_values(double *v)
+{
+  int loc = 0;
+  for (int i = 0; i < nfield; i++) {
+    if (vtype[i] == FLOAT)
+      loc += sprintf(&line[loc],format[i],v[i]);
+    else if (vtype[i] == INT)
+      loc += sprintf(&line[loc],format[i],static_cast<int>(v[i]));
+  }
 
   if (me == 0) {
     if (screen) fprintf(screen,"%s",line);
@@ -320,6 +348,7 @@ void Stats::allocate()
   for (int i = 0; i < n; i++) keyword[i] = new char[32];
   vfunc = new FnPtr[n];
   vtype = new int[n];
+  value = new double[n];
 
   format = new char*[n];
   for (int i = 0; i < n; i++) format[i] = new char[32];
@@ -340,6 +369,7 @@ void Stats::allocate()
   nvariable = 0;
   id_variable = new char*[n];
   variables = new int[n];
+  bodyvalues = new double*[n];
 }
 
 /* ----------------------------------------------------------------------
@@ -354,6 +384,7 @@ void Stats::deallocate()
   delete [] keyword;
   delete [] vfunc;
   delete [] vtype;
+  delete [] value;
 
   for (int i = 0; i < n; i++) delete [] format[i];
   delete [] format;
@@ -372,6 +403,7 @@ void Stats::deallocate()
   for (int i = 0; i < nvariable; i++) delete [] id_variable[i];
   delete [] id_variable;
   delete [] variables;
+  delete [] bodyvalues;
 }
 
 /* ----------------------------------------------------------------------
@@ -419,6 +451,12 @@ void Stats::set_fields(int narg, char **arg)
     } else if (strcmp(arg[i],"wall") == 0) {
       addfield("WALL",&Stats::compute_wall,FLOAT);
 
+    // t_solve, t_assemble, ... = phase times of this run, see Timer
+
+    } else if (timer->keyword(arg[i]) >= 0) {
+      argindex1[nfield] = timer->keyword(arg[i]);
+      addfield(arg[i],&Stats::compute_timer,FLOAT);
+
     // compute value = c_ID,  variable value = v_ID
     // count trailing [] and store int arguments
     // copy = at most 8 chars of ID to pass to addfield
@@ -475,10 +513,16 @@ void Stats::set_fields(int narg, char **arg)
       } else if (arg[i][0] == 'v') {
         n = input->variable->find(id);
         if (n < 0) error->all(FLERR,"Could not find stats variable name");
-        if (input->variable->equal_style(n) == 0)
-          error->all(FLERR,"Stats variable is not equal-style variable");
-        if (argindex1[nfield])
-          error->all(FLERR,"Stats variable cannot be indexed");
+        if (input->variable->body_style(n)) {
+          if (argindex1[nfield] == 0 || argindex2[nfield])
+            error->all(FLERR,"Stats body-style variable must be "
+                       "indexed by one body");
+        } else {
+          if (input->variable->equal_style(n) == 0)
+            error->all(FLERR,"Stats variable is not equal-style variable");
+          if (argindex1[nfield])
+            error->all(FLERR,"Stats variable cannot be indexed");
+        }
 
         field2index[nfield] = add_variable(id);
         addfield(arg[i],&Stats::compute_variable,FLOAT);
@@ -597,6 +641,8 @@ int Stats::evaluate_keyword(char *word, double *answer)
 
   } else if (strcmp(word,"wall") == 0) {
     compute_wall();
+  } else if (timer->keyword(word) >= 0) {
+    dvalue = timer->array[timer->keyword(word)];
   } 
   else return 1;
 
@@ -622,7 +668,14 @@ void Stats::compute_compute()
 
 void Stats::compute_variable()
 {
-  dvalue = input->variable->compute_equal(variables[field2index[ifield]]);
+  int m = field2index[ifield];
+  if (argindex1[ifield] == 0)
+    dvalue = input->variable->compute_equal(variables[m]);
+  else {
+    if (argindex1[ifield] > muse->nBodies)
+      error->all(FLERR,"Stats body-style variable is accessed out-of-range");
+    dvalue = bodyvalues[m][argindex1[ifield]-1];
+  }
 }
 
 /* ----------------------------------------------------------------------
@@ -722,3 +775,10 @@ void Stats::compute_wall()
 {
   dvalue = MPI_Wtime() - wall0;
 }
+
+/* ---------------------------------------------------------------------- */
+
+void Stats::compute_timer()
+{
+  dvalue = timer->array[argindex1[ifield]];
+}
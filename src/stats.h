@@ -18,6 +18,8 @@ namespace MUSE_NS {
 
 class Stats : protected Pointers {
  public:
+  int nfield;                  // # of values in a stats line
+
   Stats(class MUSE *);
   ~Stats();
 
@@ -26,14 +28,15 @@ class Stats : protected Pointers {
   void set_fields(int, char **);
   void header();
   void compute(int);
+  void write_values(double *); // format and print one line of values
   int evaluate_keyword(char *, double *);
 
  private:
   char *line;
   char **keyword;
   int *vtype;
+  double *value;               // values of the current line
 
-  int nfield;
   int me;
 
   char **format;
@@ -67,6 +70,7 @@ class Stats : protected Pointers {
   int nvariable;               // # of variables evaulated by stats
   char **id_variable;          // list of variable names
   int *variables;              // list of Variable indices
+  double **bodyvalues;         // values of body-style variables this line
 
   // private methods
 
@@ -97,6 +101,7 @@ class Stats : protected Pointers {
   void compute_tpcpu();
   void compute_spcpu();
   void compute_wall();
+  void compute_timer();
 
 };
 
@@ -11,4 +11,7 @@
 
 #include "create.h"
 #include "change.h"
-#include "run.h"
\ No newline at end of file
+#include "run.h"
+#include "write_restart.h"
+#include "read_restart.h"
+#include "read_model.h"
\ No newline at end of file
@@ -0,0 +1,579 @@
+/* ----------------------------------------------------------------------
+   MUSE - MUltibody System dynamics Engine
+   https://github.com/zhangh3/MUSE
+
+   Zhang He, zhanghecalt@163.com
+   Science and Technology on Space Physics Laboratory, Beijing
+
+   This software is distributed under the GNU General Public License.
+   Copyright (c) 2023 Zhang He. All rights reserved.
+------------------------------------------------------------------------- */
+
+#include "mpi.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "limits.h"
+#include "table.h"
+#include "muse.h"
+#include "MUSEsystem.h"
+#include "body.h"
+#include "input.h"
+#include "memory.h"
+#include "error.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+using namespace MUSE_NS;
+
+#define DELTA 4
+#define SEPARATORS " ,;\t\r"
+
+/* ----------------------------------------------------------------------
+   table name file F keyword value ...
+     time COL = column holding the time, name or 1-based index,
+                default 1st column
+   other keywords as in modify_params()
+------------------------------------------------------------------------- */
+
+Table::Table(MUSE *muse, int narg, char **arg) : Pointers(muse)
+{
+  MPI_Comm_rank(world,&me);
+
+  if (narg < 3 || strcmp(arg[1],"file") != 0)
+    error->all(FLERR,"Illegal table command");
+
+  int n = strlen(arg[0]) + 1;
+  name = new char[n];
+  strcpy(name,arg[0]);
+
+  ncol = 0;
+  nrow = 0;
+  colname = NULL;
+  timecol = 0;
+  cubic = 0;
+  data = NULL;
+  buffer = NULL;
+  map = NULL;
+  mapsize = 0;
+
+  cursor = 0;
+  tlast = 0.0;
+  ilast = -1;
+  wlast = 0.0;
+
+  nload = maxload = 0;
+  lbody = lcol = NULL;
+
+  // the time column is needed before the rows can be checked,
+  // pull it out of the keywords first
+
+  char *timename = NULL;
+  int nkeep = 0;
+  char **keep = new char*[narg];
+  for (int iarg = 3; iarg < narg; iarg++) {
+    if (strcmp(arg[iarg],"time") == 0) {
+      if (iarg+2 > narg) error->all(FLERR,"Illegal table command");
+      timename = arg[++iarg];
+    } else keep[nkeep++] = arg[iarg];
+  }
+
+  open(arg[2]);
+
+  if (timename) {
+    timecol = find_column(timename);
+    if (timecol < 0) error->all(FLERR,"Table time column does not exist");
+  }
+  check_time();
+
+  modify_params(nkeep,keep);
+  delete [] keep;
+}
+
+/* ---------------------------------------------------------------------- */
+
+Table::~Table()
+{
+  delete [] name;
+  for (int i = 0; i < ncol; i++) delete [] colname[i];
+  delete [] colname;
+  memory->sfree(buffer);
+  unmap();
+  memory->destroy(lbody);
+  memory->destroy(lcol);
+}
+
+/* ----------------------------------------------------------------------
+   table name keyword value ...
+     interp linear/cubic = interpolation between rows
+     apply BODY force A B C torque D E F = add columns to the force
+       (inertial frame) and torque (body frame) of a body, a component
+       is a column name, a 1-based column index or 0 for none
+     save FILE = write the table as a binary table file
+------------------------------------------------------------------------- */
+
+void Table::modify_params(int narg, char **arg)
+{
+  int iarg = 0;
+  while (iarg < narg) {
+    if (strcmp(arg[iarg],"interp") == 0) {
+      if (iarg+2 > narg) error->all(FLERR,"Illegal table command");
+      if (strcmp(arg[iarg+1],"linear") == 0) cubic = 0;
+      else if (strcmp(arg[iarg+1],"cubic") == 0) cubic = 1;
+      else error->all(FLERR,"Illegal table interp value");
+      iarg += 2;
+    } else if (strcmp(arg[iarg],"apply") == 0) {
+      int istart = iarg;
+      iarg += 2;
+      while (iarg < narg && (strcmp(arg[iarg],"force") == 0 ||
+                             strcmp(arg[iarg],"torque") == 0)) iarg += 4;
+      if (iarg > narg || iarg == istart+2)
+        error->all(FLERR,"Illegal table apply command");
+      add_load(iarg-istart-1,&arg[istart+1]);
+    } else if (strcmp(arg[iarg],"save") == 0) {
+      if (iarg+2 > narg) error->all(FLERR,"Illegal table command");
+      if (me == 0) save(arg[iarg+1]);
+      iarg += 2;
+    } else error->all(FLERR,"Illegal table command");
+  }
+}
+
+/* ----------------------------------------------------------------------
+   return index of a column given by name or 1-based index, -1 if none
+------------------------------------------------------------------------- */
+
+int Table::find_column(const char *str)
+{
+  for (int i = 0; i < ncol; i++)
+    if (strcmp(str,colname[i]) == 0) return i;
+
+  char *ptr;
+  long k = strtol(str,&ptr,10);
+  if (*ptr == '\0' && ptr != str && k >= 1 && k <= ncol) return k-1;
+  return -1;
+}
+
+/* ----------------------------------------------------------------------
+   value of column icol at time t
+   times outside the table take the first or last row
+------------------------------------------------------------------------- */
+
+double Table::value(int icol, double t)
+{
+  if (ilast < 0 || t != tlast) locate(t);
+  return interpolate(icol,ilast,wlast);
+}
+
+/* ----------------------------------------------------------------------
+   add the applied loads at time t to the generalized forces
+   called by System::makeBigF() at every RK stage
+------------------------------------------------------------------------- */
+
+void Table::loads(double t)
+{
+  System *s = muse->system;
+  double f[3],tau[3];
+
+  for (int i = 0; i < nload; i++) {
+    int ibody = muse->body[lbody[i]]->IDinSystem;
+    if (ibody < 0) continue;
+    const int *c = &lcol[6*i];
+    for (int k = 0; k < 3; k++) {
+      f[k] = (c[k] >= 0) ? value(c[k],t) : 0.0;
+      tau[k] = (c[3+k] >= 0) ? value(c[3+k],t) : 0.0;
+    }
+    s->add_load(ibody,f,tau);
+  }
+}
+
+/* ----------------------------------------------------------------------
+   read the table file, binary tables start with TABLE_MAGIC
+------------------------------------------------------------------------- */
+
+void Table::open(const char *file)
+{
+  mapfile(file);
+  if (mapsize >= (int64_t) sizeof(TableHeader) &&
+      strncmp(map,TABLE_MAGIC,8) == 0) read_binary(file);
+  else {
+    read_csv(file);
+    unmap();
+  }
+  if (nrow == 0) {
+    char str[256];
+    snprintf(str,256,"Table file %s has no rows",file);
+    error->one(FLERR,str);
+  }
+}
+
+/* ----------------------------------------------------------------------
+   binary table: check the header and use the values in the mapping
+------------------------------------------------------------------------- */
+
+void Table::read_binary(const char *file)
+{
+  const TableHeader *h = (const TableHeader *) map;
+  char str[256];
+
+  if (h->version != TABLE_VERSION || h->ncol <= 0 || h->nrow < 0 ||
+      h->namelen <= 0 || h->timecol < 0 || h->timecol >= h->ncol ||
+      h->data_offset % sizeof(double) ||
+      h->data_offset < (int64_t) sizeof(TableHeader) + h->ncol*h->namelen ||
+      h->data_offset + h->nrow*h->ncol*(int64_t) sizeof(double) > mapsize) {
+    snprintf(str,256,"Table file %s is corrupted",file);
+    error->one(FLERR,str);
+  }
+
+  ncol = h->ncol;
+  nrow = h->nrow;
+  timecol = h->timecol;
+  colname = new char*[ncol];
+  for (int i = 0; i < ncol; i++) {
+    const char *p = map + sizeof(TableHeader) + i*h->namelen;
+    int n = strnlen(p,h->namelen);
+    colname[i] = new char[n+1];
+    memcpy(colname[i],p,n);
+    colname[i][n] = '\0';
+  }
+  data = (const double *) (map + h->data_offset);
+}
+
+/* ----------------------------------------------------------------------
+   CSV table: one row per line, values separated by commas, semicolons
+   or white space, '#' starts a comment
+   an optional first line of column names, else names are c1,c2,...
+------------------------------------------------------------------------- */
+
+void Table::read_csv(const char *file)
+{
+  const char *p = map;
+  const char *end = map + mapsize;
+  char str[256];
+
+  // # of lines bounds the # of rows
+
+  int64_t nline = 1;
+  if (mapsize)
+    for (const char *q = p; (q = (const char *) memchr(q,'\n',end-q)); q++)
+      nline++;
+
+  int maxline = 0;
+  char *line = NULL;
+  int maxword = 0;
+  char **words = NULL;
+  int64_t iline = 0;
+  double *row = NULL;
+
+  while (p < end) {
+    const char *eol = (const char *) memchr(p,'\n',end-p);
+    if (eol == NULL) eol = end;
+    int n = eol - p;
+    iline++;
+    if (n+1 > maxline) {
+      maxline = n+1;
+      memory->grow(line,maxline,"table:line");
+      maxword = n/2+1;
+      words = (char **)
+        memory->srealloc(words,maxword*sizeof(char *),"table:words");
+    }
+    memcpy(line,p,n);
+    line[n] = '\0';
+    p = eol + 1;
+
+    char *ptr = strchr(line,'#');
+    if (ptr) *ptr = '\0';
+    int nword = 0;
+    for (char *w = strtok(line,SEPARATORS); w; w = strtok(NULL,SEPARATORS))
+      words[nword++] = w;
+    if (nword == 0) continue;
+
+    // 1st line: column names if its 1st word is not a number
+
+    char *stop;
+    strtod(words[0],&stop);
+    if (ncol == 0 && *stop != '\0') {
+      ncol = nword;
+      colname = new char*[ncol];
+      for (int i = 0; i < ncol; i++) {
+        colname[i] = new char[strlen(words[i])+1];
+        strcpy(colname[i],words[i]);
+      }
+      continue;
+    }
+
+    if (row == NULL) {
+      if (ncol == 0) {
+        ncol = nword;
+        colname = new char*[ncol];
+        for (int i = 0; i < ncol; i++) {
+          colname[i] = new char[16];
+          sprintf(colname[i],"c%d",i+1);
+        }
+      }
+      if (nline*ncol*sizeof(double) > INT_MAX) {
+        snprintf(str,256,"Table file %s is too large for CSV, "
+                 "convert it to a binary table",file);
+        error->one(FLERR,str);
+      }
+      buffer = (double *)
+        memory->smalloc(nline*ncol*sizeof(double),"table:buffer");
+      row = buffer;
+    }
+
+    int flag = (nword != ncol);
+    for (int i = 0; i < ncol && !flag; i++) {
+      row[i] = strtod(words[i],&stop);
+      if (*stop != '\0' || stop == words[i]) flag = 1;
+    }
+    if (flag) {
+      snprintf(str,256,"Invalid row in table file %s, line %lld",
+               file,(long long) iline);
+      error->one(FLERR,str);
+    }
+    row += ncol;
+    nrow++;
+  }
+
+  memory->destroy(line);
+  memory->sfree(words);
+  data = buffer;
+}
+
+/* ----------------------------------------------------------------------
+   lookups need strictly increasing times
+------------------------------------------------------------------------- */
+
+void Table::check_time()
+{
+  for (int64_t i = 1; i < nrow; i++)
+    if (!(data[i*ncol+timecol] > data[(i-1)*ncol+timecol])) {
+      char str[128];
+      snprintf(str,128,"Table %s times are not increasing at row %lld",
+               name,(long long) i+1);
+      error->all(FLERR,str);
+    }
+}
+
+/* ----------------------------------------------------------------------
+   find the interval holding t and the weight of its upper row
+   the interval of the last lookup and its neighbor are tried before
+   a binary search, so stepping forward in time costs O(1)
+------------------------------------------------------------------------- */
+
+void Table::locate(double t)
+{
+  const double *tc = data + timecol;
+  int64_t i;
+  double w;
+
+  if (nrow == 1 || t <= tc[0]) {
+    i = 0;
+    w = 0.0;
+  } else if (t >= tc[(nrow-1)*ncol]) {
+    i = nrow-2;
+    w = 1.0;
+  } else {
+    i = cursor;
+    if (t < tc[i*ncol] || t >= tc[(i+1)*ncol]) {
+      if (t >= tc[(i+1)*ncol] && i+2 < nrow && t < tc[(i+2)*ncol]) i++;
+      else {
+        int64_t lo = 0;
+        int64_t hi = nrow-1;
+        while (hi - lo > 1) {
+          int64_t mid = lo + (hi-lo)/2;
+          if (tc[mid*ncol] <= t) lo = mid;
+          else hi = mid;
+        }
+        i = lo;
+      }
+    }
+    w = (t - tc[i*ncol]) / (tc[(i+1)*ncol] - tc[i*ncol]);
+    cursor = i;
+  }
+
+  tlast = t;
+  ilast = i;
+  wlast = w;
+}
+
+/* ----------------------------------------------------------------------
+   value of column icol at weight w between rows i and i+1
+   cubic uses Hermite polynomials with finite difference slopes
+------------------------------------------------------------------------- */
+
+double Table::interpolate(int icol, int64_t i, double w)
+{
+  if (nrow == 1) return data[icol];
+
+  const double *y = data + icol;
+  const double *tc = data + timecol;
+  double y0 = y[i*ncol];
+  double y1 = y[(i+1)*ncol];
+  if (!cubic || nrow == 2) return y0 + w*(y1 - y0);
+
+  double t0 = tc[i*ncol];
+  double t1 = tc[(i+1)*ncol];
+  double h = t1 - t0;
+  double m0,m1;
+  if (i == 0) m0 = (y1 - y0) / h;
+  else m0 = (y1 - y[(i-1)*ncol]) / (t1 - tc[(i-1)*ncol]);
+  if (i+2 == nrow) m1 = (y1 - y0) / h;
+  else m1 = (y[(i+2)*ncol] - y0) / (tc[(i+2)*ncol] - t0);
+
+  double w2 = w*w;
+  double w3 = w2*w;
+  return (2.0*w3 - 3.0*w2 + 1.0)*y0 + (w3 - 2.0*w2 + w)*h*m0 +
+    (-2.0*w3 + 3.0*w2)*y1 + (w3 - w2)*h*m1;
+}
+
+/* ----------------------------------------------------------------------
+   write the table as a binary table file
+------------------------------------------------------------------------- */
+
+void Table::save(const char *file)
+{
+  char str[256];
+
+  for (int i = 0; i < ncol; i++)
+    if (strlen(colname[i]) >= TABLE_NAMELEN) {
+      snprintf(str,256,"Table column name %s is too long to save",
+               colname[i]);
+      error->one(FLERR,str);
+    }
+
+  TableHeader h;
+  memset(&h,0,sizeof(TableHeader));
+  memcpy(h.magic,TABLE_MAGIC,8);
+  h.version = TABLE_VERSION;
+  h.ncol = ncol;
+  h.nrow = nrow;
+  h.namelen = TABLE_NAMELEN;
+  h.timecol = timecol;
+  h.data_offset = sizeof(TableHeader) + ncol*TABLE_NAMELEN;
+  h.data_offset = (h.data_offset + 7) / 8 * 8;
+
+  FILE *fp = fopen(file,"wb");
+  if (fp == NULL) {
+    snprintf(str,256,"Cannot open table file %s",file);
+    error->one(FLERR,str);
+  }
+
+  int64_t nbytes = 0;
+  nbytes += fwrite(&h,1,sizeof(TableHeader),fp);
+  char cname[TABLE_NAMELEN];
+  for (int i = 0; i < ncol; i++) {
+    memset(cname,0,TABLE_NAMELEN);
+    strcpy(cname,colname[i]);
+    nbytes += fwrite(cname,1,TABLE_NAMELEN,fp);
+  }
+  char zero[8] = {0};
+  nbytes += fwrite(zero,1,h.data_offset-nbytes,fp);
+  nbytes += fwrite(data,sizeof(double),nrow*ncol,fp)*sizeof(double);
+
+  if (fclose(fp) != 0 ||
+      nbytes != h.data_offset + nrow*ncol*(int64_t) sizeof(double)) {
+    snprintf(str,256,"Cannot write table file %s",file);
+    error->one(FLERR,str);
+  }
+}
+
+/* ----------------------------------------------------------------------
+   BODY force A B C torque D E F
+------------------------------------------------------------------------- */
+
+void Table::add_load(int narg, char **arg)
+{
+  int ibody = muse->find_Body(arg[0]);
+  if (ibody < 0) {
+    char str[128];
+    snprintf(str,128,"Cannot find body with name: %s",arg[0]);
+    error->all(FLERR,str);
+  }
+
+  if (nload == maxload) {
+    maxload += DELTA;
+    memory->grow(lbody,maxload,"table:lbody");
+    memory->grow(lcol,6*maxload,"table:lcol");
+  }
+  lbody[nload] = ibody;
+  int *c = &lcol[6*nload];
+  for (int k = 0; k < 6; k++) c[k] = -1;
+
+  for (int iarg = 1; iarg < narg; iarg += 4) {
+    int offset = (strcmp(arg[iarg],"force") == 0) ? 0 : 3;
+    for (int k = 0; k < 3; k++) {
+      if (strcmp(arg[iarg+1+k],"0") == 0) continue;
+      c[offset+k] = find_column(arg[iarg+1+k]);
+      if (c[offset+k] < 0)
+        error->all(FLERR,"Table apply column does not exist");
+    }
+  }
+  nload++;
+}
+
+/* ----------------------------------------------------------------------
+   map the whole file read-only, or read it where there is no mmap()
+------------------------------------------------------------------------- */
+
+void Table::mapfile(const char *file)
+{
+  char str[256];
+
+#ifdef _WIN32
+  FILE *fp = fopen(file,"rb");
+  if (fp == NULL) {
+    snprintf(str,256,"Cannot open table file %s",file);
+    error->one(FLERR,str);
+  }
+  fseek(fp,0,SEEK_END);
+  mapsize = ftell(fp);
+  fseek(fp,0,SEEK_SET);
+  if (mapsize > INT_MAX) {
+    snprintf(str,256,"Table file %s is too large",file);
+    error->one(FLERR,str);
+  }
+  map = (char *) memory->smalloc(mapsize+1,"table:map");
+  if ((int64_t) fread(map,1,mapsize,fp) != mapsize) {
+    snprintf(str,256,"Cannot read table file %s",file);
+    error->one(FLERR,str);
+  }
+  fclose(fp);
+#else
+  int fd = ::open(file,O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd,&st) != 0) {
+    snprintf(str,256,"Cannot open table file %s",file);
+    error->one(FLERR,str);
+  }
+  mapsize = st.st_size;
+  if (mapsize == 0) map = NULL;
+  else {
+    void *ptr = mmap(NULL,mapsize,PROT_READ,MAP_PRIVATE,fd,0);
+    if (ptr == MAP_FAILED) {
+      snprintf(str,256,"Cannot map table file %s",file);
+      error->one(FLERR,str);
+    }
+    map = (char *) ptr;
+  }
+  ::close(fd);
+#endif
+}
+
+/* ---------------------------------------------------------------------- */
+
+void Table::unmap()
+{
+  if (map == NULL) return;
+#ifdef _WIN32
+  memory->sfree(map);
+#else
+  munmap(map,mapsize);
+#endif
+  map = NULL;
+  mapsize = 0;
+}
@@ -0,0 +1,93 @@
+/* ----------------------------------------------------------------------
+   MUSE - MUltibody System dynamics Engine
+   https://github.com/zhangh3/MUSE
+
+   Zhang He, zhanghecalt@163.com
+   Science and Technology on Space Physics Laboratory, Beijing
+
+   This software is distributed under the GNU General Public License.
+   Copyright (c) 2023 Zhang He. All rights reserved.
+------------------------------------------------------------------------- */
+
+#ifndef MUSE_TABLE_H
+#define MUSE_TABLE_H
+
+#include "stdint.h"
+#include "pointers.h"
+
+/* binary table file, written by "table ... save", mapped as is on read
+
+     TableHeader                     at offset 0
+     char name[ncol][namelen]        column names
+     double value[nrow][ncol]        at data_offset, rows in time order */
+
+#define TABLE_MAGIC "MUSETBL"
+#define TABLE_VERSION 1
+#define TABLE_NAMELEN 32
+
+struct TableHeader {
+  char magic[8];                 // TABLE_MAGIC
+  int32_t version;               // TABLE_VERSION
+  int32_t ncol;                  // # of columns, time included
+  int64_t nrow;                  // # of rows
+  int32_t namelen;               // bytes per column name
+  int32_t timecol;               // column holding the time
+  int64_t data_offset;           // offset of value[0][0]
+};
+
+namespace MUSE_NS {
+
+/* time table of tabulated histories, e.g. gust or thrust loads
+   the file is read once: binary tables are memory-mapped and used in
+   place, CSV tables are parsed once from a mapping of the file
+   values are interpolated at a given time, a cursor remembers the last
+   interval so monotonic time lookups cost O(1) */
+
+class Table : protected Pointers {
+ public:
+  char *name;                  // table ID
+  int ncol;                    // # of columns, time included
+  int64_t nrow;                // # of rows
+  char **colname;              // column names
+
+  Table(class MUSE *, int, char **);
+  ~Table();
+  void modify_params(int, char **);
+  int find_column(const char *);
+  double value(int, double);   // column value at a time
+  void loads(double);          // add applied loads at a time to System::F
+
+ private:
+  int me;
+  int timecol;                 // column holding the time
+  int cubic;                   // 1 = cubic Hermite, 0 = linear
+  const double *data;          // value[nrow][ncol]
+  double *buffer;              // parsed CSV values, NULL if mapped
+
+  char *map;                   // mapped file, NULL if none
+  int64_t mapsize;
+
+  int64_t cursor;              // interval of the last lookup
+  double tlast;                // time of the last lookup
+  int64_t ilast;               // and its interval and weight
+  double wlast;
+
+  int nload,maxload;           // applied loads
+  int *lbody;                  // IDinMuse of the loaded body
+  int *lcol;                   // 6 columns per load, -1 = zero component
+
+  void open(const char *);
+  void read_binary(const char *);
+  void read_csv(const char *);
+  void check_time();
+  void locate(double);
+  double interpolate(int, int64_t, double);
+  void save(const char *);
+  void add_load(int, char **);
+  void mapfile(const char *);
+  void unmap();
+};
+
+}
+
+#endif
@@ -0,0 +1,132 @@
+/* ----------------------------------------------------------------------
+   MUSE - MUltibody System dynamics Engine
+   https://github.com/zhangh3/MUSE
+
+   Zhang He, zhanghecalt@163.com
+   Science and Technology on Space Physics Laboratory, Beijing
+
+   This software is distributed under the GNU General Public License.
+   Copyright (c) 2023 Zhang He. All rights reserved.
+------------------------------------------------------------------------- */
+
+#include "thread_pool.h"
+
+using namespace MUSE_NS;
+
+/* ---------------------------------------------------------------------- */
+
+ThreadPool::ThreadPool(int n)
+{
+  nworkers = n < 1 ? 1 : n;
+  generation = 0;
+  nactive = 0;
+  stop = 0;
+  fn = NULL;
+  ptr = NULL;
+
+  worker = new Worker[nworkers];
+  thread = new std::thread[nworkers];
+  for (int i = 0; i < nworkers; i++)
+    thread[i] = std::thread(&ThreadPool::loop, this, i);
+}
+
+/* ---------------------------------------------------------------------- */
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    stop = 1;
+  }
+  cv_start.notify_all();
+  for (int i = 0; i < nworkers; i++) thread[i].join();
+  delete [] thread;
+  delete [] worker;
+}
+
+/* ----------------------------------------------------------------------
+   split 0..ntask-1 into nworkers contiguous ranges and wake the workers
+   returns once every task has been executed
+------------------------------------------------------------------------- */
+
+void ThreadPool::run(int ntask, TaskFn func, void *data)
+{
+  if (ntask <= 0) return;
+
+  for (int i = 0; i < nworkers; i++) {
+    int lo = static_cast<int>((long) ntask * i / nworkers);
+    int hi = static_cast<int>((long) ntask * (i + 1) / nworkers);
+    std::lock_guard<std::mutex> guard(worker[i].lock);
+    for (int itask = lo; itask < hi; itask++) worker[i].tasks.push_back(itask);
+  }
+
+  std::unique_lock<std::mutex> guard(lock);
+  fn = func;
+  ptr = data;
+  nactive = nworkers;
+  generation++;
+  cv_start.notify_all();
+  cv_done.wait(guard, [this] { return nactive == 0; });
+  fn = NULL;
+  ptr = NULL;
+}
+
+/* ----------------------------------------------------------------------
+   pop from the front of my own queue, else steal from the back of others
+   returns -1 when all queues are empty
+------------------------------------------------------------------------- */
+
+int ThreadPool::next_task(int iworker)
+{
+  int itask;
+
+  {
+    std::lock_guard<std::mutex> guard(worker[iworker].lock);
+    if (!worker[iworker].tasks.empty()) {
+      itask = worker[iworker].tasks.front();
+      worker[iworker].tasks.pop_front();
+      return itask;
+    }
+  }
+
+  for (int k = 1; k < nworkers; k++) {
+    int victim = (iworker + k) % nworkers;
+    std::lock_guard<std::mutex> guard(worker[victim].lock);
+    if (!worker[victim].tasks.empty()) {
+      itask = worker[victim].tasks.back();
+      worker[victim].tasks.pop_back();
+      return itask;
+    }
+  }
+
+  return -1;
+}
+
+/* ---------------------------------------------------------------------- */
+
+void ThreadPool::loop(int iworker)
+{
+  int seen = 0;
+
+  while (1) {
+    TaskFn func;
+    void *data;
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      cv_start.wait(guard, [&] { return stop || generation != seen; });
+      if (stop) return;
+      seen = generation;
+      func = fn;
+      data = ptr;
+    }
+
+    int itask;
+    while ((itask = next_task(iworker)) >= 0) func(itask, iworker, data);
+
+    // tasks are only queued before a run starts,
+    // so once every queue is empty this worker is done for this run
+
+    std::lock_guard<std::mutex> guard(lock);
+    if (--nactive == 0) cv_done.notify_one();
+  }
+}
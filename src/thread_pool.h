@@ -0,0 +1,61 @@
+/* ----------------------------------------------------------------------
+   MUSE - MUltibody System dynamics Engine
+   https://github.com/zhangh3/MUSE
+
+   Zhang He, zhanghecalt@163.com
+   Science and Technology on Space Physics Laboratory, Beijing
+
+   This software is distributed under the GNU General Public License.
+   Copyright (c) 2023 Zhang He. All rights reserved.
+------------------------------------------------------------------------- */
+
+#ifndef MUSE_THREAD_POOL_H
+#define MUSE_THREAD_POOL_H
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+
+namespace MUSE_NS {
+
+/* persistent pool of worker threads with work stealing
+   run() hands each worker a contiguous range of task indices,
+   an idle worker steals from the back of another worker's queue */
+
+class ThreadPool {
+ public:
+  typedef void (*TaskFn)(int itask, int iworker, void *ptr);
+
+  int nworkers;
+
+  ThreadPool(int);
+  ~ThreadPool();
+  void run(int, TaskFn, void *);    // execute ntask tasks, block until done
+
+ private:
+  struct Worker {
+    std::mutex lock;
+    std::deque<int> tasks;
+  };
+
+  Worker *worker;
+  std::thread *thread;
+
+  std::mutex lock;
+  std::condition_variable cv_start;
+  std::condition_variable cv_done;
+  int generation;                   // bumped once per run()
+  int nactive;                      // workers still busy in this run()
+  int stop;
+
+  TaskFn fn;
+  void *ptr;
+
+  void loop(int);
+  int next_task(int);
+};
+
+}
+
+#endif
@@ -10,16 +10,32 @@
 ------------------------------------------------------------------------- */
 
 #include "mpi.h"
+#include "stdio.h"
+#include "string.h"
 #include "timer.h"
+#include "trace.h"
+#include "muse.h"
+#include "MUSEsystem.h"
+#include "input.h"
 #include "memory.h"
+#include "error.h"
 
 using namespace MUSE_NS;
 
+// stats/result keyword of each timer, the loop itself is cpu
+
+static const char *keywords[TIME_N] = {
+  NULL,"t_comm","t_modify","t_output","t_solve",
+  "t_refresh","t_kernels","t_assemble","t_factor"};
+
 /* ---------------------------------------------------------------------- */
 
 Timer::Timer(MUSE *muse) : Pointers(muse)
 {
   memory->create(array,TIME_N,"array");
+  full = 0;
+  trace = NULL;
+  tracing = 0;
 }
 
 /* ---------------------------------------------------------------------- */
@@ -27,6 +43,41 @@ Timer::Timer(MUSE *muse) : Pointers(muse)
 Timer::~Timer()
 {
   memory->destroy(array);
+  delete trace;
+}
+
+/* ----------------------------------------------------------------------
+   timer normal = time the loop, communication, modify and output
+   timer full = also time the solver phases and print a breakdown
+     after each run
+   timer trace file N = record spans of the next N steps, over any
+     number of runs, into a Chrome trace-event file
+   timer trace none = stop tracing, spans not yet written are lost
+------------------------------------------------------------------------- */
+
+void Timer::command(int narg, char **arg)
+{
+  if (narg < 1) error->all(FLERR,"Illegal timer command");
+
+  if (strcmp(arg[0],"trace") == 0) {
+    if (narg == 2 && strcmp(arg[1],"none") == 0) {
+      delete trace;
+      trace = NULL;
+      tracing = 0;
+      return;
+    }
+    if (narg != 3) error->all(FLERR,"Illegal timer command");
+    int n = input->inumeric(FLERR,arg[2]);
+    delete trace;
+    trace = new Trace(muse,arg[1],n);
+    tracing = 0;
+    return;
+  }
+
+  if (narg != 1) error->all(FLERR,"Illegal timer command");
+  if (strcmp(arg[0],"normal") == 0) full = 0;
+  else if (strcmp(arg[0],"full") == 0) full = 1;
+  else error->all(FLERR,"Illegal timer command");
 }
 
 /* ---------------------------------------------------------------------- */
@@ -34,6 +85,7 @@ Timer::~Timer()
 void Timer::init()
 {
   for (int i = 0; i < TIME_N; i++) array[i] = 0.0;
+  if (trace) trace->start(muse->system->nthreads);
 }
 
 /* ---------------------------------------------------------------------- */
@@ -42,7 +94,7 @@ void Timer::stamp()
 {
   // uncomment if want synchronized timing
   // MPI_Barrier(world);
-  previous_time = MPI_Wtime();
+  previous_time = wtime();
 }
 
 /* ---------------------------------------------------------------------- */
@@ -51,8 +103,10 @@ void Timer::stamp(int which)
 {
   // uncomment if want synchronized timing
   // MPI_Barrier(world);
-  double current_time = MPI_Wtime();
+  double current_time = wtime();
   array[which] += current_time - previous_time;
+  if (tracing)
+    trace->add(TRACK_SOLVER,keywords[which]+2,previous_time,current_time);
   previous_time = current_time;
 }
 
@@ -80,3 +134,71 @@ double Timer::elapsed(int which)
   double current_time = MPI_Wtime();
   return (current_time - array[which]);
 }
+
+/* ---------------------------------------------------------------------- */
+
+int Timer::keyword(const char *word)
+{
+  if (strncmp(word,"t_",2) != 0) return -1;
+  for (int i = 0; i < TIME_N; i++)
+    if (keywords[i] && strcmp(word,keywords[i]) == 0) return i;
+  return -1;
+}
+
+/* ----------------------------------------------------------------------
+   print where the loop time of the last run went, phases are indented
+   under solve, they also count solver calls made by coupling (comm)
+   or by events (modify)
+------------------------------------------------------------------------- */
+
+void Timer::report(int nsteps)
+{
+  if (trace) trace->dump();
+  if (!full) return;
+
+  double loop = array[TIME_LOOP];
+  double other = loop - array[TIME_COMM] - array[TIME_MODIFY] -
+    array[TIME_OUTPUT] - array[TIME_SOLVE];
+  double scale = (loop > 0.0) ? 100.0/loop : 0.0;
+
+  static const int order[] = {TIME_SOLVE,TIME_REFRESH,TIME_KERNEL,
+                              TIME_ASSEMBLE,TIME_FACTOR,TIME_COMM,
+                              TIME_MODIFY,TIME_OUTPUT};
+
+  for (int m = 0; m < 2; m++) {
+    FILE *fp = m ? logfile : screen;
+    if (!fp) continue;
+    fprintf(fp,"Loop time of %g on %d steps\n",loop,nsteps);
+    fprintf(fp,"Phase          time (s)   %%total\n");
+    for (int i = 0; i < 8; i++) {
+      int which = order[i];
+      int sub = (which >= TIME_REFRESH && which <= TIME_FACTOR);
+      fprintf(fp,"%s%-*s %10.4g %8.2f\n",sub ? "  " : "",sub ? 12 : 14,
+              keywords[which] + 2,array[which],scale*array[which]);
+    }
+    fprintf(fp,"%-14s %10.4g %8.2f\n","other",other,scale*other);
+  }
+}
+
+/* ---------------------------------------------------------------------- */
+
+void Timer::phase_end(int which, double start)
+{
+  double current_time = wtime();
+  if (full) array[which] += current_time - start;
+  if (tracing) trace->add(TRACK_SOLVER,keywords[which]+2,start,current_time);
+}
+
+/* ---------------------------------------------------------------------- */
+
+void Timer::span_end(const char *name, double start, int track)
+{
+  trace->add(track,name,start,wtime());
+}
+
+/* ---------------------------------------------------------------------- */
+
+void Timer::step_end(double start, int ntimestep)
+{
+  trace->step(start,ntimestep);
+}
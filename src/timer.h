@@ -13,26 +13,68 @@
 #define MUSE_TIMER_H
 
 #include "pointers.h"
+#include <chrono>
 
 namespace MUSE_NS {
 
-enum{TIME_LOOP,TIME_COMM,TIME_MODIFY,TIME_OUTPUT,TIME_N};
+// TIME_SOLVE is the integration step itself, the four phases after it
+// are timed inside the solver wherever it runs and only if full is set
+// or a trace records
+
+enum{TIME_LOOP,TIME_COMM,TIME_MODIFY,TIME_OUTPUT,TIME_SOLVE,
+     TIME_REFRESH,TIME_KERNEL,TIME_ASSEMBLE,TIME_FACTOR,TIME_N};
 
 class Timer : protected Pointers {
  public:
   double *array;
+  int full;                       // 1 = also time the solver phases
+  class Trace *trace;             // NULL unless timer trace
+  int tracing;                    // 1 while the trace records spans
 
   Timer(class MUSE *);
   ~Timer();
+  void command(int, char **);
   void init();
   void stamp();
   void stamp(int);
   void barrier_start(int);
   void barrier_stop(int);
   double elapsed(int);
+  int keyword(const char *);      // TIME_ index of a t_ keyword, -1 if none
+  void report(int);               // breakdown of the last run of N steps
+
+  // no clock is read unless full is set or a trace records
+
+  double phase_start() { return (full || tracing) ? wtime() : 0.0; }
+  void phase_stop(int which, double start)
+  {
+    if (full || tracing) phase_end(which,start);
+  }
+
+  // spans that only go into the trace, see Trace for the tracks
+
+  double span_start() { return tracing ? wtime() : 0.0; }
+  void span_stop(const char *name, double start, int track)
+  {
+    if (tracing) span_end(name,start,track);
+  }
+  void step_stop(double start, int ntimestep)
+  {
+    if (tracing) step_end(start,ntimestep);
+  }
+
+  static double wtime()
+  {
+    return std::chrono::duration<double>
+      (std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
 
  private:
   double previous_time;
+
+  void phase_end(int, double);
+  void span_end(const char *, double, int);
+  void step_end(double, int);
 };
 
 }
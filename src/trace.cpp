@@ -0,0 +1,196 @@
+/* ----------------------------------------------------------------------
+   MUSE - MUltibody System dynamics Engine
+   https://github.com/zhangh3/MUSE
+
+   Zhang He, zhanghecalt@163.com
+   Science and Technology on Space Physics Laboratory, Beijing
+
+   This software is distributed under the GNU General Public License.
+   Copyright (c) 2023 Zhang He. All rights reserved.
+------------------------------------------------------------------------- */
+
+#include "stdio.h"
+#include "string.h"
+#include "limits.h"
+#include "trace.h"
+#include "timer.h"
+#include "memory.h"
+#include "error.h"
+
+using namespace MUSE_NS;
+
+#define SPANSTEP 64            // cap on spans per track and traced step
+#define MINSPAN 1024
+
+/* ---------------------------------------------------------------------- */
+
+Trace::Trace(MUSE *muse, const char *file, int nsteps) : Pointers(muse)
+{
+  if (nsteps <= 0 || nsteps > INT_MAX/SPANSTEP)
+    error->all(FLERR,"Illegal timer trace step count");
+
+  int n = strlen(file) + 1;
+  filename = new char[n];
+  strcpy(filename,file);
+
+  // make sure the file can be written before any step is traced
+
+  FILE *fp = fopen(filename,"w");
+  if (fp == NULL) {
+    char str[128];
+    snprintf(str,128,"Cannot open trace file %s",filename);
+    error->one(FLERR,str);
+  }
+  fclose(fp);
+
+  maxstep = nsteps;
+  nstep = 0;
+  maxspan = maxstep*SPANSTEP;
+  ntrack = 0;
+  tracks = NULL;
+  origin = Timer::wtime();
+  ndump = -1;
+  writer_on = 0;
+}
+
+/* ---------------------------------------------------------------------- */
+
+Trace::~Trace()
+{
+  for (int i = 0; i < ntrack; i++) memory->sfree(tracks[i].spans);
+  memory->sfree(tracks);
+  delete [] filename;
+}
+
+/* ----------------------------------------------------------------------
+   called between runs, no other thread touches the tracks now
+   turn recording on if the step cap is not reached yet
+------------------------------------------------------------------------- */
+
+void Trace::start(int nthreads)
+{
+  int n = TRACK_OMP + nthreads;
+  if (n > ntrack) {
+    tracks = (Track *) memory->srealloc(tracks,n*sizeof(Track),"trace:tracks");
+    for (int i = ntrack; i < n; i++) {
+      tracks[i].n = tracks[i].nmax = 0;
+      tracks[i].spans = NULL;
+      tracks[i].ndrop = 0;
+    }
+    ntrack = n;
+  }
+
+  int on = (nstep < maxstep);
+  timer->tracing = on;
+  writer_on = on;
+}
+
+/* ----------------------------------------------------------------------
+   record a span, only the thread owning the track calls this
+------------------------------------------------------------------------- */
+
+void Trace::add(int itrack, const char *name, double begin, double end, int arg)
+{
+  Track *t = &tracks[itrack];
+  if (t->n == t->nmax) {
+    if (t->nmax == maxspan) {
+      t->ndrop++;
+      return;
+    }
+    grow(t);
+  }
+
+  Span *s = &t->spans[t->n++];
+  s->name = name;
+  s->begin = begin;
+  s->end = end;
+  s->arg = arg;
+}
+
+/* ----------------------------------------------------------------------
+   solver thread: close the span of a step,
+   recording stops for all threads once maxstep steps are traced
+------------------------------------------------------------------------- */
+
+void Trace::step(double begin, int ntimestep)
+{
+  add(TRACK_SOLVER,"step",begin,Timer::wtime(),ntimestep);
+  if (++nstep < maxstep) return;
+  timer->tracing = 0;
+  writer_on = 0;
+}
+
+/* ----------------------------------------------------------------------
+   write all spans recorded so far as Chrome trace-event JSON,
+   the file is rewritten after each run that added spans
+   times are in microseconds since "timer trace"
+------------------------------------------------------------------------- */
+
+void Trace::dump()
+{
+  timer->tracing = 0;
+  writer_on = 0;
+
+  int ntotal = 0;
+  long ndrop = 0;
+  for (int i = 0; i < ntrack; i++) {
+    ntotal += tracks[i].n;
+    ndrop += tracks[i].ndrop;
+  }
+  if (ntotal == ndump) return;
+  ndump = ntotal;
+
+  FILE *fp = fopen(filename,"w");
+  if (fp == NULL) {
+    char str[128];
+    snprintf(str,128,"Cannot open trace file %s",filename);
+    error->one(FLERR,str);
+  }
+
+  fprintf(fp,"{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  fprintf(fp,"{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,"
+          "\"args\":{\"name\":\"MUSE\"}}");
+
+  for (int i = 0; i < ntrack; i++) {
+    Track *t = &tracks[i];
+    if (i == TRACK_SOLVER)
+      fprintf(fp,",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,"
+              "\"tid\":%d,\"args\":{\"name\":\"solver\"}}",i);
+    else if (i == TRACK_WRITER)
+      fprintf(fp,",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,"
+              "\"tid\":%d,\"args\":{\"name\":\"async writer\"}}",i);
+    else
+      fprintf(fp,",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,"
+              "\"tid\":%d,\"args\":{\"name\":\"omp %d\"}}",i,i-TRACK_OMP);
+
+    for (int k = 0; k < t->n; k++) {
+      Span *s = &t->spans[k];
+      fprintf(fp,",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,"
+              "\"ts\":%.3f,\"dur\":%.3f",s->name,i,
+              1.0e6*(s->begin-origin),1.0e6*(s->end-s->begin));
+      if (s->arg >= 0) fprintf(fp,",\"args\":{\"step\":%d}",s->arg);
+      fputc('}',fp);
+    }
+  }
+
+  fprintf(fp,"\n]}\n");
+  fclose(fp);
+
+  char str[256];
+  snprintf(str,256,"Trace: %d spans of %d steps written to %s, "
+           "%ld dropped\n",ntotal,nstep,filename,ndrop);
+  if (screen) fputs(str,screen);
+  if (logfile) fputs(str,logfile);
+}
+
+/* ----------------------------------------------------------------------
+   double the spans of a track, up to maxspan
+------------------------------------------------------------------------- */
+
+void Trace::grow(Track *t)
+{
+  t->nmax = t->nmax ? 2*t->nmax : MINSPAN;
+  if (t->nmax > maxspan) t->nmax = maxspan;
+  t->spans = (Span *)
+    memory->srealloc(t->spans,t->nmax*sizeof(Span),"trace:spans");
+}
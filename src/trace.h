@@ -0,0 +1,69 @@
+/* ----------------------------------------------------------------------
+   MUSE - MUltibody System dynamics Engine
+   https://github.com/zhangh3/MUSE
+
+   Zhang He, zhanghecalt@163.com
+   Science and Technology on Space Physics Laboratory, Beijing
+
+   This software is distributed under the GNU General Public License.
+   Copyright (c) 2023 Zhang He. All rights reserved.
+------------------------------------------------------------------------- */
+
+#ifndef MUSE_TRACE_H
+#define MUSE_TRACE_H
+
+#include <atomic>
+#include "pointers.h"
+
+namespace MUSE_NS {
+
+// tracks of the trace, OpenMP thread k of the solver loops is TRACK_OMP+k
+
+enum{TRACK_SOLVER,TRACK_WRITER,TRACK_OMP};
+
+/* span recorder for "timer trace", written as Chrome trace-event JSON
+   each track is a buffer filled by one thread only, so no locks are
+   taken, the solver and OpenMP threads are told through Timer::tracing,
+   the async writer thread through writing()
+   buffers grow by doubling up to a cap derived from the # of steps to
+   trace, spans past the cap are counted and dropped */
+
+class Trace : protected Pointers {
+ public:
+  Trace(class MUSE *, const char *, int);
+  ~Trace();
+  void start(int);             // before a run with N OpenMP threads
+  void add(int, const char *, double, double, int = -1);
+  void step(double, int);      // span of one step, stops at the step cap
+  int writing() { return writer_on.load(std::memory_order_relaxed); }
+  void dump();                 // write the file, after a run
+
+ private:
+  struct Span {
+    const char *name;          // string literal, not copied
+    double begin,end;
+    int arg;                   // step #, -1 = none
+  };
+
+  struct Track {
+    int n,nmax;
+    Span *spans;
+    long ndrop;
+  };
+
+  char *filename;
+  int maxstep;                 // # of steps to trace
+  int nstep;                   // # of steps traced so far
+  int maxspan;                 // cap on spans in one track
+  int ntrack;
+  Track *tracks;
+  double origin;               // clock at "timer trace", time 0 of the file
+  int ndump;                   // # of spans in the last dump
+  std::atomic<int> writer_on;
+
+  void grow(Track *);
+};
+
+}
+
+#endif
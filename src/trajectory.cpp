@@ -0,0 +1,755 @@
+/* ----------------------------------------------------------------------
+   MUSE - MUltibody System dynamics Engine
+   https://github.com/zhangh3/MUSE
+
+   Zhang He, zhanghecalt@163.com
+   Science and Technology on Space Physics Laboratory, Beijing
+
+   This software is distributed under the GNU General Public License.
+   Copyright (c) 2023 Zhang He. All rights reserved.
+------------------------------------------------------------------------- */
+
+#include "mpi.h"
+#include "string.h"
+#include "math.h"
+#include "trajectory.h"
+#include "trajectory_format.h"
+#include "muse.h"
+#include "MUSEsystem.h"
+#include "body.h"
+#include "ensemble.h"
+#include "input.h"
+#include "output.h"
+#include "async_writer.h"
+#include "memory.h"
+#include "error.h"
+
+using namespace MUSE_NS;
+
+// customize a new field by adding to this list, to fieldnames,
+// field_cols(), field_perbody() and pack()
+
+enum{STEP,TIME,X,XD,XDD,POS,QUAT,VEL,QUATD,OMEGA};
+static const char *fieldnames[] =
+  {"step","time","x","xd","xdd","pos","quat","vel","quatd","omega"};
+
+#define NRING 1024
+#define MAXWORD 32
+#define KEYFRAME 100
+
+/* ---------------------------------------------------------------------- */
+
+Trajectory::Trajectory(MUSE *muse) : Pointers(muse)
+{
+  MPI_Comm_rank(world,&me);
+
+  every = 1;
+  nring = NRING;
+  ncol = 0;
+  binary = binary_open = 0;
+  compress = compress_open = 0;
+  keyframe = KEYFRAME;
+  filename = NULL;
+  fp = NULL;
+  fpindex = NULL;
+
+  // default frame matches the original res.txt layout: time x xd xdd
+
+  nfield = maxfield = 0;
+  field = quant = NULL;
+  scale = deadband = NULL;
+  grow_fields();
+  nfield = 4;
+  field[0] = TIME;
+  field[1] = X;
+  field[2] = XD;
+  field[3] = XDD;
+
+  nframe = 0;
+  ring = NULL;
+  ringstep = NULL;
+  ringtime = NULL;
+  word = NULL;
+  nring_alloc = ncol_alloc = 0;
+
+  colquant = colrow = NULL;
+  colscale = NULL;
+  nrow = 0;
+  rowcol = rowwidth = NULL;
+  rowtol = NULL;
+  hist1 = hist2 = hist3 = NULL;
+  nhist = cbuf = NULL;
+
+  set_file(ensemble->resfile);
+}
+
+/* ---------------------------------------------------------------------- */
+
+Trajectory::~Trajectory()
+{
+  close();
+  delete [] filename;
+  memory->destroy(field);
+  memory->destroy(quant);
+  memory->destroy(scale);
+  memory->destroy(deadband);
+  memory->destroy(ring);
+  memory->destroy(ringstep);
+  memory->destroy(ringtime);
+  memory->destroy(word);
+
+  memory->destroy(colquant);
+  memory->destroy(colscale);
+  memory->destroy(colrow);
+  memory->destroy(rowcol);
+  memory->destroy(rowwidth);
+  memory->destroy(rowtol);
+  memory->destroy(hist1);
+  memory->destroy(hist2);
+  memory->destroy(hist3);
+  memory->destroy(nhist);
+  memory->destroy(cbuf);
+}
+
+/* ----------------------------------------------------------------------
+   trajectory none
+   trajectory keyword value ...
+     every N = log a frame every N steps
+     fields f1 f2 ... = step time x xd xdd pos quat vel quatd omega
+     file name = write frames to this file
+     format text/binary = text lines or raw doubles with header and index
+     ring N = buffer N frames between writes
+     compress yes/no = encode binary frames as predicted residuals
+     keyframe N = encoded: every Nth frame decodes on its own
+     quantize f none/float32/fixed S = store field f losslessly,
+       as floats, or as integer multiples of S
+     deadband f tol = store a body's row of field f only if one of its
+       values moved more than tol since it was last stored
+------------------------------------------------------------------------- */
+
+void Trajectory::command(int narg, char **arg)
+{
+  if (narg < 1) error->all(FLERR,"Illegal trajectory command");
+
+  if (strcmp(arg[0],"none") == 0) {
+    if (narg != 1) error->all(FLERR,"Illegal trajectory command");
+    flush();
+    muse->system->logflag = false;
+    return;
+  }
+
+  flush();
+  muse->system->logflag = true;
+
+  int reopen = 0;
+  int iarg = 0;
+  while (iarg < narg) {
+    if (strcmp(arg[iarg],"every") == 0) {
+      if (iarg+2 > narg) error->all(FLERR,"Illegal trajectory command");
+      every = input->inumeric(FLERR,arg[iarg+1]);
+      if (every <= 0) error->all(FLERR,"Illegal trajectory every value");
+      iarg += 2;
+    } else if (strcmp(arg[iarg],"ring") == 0) {
+      if (iarg+2 > narg) error->all(FLERR,"Illegal trajectory command");
+      nring = input->inumeric(FLERR,arg[iarg+1]);
+      if (nring <= 0) error->all(FLERR,"Illegal trajectory ring value");
+      iarg += 2;
+    } else if (strcmp(arg[iarg],"format") == 0) {
+      if (iarg+2 > narg) error->all(FLERR,"Illegal trajectory command");
+      if (strcmp(arg[iarg+1],"text") == 0) binary = 0;
+      else if (strcmp(arg[iarg+1],"binary") == 0) binary = 1;
+      else error->all(FLERR,"Illegal trajectory format value");
+      iarg += 2;
+    } else if (strcmp(arg[iarg],"compress") == 0) {
+      if (iarg+2 > narg) error->all(FLERR,"Illegal trajectory command");
+      if (strcmp(arg[iarg+1],"yes") == 0) compress = 1;
+      else if (strcmp(arg[iarg+1],"no") == 0) compress = 0;
+      else error->all(FLERR,"Illegal trajectory compress value");
+      reopen = 1;
+      iarg += 2;
+    } else if (strcmp(arg[iarg],"keyframe") == 0) {
+      if (iarg+2 > narg) error->all(FLERR,"Illegal trajectory command");
+      keyframe = input->inumeric(FLERR,arg[iarg+1]);
+      if (keyframe <= 0) error->all(FLERR,"Illegal trajectory keyframe value");
+      reopen = 1;
+      iarg += 2;
+    } else if (strcmp(arg[iarg],"quantize") == 0) {
+      if (iarg+3 > narg) error->all(FLERR,"Illegal trajectory command");
+      int ifield = find_field(arg[iarg+1]);
+      if (strcmp(arg[iarg+2],"none") == 0) {
+        quant[ifield] = TRAJ_DOUBLE;
+        iarg += 3;
+      } else if (strcmp(arg[iarg+2],"float32") == 0) {
+        quant[ifield] = TRAJ_FLOAT32;
+        iarg += 3;
+      } else if (strcmp(arg[iarg+2],"fixed") == 0) {
+        if (iarg+4 > narg) error->all(FLERR,"Illegal trajectory command");
+        quant[ifield] = TRAJ_FIXED;
+        scale[ifield] = input->numeric(FLERR,arg[iarg+3]);
+        if (scale[ifield] <= 0.0)
+          error->all(FLERR,"Illegal trajectory quantize fixed value");
+        iarg += 4;
+      } else error->all(FLERR,"Illegal trajectory quantize value");
+      reopen = 1;
+    } else if (strcmp(arg[iarg],"deadband") == 0) {
+      if (iarg+3 > narg) error->all(FLERR,"Illegal trajectory command");
+      int ifield = find_field(arg[iarg+1]);
+      if (!field_perbody(field[ifield]))
+        error->all(FLERR,"Trajectory deadband needs a per-body field");
+      deadband[ifield] = input->numeric(FLERR,arg[iarg+2]);
+      if (deadband[ifield] < 0.0)
+        error->all(FLERR,"Illegal trajectory deadband value");
+      reopen = 1;
+      iarg += 3;
+    } else if (strcmp(arg[iarg],"file") == 0) {
+      if (iarg+2 > narg) error->all(FLERR,"Illegal trajectory command");
+      set_file(arg[iarg+1]);
+      iarg += 2;
+    } else if (strcmp(arg[iarg],"fields") == 0) {
+      nfield = 0;
+      iarg++;
+      while (iarg < narg) {
+        int which = find_fieldname(arg[iarg]);
+        if (which < 0) break;
+        if (nfield == maxfield) grow_fields();
+        field[nfield] = which;
+        quant[nfield] = TRAJ_DOUBLE;
+        scale[nfield] = 1.0;
+        deadband[nfield] = 0.0;
+        nfield++;
+        iarg++;
+      }
+      if (nfield == 0) error->all(FLERR,"Illegal trajectory fields");
+    } else error->all(FLERR,"Illegal trajectory command");
+  }
+
+  // a new format or encoding rewrites the file from the start
+  // on the next setup
+
+  if (fp && (binary != binary_open || reopen)) close();
+}
+
+/* ---------------------------------------------------------------------- */
+
+void Trajectory::grow_fields()
+{
+  maxfield += 4;
+  memory->grow(field,maxfield,"trajectory:field");
+  memory->grow(quant,maxfield,"trajectory:quant");
+  memory->grow(scale,maxfield,"trajectory:scale");
+  memory->grow(deadband,maxfield,"trajectory:deadband");
+  for (int i = nfield; i < maxfield; i++) {
+    quant[i] = TRAJ_DOUBLE;
+    scale[i] = 1.0;
+    deadband[i] = 0.0;
+  }
+}
+
+/* ----------------------------------------------------------------------
+   index of a field in the selected field list, error if not selected
+------------------------------------------------------------------------- */
+
+int Trajectory::find_field(const char *name)
+{
+  for (int i = 0; i < nfield; i++)
+    if (strcmp(name,fieldnames[field[i]]) == 0) return i;
+
+  char str[128];
+  sprintf(str,"Trajectory field %s is not selected",name);
+  error->all(FLERR,str);
+  return -1;
+}
+
+/* ----------------------------------------------------------------------
+   switch to a new file, opened on the next setup
+------------------------------------------------------------------------- */
+
+void Trajectory::set_file(const char *name)
+{
+  close();
+
+  delete [] filename;
+  int n = strlen(name) + 1;
+  filename = new char[n];
+  strcpy(filename,name);
+}
+
+/* ----------------------------------------------------------------------
+   size the ring for the current system and field list
+   called from Output::setup() before every run
+------------------------------------------------------------------------- */
+
+void Trajectory::setup()
+{
+  if (!muse->system->logflag) return;
+
+  flush();
+
+  if (compress && !binary)
+    error->all(FLERR,"Trajectory compress requires format binary");
+  if (!compress)
+    for (int i = 0; i < nfield; i++)
+      if (quant[i] != TRAJ_DOUBLE || deadband[i] > 0.0)
+        error->all(FLERR,"Trajectory quantize and deadband "
+                   "require compress yes");
+
+  ncol = 0;
+  for (int i = 0; i < nfield; i++) ncol += field_cols(field[i]);
+
+  if (nring != nring_alloc || ncol != ncol_alloc) {
+    memory->destroy(ring);
+    memory->create(ring,nring,ncol,"trajectory:ring");
+    memory->destroy(ringstep);
+    memory->create(ringstep,nring,"trajectory:ringstep");
+    memory->destroy(ringtime);
+    memory->create(ringtime,nring,"trajectory:ringtime");
+    memory->destroy(word);
+    memory->create(word,ncol,MAXWORD,"trajectory:word");
+    nring_alloc = nring;
+    ncol_alloc = ncol;
+  }
+
+  if (fp == NULL) open();
+
+  // binary frames have a fixed width recorded in the header
+
+  if (fp && binary_open && ncol != ncol_file)
+    error->one(FLERR,"Trajectory frame layout changed, "
+               "use trajectory file to start a new binary file");
+}
+
+/* ----------------------------------------------------------------------
+   field id of a field name, -1 if there is no such field
+------------------------------------------------------------------------- */
+
+int Trajectory::find_fieldname(const char *name)
+{
+  int n = sizeof(fieldnames) / sizeof(fieldnames[0]);
+  for (int which = 0; which < n; which++)
+    if (strcmp(name,fieldnames[which]) == 0) return which;
+  return -1;
+}
+
+/* ---------------------------------------------------------------------- */
+
+const char *Trajectory::fieldname(int which)
+{
+  return fieldnames[which];
+}
+
+/* ---------------------------------------------------------------------- */
+
+int Trajectory::field_cols(int which)
+{
+  int nbody = muse->system->nBodies;
+
+  switch (which) {
+  case STEP:
+  case TIME:  return 1;
+  case X:
+  case XD:
+  case XDD:   return 7 * nbody;
+  case POS:
+  case VEL:
+  case OMEGA: return 3 * nbody;
+  case QUAT:
+  case QUATD: return 4 * nbody;
+  }
+  return 0;
+}
+
+/* ----------------------------------------------------------------------
+   1 if the columns of a field repeat once per body
+------------------------------------------------------------------------- */
+
+int Trajectory::field_perbody(int which)
+{
+  return (which != STEP && which != TIME);
+}
+
+/* ---------------------------------------------------------------------- */
+
+void Trajectory::open()
+{
+  if (me != 0) return;
+  if (binary) {
+    open_binary();
+    return;
+  }
+
+  fp = fopen(filename,"w");
+  if (fp == NULL) {
+    char str[128];
+    sprintf(str,"Cannot open trajectory file %s",filename);
+    error->one(FLERR,str);
+  }
+  fprintf(fp,"MUSE OUTPUT:\n");
+  binary_open = 0;
+}
+
+/* ----------------------------------------------------------------------
+   write the self-describing header of a binary trajectory
+   index entries are spooled to a temporary file and appended on close
+------------------------------------------------------------------------- */
+
+void Trajectory::open_binary()
+{
+  System *s = muse->system;
+  int nbody = s->nBodies;
+
+  fp = fopen(filename,"wb");
+  if (fp == NULL) {
+    char str[128];
+    sprintf(str,"Cannot open trajectory file %s",filename);
+    error->one(FLERR,str);
+  }
+  fpindex = tmpfile();
+  if (fpindex == NULL)
+    error->one(FLERR,"Cannot open trajectory index scratch file");
+
+  int namelen = TRAJ_NAMELEN;
+  for (int i = 0; i < nbody; i++) {
+    int n = strlen(s->body[i]->name) + 1;
+    if (n > namelen) namelen = (n + 7) / 8 * 8;
+  }
+
+  TrajHeader header;
+  memset(&header,0,sizeof(TrajHeader));
+  strcpy(header.magic,TRAJ_MAGIC);
+  header.version = TRAJ_VERSION;
+  header.nbody = nbody;
+  header.nfield = nfield;
+  header.ncol = ncol;
+  header.every = every;
+  header.namelen = namelen;
+  header.compress = compress;
+  header.keyframe = keyframe;
+  header.dt = s->dt;
+  header.startstep = s->ntimestep;
+  header.header_size = sizeof(TrajHeader) + nfield*sizeof(TrajField) +
+    (int64_t) nbody*namelen;
+  fwrite(&header,sizeof(TrajHeader),1,fp);
+
+  int offset = 0;
+  for (int i = 0; i < nfield; i++) {
+    TrajField f;
+    memset(&f,0,sizeof(TrajField));
+    strcpy(f.name,fieldnames[field[i]]);
+    f.offset = offset;
+    f.perbody = field_perbody(field[i]);
+    f.width = field_cols(field[i]);
+    if (f.perbody) f.width /= nbody;
+    f.quant = quant[i];
+    f.scale = scale[i];
+    f.deadband = deadband[i];
+    fwrite(&f,sizeof(TrajField),1,fp);
+    offset += field_cols(field[i]);
+  }
+
+  char *name = new char[namelen];
+  for (int i = 0; i < nbody; i++) {
+    memset(name,0,namelen);
+    strcpy(name,s->body[i]->name);
+    fwrite(name,1,namelen,fp);
+  }
+  delete [] name;
+
+  binary_open = 1;
+  ncol_file = ncol;
+  header_size = header.header_size;
+  nwritten = 0;
+  firststep = laststep = s->ntimestep;
+  foffset = header_size;
+
+  compress_open = compress;
+  if (compress_open) setup_codec();
+}
+
+/* ----------------------------------------------------------------------
+   per-column codec tables for encoded frames
+   a deadband row is one body's columns of a field with a deadband
+------------------------------------------------------------------------- */
+
+void Trajectory::setup_codec()
+{
+  int nbody = muse->system->nBodies;
+  int i,j,k;
+
+  nrow = 0;
+  for (i = 0; i < nfield; i++)
+    if (deadband[i] > 0.0 && field_perbody(field[i])) nrow += nbody;
+
+  memory->destroy(colquant);
+  memory->create(colquant,ncol,"trajectory:colquant");
+  memory->destroy(colscale);
+  memory->create(colscale,ncol,"trajectory:colscale");
+  memory->destroy(colrow);
+  memory->create(colrow,ncol,"trajectory:colrow");
+  memory->destroy(rowcol);
+  memory->create(rowcol,MAX(nrow,1),"trajectory:rowcol");
+  memory->destroy(rowwidth);
+  memory->create(rowwidth,MAX(nrow,1),"trajectory:rowwidth");
+  memory->destroy(rowtol);
+  memory->create(rowtol,MAX(nrow,1),"trajectory:rowtol");
+  memory->destroy(hist1);
+  memory->create(hist1,ncol,"trajectory:hist1");
+  memory->destroy(hist2);
+  memory->create(hist2,ncol,"trajectory:hist2");
+  memory->destroy(hist3);
+  memory->create(hist3,ncol,"trajectory:hist3");
+  memory->destroy(nhist);
+  memory->create(nhist,ncol,"trajectory:nhist");
+  memory->destroy(cbuf);
+  memory->create(cbuf,(nrow+7)/8 + ncol*TRAJ_MAXVARINT,"trajectory:cbuf");
+
+  int m = 0;
+  int irow = 0;
+  for (i = 0; i < nfield; i++) {
+    int n = field_cols(field[i]);
+    for (k = 0; k < n; k++) {
+      colquant[m+k] = quant[i];
+      colscale[m+k] = scale[i];
+      colrow[m+k] = -1;
+    }
+    if (deadband[i] > 0.0 && field_perbody(field[i])) {
+      int width = n / nbody;
+      for (j = 0; j < nbody; j++, irow++) {
+        rowcol[irow] = m + j*width;
+        rowwidth[irow] = width;
+        rowtol[irow] = deadband[i];
+        for (k = 0; k < width; k++) colrow[m+j*width+k] = irow;
+      }
+    }
+    m += n;
+  }
+
+  memset(nhist,0,ncol);
+}
+
+/* ----------------------------------------------------------------------
+   encode one frame into cbuf, return # of payload bytes
+   a key frame starts without history, see trajectory_format.h
+------------------------------------------------------------------------- */
+
+int Trajectory::encode(double *frame, int key)
+{
+  int nmask = (nrow + 7) / 8;
+  unsigned char *p = cbuf + nmask;
+  int c,k,irow;
+
+  if (key) memset(nhist,0,ncol);
+  memset(cbuf,0,nmask);
+
+  for (irow = 0; irow < nrow; irow++) {
+    c = rowcol[irow];
+    for (k = 0; k < rowwidth[irow]; k++, c++)
+      if (nhist[c] == 0 ||
+          fabs(frame[c] - traj_value(colquant[c],colscale[c],hist1[c])) >
+          rowtol[irow]) break;
+    if (k < rowwidth[irow]) cbuf[irow >> 3] |= 1 << (irow & 7);
+  }
+
+  for (c = 0; c < ncol; c++) {
+    irow = colrow[c];
+    if (irow >= 0 && !(cbuf[irow >> 3] & (1 << (irow & 7)))) continue;
+    double pred = traj_predict(colquant[c],hist1[c],hist2[c],hist3[c],
+                               nhist[c]);
+    double h;
+    p += traj_put_varint(p,traj_residual(colquant[c],colscale[c],
+                                         frame[c],pred,&h));
+    hist3[c] = hist2[c];
+    hist2[c] = hist1[c];
+    hist1[c] = h;
+    if (nhist[c] < 3) nhist[c]++;
+  }
+
+  return p - cbuf;
+}
+
+/* ----------------------------------------------------------------------
+   write pending frames and close the file
+   a binary file gets its footer index and trailer here
+------------------------------------------------------------------------- */
+
+void Trajectory::close()
+{
+  flush();
+  if (fp == NULL) return;
+
+  if (binary_open) {
+    TrajTrailer trailer;
+    memset(&trailer,0,sizeof(TrajTrailer));
+    // index entries start 8-byte aligned after the frames
+
+    char pad[8];
+    memset(pad,0,8);
+    int npad = (8 - foffset % 8) % 8;
+    fwrite(pad,1,npad,fp);
+
+    trailer.nframe = nwritten;
+    trailer.index_offset = foffset + npad;
+    trailer.firststep = firststep;
+    trailer.laststep = laststep;
+    strcpy(trailer.magic,TRAJ_TRAILER_MAGIC);
+
+    TrajIndex entry;
+    rewind(fpindex);
+    while (fread(&entry,sizeof(TrajIndex),1,fpindex) == 1)
+      fwrite(&entry,sizeof(TrajIndex),1,fp);
+    fwrite(&trailer,sizeof(TrajTrailer),1,fp);
+    fclose(fpindex);
+    fpindex = NULL;
+  }
+
+  fclose(fp);
+  fp = NULL;
+  binary_open = 0;
+}
+
+/* ----------------------------------------------------------------------
+   copy selected fields of the current state into the next free frame
+   with output async the frame goes to a writer slot instead of the ring
+------------------------------------------------------------------------- */
+
+void Trajectory::log()
+{
+  System *s = muse->system;
+  AsyncWriter *async = output->async;
+  double *frame;
+
+  if (async) frame = async->claim(ASYNC_TRAJ,s->ntimestep,s->timenow) + 3;
+  else {
+    if (nframe == nring_alloc) flush();
+    frame = ring[nframe];
+    ringstep[nframe] = s->ntimestep;
+    ringtime[nframe] = s->timenow;
+  }
+
+  pack(nfield,field,frame);
+
+  if (async) async->commit();
+  else nframe++;
+}
+
+/* ----------------------------------------------------------------------
+   copy fields list[0..n-1] of the current state into frame
+------------------------------------------------------------------------- */
+
+void Trajectory::pack(int n, int *list, double *frame)
+{
+  System *s = muse->system;
+  int nbody = s->nBodies;
+  int m = 0;
+  int i,k;
+
+  for (int ifield = 0; ifield < n; ifield++) {
+    switch (list[ifield]) {
+    case STEP:
+      frame[m++] = s->ntimestep;
+      break;
+    case TIME:
+      frame[m++] = s->timenow;
+      break;
+    case X:
+      for (k = 0; k < 7 * nbody; k++) frame[m++] = s->x(k);
+      break;
+    case XD:
+      for (k = 0; k < 7 * nbody; k++) frame[m++] = s->xd(k);
+      break;
+    case XDD:
+      for (k = 0; k < 7 * nbody; k++) frame[m++] = s->xdd(k);
+      break;
+    case POS:
+      for (i = 0; i < nbody; i++)
+        for (k = 0; k < 3; k++) frame[m++] = s->x(7 * i + k);
+      break;
+    case QUAT:
+      for (i = 0; i < nbody; i++)
+        for (k = 3; k < 7; k++) frame[m++] = s->x(7 * i + k);
+      break;
+    case VEL:
+      for (i = 0; i < nbody; i++)
+        for (k = 0; k < 3; k++) frame[m++] = s->xd(7 * i + k);
+      break;
+    case QUATD:
+      for (i = 0; i < nbody; i++)
+        for (k = 3; k < 7; k++) frame[m++] = s->xd(7 * i + k);
+      break;
+    case OMEGA:
+      for (i = 0; i < nbody; i++)
+        for (k = 0; k < 3; k++) frame[m++] = s->body[i]->omega(k);
+      break;
+    }
+  }
+}
+
+/* ----------------------------------------------------------------------
+   write buffered frames
+------------------------------------------------------------------------- */
+
+void Trajectory::flush()
+{
+  if (nframe == 0) return;
+
+  for (int iframe = 0; iframe < nframe; iframe++)
+    write_frame(ring[iframe],ringstep[iframe],ringtime[iframe]);
+  if (fp) fflush(fp);
+
+  nframe = 0;
+}
+
+/* ----------------------------------------------------------------------
+   write one frame
+   binary: raw doubles, plus one footer index entry
+   text: one line, values right aligned to the widest value of the
+   frame, the same layout Eigen used when res.txt was written
+   runs on the writer thread with output async
+------------------------------------------------------------------------- */
+
+void Trajectory::write_frame(double *frame, int step, double time)
+{
+  if (me != 0 || fp == NULL) return;
+
+  if (binary_open) {
+    TrajIndex entry;
+    entry.offset = foffset;
+    entry.step = step;
+    entry.time = time;
+    if (compress_open) {
+      TrajRecord record;
+      record.step = step;
+      record.time = time;
+      record.key = (nwritten % keyframe == 0);
+      record.nbytes = encode(frame,record.key);
+      fwrite(&record,sizeof(TrajRecord),1,fp);
+      fwrite(cbuf,1,record.nbytes,fp);
+      foffset += sizeof(TrajRecord) + record.nbytes;
+    } else {
+      fwrite(frame,sizeof(double),ncol,fp);
+      foffset += ncol*sizeof(double);
+    }
+    fwrite(&entry,sizeof(TrajIndex),1,fpindex);
+    if (nwritten == 0) firststep = step;
+    laststep = step;
+    nwritten++;
+    return;
+  }
+
+  int m = 0;
+  int width = 0;
+  for (int ifield = 0; ifield < nfield; ifield++) {
+    int n = field_cols(field[ifield]);
+    for (int k = 0; k < n; k++, m++) {
+      int len;
+      if (field[ifield] == STEP)
+        len = snprintf(word[m],MAXWORD,"%.0f",frame[m]);
+      else len = snprintf(word[m],MAXWORD,"%g",frame[m]);
+      if (len > width) width = len;
+    }
+  }
+  for (m = 0; m < ncol; m++) {
+    if (m) fputc(' ',fp);
+    fprintf(fp,"%*s",width,word[m]);
+  }
+  fputc('\n',fp);
+}
@@ -0,0 +1,109 @@
+/* ----------------------------------------------------------------------
+   MUSE - MUltibody System dynamics Engine
+   https://github.com/zhangh3/MUSE
+
+   Zhang He, zhanghecalt@163.com
+   Science and Technology on Space Physics Laboratory, Beijing
+
+   This software is distributed under the GNU General Public License.
+   Copyright (c) 2023 Zhang He. All rights reserved.
+------------------------------------------------------------------------- */
+
+#ifndef MUSE_TRAJECTORY_H
+#define MUSE_TRAJECTORY_H
+
+#include "stdio.h"
+#include "stdint.h"
+#include "pointers.h"
+
+namespace MUSE_NS {
+
+/* streaming trajectory logger
+   every N steps the selected fields are copied into a preallocated ring
+   of frames, the ring is written to file whenever it fills up and at
+   the end of each solve, so memory use does not grow with run length
+   frames are written as text lines or, with format binary, as raw
+   doubles after a self-describing header (see trajectory_format.h)
+   compress yes stores binary frames as predicted residuals instead,
+   optionally quantized per field and thinned out by a deadband */
+
+class Trajectory : protected Pointers {
+ public:
+  int every;                   // log a frame every this many steps
+  int nring;                   // # of frames in the ring
+  int ncol;                    // # of doubles in one frame
+  int binary;                  // 1 for binary frames, 0 for text
+  int compress;                // 1 to encode binary frames
+  int keyframe;                // encoded: key frame every this many frames
+  char *filename;              // trajectory file
+
+  Trajectory(class MUSE *);
+  ~Trajectory();
+  void command(int, char **);
+  void set_file(const char *);
+  void setup();
+  void log();                  // copy current state into the ring
+  void flush();                // write buffered frames to file
+  void write_frame(double *, int, double);
+
+  // field helpers, also used by ShmRing
+
+  static int find_fieldname(const char *);   // field id, -1 if unknown
+  static const char *fieldname(int);
+  int field_cols(int);
+  int field_perbody(int);
+  void pack(int, int *, double *);           // copy fields of current state
+
+ private:
+  int me;
+  int nfield;
+  int *field;                  // list of selected fields
+  int *quant;                  // TRAJ_DOUBLE/FLOAT32/FIXED of each field
+  double *scale;               // TRAJ_FIXED unit of each field
+  double *deadband;            // deadband of each field, 0 = none
+  int maxfield;
+
+  int nframe;                  // # of frames waiting in the ring
+  double **ring;               // nring x ncol frame storage
+  int *ringstep;               // timestep of each buffered frame
+  double *ringtime;            // time of each buffered frame
+  int nring_alloc,ncol_alloc;
+  char **word;                 // formatted values of one frame
+
+  FILE *fp;
+  int binary_open;             // format of the open file
+
+  // binary file bookkeeping
+
+  FILE *fpindex;               // footer index entries until close
+  int ncol_file;               // frame width in the file header
+  int64_t header_size;         // offset of the first frame
+  int64_t nwritten;            // # of frames in the file
+  int64_t firststep,laststep;
+  int64_t foffset;             // offset of the next frame in the file
+
+  // encoder state, see trajectory_format.h
+
+  int compress_open;           // 1 if the open file holds encoded records
+  int *colquant;               // quant/scale of each column
+  double *colscale;
+  int *colrow;                 // deadband row of each column, -1 = none
+  int nrow;                    // # of deadband rows
+  int *rowcol,*rowwidth;       // first column and width of each row
+  double *rowtol;              // deadband of each row
+  double *hist1,*hist2,*hist3; // last three stored values of each column
+  unsigned char *nhist;        // # of valid history values, 0 to 3
+  unsigned char *cbuf;         // encoded payload of one frame
+
+  void open();
+  void open_binary();
+  void setup_codec();
+  int encode(double *, int);
+  void grow_fields();
+  int find_field(const char *);
+  void close();
+};
+
+}
+
+#endif
@@ -0,0 +1,220 @@
+/* ----------------------------------------------------------------------
+   MUSE - MUltibody System dynamics Engine
+   https://github.com/zhangh3/MUSE
+
+   Zhang He, zhanghecalt@163.com
+   Science and Technology on Space Physics Laboratory, Beijing
+
+   This software is distributed under the GNU General Public License.
+   Copyright (c) 2023 Zhang He. All rights reserved.
+------------------------------------------------------------------------- */
+
+#ifndef MUSE_TRAJECTORY_FORMAT_H
+#define MUSE_TRAJECTORY_FORMAT_H
+
+#include "stdint.h"
+#include "string.h"
+#include "math.h"
+
+/* on-disk layout of a binary trajectory file, shared by Trajectory
+   and the tools/muse_traj reader, all values in native byte order
+
+     TrajHeader                      fixed size
+     TrajField[nfield]               field layout of one frame
+     char name[nbody][namelen]       body names, null padded
+     frames                          compress = 0: frame[nframe][ncol]
+                                     doubles, frame i at
+                                     header_size + i*ncol*8
+                                     compress = 1: one TrajRecord plus
+                                     nbytes of payload per frame
+     padding to a multiple of 8 bytes
+     TrajIndex[nframe]               footer index, written on close
+     TrajTrailer                     last bytes of the file
+
+   a file without a valid trailer (run aborted before close) still
+   holds complete frames, a reader recovers them from the file size
+   or by walking the records
+
+   encoded payload of a frame:
+     mask[(nrow+7)/8]                bit set if the row is stored, one
+                                     row per body of each field with
+                                     a deadband, absent if nrow = 0
+     varint[]                        one per stored column
+   each column is extrapolated from its last three stored values, the
+   residual is the XOR of the bit patterns (double, float32) or the
+   zigzag difference of the integers (fixed), a key frame resets the
+   history so it can be decoded on its own
+   a row left out by the deadband keeps its last stored value */
+
+#define TRAJ_MAGIC "MUSETRJ"
+#define TRAJ_TRAILER_MAGIC "MUSEIDX"
+#define TRAJ_VERSION 2
+#define TRAJ_NAMELEN 16
+#define TRAJ_MAXVARINT 10
+
+enum{TRAJ_DOUBLE,TRAJ_FLOAT32,TRAJ_FIXED};
+
+struct TrajHeader {
+  char magic[8];                 // TRAJ_MAGIC
+  int32_t version;               // TRAJ_VERSION
+  int32_t nbody;                 // # of bodies in the system
+  int32_t nfield;                // # of TrajField entries
+  int32_t ncol;                  // # of doubles in one frame
+  int32_t every;                 // steps between frames
+  int32_t namelen;               // bytes per body name
+  int32_t compress;              // 0 = raw frames, 1 = encoded records
+  int32_t keyframe;              // encoded: every Nth frame is a key frame
+  double dt;                     // timestep
+  int64_t startstep;             // timestep when the file was opened
+  int64_t header_size;           // offset of the first frame
+};
+
+struct TrajField {
+  char name[8];                  // step time x xd xdd pos quat vel ...
+  int32_t offset;                // first column of the field in a frame
+  int32_t width;                 // columns per body, or in total if
+                                 // perbody = 0
+  int32_t perbody;               // 1 if columns repeat for each body
+  int32_t quant;                 // TRAJ_DOUBLE/FLOAT32/FIXED
+  double scale;                  // TRAJ_FIXED: value of one integer unit
+  double deadband;               // store a body row only if a column
+                                 // moved more than this, 0 = always
+};
+
+struct TrajRecord {
+  int64_t step;                  // timestep of the frame
+  double time;                   // simulation time of the frame
+  int32_t nbytes;                // payload bytes after the record
+  int32_t key;                   // 1 for a key frame
+};
+
+struct TrajIndex {
+  int64_t offset;                // file offset of the frame or record
+  int64_t step;                  // timestep of the frame
+  double time;                   // simulation time of the frame
+};
+
+struct TrajTrailer {
+  int64_t nframe;                // # of frames in the file
+  int64_t index_offset;          // file offset of TrajIndex[0]
+  int64_t firststep;             // step range covered by the frames
+  int64_t laststep;
+  char magic[8];                 // TRAJ_TRAILER_MAGIC
+};
+
+/* ----------------------------------------------------------------------
+   column codec, the writer and the reader must predict and round
+   identically, so both use these
+   history values are doubles, integers for TRAJ_FIXED
+------------------------------------------------------------------------- */
+
+static inline int traj_put_varint(unsigned char *p, uint64_t u)
+{
+  int n = 0;
+  while (u >= 0x80) {
+    p[n++] = (unsigned char) (u | 0x80);
+    u >>= 7;
+  }
+  p[n++] = (unsigned char) u;
+  return n;
+}
+
+// returns -1 if the varint runs past end
+
+static inline int traj_get_varint(const unsigned char **p,
+                                  const unsigned char *end, uint64_t *u)
+{
+  const unsigned char *q = *p;
+  uint64_t value = 0;
+  for (int shift = 0; shift < 7*TRAJ_MAXVARINT; shift += 7) {
+    if (q == end) return -1;
+    unsigned char c = *q++;
+    value |= (uint64_t) (c & 0x7f) << shift;
+    if (!(c & 0x80)) {
+      *p = q;
+      *u = value;
+      return 0;
+    }
+  }
+  return -1;
+}
+
+static inline double traj_predict(int quant, double h1, double h2, double h3,
+                                  int nhist)
+{
+  if (nhist == 0) return 0.0;
+  if (nhist == 1) return h1;
+  if (quant == TRAJ_FLOAT32) {
+    float f1 = (float) h1;
+    float f2 = (float) h2;
+    float f3 = (float) h3;
+    if (nhist == 2) return (float) (2.0f*f1 - f2);
+    return (float) (3.0f*f1 - 3.0f*f2 + f3);
+  }
+  if (nhist == 2) return 2.0*h1 - h2;
+  return 3.0*h1 - 3.0*h2 + h3;
+}
+
+// residual of value v against the prediction, *hist = new history value
+
+static inline uint64_t traj_residual(int quant, double scale, double v,
+                                     double pred, double *hist)
+{
+  if (quant == TRAJ_FLOAT32) {
+    float f = (float) v;
+    float fp = (float) pred;
+    uint32_t a,b;
+    memcpy(&a,&f,sizeof(float));
+    memcpy(&b,&fp,sizeof(float));
+    *hist = f;
+    return a ^ b;
+  }
+  if (quant == TRAJ_FIXED) {
+    double q = v / scale;
+    if (!(q > -4.0e15)) q = -4.0e15;
+    if (q > 4.0e15) q = 4.0e15;
+    int64_t d = llround(q) - (int64_t) pred;
+    *hist = (double) llround(q);
+    return ((uint64_t) d << 1) ^ (uint64_t) (d >> 63);
+  }
+  uint64_t a,b;
+  memcpy(&a,&v,sizeof(double));
+  memcpy(&b,&pred,sizeof(double));
+  *hist = v;
+  return a ^ b;
+}
+
+// inverse of traj_residual(), returns the new history value
+
+static inline double traj_restore(int quant, uint64_t r, double pred)
+{
+  if (quant == TRAJ_FLOAT32) {
+    float fp = (float) pred;
+    uint32_t b;
+    memcpy(&b,&fp,sizeof(float));
+    b ^= (uint32_t) r;
+    float f;
+    memcpy(&f,&b,sizeof(float));
+    return f;
+  }
+  if (quant == TRAJ_FIXED) {
+    int64_t d = (int64_t) (r >> 1) ^ -(int64_t) (r & 1);
+    return (double) ((int64_t) pred + d);
+  }
+  uint64_t b;
+  memcpy(&b,&pred,sizeof(double));
+  b ^= r;
+  double v;
+  memcpy(&v,&b,sizeof(double));
+  return v;
+}
+
+// value of a history entry in the units of the field
+
+static inline double traj_value(int quant, double scale, double hist)
+{
+  if (quant == TRAJ_FIXED) return hist * scale;
+  return hist;
+}
+
+#endif
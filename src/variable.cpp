@@ -24,6 +24,9 @@
 #include "ensemble.h"
 #include "compute.h"
 #include "modify.h"
+#include "table.h"
+#include "muse.h"
+#include "body.h"
 
 using namespace MUSE_NS;
 
@@ -38,7 +41,7 @@ using namespace MUSE_NS;
 #define MYROUND(a) (( a-floor(a) ) >= .5) ? ceil(a) : floor(a)
 
 enum{INDEX,LOOP,WORLD,UNIVERSE,ULOOP,STRING,GETENV,
-     SCALARFILE,FORMAT,EQUAL,PARTICLE,GRID,SURF,INTERNAL};
+     SCALARFILE,FORMAT,EQUAL,PARTICLE,GRID,SURF,INTERNAL,TABLE,BODY};
 enum{ARG,OP};
 
 // customize by adding a function
@@ -50,12 +53,24 @@ enum{DONE,ADD,SUBTRACT,MULTIPLY,DIVIDE,CARAT,MODULO,UNARY,
      SQRT,EXP,LN,LOG,ABS,SIN,COS,TAN,ASIN,ACOS,ATAN,ATAN2,
      RANDOM,NORMAL,CEIL,FLOOR,ROUND,RAMP,STAGGER,LOGFREQ,STRIDE,
      VDISPLACE,SWIGGLE,CWIGGLE,
-     VALUE,ARRAY,PARTARRAYDOUBLE,PARTARRAYINT,SPECARRAY};
+     VALUE,ARRAY,PARTARRAYDOUBLE,PARTARRAYINT,SPECARRAY,VARIABLE,VECFUNC,
+     BODYFIELD,BODYFUNC};
+
+// per-body fields in body-style formulas
+// customize by adding a body field, see body_field() and gather()
+
+enum{BMASS,BX,BY,BZ,BQ1,BQ2,BQ3,BQ4,BVX,BVY,BVZ,BWX,BWY,BWZ,
+     BIXX,BIYY,BIZZ,BIXY,BIXZ,BIYZ,NBODYFIELD};
+static const char *bodyfield[NBODYFIELD] =
+  {"mass","x","y","z","q1","q2","q3","q4","vx","vy","vz","wx","wy","wz",
+   "ixx","iyy","izz","ixy","ixz","iyz"};
 
 // customize by adding a special function
 
 enum{SUM,XMIN,XMAX,AVE,TRAP,SLOPE};
 
+#define LOCKFILE "tmp.muse.variable"
+
 #define INVOKED_SCALAR 1
 #define INVOKED_VECTOR 2
 #define INVOKED_ARRAY 4
@@ -83,6 +98,11 @@ Variable::Variable(MUSE *muse) : Pointers(muse)
 
   eval_in_progress = NULL;
 
+  program = NULL;
+  generation = 0;
+  nocompile = 0;
+  treestyle = EQUAL;
+
   randomequal = NULL;
   randomparticle = NULL;
 
@@ -114,6 +134,7 @@ Variable::~Variable()
     if (style[i] == LOOP || style[i] == ULOOP) delete [] data[i][0];
     else for (int j = 0; j < num[i]; j++) delete [] data[i][j];
     delete [] data[i];
+    free_program(i);
   }
   memory->sfree(names);
   memory->destroy(style);
@@ -125,6 +146,7 @@ Variable::~Variable()
   memory->sfree(dvalue);
 
   memory->destroy(eval_in_progress);
+  memory->sfree(program);
 
   delete randomequal;
   delete randomparticle;
@@ -201,6 +223,74 @@ void Variable::set(int narg, char **arg)
     data[nvar] = new char*[1];
     data[nvar][0] = NULL;
 
+  // WORLD
+  // num = listed args, which = partition this proc is in, data = copied args
+  // error check that num = # of simulations in universe
+
+  } else if (strcmp(arg[1],"world") == 0) {
+    if (narg < 3) error->all(FLERR,"Illegal variable command");
+    if (find(arg[0]) >= 0) return;
+    if (nvar == maxvar) grow();
+    style[nvar] = WORLD;
+    num[nvar] = narg - 2;
+    if (num[nvar] != ensemble->nSim)
+      error->all(FLERR,"World variable count doesn't match # of partitions");
+    which[nvar] = ensemble->iSim;
+    pad[nvar] = 0;
+    data[nvar] = new char*[num[nvar]];
+    copy(num[nvar],&arg[2],data[nvar]);
+
+  // UNIVERSE and ULOOP
+  // for UNIVERSE: num = listed args, data = copied args
+  // for ULOOP: num = N, data = single string
+  // which = partition this proc is in
+  // universe proc 0 creates lock file
+  // error check that all other universe/uloop variables are same length
+
+  } else if (strcmp(arg[1],"universe") == 0 || strcmp(arg[1],"uloop") == 0) {
+    if (strcmp(arg[1],"universe") == 0) {
+      if (narg < 3) error->all(FLERR,"Illegal variable command");
+      if (find(arg[0]) >= 0) return;
+      if (nvar == maxvar) grow();
+      style[nvar] = UNIVERSE;
+      num[nvar] = narg - 2;
+      pad[nvar] = 0;
+      data[nvar] = new char*[num[nvar]];
+      copy(num[nvar],&arg[2],data[nvar]);
+    } else {
+      if (narg != 3 && (narg != 4 || strcmp(arg[3],"pad") != 0))
+        error->all(FLERR,"Illegal variable command");
+      if (find(arg[0]) >= 0) return;
+      if (nvar == maxvar) grow();
+      style[nvar] = ULOOP;
+      num[nvar] = atoi(arg[2]);
+      if (num[nvar] <= 0) error->all(FLERR,"Illegal variable command");
+      if (narg == 4) {
+        char digits[12];
+        sprintf(digits,"%d",num[nvar]);
+        pad[nvar] = strlen(digits);
+      } else pad[nvar] = 0;
+      data[nvar] = new char*[1];
+      data[nvar][0] = NULL;
+    }
+
+    if (num[nvar] < ensemble->nSim)
+      error->all(FLERR,"Universe/uloop variable count < # of partitions");
+    which[nvar] = ensemble->iSim;
+
+    if (ensemble->me == 0) {
+      FILE *fp = fopen(LOCKFILE,"w");
+      if (fp == NULL) error->one(FLERR,"Cannot open universe variable file");
+      fprintf(fp,"%d\n",ensemble->nSim);
+      fclose(fp);
+    }
+
+    for (int jvar = 0; jvar < nvar; jvar++)
+      if ((style[jvar] == UNIVERSE || style[jvar] == ULOOP) &&
+          num[nvar] != num[jvar])
+        error->all(FLERR,
+                   "All universe/uloop variables must have same # of values");
+
 
   } else if (strcmp(arg[1],"string") == 0) {
     if (narg != 3) error->all(FLERR,"Illegal variable command");
@@ -293,6 +383,7 @@ void Variable::set(int narg, char **arg)
 	error->all(FLERR,"Cannot redefine variable as a different style");
       delete [] data[ivar][0];
       copy(1,&arg[2],data[ivar]);
+      free_program(ivar);
       replaceflag = 1;
     } else {
       if (nvar == maxvar) grow();
@@ -329,6 +420,58 @@ void Variable::set(int narg, char **arg)
       dvalue[nvar] = input->numeric(FLERR,arg[2]);
     }
 
+  // TABLE
+  // replace pre-existing var if also style TABLE (allows it to be reset)
+  // num = 3, which = 1st value
+  // data = 3 values, table ID, column, 3rd is filled on retrieval
+
+  } else if (strcmp(arg[1],"table") == 0) {
+    if (narg != 4) error->all(FLERR,"Illegal variable command");
+    int ivar = find(arg[0]);
+    if (ivar >= 0) {
+      if (style[ivar] != TABLE)
+        error->all(FLERR,"Cannot redefine variable as a different style");
+      delete [] data[ivar][0];
+      delete [] data[ivar][1];
+      copy(2,&arg[2],data[ivar]);
+      replaceflag = 1;
+    } else {
+      if (nvar == maxvar) grow();
+      style[nvar] = TABLE;
+      num[nvar] = 3;
+      which[nvar] = 0;
+      pad[nvar] = 0;
+      data[nvar] = new char*[num[nvar]];
+      copy(2,&arg[2],data[nvar]);
+      data[nvar][2] = new char[VALUELENGTH];
+      strcpy(data[nvar][2],"(undefined)");
+    }
+
+  // BODY
+  // replace pre-existing var if also style BODY (allows it to be reset)
+  // num = 1, which = 1st value
+  // data = 1 value, string to eval for every body
+
+  } else if (strcmp(arg[1],"body") == 0) {
+    if (narg != 3) error->all(FLERR,"Illegal variable command");
+    int ivar = find(arg[0]);
+    if (ivar >= 0) {
+      if (style[ivar] != BODY)
+        error->all(FLERR,"Cannot redefine variable as a different style");
+      delete [] data[ivar][0];
+      copy(1,&arg[2],data[ivar]);
+      free_program(ivar);
+      replaceflag = 1;
+    } else {
+      if (nvar == maxvar) grow();
+      style[nvar] = BODY;
+      num[nvar] = 1;
+      which[nvar] = 0;
+      pad[nvar] = 0;
+      data[nvar] = new char*[num[nvar]];
+      copy(1,&arg[2],data[nvar]);
+    }
+
   } else error->all(FLERR,"Illegal variable command");
 
   // set name of variable, if not replacing one flagged with replaceflag
@@ -387,11 +530,12 @@ int Variable::next(int narg, char **arg)
   }
 
   // invalid styles: STRING, EQUAL, WORLD, PARTICLE, GRID, GETENV,
-  //                 FORMAT, INTERNAL
+  //                 FORMAT, INTERNAL, TABLE
 
   int istyle = style[find(arg[0])];
   if (istyle == STRING || istyle == EQUAL  || istyle == WORLD ||
-      istyle == GETENV || istyle == FORMAT || istyle == INTERNAL)
+      istyle == GETENV || istyle == FORMAT || istyle == INTERNAL ||
+      istyle == TABLE)
     error->all(FLERR,"Invalid variable style with next command");
 
 
@@ -421,7 +565,57 @@ int Variable::next(int narg, char **arg)
       }
     }
 
-  } 
+  // UNIVERSE and ULOOP act as a work queue shared by all partitions
+  // the lock file holds the next unclaimed index, a partition claims it
+  // by renaming the file away, so a faster partition claims more cases
+  // wait a random fraction of a second between tries to spread contention
+  // the claimed index is broadcast within my partition
+
+  } else if (istyle == UNIVERSE || istyle == ULOOP) {
+
+    int nextindex = -1;
+    if (me == 0) {
+      RanMars *random = new RanMars(muse);
+      random->init(12345 + ensemble->me + which[find(arg[0])]);
+      while (1) {
+        int delay = (int) (1000000*random->uniform());
+#ifdef _WIN32
+        Sleep(delay/1000);
+#else
+        usleep(delay);
+#endif
+        if (!rename(LOCKFILE,LOCKFILE ".lock")) break;
+      }
+      delete random;
+
+      FILE *fp = fopen(LOCKFILE ".lock","r");
+      if (fp == NULL || fscanf(fp,"%d",&nextindex) != 1)
+        error->one(FLERR,"Cannot read universe variable file");
+      fclose(fp);
+      fp = fopen(LOCKFILE ".lock","w");
+      fprintf(fp,"%d\n",nextindex+1);
+      fclose(fp);
+      rename(LOCKFILE ".lock",LOCKFILE);
+
+      if (ensemble->uscreen)
+        fprintf(ensemble->uscreen,"Increment via next: value %d on partition %d\n",
+                nextindex+1,ensemble->iSim);
+    }
+    MPI_Bcast(&nextindex,1,MPI_INT,0,world);
+
+    // set all variables in list to nextindex
+    // must increment all UNIVERSE and ULOOP variables here
+    // error check above tested for this
+
+    for (int iarg = 0; iarg < narg; iarg++) {
+      ivar = find(arg[iarg]);
+      which[ivar] = nextindex;
+      if (which[ivar] >= num[ivar]) {
+        flag = 1;
+        remove(ivar);
+      }
+    }
+  }
 
   return flag;
 }
@@ -436,6 +630,7 @@ int Variable::next(int narg, char **arg)
    if GETENV var, query environment and put result in str
    if PARTICLE or GRID var, return NULL
    if INTERNAL, convert dvalue and put result in str
+   if TABLE, interpolate its table column and put result in str
    return NULL if no variable with name or which value is bad,
      caller must respond
 ------------------------------------------------------------------------- */
@@ -465,7 +660,7 @@ char *Variable::retrieve(char *name)
     strcpy(data[ivar][0],result);
     str = data[ivar][0];
   } else if (style[ivar] == EQUAL) {
-    double answer = evaluate(data[ivar][0],NULL);
+    double answer = compute_equal(ivar);
     sprintf(data[ivar][1],"%.15g",answer);
     str = data[ivar][1];
   } else if (style[ivar] == FORMAT) {
@@ -488,14 +683,20 @@ char *Variable::retrieve(char *name)
   } else if (style[ivar] == INTERNAL) {
     sprintf(data[ivar][0],"%.15g",dvalue[ivar]);
     str = data[ivar][0];
-  } else if (style[ivar] == PARTICLE || style[ivar] == GRID) return NULL;
+  } else if (style[ivar] == TABLE) {
+    sprintf(data[ivar][2],"%.15g",table_value(ivar));
+    str = data[ivar][2];
+  } else if (style[ivar] == PARTICLE || style[ivar] == GRID ||
+             style[ivar] == BODY) return NULL;
 
   return str;
 }
 
 /* ----------------------------------------------------------------------
    return result of equal-style variable evaluation
-   can be EQUAL or INTERNAL style
+   can be EQUAL or INTERNAL or TABLE style
+   EQUAL formulas are compiled on first use and run as a postfix program,
+     recompiled when redefined or when variable indices have shifted
 ------------------------------------------------------------------------- */
 
 double Variable::compute_equal(int ivar)
@@ -506,13 +707,41 @@ double Variable::compute_equal(int ivar)
   eval_in_progress[ivar] = 1;
 
   double value;
-  if (style[ivar] == EQUAL) value = evaluate(data[ivar][0],NULL);
+  if (style[ivar] == EQUAL) {
+    if (program[ivar] == NULL || program[ivar]->generation != generation)
+      compile(ivar);
+    if (program[ivar]->interpret) value = evaluate(data[ivar][0],NULL);
+    else value = execute(program[ivar]);
+  }
   else if (style[ivar] == INTERNAL) value = dvalue[ivar];
+  else if (style[ivar] == TABLE) value = table_value(ivar);
 
   eval_in_progress[ivar] = 0;
   return value;
 }
 
+/* ----------------------------------------------------------------------
+   return result of body-style variable evaluation, one value per body
+   in the order of MUSE::body, valid until the next evaluation of ivar
+   the compiled program runs once over all bodies, see execute_body()
+------------------------------------------------------------------------- */
+
+double *Variable::compute_body(int ivar)
+{
+  if (eval_in_progress[ivar])
+    error->all(FLERR,"Variable has circular dependency");
+  eval_in_progress[ivar] = 1;
+
+  if (program[ivar] == NULL || program[ivar]->generation != generation)
+    compile(ivar);
+  if (program[ivar]->interpret)
+    error->all(FLERR,"Body-style variable formula cannot use next()");
+  execute_body(program[ivar]);
+
+  eval_in_progress[ivar] = 0;
+  return program[ivar]->result;
+}
+
 /* ----------------------------------------------------------------------
    return result of immediate equal-style variable evaluation
    called from Input::substitute()
@@ -523,6 +752,20 @@ double Variable::compute_equal(char *str)
   return evaluate(str,NULL);
 }
 
+/* ----------------------------------------------------------------------
+   value of TABLE style ivar: its table column at the current time
+------------------------------------------------------------------------- */
+
+double Variable::table_value(int ivar)
+{
+  int itable = modify->find_table(data[ivar][0]);
+  if (itable < 0) error->all(FLERR,"Could not find table ID for variable");
+  Table *t = modify->table[itable];
+  int icol = t->find_column(data[ivar][1]);
+  if (icol < 0) error->all(FLERR,"Variable table column does not exist");
+  return t->value(icol,muse->system->timenow);
+}
+
 /* ----------------------------------------------------------------------
    set value stored by INTERNAL style ivar
 ------------------------------------------------------------------------- */
@@ -545,12 +788,23 @@ int Variable::find(char *name)
 }
 
 /* ----------------------------------------------------------------------
-   return 1 if variable is EQUAL or INTERNAL style, 0 if not
+   return 1 if variable is EQUAL or INTERNAL or TABLE style, 0 if not
 ------------------------------------------------------------------------- */
 
 int Variable::equal_style(int ivar)
 {
-  if (style[ivar] == EQUAL || style[ivar] == INTERNAL) return 1;
+  if (style[ivar] == EQUAL || style[ivar] == INTERNAL ||
+      style[ivar] == TABLE) return 1;
+  return 0;
+}
+
+/* ----------------------------------------------------------------------
+   return 1 if variable is BODY style, 0 if not
+------------------------------------------------------------------------- */
+
+int Variable::body_style(int ivar)
+{
+  if (style[ivar] == BODY) return 1;
   return 0;
 }
 
@@ -577,6 +831,7 @@ void Variable::remove(int n)
   else for (int i = 0; i < num[n]; i++) delete [] data[n][i];
   delete [] data[n];
   delete reader[n];
+  free_program(n);
 
   for (int i = n+1; i < nvar; i++) {
     names[i-1] = names[i];
@@ -586,8 +841,14 @@ void Variable::remove(int n)
     pad[i-1] = pad[i];
     reader[i-1] = reader[i];
     data[i-1] = data[i];
+    program[i-1] = program[i];
   }
   nvar--;
+  program[nvar] = NULL;
+
+  // compiled programs refer to variables by index
+
+  generation++;
 }
 
 /* ----------------------------------------------------------------------
@@ -611,6 +872,10 @@ void Variable::grow()
   data = (char ***) memory->srealloc(data,maxvar*sizeof(char **),"var:data");
   memory->grow(dvalue,maxvar,"var:dvalue");
 
+  program = (Program **)
+    memory->srealloc(program,maxvar*sizeof(Program *),"var:program");
+  for (int i = old; i < maxvar; i++) program[i] = NULL;
+
   memory->grow(eval_in_progress,maxvar,"var:eval_in_progress");
   for (int i = 0; i < maxvar; i++) eval_in_progress[i] = 0;
 }
@@ -673,8 +938,7 @@ double Variable::evaluate(char *str, Tree **tree)
     onechar = str[i];
 
     // whitespace: just skip
-    std::locale::global(std::locale(""));//�޸�isspace��������
-    if (isspace(onechar)) i++;
+    if (isspace((unsigned char) onechar)) i++;
 
     // ----------------
     // parentheses: recursively evaluate contents of parens
@@ -702,7 +966,7 @@ double Variable::evaluate(char *str, Tree **tree)
     // number: push value onto stack
     // ----------------
 
-    } else if (isdigit(onechar) || onechar == '.') {
+    } else if (isdigit((unsigned char) onechar) || onechar == '.') {
       if (expect == OP) error->all(FLERR,"Invalid syntax in variable formula");
       expect = OP;
 
@@ -737,7 +1001,7 @@ double Variable::evaluate(char *str, Tree **tree)
     //         v_name, exp(), x, PI, vol
     // ----------------
 
-    } else if (isalpha(onechar)) {
+    } else if (isalpha((unsigned char) onechar)) {
       if (expect == OP) error->all(FLERR,"Invalid syntax in variable formula");
       expect = OP;
 
@@ -773,20 +1037,61 @@ double Variable::evaluate(char *str, Tree **tree)
 	// nbracket = # of bracket pairs
 
 	int nbracket;
+	int index = 0;
 	if (str[i] != '[') nbracket = 0;
 	else {
 	  nbracket = 1;
 	  ptr = &str[i];
-	  int_between_brackets(ptr,1);
+	  index = int_between_brackets(ptr,1);
 	  i = ptr-str+1;
 	}
 
-        // v_name = scalar from internal-style variable
+        // per-body values only in body-style formulas, or one of them
+
+        if (nbracket == 0 && style[ivar] == BODY &&
+            (tree == NULL || treestyle != BODY))
+          error->all(FLERR,"Per-body variable in "
+                     "non body-style variable formula");
+        if (nbracket && style[ivar] == BODY && index > muse->nBodies)
+          error->all(FLERR,"Variable formula body-style variable "
+                     "is accessed out-of-range");
+
+        // v_name or v_name[i] of body-style in a compiled formula
+        // resolved to its index, its value is taken when the program runs
+
+        if (tree && (treestyle == EQUAL || treestyle == BODY) &&
+            ((nbracket == 0 && style[ivar] != PARTICLE &&
+              style[ivar] != GRID) ||
+             (nbracket && style[ivar] == BODY))) {
+
+          Tree *newtree = new Tree();
+          newtree->type = VARIABLE;
+          newtree->ivalue1 = ivar;
+          newtree->ivalue2 = nbracket ? index : 0;
+          newtree->left = newtree->middle = newtree->right = NULL;
+          treestack[ntreestack++] = newtree;
+
+        // v_name[i] = value of body I from body-style variable
+
+        } else if (nbracket && style[ivar] == BODY) {
+
+          value1 = compute_body(ivar)[index-1];
+          if (tree) {
+            Tree *newtree = new Tree();
+            newtree->type = VALUE;
+            newtree->value = value1;
+            newtree->left = newtree->middle = newtree->right = NULL;
+            treestack[ntreestack++] = newtree;
+          } else argstack[nargstack++] = value1;
+
+        // v_name = scalar from internal-style or table-style variable
         // access value directly
 
-        if (nbracket == 0 && style[ivar] == INTERNAL) {
+        } else if (nbracket == 0 && (style[ivar] == INTERNAL ||
+                                     style[ivar] == TABLE)) {
 
-          value1 = dvalue[ivar];
+          if (style[ivar] == INTERNAL) value1 = dvalue[ivar];
+          else value1 = table_value(ivar);
           if (tree) {
             Tree *newtree = new Tree();
             newtree->type = VALUE;
@@ -867,6 +1172,19 @@ double Variable::evaluate(char *str, Tree **tree)
 	// particle vector
 	// ----------------
 
+	// ----------------
+	// body field
+	// ----------------
+
+	} else if (body_field(word) >= 0) {
+	  if (tree == NULL || treestyle != BODY)
+	    error->all(FLERR,"Body field in non body-style variable formula");
+	  Tree *newtree = new Tree();
+	  newtree->type = BODYFIELD;
+	  newtree->ivalue1 = body_field(word);
+	  newtree->left = newtree->middle = newtree->right = NULL;
+	  treestack[ntreestack++] = newtree;
+
 	} else if (is_constant(word)) {
 	  value1 = constant(word);
 	  if (tree) {
@@ -951,7 +1269,7 @@ double Variable::evaluate(char *str, Tree **tree)
 	if (tree) {
 	  Tree *newtree = new Tree();
 	  newtree->type = opprevious;
-	  if (opprevious == UNARY) {
+	  if (opprevious == UNARY || opprevious == NOT) {
 	    newtree->left = treestack[--ntreestack];
 	    newtree->middle = newtree->right = NULL;
 	  } else {
@@ -1551,9 +1869,555 @@ void Variable::free_tree(Tree *tree)
   if (tree->left) free_tree(tree->left);
   if (tree->middle) free_tree(tree->middle);
   if (tree->right) free_tree(tree->right);
+  delete [] tree->id;
   delete tree;
 }
 
+/* ----------------------------------------------------------------------
+   compile the formula of EQUAL style ivar into a postfix program
+   the formula is parsed once into a tree by evaluate(), the tree is
+     flattened with constant sub-expressions folded
+   variable references become indices, compute references are resolved
+     by ID and checked each time the program runs
+------------------------------------------------------------------------- */
+
+void Variable::compile(int ivar)
+{
+  free_program(ivar);
+  Program *p = new Program();
+  p->generation = generation;
+
+  int saved = treestyle;
+  if (style[ivar] == BODY) treestyle = BODY;
+  else treestyle = EQUAL;
+  nocompile = 0;
+  Tree *tree;
+  evaluate(data[ivar][0],&tree);
+  treestyle = saved;
+
+  if (nocompile) p->interpret = 1;
+  else {
+    int sp = 0;
+    emit(tree,p,sp);
+    if (style[ivar] != BODY)
+      memory->create(p->stack,p->depth,"var:stack");
+  }
+  free_tree(tree);
+
+  program[ivar] = p;
+}
+
+/* ----------------------------------------------------------------------
+   append the postfix code of tree to program p
+   sp = stack depth reached so far, an operation whose arguments are all
+     constants is done now and replaced by its VALUE
+------------------------------------------------------------------------- */
+
+void Variable::emit(Tree *tree, Program *p, int &sp)
+{
+  Instr c;
+  memset(&c,0,sizeof(Instr));
+  c.op = tree->type;
+
+  if (tree->type == VALUE) {
+    c.value = tree->value;
+  } else if (tree->type == VARIABLE) {
+    c.index = tree->ivalue1;
+    c.column = tree->ivalue2;
+  } else if (tree->type == BODYFIELD) {
+    c.index = tree->ivalue1;
+  } else if (tree->type == BODYFUNC) {
+    c.method = tree->ivalue1;
+    c.index = find(tree->id);
+    c.id = new char[strlen(tree->id)+1];
+    strcpy(c.id,tree->id);
+  } else if (tree->type == VECFUNC) {
+    c.method = tree->ivalue1;
+    c.column = tree->ivalue2;
+    c.index = modify->find_compute(tree->id);
+    c.id = new char[strlen(tree->id)+1];
+    strcpy(c.id,tree->id);
+  } else {
+    c.narg = arity(tree->type);
+    if (c.narg == 0) error->all(FLERR,"Invalid syntax in variable formula");
+    if (tree->left) emit(tree->left,p,sp);
+    if (tree->middle) emit(tree->middle,p,sp);
+    if (tree->right) emit(tree->right,p,sp);
+
+    int fold = (c.op != RANDOM && c.op != NORMAL && p->ncode >= c.narg);
+    for (int k = p->ncode - c.narg; fold && k < p->ncode; k++)
+      if (p->code[k].op != VALUE) fold = 0;
+
+    if (fold) {
+      double arg[2];
+      for (int k = 0; k < c.narg; k++)
+        arg[k] = p->code[p->ncode - c.narg + k].value;
+      p->ncode -= c.narg;
+      sp -= c.narg;
+      c.op = VALUE;
+      c.value = apply(tree->type,arg);
+      c.narg = 0;
+    } else {
+      sp -= c.narg;
+      add_instr(p,c);
+      sp++;
+      return;
+    }
+  }
+
+  add_instr(p,c);
+  sp++;
+  if (sp > p->depth) p->depth = sp;
+}
+
+/* ---------------------------------------------------------------------- */
+
+void Variable::add_instr(Program *p, Instr &c)
+{
+  if (p->ncode == p->maxcode) {
+    p->maxcode = p->maxcode ? 2*p->maxcode : 16;
+    p->code = (Instr *)
+      memory->srealloc(p->code,p->maxcode*sizeof(Instr),"var:code");
+  }
+  p->code[p->ncode++] = c;
+}
+
+/* ---------------------------------------------------------------------- */
+
+void Variable::free_program(int ivar)
+{
+  Program *p = program[ivar];
+  if (p == NULL) return;
+  for (int k = 0; k < p->ncode; k++) delete [] p->code[k].id;
+  memory->sfree(p->code);
+  memory->destroy(p->stack);
+  memory->destroy(p->result);
+  delete p;
+  program[ivar] = NULL;
+}
+
+/* ----------------------------------------------------------------------
+   run a compiled program on its own stack and return its value
+   a program never runs inside itself, see eval_in_progress
+------------------------------------------------------------------------- */
+
+double Variable::execute(Program *p)
+{
+  double *stack = p->stack;
+  int sp = 0;
+
+  for (int k = 0; k < p->ncode; k++) {
+    Instr *c = &p->code[k];
+    if (c->op == VALUE) stack[sp++] = c->value;
+    else if (c->op == VARIABLE)
+      stack[sp++] = variable_value(c->index,c->column);
+    else if (c->op == BODYFUNC) stack[sp++] = reduce_body(c);
+    else if (c->op == VECFUNC) {
+      if (c->index < 0 || c->index >= modify->ncompute ||
+          strcmp(modify->compute[c->index]->name,c->id) != 0) {
+        c->index = modify->find_compute(c->id);
+        if (c->index < 0)
+          error->all(FLERR,"Invalid compute ID in variable formula");
+      }
+      stack[sp++] = reduce_compute(c->method,modify->compute[c->index],
+                                   c->column);
+    } else if (c->op == RANDOM || c->op == NORMAL) {
+      double value1 = stack[sp-2];
+      double value2 = stack[sp-1];
+      sp -= 2;
+      if (c->op == NORMAL && value2 < 0.0)
+        error->all(FLERR,"Invalid math function in variable formula");
+      if (randomequal == NULL) {
+        randomequal = new RanPark(ensemble->ranmaster->uniform());
+        double seed = ensemble->ranmaster->uniform();
+        randomequal->reset(seed,me,100);
+      }
+      if (c->op == RANDOM)
+        stack[sp++] = randomequal->uniform()*(value2-value1) + value1;
+      else stack[sp++] = value1 + value2*randomequal->gaussian();
+    } else {
+      sp -= c->narg;
+      stack[sp] = apply(c->op,&stack[sp]);
+      sp++;
+    }
+  }
+
+  return stack[0];
+}
+
+/* ----------------------------------------------------------------------
+   run a compiled body-style program over all bodies at once
+   every stack entry is a vector of nbody values, each instruction is one
+     loop over them, body fields are gathered into contiguous vectors
+   result = one value per body in the order of MUSE::body
+------------------------------------------------------------------------- */
+
+void Variable::execute_body(Program *p)
+{
+  int n = muse->nBodies;
+  if (n > p->maxbody) {
+    p->maxbody = n;
+    memory->destroy(p->stack);
+    memory->destroy(p->result);
+    memory->create(p->stack,p->depth*n,"var:stack");
+    memory->create(p->result,n,"var:result");
+  }
+
+  double *stack = p->stack;
+  int sp = 0;
+
+  for (int k = 0; k < p->ncode; k++) {
+    Instr *c = &p->code[k];
+    double *top = &stack[sp*n];
+
+    if (c->op == VALUE) {
+      double value = c->value;
+      for (int i = 0; i < n; i++) top[i] = value;
+      sp++;
+    } else if (c->op == BODYFIELD) {
+      gather(c->index,top);
+      sp++;
+    } else if (c->op == VARIABLE && style[c->index] == BODY &&
+               c->column == 0) {
+      double *vec = compute_body(c->index);
+      memcpy(top,vec,n*sizeof(double));
+      sp++;
+    } else if (c->op == VARIABLE || c->op == VECFUNC || c->op == BODYFUNC) {
+      double value;
+      if (c->op == VARIABLE) value = variable_value(c->index,c->column);
+      else if (c->op == BODYFUNC) value = reduce_body(c);
+      else {
+        if (c->index < 0 || c->index >= modify->ncompute ||
+            strcmp(modify->compute[c->index]->name,c->id) != 0) {
+          c->index = modify->find_compute(c->id);
+          if (c->index < 0)
+            error->all(FLERR,"Invalid compute ID in variable formula");
+        }
+        value = reduce_compute(c->method,modify->compute[c->index],
+                               c->column);
+      }
+      for (int i = 0; i < n; i++) top[i] = value;
+      sp++;
+    } else if (c->op == RANDOM || c->op == NORMAL) {
+      double *a = &stack[(sp-2)*n];
+      double *b = &stack[(sp-1)*n];
+      if (randomequal == NULL) {
+        randomequal = new RanPark(ensemble->ranmaster->uniform());
+        double seed = ensemble->ranmaster->uniform();
+        randomequal->reset(seed,me,100);
+      }
+      for (int i = 0; i < n; i++) {
+        if (c->op == RANDOM)
+          a[i] = randomequal->uniform()*(b[i]-a[i]) + a[i];
+        else {
+          if (b[i] < 0.0)
+            error->all(FLERR,"Invalid math function in variable formula");
+          a[i] = a[i] + b[i]*randomequal->gaussian();
+        }
+      }
+      sp--;
+    } else {
+      sp -= c->narg;
+      if (c->narg == 2) apply_vector(c->op,&stack[sp*n],&stack[(sp+1)*n],n);
+      else apply_vector(c->op,&stack[sp*n],NULL,n);
+      sp++;
+    }
+  }
+
+  memcpy(p->result,stack,n*sizeof(double));
+}
+
+/* ----------------------------------------------------------------------
+   a = op(a,b) for n values, b = NULL for operations of one argument
+   same results and errors as apply()
+------------------------------------------------------------------------- */
+
+void Variable::apply_vector(int op, double *a, double *b, int n)
+{
+  int i;
+
+  switch (op) {
+  case ADD: for (i = 0; i < n; i++) a[i] += b[i]; return;
+  case SUBTRACT: for (i = 0; i < n; i++) a[i] -= b[i]; return;
+  case MULTIPLY: for (i = 0; i < n; i++) a[i] *= b[i]; return;
+  case UNARY: for (i = 0; i < n; i++) a[i] = -a[i]; return;
+  case SQRT:
+    for (i = 0; i < n; i++)
+      if (a[i] < 0.0)
+        error->all(FLERR,"Sqrt of negative value in variable formula");
+    for (i = 0; i < n; i++) a[i] = sqrt(a[i]);
+    return;
+  case EXP: for (i = 0; i < n; i++) a[i] = exp(a[i]); return;
+  case ABS: for (i = 0; i < n; i++) a[i] = fabs(a[i]); return;
+  case SIN: for (i = 0; i < n; i++) a[i] = sin(a[i]); return;
+  case COS: for (i = 0; i < n; i++) a[i] = cos(a[i]); return;
+  case ATAN2: for (i = 0; i < n; i++) a[i] = atan2(a[i],b[i]); return;
+  }
+
+  // remaining operations go value by value
+
+  double arg[2];
+  for (i = 0; i < n; i++) {
+    arg[0] = a[i];
+    arg[1] = b ? b[i] : 0.0;
+    a[i] = apply(op,arg);
+  }
+}
+
+/* ----------------------------------------------------------------------
+   copy field of every body into vec
+------------------------------------------------------------------------- */
+
+void Variable::gather(int field, double *vec)
+{
+  int n = muse->nBodies;
+  Body **body = muse->body;
+
+  switch (field) {
+  case BMASS: for (int i = 0; i < n; i++) vec[i] = body[i]->mass; break;
+  case BX: for (int i = 0; i < n; i++) vec[i] = body[i]->pos[0]; break;
+  case BY: for (int i = 0; i < n; i++) vec[i] = body[i]->pos[1]; break;
+  case BZ: for (int i = 0; i < n; i++) vec[i] = body[i]->pos[2]; break;
+  case BQ1: for (int i = 0; i < n; i++) vec[i] = body[i]->quat[0]; break;
+  case BQ2: for (int i = 0; i < n; i++) vec[i] = body[i]->quat[1]; break;
+  case BQ3: for (int i = 0; i < n; i++) vec[i] = body[i]->quat[2]; break;
+  case BQ4: for (int i = 0; i < n; i++) vec[i] = body[i]->quat[3]; break;
+  case BVX: for (int i = 0; i < n; i++) vec[i] = body[i]->vel[0]; break;
+  case BVY: for (int i = 0; i < n; i++) vec[i] = body[i]->vel[1]; break;
+  case BVZ: for (int i = 0; i < n; i++) vec[i] = body[i]->vel[2]; break;
+  case BWX: for (int i = 0; i < n; i++) vec[i] = body[i]->omega[0]; break;
+  case BWY: for (int i = 0; i < n; i++) vec[i] = body[i]->omega[1]; break;
+  case BWZ: for (int i = 0; i < n; i++) vec[i] = body[i]->omega[2]; break;
+  case BIXX:
+    for (int i = 0; i < n; i++) vec[i] = body[i]->inertia(0,0);
+    break;
+  case BIYY:
+    for (int i = 0; i < n; i++) vec[i] = body[i]->inertia(1,1);
+    break;
+  case BIZZ:
+    for (int i = 0; i < n; i++) vec[i] = body[i]->inertia(2,2);
+    break;
+  case BIXY:
+    for (int i = 0; i < n; i++) vec[i] = body[i]->inertia(0,1);
+    break;
+  case BIXZ:
+    for (int i = 0; i < n; i++) vec[i] = body[i]->inertia(0,2);
+    break;
+  case BIYZ:
+    for (int i = 0; i < n; i++) vec[i] = body[i]->inertia(1,2);
+    break;
+  }
+}
+
+/* ----------------------------------------------------------------------
+   reduce the values of the body-style variable in instruction c
+   its index is checked against its name as variables may be deleted
+------------------------------------------------------------------------- */
+
+double Variable::reduce_body(Instr *c)
+{
+  if (c->index < 0 || c->index >= nvar || strcmp(names[c->index],c->id) != 0)
+    c->index = find(c->id);
+  if (c->index < 0 || style[c->index] != BODY)
+    error->all(FLERR,"Invalid variable name in variable formula");
+  return reduce(c->method,compute_body(c->index),muse->nBodies,1);
+}
+
+/* ----------------------------------------------------------------------
+   result of operation op on its arguments
+   same results and errors as the string evaluation in evaluate()
+------------------------------------------------------------------------- */
+
+double Variable::apply(int op, double *arg)
+{
+  double value1 = arg[0];
+  double value2 = arg[1];
+
+  switch (op) {
+  case ADD: return value1 + value2;
+  case SUBTRACT: return value1 - value2;
+  case MULTIPLY: return value1 * value2;
+  case DIVIDE:
+    if (value2 == 0.0) error->one(FLERR,"Divide by 0 in variable formula");
+    return value1 / value2;
+  case MODULO:
+    if (value2 == 0.0) error->one(FLERR,"Modulo 0 in variable formula");
+    return fmod(value1,value2);
+  case CARAT:
+    if (value2 == 0.0) error->one(FLERR,"Power by 0 in variable formula");
+    return pow(value1,value2);
+  case UNARY: return -value1;
+  case NOT: return (value1 == 0.0) ? 1.0 : 0.0;
+  case EQ: return (value1 == value2) ? 1.0 : 0.0;
+  case NE: return (value1 != value2) ? 1.0 : 0.0;
+  case LT: return (value1 < value2) ? 1.0 : 0.0;
+  case LE: return (value1 <= value2) ? 1.0 : 0.0;
+  case GT: return (value1 > value2) ? 1.0 : 0.0;
+  case GE: return (value1 >= value2) ? 1.0 : 0.0;
+  case AND: return (value1 != 0.0 && value2 != 0.0) ? 1.0 : 0.0;
+  case OR: return (value1 != 0.0 || value2 != 0.0) ? 1.0 : 0.0;
+  case SQRT:
+    if (value1 < 0.0)
+      error->all(FLERR,"Sqrt of negative value in variable formula");
+    return sqrt(value1);
+  case EXP: return exp(value1);
+  case LN:
+    if (value1 <= 0.0)
+      error->all(FLERR,"Log of zero/negative value in variable formula");
+    return log(value1);
+  case LOG:
+    if (value1 <= 0.0)
+      error->all(FLERR,"Log of zero/negative value in variable formula");
+    return log10(value1);
+  case ABS: return fabs(value1);
+  case SIN: return sin(value1);
+  case COS: return cos(value1);
+  case TAN: return tan(value1);
+  case ASIN:
+    if (value1 < -1.0 || value1 > 1.0)
+      error->all(FLERR,"Arcsin of invalid value in variable formula");
+    return asin(value1);
+  case ACOS:
+    if (value1 < -1.0 || value1 > 1.0)
+      error->all(FLERR,"Arccos of invalid value in variable formula");
+    return acos(value1);
+  case ATAN: return atan(value1);
+  case ATAN2: return atan2(value1,value2);
+  case CEIL: return ceil(value1);
+  case FLOOR: return floor(value1);
+  case ROUND: return MYROUND(value1);
+  }
+  return 0.0;
+}
+
+/* ----------------------------------------------------------------------
+   # of arguments of operation op, 0 if it is not a compiled operation
+------------------------------------------------------------------------- */
+
+int Variable::arity(int op)
+{
+  switch (op) {
+  case UNARY: case NOT:
+  case SQRT: case EXP: case LN: case LOG: case ABS:
+  case SIN: case COS: case TAN: case ASIN: case ACOS: case ATAN:
+  case CEIL: case FLOOR: case ROUND:
+    return 1;
+  case ADD: case SUBTRACT: case MULTIPLY: case DIVIDE: case MODULO:
+  case CARAT: case EQ: case NE: case LT: case LE: case GT: case GE:
+  case AND: case OR: case ATAN2: case RANDOM: case NORMAL:
+    return 2;
+  }
+  return 0;
+}
+
+/* ----------------------------------------------------------------------
+   current value of variable ivar referenced as v_name in a formula
+   index = 1-based body of a body-style variable referenced as v_name[i]
+   equal-style variables are evaluated directly,
+     other styles through their string value
+------------------------------------------------------------------------- */
+
+double Variable::variable_value(int ivar, int index)
+{
+  if (style[ivar] == BODY) {
+    if (index > muse->nBodies)
+      error->all(FLERR,"Variable formula body-style variable "
+                 "is accessed out-of-range");
+    return compute_body(ivar)[index-1];
+  }
+  if (equal_style(ivar)) return compute_equal(ivar);
+
+  char *var = retrieve(names[ivar]);
+  if (var == NULL)
+    error->all(FLERR,"Invalid variable evaluation in variable formula");
+  return atof(var);
+}
+
+/* ----------------------------------------------------------------------
+   reduce a global vector or array column of compute to a single value
+   index = 0 for its vector, else 1-based column of its array
+   method = SUM,XMIN,XMAX,AVE,TRAP,SLOPE
+------------------------------------------------------------------------- */
+
+double Variable::reduce_compute(int method, Compute *compute, int index)
+{
+  int nvec,nstride;
+
+  if (index == 0 && compute->vector_flag) {
+    //FIXME: runflag
+    if (!(compute->invoked_flag & INVOKED_VECTOR)) {
+      compute->compute_vector();
+      compute->invoked_flag |= INVOKED_VECTOR;
+    }
+    nvec = compute->size_vector;
+    nstride = 1;
+  } else if (index && compute->array_flag) {
+    if (index > compute->size_array_cols)
+      error->all(FLERR,"Variable formula compute array "
+                 "is accessed out-of-range");
+    //FIXME: runflag
+    if (!(compute->invoked_flag & INVOKED_ARRAY)) {
+      compute->compute_array();
+      compute->invoked_flag |= INVOKED_ARRAY;
+    }
+    nvec = compute->size_array_rows;
+    nstride = compute->size_array_cols;
+  } else error->all(FLERR,"Mismatched compute in variable formula");
+
+  double *vec;
+  if (index) {
+    if (compute->array) vec = &compute->array[0][index-1];
+    else vec = NULL;
+  } else vec = compute->vector;
+
+  return reduce(method,vec,nvec,nstride);
+}
+
+/* ----------------------------------------------------------------------
+   reduce nvec values of vec, nstride apart, to a single value
+   method = SUM,XMIN,XMAX,AVE,TRAP,SLOPE
+------------------------------------------------------------------------- */
+
+double Variable::reduce(int method, double *vec, int nvec, int nstride)
+{
+  double value,xvalue,sx,sy,sxx,sxy;
+
+  value = 0.0;
+  if (method == SLOPE) sx = sy = sxx = sxy = 0.0;
+  if (method == XMIN) value = BIG;
+  if (method == XMAX) value = -BIG;
+
+  int j = 0;
+  for (int i = 0; i < nvec; i++) {
+    if (method == SUM) value += vec[j];
+    else if (method == XMIN) value = MIN(value,vec[j]);
+    else if (method == XMAX) value = MAX(value,vec[j]);
+    else if (method == AVE) value += vec[j];
+    else if (method == TRAP) value += vec[j];
+    else if (method == SLOPE) {
+      if (nvec > 1) xvalue = (double) i / (nvec-1);
+      else xvalue = 0.0;
+      sx += xvalue;
+      sy += vec[j];
+      sxx += xvalue*xvalue;
+      sxy += xvalue*vec[j];
+    }
+    j += nstride;
+  }
+  if (method == TRAP && nvec) value -= 0.5*vec[0] + 0.5*vec[nvec-1];
+
+  if (method == AVE) value /= nvec;        //FIXME
+
+  if (method == SLOPE) {
+    double numerator = sxy - sx*sy;
+    double denominator = sxx - sx*sx;
+    if (denominator != 0.0) value = numerator/denominator / nvec;  //FIXME
+    else value = BIG;
+  }
+
+  return value;
+}
+
 /* ----------------------------------------------------------------------
    find matching parenthesis in str, allocate contents = str between parens
    i = left paren
@@ -1904,7 +2768,7 @@ int Variable::special_function(char *word, char *contents, Tree **tree,
 			       Tree **treestack, int &ntreestack,
 			       double *argstack, int &nargstack)
 {
-  double value,xvalue,sx,sy,sxx,sxy;
+  double value;
 
   // word not a match to any special function
 
@@ -1960,106 +2824,75 @@ int Variable::special_function(char *word, char *contents, Tree **tree,
     if (narg != 1)
       error->all(FLERR,"Invalid special function in variable formula");
 
-    Compute* compute = NULL;
-    int index,nvec,nstride;
-
-    //FIXME::nvec��comput�йأ�����
+    // v_name = values of a body-style variable over all bodies
+    // compiled formulas reduce them when the program runs
 
+    if (strstr(arg1,"v_") == arg1) {
+      int ivar = find(&arg1[2]);
+      if (ivar < 0 || style[ivar] != BODY)
+        error->all(FLERR,"Invalid variable name in variable formula");
 
+      if (tree && (treestyle == EQUAL || treestyle == BODY)) {
+        Tree *newtree = new Tree();
+        newtree->type = BODYFUNC;
+        newtree->ivalue1 = method;
+        newtree->id = new char[strlen(&arg1[2])+1];
+        strcpy(newtree->id,&arg1[2]);
+        newtree->left = newtree->middle = newtree->right = NULL;
+        treestack[ntreestack++] = newtree;
+      } else {
+        value = reduce(method,compute_body(ivar),muse->nBodies,1);
+        if (tree) {
+          Tree *newtree = new Tree();
+          newtree->type = VALUE;
+          newtree->value = value;
+          newtree->left = newtree->middle = newtree->right = NULL;
+          treestack[ntreestack++] = newtree;
+        } else argstack[nargstack++] = value;
+      }
 
-    if (strstr(arg1, "c_") == arg1) {
-        ptr1 = strchr(arg1, '[');
-        if (ptr1) {
-            ptr2 = ptr1;
-            index = int_between_brackets(ptr2, 0);
-            *ptr1 = '\0';
-        }
-        else index = 0;
-
-        int icompute = modify->find_compute(&arg1[2]);
-        if (icompute < 0)
-            error->all(FLERR, "Invalid compute ID in variable formula");
-        compute = modify->compute[icompute];
-        if (index == 0 && compute->vector_flag) {
-            //FIXME:����ɾ����runflag
-            if (!(compute->invoked_flag & INVOKED_VECTOR)) {
-                compute->compute_vector();
-                compute->invoked_flag |= INVOKED_VECTOR;
-            }
-            nvec = compute->size_vector;
-            nstride = 1;
-        }
-        else if (index && compute->array_flag) {
-            if (index > compute->size_array_cols)
-                error->all(FLERR, "Variable formula compute array "
-                    "is accessed out-of-range");
-            //FIXME:����ɾ����runflag
-            if (!(compute->invoked_flag & INVOKED_ARRAY)) {
-                compute->compute_array();
-                compute->invoked_flag |= INVOKED_ARRAY;
-            }
-            nvec = compute->size_array_rows;
-            nstride = compute->size_array_cols;
-        }
-        else error->all(FLERR, "Mismatched compute in variable formula");
-
-    }
-    else error->all(FLERR, "Invalid special function in variable formula");
-
+    // c_ID = global vector or array column of a compute
 
+    } else {
+      if (strstr(arg1,"c_") != arg1)
+        error->all(FLERR,"Invalid special function in variable formula");
 
-    value = 0.0;
-    if (method == SLOPE) sx = sy = sxx = sxy = 0.0;
-    if (method == XMIN) value = BIG;
-    if (method == XMAX) value = -BIG;
+      int index;
+      ptr1 = strchr(arg1,'[');
+      if (ptr1) {
+        ptr2 = ptr1;
+        index = int_between_brackets(ptr2,0);
+        *ptr1 = '\0';
+      } else index = 0;
 
-    if (compute) {
-        double* vec;
-        if (index) {
-            if (compute->array) vec = &compute->array[0][index - 1];
-            else vec = NULL;
-        }
-        else vec = compute->vector;
-
-        int j = 0;
-        for (int i = 0; i < nvec; i++) {
-            if (method == SUM) value += vec[j];
-            else if (method == XMIN) value = MIN(value, vec[j]);
-            else if (method == XMAX) value = MAX(value, vec[j]);
-            else if (method == AVE) value += vec[j];
-            else if (method == TRAP) value += vec[j];
-            else if (method == SLOPE) {
-                if (nvec > 1) xvalue = (double)i / (nvec - 1);
-                else xvalue = 0.0;
-                sx += xvalue;
-                sy += vec[j];
-                sxx += xvalue * xvalue;
-                sxy += xvalue * vec[j];
-            }
-            j += nstride;
-        }
-        if (method == TRAP) value -= 0.5 * vec[0] + 0.5 * vec[nvec - 1];
-    }
+      int icompute = modify->find_compute(&arg1[2]);
+      if (icompute < 0)
+        error->all(FLERR,"Invalid compute ID in variable formula");
 
-    if (method == AVE) value /= nvec;//FIXME
+      // compiled formula reduces the compute when it runs
+      // else save value in tree or on argstack
 
-    if (method == SLOPE) {
-      double numerator = sxy - sx*sy;
-      double denominator = sxx - sx*sx;
-      if (denominator != 0.0) value = numerator/denominator / nvec;//FIXME
-      else value = BIG;
+      if (tree && (treestyle == EQUAL || treestyle == BODY)) {
+        Tree *newtree = new Tree();
+        newtree->type = VECFUNC;
+        newtree->ivalue1 = method;
+        newtree->ivalue2 = index;
+        newtree->id = new char[strlen(&arg1[2])+1];
+        strcpy(newtree->id,&arg1[2]);
+        newtree->left = newtree->middle = newtree->right = NULL;
+        treestack[ntreestack++] = newtree;
+      } else {
+        value = reduce_compute(method,modify->compute[icompute],index);
+        if (tree) {
+          Tree *newtree = new Tree();
+          newtree->type = VALUE;
+          newtree->value = value;
+          newtree->left = newtree->middle = newtree->right = NULL;
+          treestack[ntreestack++] = newtree;
+        } else argstack[nargstack++] = value;
+      }
     }
 
-    // save value in tree or on argstack
-
-    if (tree) {
-      Tree *newtree = new Tree();
-      newtree->type = VALUE;
-      newtree->value = value;
-      newtree->left = newtree->middle = newtree->right = NULL;
-      treestack[ntreestack++] = newtree;
-    } else argstack[nargstack++] = value;
-
   // special function for file-style variable
 
   } else if (strcmp(word,"next") == 0) {
@@ -2073,7 +2906,19 @@ int Variable::special_function(char *word, char *contents, Tree **tree,
     // SCALARFILE has single current value, read next one
     // save value in tree or on argstack
 
-    if (style[ivar] == SCALARFILE) {
+    // reading the next value is a side effect, formulas using next()
+    //   are not compiled but evaluated from their string every time
+
+    if (style[ivar] == SCALARFILE && tree &&
+        (treestyle == EQUAL || treestyle == BODY)) {
+      nocompile = 1;
+      Tree *newtree = new Tree();
+      newtree->type = VALUE;
+      newtree->value = 0.0;
+      newtree->left = newtree->middle = newtree->right = NULL;
+      treestack[ntreestack++] = newtree;
+
+    } else if (style[ivar] == SCALARFILE) {
       double value = atof(data[ivar][0]);
       int done = reader[ivar]->read_scalar(data[ivar][0]);
       if (done) remove(ivar);
@@ -2120,6 +2965,17 @@ int Variable::is_particle_vector(char *word)
 }
 
 
+/* ----------------------------------------------------------------------
+   return index of body field matching word, -1 if none
+------------------------------------------------------------------------- */
+
+int Variable::body_field(char *word)
+{
+  for (int i = 0; i < NBODYFIELD; i++)
+    if (strcmp(word,bodyfield[i]) == 0) return i;
+  return -1;
+}
+
 /* ----------------------------------------------------------------------
    check if word matches a constant
    return 1 if yes, else 0
@@ -2208,8 +3064,7 @@ double Variable::evaluate_boolean(char *str)
     onechar = str[i];
 
     // whitespace: just skip
-    std::locale::global(std::locale(""));//�޸�isspace��������
-    if (isspace(onechar)) i++;
+    if (isspace((unsigned char) onechar)) i++;
 
     // ----------------
     // parentheses: recursively evaluate contents of parens
@@ -2236,7 +3091,7 @@ double Variable::evaluate_boolean(char *str)
     // number: push value onto stack
     // ----------------
 
-    } else if (isdigit(onechar) || onechar == '.' || onechar == '-') {
+    } else if (isdigit((unsigned char) onechar) || onechar == '.' || onechar == '-') {
       if (expect == OP)
         error->all(FLERR,"Invalid Boolean syntax in if command");
       expect = OP;
@@ -2262,7 +3117,7 @@ double Variable::evaluate_boolean(char *str)
     // string: push string onto stack
     // ----------------
 
-    } else if (isalpha(onechar)) {
+    } else if (isalpha((unsigned char) onechar)) {
       if (expect == OP)
         error->all(FLERR,"Invalid Boolean syntax in if command");
       expect = OP;
@@ -31,14 +31,17 @@ class Variable : protected Pointers {
   int grid_style(int);
   int surf_style(int);
   int internal_style(int);
+  int body_style(int);
 
   char *retrieve(char *);
   double compute_equal(int);
   double compute_equal(char *);
+  double *compute_body(int);
   void compute_particle(int, double *, int, int);
   void compute_grid(int, double *, int, int);
   void compute_surf(int, double *, int, int) {}  // not yet supported
   void internal_set(int, double);
+  double table_value(int);
 
   int int_between_brackets(char *&, int);
   double evaluate_boolean(char *);
@@ -80,9 +83,35 @@ class Variable : protected Pointers {
     int nstride;           // stride between atoms if array is a 2d array
     int selfalloc;         // 1 if array is allocated here, else 0
     int ivalue1,ivalue2;   // extra values for needed for gmask,rmask,grmask
+                           // or variable/reduction and bracket index
+    char *id;              // compute ID of a compute vector reduction
     Tree *left,*middle,*right;    // ptrs further down tree
   };
 
+  struct Instr {           // one step of a compiled equal-style formula
+    int op;                // see enum{} in variable.cpp
+    int narg;              // # of stack values the op consumes
+    int index;             // variable or compute index
+    int method,column;     // reduction and bracket index of a compute vector
+    double value;          // VALUE constant
+    char *id;              // compute ID, checks index is still valid
+  };
+
+  struct Program {         // postfix program of an equal-style variable
+    Instr *code;
+    int ncode,maxcode;
+    double *stack;         // evaluation stack, depth vectors for BODY style
+    int depth;             // # of values the stack holds
+    double *result;        // BODY style values, one per body
+    int maxbody;           // # of bodies stack and result can hold
+    int generation;        // generation it was compiled in
+    int interpret;         // 1 = formula cannot be compiled, use evaluate()
+  };
+
+  Program **program;       // compiled program of each EQUAL variable or NULL
+  int generation;          // incremented when variable indices shift
+  int nocompile;           // set by evaluate() for formulas with side effects
+
   void remove(int);
   void grow();
   void copy(int, char **, char **);
@@ -90,6 +119,21 @@ class Variable : protected Pointers {
   double collapse_tree(Tree *);
   double eval_tree(Tree *, int);
   void free_tree(Tree *);
+  void compile(int);
+  void emit(Tree *, Program *, int &);
+  void add_instr(Program *, Instr &);
+  void free_program(int);
+  double execute(Program *);
+  double apply(int, double *);
+  int arity(int);
+  void execute_body(Program *);
+  void apply_vector(int, double *, double *, int);
+  void gather(int, double *);
+  double variable_value(int, int);
+  double reduce_compute(int, class Compute *, int);
+  double reduce(int, double *, int, int);
+  double reduce_body(Instr *);
+  int body_field(char *);
   int find_matching_paren(char *, int, char *&);
   int math_function(char *, char *, Tree **, Tree **, int &, double *, int &);
   int special_function(char *, char *, Tree **, Tree **,
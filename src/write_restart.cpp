@@ -0,0 +1,253 @@
+/* ----------------------------------------------------------------------
+   MUSE - MUltibody System dynamics Engine
+   https://github.com/zhangh3/MUSE
+
+   Zhang He, zhanghecalt@163.com
+   Science and Technology on Space Physics Laboratory, Beijing
+
+   This software is distributed under the GNU General Public License.
+   Copyright (c) 2023 Zhang He. All rights reserved.
+------------------------------------------------------------------------- */
+
+#include "mpi.h"
+#include "stdio.h"
+#include "string.h"
+#include "write_restart.h"
+#include "muse.h"
+#include "MUSEsystem.h"
+#include "body.h"
+#include "joint.h"
+#include "modify.h"
+#include "compute.h"
+#include "output.h"
+#include "ensemble.h"
+#include "random_mars.h"
+#include "memory.h"
+#include "error.h"
+
+using namespace MUSE_NS;
+
+#define BUFDELTA 4096
+
+/* ---------------------------------------------------------------------- */
+
+WriteRestart::WriteRestart(MUSE *muse) : Pointers(muse)
+{
+  MPI_Comm_rank(world,&me);
+  buf = NULL;
+  nbuf = maxbuf = 0;
+  file = NULL;
+}
+
+/* ---------------------------------------------------------------------- */
+
+WriteRestart::~WriteRestart()
+{
+  wait();
+  memory->sfree(buf);
+  delete [] file;
+}
+
+/* ----------------------------------------------------------------------
+   write_restart file
+------------------------------------------------------------------------- */
+
+void WriteRestart::command(int narg, char **arg)
+{
+  if (narg != 1) error->all(FLERR,"Illegal write_restart command");
+
+  // periodic checkpoints may still be going to disk
+
+  output->drain();
+
+  write(arg[0]);
+  wait();
+}
+
+/* ----------------------------------------------------------------------
+   pack the model now and hand the buffer to a writer thread
+   a previous write still in flight is finished first
+------------------------------------------------------------------------- */
+
+void WriteRestart::write(const char *name)
+{
+  wait();
+  snapshot();
+
+  if (me != 0) return;
+
+  delete [] file;
+  file = new char[strlen(name) + 1];
+  strcpy(file,name);
+  writer = std::thread(&WriteRestart::write_file,this);
+}
+
+/* ---------------------------------------------------------------------- */
+
+void WriteRestart::wait()
+{
+  if (writer.joinable()) writer.join();
+}
+
+/* ----------------------------------------------------------------------
+   pack everything needed to resume the run
+     header: magic, version
+     system: ntimestep, timenow, dt, gravity
+     bodies: name, mass, inertia, pos, vel, quat, quatd, omega,
+             force, torque
+     joints: name, type, point1/2, axis1/2, indices of body1/2 or -1
+     system membership: body and joint indices
+     solution: System::changed and xdd, a run read from the file starts
+               from them like the next run here does
+     computes: command arguments
+     random number generator state
+     trailer: end magic
+------------------------------------------------------------------------- */
+
+void WriteRestart::snapshot()
+{
+  System *s = muse->system;
+  int i;
+
+  nbuf = 0;
+  grow(8);
+  memcpy(&buf[nbuf],RESTART_MAGIC,8);
+  nbuf += 8;
+  pack_int(RESTART_VERSION);
+
+  pack_int(s->ntimestep);
+  pack_double(s->timenow);
+  pack_double(s->dt);
+  pack_doubles(s->ga.data(),3);
+
+  pack_int(muse->nBodies);
+  for (i = 0; i < muse->nBodies; i++) {
+    Body *b = muse->body[i];
+    pack_string(b->name);
+    pack_double(b->mass);
+    pack_doubles(b->inertia.data(),9);
+    pack_doubles(b->pos.data(),3);
+    pack_doubles(b->vel.data(),3);
+    pack_doubles(b->quat.data(),4);
+    pack_doubles(b->quatd.data(),4);
+    pack_doubles(b->omega.data(),3);
+    pack_doubles(b->force.data(),3);
+    pack_doubles(b->torque.data(),3);
+  }
+
+  pack_int(muse->nJoints);
+  for (i = 0; i < muse->nJoints; i++) {
+    Joint *j = muse->joint[i];
+    pack_string(j->name);
+    pack_int(j->get_type());
+    pack_doubles(j->point1.data(),3);
+    pack_doubles(j->point2.data(),3);
+    pack_doubles(j->axis1.data(),3);
+    pack_doubles(j->axis2.data(),3);
+    for (int k = 0; k < 2; k++)
+      pack_int(j->body[k] ? j->body[k]->IDinMuse : -1);
+  }
+
+  pack_int(s->nBodies);
+  for (i = 0; i < s->nBodies; i++) pack_int(s->body[i]->IDinMuse);
+  pack_int(s->nJoints);
+  for (i = 0; i < s->nJoints; i++) pack_int(s->joint[i]->IDinMuse);
+
+  pack_int(s->changed);
+  pack_int((int) s->xdd.size());
+  pack_doubles(s->xdd.data(),(int) s->xdd.size());
+
+  pack_int(modify->ncompute);
+  for (i = 0; i < modify->ncompute; i++) {
+    Compute *c = modify->compute[i];
+    pack_int(c->nargs);
+    for (int k = 0; k < c->nargs; k++) pack_string(c->args[k]);
+  }
+
+  RanMars *ran = ensemble->ranmaster;
+  int n = ran->size_restart();
+  double *state = new double[n];
+  ran->pack_restart(state);
+  pack_int(n);
+  pack_doubles(state,n);
+  delete [] state;
+
+  grow(8);
+  memcpy(&buf[nbuf],RESTART_END,8);
+  nbuf += 8;
+}
+
+/* ----------------------------------------------------------------------
+   writer thread: the file appears under its name only once complete,
+   a crash during the write leaves the previous checkpoint intact
+------------------------------------------------------------------------- */
+
+void WriteRestart::write_file()
+{
+  char *tmp = new char[strlen(file) + 5];
+  sprintf(tmp,"%s.tmp",file);
+
+  FILE *fp = fopen(tmp,"wb");
+  if (fp == NULL) {
+    if (screen) fprintf(screen,"WARNING: Cannot open restart file %s\n",tmp);
+    delete [] tmp;
+    return;
+  }
+  int nwrite = fwrite(buf,1,nbuf,fp);
+  fclose(fp);
+
+  if (nwrite != nbuf) {
+    if (screen) fprintf(screen,"WARNING: Cannot write restart file %s\n",tmp);
+  } else {
+#ifdef _WIN32
+    remove(file);
+#endif
+    rename(tmp,file);
+  }
+  delete [] tmp;
+}
+
+/* ---------------------------------------------------------------------- */
+
+void WriteRestart::grow(int n)
+{
+  if (nbuf + n <= maxbuf) return;
+  while (nbuf + n > maxbuf) maxbuf = maxbuf ? 2*maxbuf : BUFDELTA;
+  buf = (char *) memory->srealloc(buf,maxbuf,"write_restart:buf");
+}
+
+/* ---------------------------------------------------------------------- */
+
+void WriteRestart::pack_int(int value)
+{
+  grow(sizeof(int));
+  memcpy(&buf[nbuf],&value,sizeof(int));
+  nbuf += sizeof(int);
+}
+
+/* ---------------------------------------------------------------------- */
+
+void WriteRestart::pack_double(double value)
+{
+  pack_doubles(&value,1);
+}
+
+/* ---------------------------------------------------------------------- */
+
+void WriteRestart::pack_doubles(const double *values, int n)
+{
+  grow(n*sizeof(double));
+  memcpy(&buf[nbuf],values,n*sizeof(double));
+  nbuf += n*sizeof(double);
+}
+
+/* ---------------------------------------------------------------------- */
+
+void WriteRestart::pack_string(const char *str)
+{
+  int n = strlen(str);
+  pack_int(n);
+  grow(n);
+  memcpy(&buf[nbuf],str,n);
+  nbuf += n;
+}
@@ -0,0 +1,64 @@
+/* ----------------------------------------------------------------------
+   MUSE - MUltibody System dynamics Engine
+   https://github.com/zhangh3/MUSE
+
+   Zhang He, zhanghecalt@163.com
+   Science and Technology on Space Physics Laboratory, Beijing
+
+   This software is distributed under the GNU General Public License.
+   Copyright (c) 2023 Zhang He. All rights reserved.
+------------------------------------------------------------------------- */
+
+#ifdef COMMAND_CLASS
+
+CommandStyle(write_restart,WriteRestart)
+
+#else
+
+#ifndef MUSE_WRITE_RESTART_H
+#define MUSE_WRITE_RESTART_H
+
+#include <thread>
+#include "pointers.h"
+
+// restart file layout, see WriteRestart::snapshot()
+
+#define RESTART_MAGIC "MUSERST"
+#define RESTART_END "MUSEEND"
+#define RESTART_VERSION 3
+
+namespace MUSE_NS {
+
+/* binary restart files
+   snapshot() packs the model into a memory buffer, the buffer is then
+   written to disk, by a background thread for periodic checkpoints,
+   so the step loop only pays for the copy */
+
+class WriteRestart : protected Pointers {
+ public:
+  WriteRestart(class MUSE *);
+  ~WriteRestart();
+  void command(int, char **);
+  void write(const char *);    // snapshot, then write in background
+  void wait();                 // block until the background write is done
+
+ private:
+  int me;
+  char *buf;                   // packed model
+  int nbuf,maxbuf;
+  char *file;                  // file being written in background
+  std::thread writer;
+
+  void snapshot();
+  void write_file();
+  void grow(int);
+  void pack_int(int);
+  void pack_double(double);
+  void pack_doubles(const double *, int);
+  void pack_string(const char *);
+};
+
+}
+
+#endif
+#endif
@@ -0,0 +1,469 @@
+/* ----------------------------------------------------------------------
+   MUSE - MUltibody System dynamics Engine
+   https://github.com/zhangh3/MUSE
+
+   Zhang He, zhanghecalt@163.com
+   Science and Technology on Space Physics Laboratory, Beijing
+
+   This software is distributed under the GNU General Public License.
+   Copyright (c) 2023 Zhang He. All rights reserved.
+------------------------------------------------------------------------- */
+
+#include "mpi.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "math.h"
+#include <vector>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "muse.h"
+#include "input.h"
+#include "body.h"
+#include "joint.h"
+#include "joint_enums.h"
+#include "MUSEsystem.h"
+#include "timer.h"
+#include "models.h"
+#include "accuracy.h"
+
+using namespace MUSE_NS;
+
+#define NSAMPLE 10             // # of comparison times after t = 0
+#define MAXLINE 512
+#define BIG 1.0e6              // |pos| beyond this counts as diverged
+
+const char *metric_names[] = {"pos","quat","energy","drift"};
+
+/* ----------------------------------------------------------------------
+   point fixed in body1 and its image in body2 (or the ground) at t = 0
+   the joint keeps them together, slide joints only across the axis
+   rotations show up as gaps of the probes 1 m off the joint point
+------------------------------------------------------------------------- */
+
+struct Probe {
+  Body *b1,*b2;                // b2 = NULL for ground joints
+  Eigen::Vector3d q1,q2;       // body1 frame, body2 or inertial frame
+  Eigen::Vector3d axis;        // slide axis in body1 frame
+  int slide;
+};
+
+struct Header {
+  int nbody,nsample,diverged;
+  double time;                 // loop time of the runs, seconds
+};
+
+struct Result {
+  Header h;
+  std::vector<double> rec;     // (NSAMPLE+1) records, see record()
+};
+
+struct Case {
+  char model[32];
+  int n,nbody,nsteps,diverged,front;
+  const char *integrator;
+  double dt,time;
+  double tdiverge;             // first sample time found diverged
+  double err[NMETRIC];
+};
+
+/* ---------------------------------------------------------------------- */
+
+static void add_probes(std::vector<Probe> &probes, Joint *j)
+{
+  int type = j->get_type();
+  Eigen::Vector3d lever[4];
+  int nlever;
+
+  if (type == SPHERE) {
+    lever[0] = Eigen::Vector3d::Zero();
+    nlever = 1;
+  } else if (type == HINGE) {
+    lever[0] = j->axis1;
+    lever[1] = -j->axis1;
+    nlever = 2;
+  } else if (type == FIX || type == SLIDE || type == GROUND) {
+    lever[0] = Eigen::Vector3d::Zero();
+    for (int k = 0; k < 3; k++) lever[k+1] = Eigen::Vector3d::Unit(k);
+    nlever = 4;
+  } else return;
+
+  Body *b1 = j->body[0];
+  Body *b2 = (type == GROUND) ? NULL : j->body[1];
+
+  for (int k = 0; k < nlever; k++) {
+    Probe p;
+    p.b1 = b1;
+    p.b2 = b2;
+    p.q1 = j->point1 + lever[k];
+    Eigen::Vector3d at = b1->pos + b1->DCM*p.q1;
+    p.q2 = b2 ? Eigen::Vector3d(b2->DCM.transpose()*(at - b2->pos)) : at;
+    p.axis = j->axis1;
+    p.slide = (type == SLIDE);
+    probes.push_back(p);
+  }
+}
+
+/* ----------------------------------------------------------------------
+   largest gap of the probes, length units
+------------------------------------------------------------------------- */
+
+static double drift(const std::vector<Probe> &probes)
+{
+  double gapmax = 0.0;
+  for (size_t i = 0; i < probes.size(); i++) {
+    const Probe &p = probes[i];
+    Eigen::Vector3d gap = p.b1->pos + p.b1->DCM*p.q1;
+    if (p.b2) gap -= p.b2->pos + p.b2->DCM*p.q2;
+    else gap -= p.q2;
+    if (p.slide) {
+      Eigen::Vector3d a = p.b1->DCM*p.axis;
+      gap -= gap.dot(a)*a;
+    }
+    if (gap.norm() > gapmax) gapmax = gap.norm();
+  }
+  return gapmax;
+}
+
+/* ----------------------------------------------------------------------
+   kinetic plus gravitational energy of the system
+------------------------------------------------------------------------- */
+
+static double energy(System *sys)
+{
+  double e = 0.0;
+  for (int i = 0; i < sys->nBodies; i++) {
+    Body *b = sys->body[i];
+    e += 0.5*b->mass*b->vel.dot(b->vel) +
+      0.5*b->omega.dot(b->inertia*b->omega) - b->mass*sys->ga.dot(b->pos);
+  }
+  return e;
+}
+
+/* ----------------------------------------------------------------------
+   one record: pos and quat of each body, energy, constraint drift
+   return 0 if the state is no longer finite or has blown up
+------------------------------------------------------------------------- */
+
+static int record(System *sys, const std::vector<Probe> &probes, double *rec)
+{
+  int ok = 1;
+  for (int i = 0; i < sys->nBodies; i++) {
+    Body *b = sys->body[i];
+    for (int k = 0; k < 3; k++) rec[7*i+k] = b->pos(k);
+    for (int k = 0; k < 4; k++) rec[7*i+3+k] = b->quat(k);
+    if (!(b->pos.norm() < BIG)) ok = 0;
+  }
+  rec[7*sys->nBodies] = energy(sys);
+  rec[7*sys->nBodies+1] = drift(probes);
+  if (!isfinite(rec[7*sys->nBodies]) || !isfinite(rec[7*sys->nBodies+1]))
+    ok = 0;
+  return ok;
+}
+
+/* ----------------------------------------------------------------------
+   child process: run one model with one integrator and dt to tend,
+   record the state at NSAMPLE+1 evenly spaced times, send it to fd
+------------------------------------------------------------------------- */
+
+static void run_child(const BenchModel *model, int n, const char *integrator,
+                      double dt, const AccuracySweep *sweep, int fd)
+{
+  if (!freopen("/dev/null","w",stdout)) _exit(1);
+
+  char *noarg[] = {(char *) "muse_bench"};
+  MUSE *muse = new MUSE(1,noarg,MPI_COMM_WORLD);
+
+  model->build(muse,n);
+  System *sys = muse->system;
+  sys->reserve(muse->nBodies,muse->nJoints);
+  for (int i = 0; i < muse->nBodies; i++) sys->add_Body(muse->body[i]);
+  for (int i = 0; i < muse->nJoints; i++) sys->add_Joint(muse->joint[i]);
+
+  char line[MAXLINE];
+  snprintf(line,MAXLINE,"system dt %.17g gravity 0 -9.8 0 threads %d "
+           "integrator %s",dt,sweep->nthreads,integrator);
+  muse->input->one(line);
+  muse->input->one("stats 0");
+  muse->input->one("trajectory none");
+  muse->input->one("run 0");
+
+  std::vector<Probe> probes;
+  for (int i = 0; i < sys->nJoints; i++) add_probes(probes,sys->joint[i]);
+
+  int nrecord = 7*sys->nBodies + 2;
+  std::vector<double> rec((NSAMPLE+1)*nrecord);
+
+  Header h;
+  h.nbody = sys->nBodies;
+  h.nsample = 0;
+  h.diverged = !record(sys,probes,&rec[0]);
+  h.time = 0.0;
+
+  // runs continue one another exactly, see System::prepare()
+
+  int nper = (int) lround(sweep->tend/NSAMPLE/dt);
+  snprintf(line,MAXLINE,"run %d",nper);
+  for (int k = 1; k <= NSAMPLE && !h.diverged; k++) {
+    muse->input->one(line);
+    h.time += muse->timer->array[TIME_LOOP];
+    h.diverged = !record(sys,probes,&rec[k*nrecord]);
+    h.nsample = k;
+  }
+
+  size_t nbytes = (h.nsample+1)*nrecord*sizeof(double);
+  if (write(fd,&h,sizeof(Header)) != (ssize_t) sizeof(Header)) _exit(1);
+  for (size_t done = 0; done < nbytes; ) {
+    ssize_t m = write(fd,(char *) &rec[0] + done,nbytes - done);
+    if (m <= 0) _exit(1);
+    done += m;
+  }
+
+  delete muse;
+  _exit(0);
+}
+
+/* ----------------------------------------------------------------------
+   run one configuration in a child, return 0 if it failed
+------------------------------------------------------------------------- */
+
+static int run_config(const BenchModel *model, int n, const char *integrator,
+                      double dt, const AccuracySweep *sweep, Result *r)
+{
+  int fd[2];
+  if (pipe(fd) < 0) return 0;
+  fflush(NULL);
+
+  pid_t pid = fork();
+  if (pid < 0) return 0;
+  if (pid == 0) {
+    close(fd[0]);
+    run_child(model,n,integrator,dt,sweep,fd[1]);
+  }
+  close(fd[1]);
+
+  int ok = (read(fd[0],&r->h,sizeof(Header)) == (ssize_t) sizeof(Header));
+  if (ok) {
+    size_t nbytes = (r->h.nsample+1)*(7*r->h.nbody+2)*sizeof(double);
+    r->rec.resize(nbytes/sizeof(double));
+    for (size_t done = 0; done < nbytes; ) {
+      ssize_t m = read(fd[0],(char *) &r->rec[0] + done,nbytes - done);
+      if (m <= 0) {
+        ok = 0;
+        break;
+      }
+      done += m;
+    }
+  }
+  close(fd[0]);
+
+  int status;
+  waitpid(pid,&status,0);
+  return ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+/* ----------------------------------------------------------------------
+   errors of a run against the reference at the sample times,
+   energy and constraint drift are the run's own changes since t = 0
+------------------------------------------------------------------------- */
+
+static void errors(const Result *r, const Result *ref, double *err)
+{
+  int nbody = r->h.nbody;
+  int nrecord = 7*nbody + 2;
+  for (int m = 0; m < NMETRIC; m++) err[m] = 0.0;
+
+  const double *r0 = &r->rec[0];
+  for (int k = 1; k <= r->h.nsample; k++) {
+    const double *a = &r->rec[k*nrecord];
+    const double *b = &ref->rec[k*nrecord];
+    for (int i = 0; i < nbody; i++) {
+      double d2 = 0.0,dot = 0.0,chord = 0.0;
+      for (int j = 0; j < 3; j++)
+        d2 += (a[7*i+j] - b[7*i+j])*(a[7*i+j] - b[7*i+j]);
+
+      // rotation angle between the two attitudes from the chord of the
+      // quaternions, q and -q are the same attitude, exact near 0
+      // unlike acos of the dot product
+
+      for (int j = 3; j < 7; j++) dot += a[7*i+j]*b[7*i+j];
+      double sign = (dot < 0.0) ? -1.0 : 1.0;
+      for (int j = 3; j < 7; j++)
+        chord += (a[7*i+j] - sign*b[7*i+j])*(a[7*i+j] - sign*b[7*i+j]);
+      double angle = 4.0*asin(fmin(1.0,0.5*sqrt(chord)));
+      err[METRIC_POS] = fmax(err[METRIC_POS],sqrt(d2));
+      err[METRIC_QUAT] = fmax(err[METRIC_QUAT],angle);
+    }
+    err[METRIC_ENERGY] = fmax(err[METRIC_ENERGY],
+                              fabs(a[7*nbody] - r0[7*nbody]));
+    err[METRIC_DRIFT] = fmax(err[METRIC_DRIFT],a[7*nbody+1]);
+  }
+}
+
+/* ----------------------------------------------------------------------
+   mark the cases of one model not beaten in both time and metric
+------------------------------------------------------------------------- */
+
+static void pareto(Case *cases, int ncase, int metric)
+{
+  for (int i = 0; i < ncase; i++) {
+    Case *c = &cases[i];
+    c->front = !c->diverged;
+    for (int j = 0; j < ncase && c->front; j++) {
+      Case *o = &cases[j];
+      if (j == i || o->diverged) continue;
+      if (o->time <= c->time && o->err[metric] <= c->err[metric] &&
+          (o->time < c->time || o->err[metric] < c->err[metric]))
+        c->front = 0;
+    }
+  }
+}
+
+/* ----------------------------------------------------------------------
+   # of steps per sample interval, 0 if dt does not divide it
+------------------------------------------------------------------------- */
+
+static int steps_per_sample(double tend, double dt)
+{
+  double x = tend/NSAMPLE/dt;
+  long n = lround(x);
+  if (n < 1 || fabs(n - x) > 1.0e-6*x) return 0;
+  return (int) n;
+}
+
+/* ---------------------------------------------------------------------- */
+
+static const char *CASEFORMAT =
+  "{\"model\":\"%s\",\"n\":%d,\"bodies\":%d,\"integrator\":\"%s\","
+  "\"dt\":%.6g,\"steps\":%d,\"time_s\":%.6g,\"diverged\":%d,"
+  "\"pos_err\":%.6g,\"quat_err\":%.6g,\"energy_drift\":%.6g,"
+  "\"constraint_drift\":%.6g,\"pareto\":%d}";
+
+/* ----------------------------------------------------------------------
+   run the sweep for each model and size, print the tables,
+   write all cases to outfile as JSON, errors of diverged runs are -1
+   return # of model/size pairs that failed
+------------------------------------------------------------------------- */
+
+int accuracy(const BenchModel **models, int nmodel, const int *sizes,
+             int nsize, AccuracySweep *sweep, const char *outfile)
+{
+  double dtmin = sweep->dt[0];
+  for (int i = 0; i < sweep->ndt; i++) dtmin = fmin(dtmin,sweep->dt[i]);
+  if (sweep->dtref <= 0.0) sweep->dtref = dtmin/10.0;
+
+  for (int i = 0; i <= sweep->ndt; i++) {
+    double dt = (i < sweep->ndt) ? sweep->dt[i] : sweep->dtref;
+    if (!steps_per_sample(sweep->tend,dt)) {
+      fprintf(stderr,"ERROR: dt %g does not divide tend/%d = %g\n",
+              dt,NSAMPLE,sweep->tend/NSAMPLE);
+      return -1;
+    }
+  }
+
+  FILE *fp = fopen(outfile,"w");
+  if (fp == NULL) {
+    fprintf(stderr,"ERROR: Cannot open %s\n",outfile);
+    exit(1);
+  }
+  fprintf(fp,"{\"muse_bench_accuracy\":1,\"tend\":%g,\"dt_ref\":%g,"
+          "\"threads\":%d,\"front_metric\":\"%s\",\"cases\":[\n",
+          sweep->tend,sweep->dtref,sweep->nthreads,
+          metric_names[sweep->metric]);
+
+  int ncase = sweep->ndt*sweep->nintegrator;
+  Case *cases = new Case[ncase];
+  int nfail = 0,first = 1;
+
+  for (int m = 0; m < nmodel; m++) {
+    int last = 0;
+    for (int s = 0; s < nsize; s++) {
+      int unit = models[m]->unit;
+      int nunit = sizes[s]/unit > 1 ? sizes[s]/unit : 1;
+      if (nunit == last) continue;
+      last = nunit;
+
+      int n = sizes[s];
+      Result ref;
+      if (!run_config(models[m],n,"rk4",sweep->dtref,sweep,&ref) ||
+          ref.h.diverged) {
+        printf("\n%s n = %d: reference run FAILED\n",models[m]->name,n);
+        nfail++;
+        continue;
+      }
+
+      printf("\n%s n = %d, %d bodies, t = %g, reference rk4 dt %g "
+             "(%.4g s)\n",models[m]->name,n,ref.h.nbody,sweep->tend,
+             sweep->dtref,ref.h.time);
+      printf("%-10s %10s %7s %10s %10s %10s %10s %10s %5s\n","integrator",
+             "dt","steps","time (s)","pos err","quat err","energy","drift",
+             "front");
+
+      int nc = 0;
+      for (int i = 0; i < sweep->nintegrator; i++)
+        for (int k = 0; k < sweep->ndt; k++) {
+          Case *c = &cases[nc];
+          Result r;
+          if (!run_config(models[m],n,sweep->integrator[i],sweep->dt[k],
+                          sweep,&r)) {
+            printf("%-10s %10g  FAILED\n",sweep->integrator[i],sweep->dt[k]);
+            continue;
+          }
+          strncpy(c->model,models[m]->name,31);
+          c->model[31] = '\0';
+          c->n = n;
+          c->nbody = r.h.nbody;
+          c->integrator = sweep->integrator[i];
+          c->dt = sweep->dt[k];
+          c->nsteps = NSAMPLE*steps_per_sample(sweep->tend,c->dt);
+          c->time = r.h.time;
+          c->diverged = r.h.diverged;
+          c->tdiverge = r.h.nsample*sweep->tend/NSAMPLE;
+          if (c->diverged)
+            for (int j = 0; j < NMETRIC; j++) c->err[j] = -1.0;
+          else errors(&r,&ref,c->err);
+          nc++;
+        }
+      pareto(cases,nc,sweep->metric);
+
+      Case *best = NULL;
+      for (int i = 0; i < nc; i++) {
+        Case *c = &cases[i];
+        if (c->diverged)
+          printf("%-10s %10g %7d %10.4g  diverged at t = %g\n",c->integrator,
+                 c->dt,c->nsteps,c->time,c->tdiverge);
+        else
+          printf("%-10s %10g %7d %10.4g %10.3e %10.3e %10.3e %10.3e %5s\n",
+                 c->integrator,c->dt,c->nsteps,c->time,c->err[METRIC_POS],
+                 c->err[METRIC_QUAT],c->err[METRIC_ENERGY],
+                 c->err[METRIC_DRIFT],c->front ? "*" : "");
+        if (c->front && sweep->goal > 0.0 &&
+            c->err[sweep->metric] <= sweep->goal &&
+            (!best || c->time < best->time)) best = c;
+
+        if (!first) fprintf(fp,",\n");
+        first = 0;
+        fprintf(fp,CASEFORMAT,c->model,c->n,c->nbody,c->integrator,c->dt,
+                c->nsteps,c->time,c->diverged,c->err[METRIC_POS],
+                c->err[METRIC_QUAT],c->err[METRIC_ENERGY],
+                c->err[METRIC_DRIFT],c->front);
+      }
+
+      if (sweep->goal > 0.0) {
+        if (best)
+          printf("cheapest with %s <= %g: %s dt %g, %.4g s\n",
+                 metric_names[sweep->metric],sweep->goal,best->integrator,
+                 best->dt,best->time);
+        else
+          printf("no run reaches %s <= %g\n",metric_names[sweep->metric],
+                 sweep->goal);
+      }
+      fflush(stdout);
+    }
+  }
+
+  fprintf(fp,"\n]}\n");
+  fclose(fp);
+  delete [] cases;
+  return nfail;
+}
@@ -0,0 +1,45 @@
+/* ----------------------------------------------------------------------
+   MUSE - MUltibody System dynamics Engine
+   https://github.com/zhangh3/MUSE
+
+   Zhang He, zhanghecalt@163.com
+   Science and Technology on Space Physics Laboratory, Beijing
+
+   This software is distributed under the GNU General Public License.
+   Copyright (c) 2023 Zhang He. All rights reserved.
+------------------------------------------------------------------------- */
+
+#ifndef MUSE_BENCH_ACCURACY_H
+#define MUSE_BENCH_ACCURACY_H
+
+struct BenchModel;
+
+#define MAXSWEEP 64
+
+// error measures of a run, the Pareto front is taken on one of them
+
+enum{METRIC_POS,METRIC_QUAT,METRIC_ENERGY,METRIC_DRIFT,NMETRIC};
+
+extern const char *metric_names[];
+
+/* accuracy-versus-cost sweep: every model runs to tend with each
+   integrator and dt, and is compared with a reference run of RK4 at
+   dtref sampled at the same times */
+
+struct AccuracySweep {
+  double tend;                       // end time of every run
+  double dt[MAXSWEEP];               // time steps swept
+  int ndt;
+  const char *integrator[MAXSWEEP];  // system integrator styles swept
+  int nintegrator;
+  double dtref;                      // reference step, 0 = smallest dt/10
+  int metric;                        // METRIC_* of the Pareto front
+  double goal;                       // report the cheapest run with
+                                     // metric <= goal, 0 = none
+  int nthreads;
+};
+
+int accuracy(const BenchModel **, int, const int *, int, AccuracySweep *,
+             const char *);
+
+#endif
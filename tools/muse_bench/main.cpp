@@ -0,0 +1,438 @@
+/* ----------------------------------------------------------------------
+   MUSE - MUltibody System dynamics Engine
+   https://github.com/zhangh3/MUSE
+
+   Zhang He, zhanghecalt@163.com
+   Science and Technology on Space Physics Laboratory, Beijing
+
+   This software is distributed under the GNU General Public License.
+   Copyright (c) 2023 Zhang He. All rights reserved.
+------------------------------------------------------------------------- */
+
+/* muse_bench: scaling benchmark of the solver on canonical mechanisms
+
+   muse_bench [-m model,...] [-n N,...] [-s steps] [-t threads]
+              [-o file.json] [-c baseline.json] [-tol fraction] [-l]
+     -m           models to run, default all, -l lists them
+     -n           body counts, default 2,4,8,16
+     -s           timed steps per case, default 50
+     -t           solver threads (system threads), default 1
+     -o           write the results as JSON, default bench.json
+     -c           compare with a baseline written by -o, exit status 1
+                  if a case got slower or bigger by more than -tol
+     -tol         allowed relative increase, default 0.1
+
+   muse_bench -a [-m model,...] [-n N,...] [-T tend] [-dt dt,...]
+              [-i integrator,...] [-ref dt] [-e metric] [-goal value]
+              [-t threads] [-o file.json]
+     -a           accuracy-versus-cost sweep instead of scaling
+     -n           body counts, default 4, without -m models made of
+                  units larger than the largest N are left out
+     -T           end time of every run, default 0.5
+     -dt          time steps, default 1e-2,5e-3,2e-3,1e-3
+     -i           system integrators, default rk4,euler
+     -ref         step of the rk4 reference run, default smallest dt/10
+     -e           error of the Pareto front: pos, quat, energy or drift,
+                  default pos
+     -goal        report the cheapest run with that error <= goal
+     -o           default accuracy.json
+
+   each case runs in its own child process, so peak memory is the
+   high-water mark of that case alone; the model is built, settled by
+   a 2-step run and then timed over the given steps with timer full,
+   trajectory output is off so only the solver is measured */
+
+#include "mpi.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "muse.h"
+#include "input.h"
+#include "body.h"
+#include "joint.h"
+#include "MUSEsystem.h"
+#include "timer.h"
+#include "models.h"
+#include "accuracy.h"
+
+using namespace MUSE_NS;
+
+#define MAXCASE 256
+#define MAXLINE 512
+
+struct Sample {
+  char model[32];
+  int n,nbody,njoint,nsteps;
+  double loop,solve,factor;    // seconds
+  long peak;                   // peak resident memory, KB
+  int ok;
+};
+
+static void usage()
+{
+  fprintf(stderr,"Usage: muse_bench [-m model,...] [-n N,...] [-s steps] "
+          "[-t threads] [-o file.json] [-c baseline.json] [-tol fraction] "
+          "[-l]\n"
+          "       muse_bench -a [-m model,...] [-n N,...] [-T tend] "
+          "[-dt dt,...] [-i integrator,...] [-ref dt] [-e metric] "
+          "[-goal value] [-t threads] [-o file.json]\n");
+  exit(1);
+}
+
+/* ----------------------------------------------------------------------
+   child process: build, settle and time one case, send it to fd
+------------------------------------------------------------------------- */
+
+static void run_child(const BenchModel *model, int n, int nsteps,
+                      int nthreads, int fd)
+{
+  if (!freopen("/dev/null","w",stdout)) _exit(1);
+
+  char *noarg[] = {(char *) "muse_bench"};
+  MUSE *muse = new MUSE(1,noarg,MPI_COMM_WORLD);
+
+  model->build(muse,n);
+  muse->system->reserve(muse->nBodies,muse->nJoints);
+  for (int i = 0; i < muse->nBodies; i++) muse->system->add_Body(muse->body[i]);
+  for (int i = 0; i < muse->nJoints; i++) muse->system->add_Joint(muse->joint[i]);
+
+  char line[MAXLINE];
+  snprintf(line,MAXLINE,"system dt 1e-3 gravity 0 -9.8 0 threads %d",nthreads);
+  muse->input->one(line);
+  muse->input->one("stats 0");
+  muse->input->one("trajectory none");
+  muse->input->one("timer full");
+  muse->input->one("run 2");
+  snprintf(line,MAXLINE,"run %d",nsteps);
+  muse->input->one(line);
+
+  Sample s;
+  memset(&s,0,sizeof(Sample));
+  s.nbody = muse->system->nBodies;
+  s.njoint = muse->system->nJoints;
+  s.loop = muse->timer->array[TIME_LOOP];
+  s.solve = muse->timer->array[TIME_SOLVE];
+  s.factor = muse->timer->array[TIME_FACTOR];
+  s.ok = 1;
+  if (write(fd,&s,sizeof(Sample)) != (ssize_t) sizeof(Sample)) _exit(1);
+
+  delete muse;
+  _exit(0);
+}
+
+/* ----------------------------------------------------------------------
+   run one case in a child, return 0 if it failed
+------------------------------------------------------------------------- */
+
+static int run_case(const BenchModel *model, int n, int nsteps, int nthreads,
+                    Sample *s)
+{
+  int fd[2];
+  if (pipe(fd) < 0) return 0;
+  fflush(NULL);
+
+  pid_t pid = fork();
+  if (pid < 0) return 0;
+  if (pid == 0) {
+    close(fd[0]);
+    run_child(model,n,nsteps,nthreads,fd[1]);
+  }
+  close(fd[1]);
+
+  memset(s,0,sizeof(Sample));
+  ssize_t nread = read(fd[0],s,sizeof(Sample));
+  close(fd[0]);
+
+  int status;
+  struct rusage ru;
+  wait4(pid,&status,0,&ru);
+
+  strncpy(s->model,model->name,31);
+  s->n = n;
+  s->nsteps = nsteps;
+  s->peak = ru.ru_maxrss;
+  s->ok = (nread == (ssize_t) sizeof(Sample) && WIFEXITED(status) &&
+           WEXITSTATUS(status) == 0);
+  return s->ok;
+}
+
+/* ---------------------------------------------------------------------- */
+
+static double steps_per_second(const Sample *s)
+{
+  return s->loop > 0.0 ? s->nsteps/s->loop : 0.0;
+}
+
+static double ns_per_body_step(const Sample *s)
+{
+  return 1.0e9*s->loop/((double) s->nsteps*s->nbody);
+}
+
+/* ----------------------------------------------------------------------
+   one case per line, so a baseline is read back with sscanf
+------------------------------------------------------------------------- */
+
+static const char *CASEFORMAT =
+  "{\"model\":\"%s\",\"n\":%d,\"bodies\":%d,\"joints\":%d,\"steps\":%d,"
+  "\"steps_per_s\":%.6g,\"ns_per_body_step\":%.6g,\"solver_share\":%.4f,"
+  "\"factor_share\":%.4f,\"peak_kb\":%ld}";
+
+static const char *CASESCAN =
+  "{\"model\":\"%31[^\"]\",\"n\":%d,\"bodies\":%d,\"joints\":%d,\"steps\":%d,"
+  "\"steps_per_s\":%lf,\"ns_per_body_step\":%lf,\"solver_share\":%lf,"
+  "\"factor_share\":%lf,\"peak_kb\":%ld}";
+
+static void write_json(const char *file, Sample *cases, int ncase, int nthreads)
+{
+  FILE *fp = fopen(file,"w");
+  if (fp == NULL) {
+    fprintf(stderr,"ERROR: Cannot open %s\n",file);
+    exit(1);
+  }
+
+  fprintf(fp,"{\"muse_bench\":1,\"threads\":%d,\"cases\":[\n",nthreads);
+  int first = 1;
+  for (int i = 0; i < ncase; i++) {
+    Sample *s = &cases[i];
+    if (!s->ok) continue;
+    if (!first) fprintf(fp,",\n");
+    first = 0;
+    fprintf(fp,CASEFORMAT,s->model,s->n,s->nbody,s->njoint,s->nsteps,
+            steps_per_second(s),ns_per_body_step(s),s->solve/s->loop,
+            s->factor/s->loop,s->peak);
+  }
+  fprintf(fp,"\n]}\n");
+  fclose(fp);
+}
+
+/* ----------------------------------------------------------------------
+   flag cases slower or bigger than the baseline by more than tol
+   return # of regressions
+------------------------------------------------------------------------- */
+
+static int compare(const char *file, Sample *cases, int ncase, double tol)
+{
+  FILE *fp = fopen(file,"r");
+  if (fp == NULL) {
+    fprintf(stderr,"ERROR: Cannot open baseline %s\n",file);
+    exit(1);
+  }
+
+  printf("\nComparison with %s, tolerance %g%%\n",file,100.0*tol);
+  printf("%-14s %5s %14s %14s %10s %10s\n","model","n",
+         "ns/body-step","baseline","peak KB","baseline");
+
+  int nmatch = 0,nregress = 0;
+  char line[MAXLINE];
+  while (fgets(line,MAXLINE,fp)) {
+    char *ptr = strstr(line,"{\"model\"");
+    if (!ptr) continue;
+
+    char model[32];
+    int n,nbody,njoint,nsteps;
+    double sps,ns,solver,factor;
+    long peak;
+    if (sscanf(ptr,CASESCAN,model,&n,&nbody,&njoint,&nsteps,&sps,&ns,
+               &solver,&factor,&peak) != 10) continue;
+
+    for (int i = 0; i < ncase; i++) {
+      Sample *s = &cases[i];
+      if (!s->ok || s->n != n || strcmp(s->model,model) != 0) continue;
+      nmatch++;
+      double now = ns_per_body_step(s);
+      int slow = (now > ns*(1.0 + tol));
+      int big = (s->peak > peak*(1.0 + tol));
+      printf("%-14s %5d %14.4g %14.4g %10ld %10ld%s%s\n",model,n,now,ns,
+             s->peak,peak,slow ? "  SLOWER" : "",big ? "  BIGGER" : "");
+      if (slow || big) nregress++;
+    }
+  }
+  fclose(fp);
+
+  printf("%d cases compared, %d regressions\n",nmatch,nregress);
+  return nregress;
+}
+
+/* ---------------------------------------------------------------------- */
+
+int main(int argc, char **argv)
+{
+  MPI_Init(&argc,&argv);
+
+  const BenchModel *models[MAXCASE];
+  int nmodel = 0;
+  int sizes[MAXCASE] = {2,4,8,16};
+  int nsize = 4;
+  int sizeflag = 0;
+  int nsteps = 50;
+  int nthreads = 1;
+  const char *outfile = NULL;
+  const char *basefile = NULL;
+  double tol = 0.1;
+
+  int accuracyflag = 0;
+  AccuracySweep sweep;
+  sweep.tend = 0.5;
+  double dtdefault[] = {1.0e-2,5.0e-3,2.0e-3,1.0e-3};
+  sweep.ndt = 4;
+  memcpy(sweep.dt,dtdefault,sizeof(dtdefault));
+  sweep.integrator[0] = "rk4";
+  sweep.integrator[1] = "euler";
+  sweep.nintegrator = 2;
+  sweep.dtref = 0.0;
+  sweep.metric = METRIC_POS;
+  sweep.goal = 0.0;
+
+  int iarg = 1;
+  while (iarg < argc) {
+    if (strcmp(argv[iarg],"-l") == 0) {
+      for (int i = 0; bench_models[i].name; i++)
+        printf("%-14s %s\n",bench_models[i].name,bench_models[i].about);
+      return 0;
+    }
+    if (strcmp(argv[iarg],"-a") == 0) {
+      accuracyflag = 1;
+      iarg++;
+      continue;
+    }
+    if (iarg+2 > argc) usage();
+    if (strcmp(argv[iarg],"-m") == 0) {
+      nmodel = 0;
+      for (char *word = strtok(argv[iarg+1],","); word; word = strtok(NULL,",")) {
+        const BenchModel *m = find_model(word);
+        if (!m) {
+          fprintf(stderr,"ERROR: Unknown model %s, -l lists them\n",word);
+          return 1;
+        }
+        if (nmodel < MAXCASE) models[nmodel++] = m;
+      }
+    } else if (strcmp(argv[iarg],"-n") == 0) {
+      nsize = 0;
+      for (char *word = strtok(argv[iarg+1],","); word; word = strtok(NULL,","))
+        if (nsize < MAXCASE && atoi(word) > 0) sizes[nsize++] = atoi(word);
+      if (nsize == 0) usage();
+      sizeflag = 1;
+    } else if (strcmp(argv[iarg],"-s") == 0) {
+      nsteps = atoi(argv[iarg+1]);
+      if (nsteps <= 0) usage();
+    } else if (strcmp(argv[iarg],"-t") == 0) {
+      nthreads = atoi(argv[iarg+1]);
+      if (nthreads <= 0) usage();
+    } else if (strcmp(argv[iarg],"-o") == 0) {
+      outfile = argv[iarg+1];
+    } else if (strcmp(argv[iarg],"-c") == 0) {
+      basefile = argv[iarg+1];
+    } else if (strcmp(argv[iarg],"-tol") == 0) {
+      tol = atof(argv[iarg+1]);
+    } else if (strcmp(argv[iarg],"-T") == 0) {
+      sweep.tend = atof(argv[iarg+1]);
+      if (sweep.tend <= 0.0) usage();
+    } else if (strcmp(argv[iarg],"-dt") == 0) {
+      sweep.ndt = 0;
+      for (char *word = strtok(argv[iarg+1],","); word; word = strtok(NULL,","))
+        if (sweep.ndt < MAXSWEEP && atof(word) > 0.0)
+          sweep.dt[sweep.ndt++] = atof(word);
+      if (sweep.ndt == 0) usage();
+    } else if (strcmp(argv[iarg],"-i") == 0) {
+      sweep.nintegrator = 0;
+      for (char *word = strtok(argv[iarg+1],","); word; word = strtok(NULL,",")) {
+        if (strcmp(word,"rk4") != 0 && strcmp(word,"euler") != 0) {
+          fprintf(stderr,"ERROR: Unknown integrator %s, use rk4 or euler\n",
+                  word);
+          return 1;
+        }
+        if (sweep.nintegrator < MAXSWEEP)
+          sweep.integrator[sweep.nintegrator++] = word;
+      }
+      if (sweep.nintegrator == 0) usage();
+    } else if (strcmp(argv[iarg],"-ref") == 0) {
+      sweep.dtref = atof(argv[iarg+1]);
+      if (sweep.dtref <= 0.0) usage();
+    } else if (strcmp(argv[iarg],"-e") == 0) {
+      sweep.metric = -1;
+      for (int m = 0; m < NMETRIC; m++)
+        if (strcmp(argv[iarg+1],metric_names[m]) == 0) sweep.metric = m;
+      if (sweep.metric < 0) usage();
+    } else if (strcmp(argv[iarg],"-goal") == 0) {
+      sweep.goal = atof(argv[iarg+1]);
+    } else usage();
+    iarg += 2;
+  }
+
+  if (accuracyflag) {
+    if (basefile) {
+      fprintf(stderr,"ERROR: -c compares scaling runs only\n");
+      return 1;
+    }
+    if (!sizeflag) {
+      sizes[0] = 4;
+      nsize = 1;
+    }
+
+    // reference runs of models made of big units take long, leave them
+    // out unless asked for
+
+    if (nmodel == 0) {
+      int nmax = 0;
+      for (int k = 0; k < nsize; k++) if (sizes[k] > nmax) nmax = sizes[k];
+      for (int i = 0; bench_models[i].name && nmodel < MAXCASE; i++)
+        if (bench_models[i].unit <= nmax) models[nmodel++] = &bench_models[i];
+    }
+
+    sweep.nthreads = nthreads;
+    if (!outfile) outfile = "accuracy.json";
+    int nfail = accuracy(models,nmodel,sizes,nsize,&sweep,outfile);
+    if (nfail >= 0) printf("\nResults written to %s\n",outfile);
+    MPI_Finalize();
+    return nfail ? 1 : 0;
+  }
+
+  if (nmodel == 0)
+    for (int i = 0; bench_models[i].name && nmodel < MAXCASE; i++)
+      models[nmodel++] = &bench_models[i];
+  if (!outfile) outfile = "bench.json";
+
+  Sample *cases = new Sample[nmodel*nsize];
+  int ncase = 0;
+
+  printf("%-14s %5s %6s %6s %10s %14s %8s %8s %10s\n","model","n","bodies",
+         "joints","steps/s","ns/body-step","solver%","factor%","peak KB");
+
+  for (int m = 0; m < nmodel; m++) {
+    int last = 0;
+    for (int k = 0; k < nsize; k++) {
+
+      // models of fixed units round N down, skip sizes giving the same model
+
+      int unit = models[m]->unit;
+      int nunit = sizes[k]/unit > 1 ? sizes[k]/unit : 1;
+      if (nunit == last) continue;
+      last = nunit;
+
+      Sample *s = &cases[ncase];
+      if (!run_case(models[m],sizes[k],nsteps,nthreads,s)) {
+        printf("%-14s %5d  FAILED\n",models[m]->name,sizes[k]);
+        continue;
+      }
+      ncase++;
+
+      printf("%-14s %5d %6d %6d %10.4g %14.4g %8.2f %8.2f %10ld\n",
+             s->model,s->n,s->nbody,s->njoint,steps_per_second(s),
+             ns_per_body_step(s),100.0*s->solve/s->loop,
+             100.0*s->factor/s->loop,s->peak);
+      fflush(stdout);
+    }
+  }
+
+  write_json(outfile,cases,ncase,nthreads);
+  printf("Results written to %s\n",outfile);
+
+  int nregress = basefile ? compare(basefile,cases,ncase,tol) : 0;
+
+  delete [] cases;
+  MPI_Finalize();
+  return nregress ? 1 : 0;
+}
@@ -0,0 +1,318 @@
+/* ----------------------------------------------------------------------
+   MUSE - MUltibody System dynamics Engine
+   https://github.com/zhangh3/MUSE
+
+   Zhang He, zhanghecalt@163.com
+   Science and Technology on Space Physics Laboratory, Beijing
+
+   This software is distributed under the GNU General Public License.
+   Copyright (c) 2023 Zhang He. All rights reserved.
+------------------------------------------------------------------------- */
+
+#include "mpi.h"
+#include "stdio.h"
+#include "stdarg.h"
+#include "string.h"
+#include "math.h"
+#include "muse.h"
+#include "input.h"
+#include "models.h"
+
+using namespace MUSE_NS;
+
+#define MAXLINE 512
+
+static const double ZAXIS[3] = {0.0,0.0,1.0};
+
+/* ---------------------------------------------------------------------- */
+
+static void command(MUSE *muse, const char *format, ...)
+{
+  char line[MAXLINE];
+  va_list ap;
+  va_start(ap,format);
+  vsnprintf(line,MAXLINE,format,ap);
+  va_end(ap);
+  muse->input->one(line);
+}
+
+/* ----------------------------------------------------------------------
+   body at x with the default mass and inertia, body frame = inertial
+------------------------------------------------------------------------- */
+
+static void body(MUSE *muse, const char *name, const double *x)
+{
+  command(muse,"create body %s pos %.15g %.15g %.15g quat 0 0 0 1",
+          name,x[0],x[1],x[2]);
+}
+
+/* ----------------------------------------------------------------------
+   joint between bodies centered at x1 and x2, located at point at
+   axis is used by hinge and slide joints
+------------------------------------------------------------------------- */
+
+static void joint(MUSE *muse, const char *name, const char *type,
+                  const char *b1, const double *x1,
+                  const char *b2, const double *x2,
+                  const double *at, const double *axis)
+{
+  command(muse,"create joint %s %s body1 %s body2 %s "
+          "point1 %.15g %.15g %.15g point2 %.15g %.15g %.15g "
+          "axis1 %.15g %.15g %.15g",name,type,b1,b2,
+          at[0]-x1[0],at[1]-x1[1],at[2]-x1[2],
+          at[0]-x2[0],at[1]-x2[1],at[2]-x2[2],axis[0],axis[1],axis[2]);
+}
+
+/* ---------------------------------------------------------------------- */
+
+static void ground(MUSE *muse, const char *name, const char *b)
+{
+  command(muse,"create joint %s ground body1 %s",name,b);
+}
+
+/* ----------------------------------------------------------------------
+   N-link pendulum along x, first link grounded
+------------------------------------------------------------------------- */
+
+static void chain(MUSE *muse, int n, const char *type)
+{
+  char name[32],prev[32];
+  double x[3] = {0.0,0.0,0.0},xprev[3],at[3];
+
+  for (int k = 1; k <= n; k++) {
+    x[0] = k - 1;
+    sprintf(name,"l%d",k);
+    body(muse,name,x);
+    if (k == 1) ground(muse,"g",name);
+    else {
+      at[0] = k - 1.5; at[1] = at[2] = 0.0;
+      char jname[32];
+      sprintf(jname,"j%d",k-1);
+      joint(muse,jname,type,prev,xprev,name,x,at,ZAXIS);
+    }
+    strcpy(prev,name);
+    memcpy(xprev,x,3*sizeof(double));
+  }
+}
+
+static void chain_sphere(MUSE *muse, int n) { chain(muse,n,"sphere"); }
+static void chain_hinge(MUSE *muse, int n) { chain(muse,n,"hinge"); }
+
+/* ----------------------------------------------------------------------
+   binary tree, body i hangs off body i/2 by a sphere joint,
+   level d at x = d, spread out in y, root grounded
+------------------------------------------------------------------------- */
+
+static void position_tree(int i, double *x)
+{
+  int d = 0;
+  while ((2 << d) <= i) d++;
+  int first = 1 << d;
+  x[0] = d;
+  x[1] = (i - first + 0.5) * 8.0/first - 4.0;
+  x[2] = 0.0;
+}
+
+static void tree(MUSE *muse, int n)
+{
+  char name[32],parent[32],jname[32];
+  double x[3],xp[3],at[3];
+
+  for (int i = 1; i <= n; i++) {
+    position_tree(i,x);
+    sprintf(name,"t%d",i);
+    body(muse,name,x);
+    if (i == 1) {
+      ground(muse,"g",name);
+      continue;
+    }
+    position_tree(i/2,xp);
+    sprintf(parent,"t%d",i/2);
+    sprintf(jname,"j%d",i);
+    for (int k = 0; k < 3; k++) at[k] = 0.5*(x[k] + xp[k]);
+    joint(muse,jname,"sphere",parent,xp,name,x,at,ZAXIS);
+  }
+}
+
+/* ----------------------------------------------------------------------
+   closed four-bar loops side by side in z, 4 bodies each:
+   grounded base, crank, coupler and rocker, hinged about z
+   pivots A and D on the base, B and C between the moving links
+------------------------------------------------------------------------- */
+
+static void fourbar(MUSE *muse, int n)
+{
+  int nloop = n/4 > 1 ? n/4 : 1;
+  char bname[4][32],jname[32];
+  double x[4][3],p[4][3];
+
+  for (int m = 0; m < nloop; m++) {
+    double z = 2.0*m;
+    double pivot[4][2] = {{0.0,0.0},{0.3,1.0},{2.1,1.2},{2.0,0.0}};
+    for (int k = 0; k < 4; k++) {
+      p[k][0] = pivot[k][0]; p[k][1] = pivot[k][1]; p[k][2] = z;
+    }
+
+    // base between A and D, links between their two pivots
+
+    for (int k = 0; k < 4; k++) {
+      int a = (k == 0) ? 0 : k-1;
+      int b = (k == 0) ? 3 : k;
+      for (int j = 0; j < 3; j++) x[k][j] = 0.5*(p[a][j] + p[b][j]);
+    }
+    sprintf(bname[0],"base%d",m+1);
+    sprintf(bname[1],"crank%d",m+1);
+    sprintf(bname[2],"coupler%d",m+1);
+    sprintf(bname[3],"rocker%d",m+1);
+    for (int k = 0; k < 4; k++) body(muse,bname[k],x[k]);
+
+    sprintf(jname,"g%d",m+1);
+    ground(muse,jname,bname[0]);
+    for (int k = 0; k < 4; k++) {
+      int b1 = k;
+      int b2 = (k + 1) % 4;
+      sprintf(jname,"h%d_%d",m+1,k+1);
+      joint(muse,jname,"hinge",bname[b1],x[b1],bname[b2],x[b2],p[k],ZAXIS);
+    }
+  }
+}
+
+/* ----------------------------------------------------------------------
+   Stewart platforms side by side in x, 14 bodies each:
+   grounded base, top platform and 6 legs of two halves,
+   sphere at the base, slide between the halves, sphere at the top
+------------------------------------------------------------------------- */
+
+static void stewart(MUSE *muse, int n)
+{
+  int nplat = n/14 > 1 ? n/14 : 1;
+  char base[32],top[32],lower[32],upper[32],jname[32];
+  double xb[3],xt[3],xl[3],xu[3],pb[3],pt[3],d[3];
+
+  for (int m = 0; m < nplat; m++) {
+    double x0 = 4.0*m;
+    xb[0] = x0; xb[1] = 0.0; xb[2] = 0.0;
+    xt[0] = x0; xt[1] = 1.5; xt[2] = 0.0;
+    sprintf(base,"base%d",m+1);
+    sprintf(top,"top%d",m+1);
+    body(muse,base,xb);
+    body(muse,top,xt);
+    sprintf(jname,"g%d",m+1);
+    ground(muse,jname,base);
+
+    for (int i = 0; i < 6; i++) {
+      double tb = M_PI/3.0*i + ((i % 2) ? -0.2 : 0.2);
+      double tt = M_PI/3.0*i + M_PI/6.0*((i % 2) ? 1.0 : -1.0);
+      pb[0] = x0 + cos(tb); pb[1] = 0.0; pb[2] = sin(tb);
+      pt[0] = x0 + 0.6*cos(tt); pt[1] = 1.5; pt[2] = 0.6*sin(tt);
+      double len = 0.0;
+      for (int k = 0; k < 3; k++) {
+        d[k] = pt[k] - pb[k];
+        len += d[k]*d[k];
+      }
+      len = sqrt(len);
+      for (int k = 0; k < 3; k++) {
+        xl[k] = pb[k] + 0.25*d[k];
+        xu[k] = pb[k] + 0.75*d[k];
+        d[k] /= len;
+      }
+
+      sprintf(lower,"leg%d_%d_lo",m+1,i+1);
+      sprintf(upper,"leg%d_%d_up",m+1,i+1);
+      body(muse,lower,xl);
+      body(muse,upper,xu);
+
+      // both halves slide along the leg line, axis d
+
+      sprintf(jname,"sb%d_%d",m+1,i+1);
+      joint(muse,jname,"sphere",base,xb,lower,xl,pb,ZAXIS);
+      sprintf(jname,"sl%d_%d",m+1,i+1);
+      joint(muse,jname,"slide",lower,xl,upper,xu,xl,d);
+      sprintf(jname,"st%d_%d",m+1,i+1);
+      joint(muse,jname,"sphere",upper,xu,top,xt,pt,ZAXIS);
+    }
+  }
+}
+
+/* ----------------------------------------------------------------------
+   N free bodies on a grid with spread velocities, no joints
+------------------------------------------------------------------------- */
+
+static void swarm(MUSE *muse, int n)
+{
+  char name[32];
+  double x[3];
+  int side = (int) ceil(cbrt((double) n));
+
+  for (int i = 0; i < n; i++) {
+    x[0] = 2.0*(i % side);
+    x[1] = 2.0*((i / side) % side);
+    x[2] = 2.0*(i / (side*side));
+    sprintf(name,"f%d",i+1);
+    body(muse,name,x);
+    command(muse,"change body %s vel %g %g %g omega %g %g %g",name,
+            0.1*(i % 3),0.1*(i % 5),0.1*(i % 7),
+            1.0 + 0.1*(i % 4),0.5,0.2*(i % 3));
+  }
+}
+
+/* ----------------------------------------------------------------------
+   chain of welded clusters in x, 4 bodies each: a hub with three
+   satellites fixed to it, hubs linked by sphere joints, first grounded
+------------------------------------------------------------------------- */
+
+static void weld(MUSE *muse, int n)
+{
+  int nclus = n/4 > 1 ? n/4 : 1;
+  char hub[32],prev[32],sat[32],jname[32];
+  double xh[3],xprev[3],xs[3],at[3];
+  double offset[3][3] = {{0.0,0.5,0.0},{0.0,-0.5,0.0},{0.0,0.0,0.5}};
+
+  for (int m = 0; m < nclus; m++) {
+    xh[0] = 2.0*m; xh[1] = xh[2] = 0.0;
+    sprintf(hub,"hub%d",m+1);
+    body(muse,hub,xh);
+    if (m == 0) ground(muse,"g",hub);
+    else {
+      at[0] = 2.0*m - 1.0; at[1] = at[2] = 0.0;
+      sprintf(jname,"s%d",m);
+      joint(muse,jname,"sphere",prev,xprev,hub,xh,at,ZAXIS);
+    }
+
+    for (int k = 0; k < 3; k++) {
+      for (int j = 0; j < 3; j++) {
+        xs[j] = xh[j] + offset[k][j];
+        at[j] = xh[j] + 0.5*offset[k][j];
+      }
+      sprintf(sat,"sat%d_%d",m+1,k+1);
+      body(muse,sat,xs);
+      sprintf(jname,"w%d_%d",m+1,k+1);
+      joint(muse,jname,"fix",hub,xh,sat,xs,at,ZAXIS);
+    }
+
+    strcpy(prev,hub);
+    memcpy(xprev,xh,3*sizeof(double));
+  }
+}
+
+/* ---------------------------------------------------------------------- */
+
+const BenchModel bench_models[] = {
+  {"chain_sphere",chain_sphere,1,"N-link pendulum, sphere joints"},
+  {"chain_hinge",chain_hinge,1,"N-link pendulum, hinge joints"},
+  {"tree",tree,1,"binary tree, sphere joints"},
+  {"fourbar",fourbar,4,"closed four-bar loops, 4 bodies each"},
+  {"stewart",stewart,14,"Stewart platforms, 14 bodies each"},
+  {"swarm",swarm,1,"free bodies, no joints"},
+  {"weld",weld,4,"welded 4-body clusters in a chain"},
+  {NULL,NULL,0,NULL}
+};
+
+/* ---------------------------------------------------------------------- */
+
+const BenchModel *find_model(const char *name)
+{
+  for (int i = 0; bench_models[i].name; i++)
+    if (strcmp(name,bench_models[i].name) == 0) return &bench_models[i];
+  return NULL;
+}
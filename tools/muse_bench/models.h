@@ -0,0 +1,36 @@
+/* ----------------------------------------------------------------------
+   MUSE - MUltibody System dynamics Engine
+   https://github.com/zhangh3/MUSE
+
+   Zhang He, zhanghecalt@163.com
+   Science and Technology on Space Physics Laboratory, Beijing
+
+   This software is distributed under the GNU General Public License.
+   Copyright (c) 2023 Zhang He. All rights reserved.
+------------------------------------------------------------------------- */
+
+#ifndef MUSE_BENCH_MODELS_H
+#define MUSE_BENCH_MODELS_H
+
+namespace MUSE_NS { class MUSE; }
+
+/* generators of the benchmark mechanisms
+   each builds a model of about N bodies through input commands,
+   bodies and joints are created but not added to the system,
+   models made of fixed units (four-bar, Stewart, weld) round N down
+   to whole units, at least one */
+
+typedef void (*BuildFn)(MUSE_NS::MUSE *, int);
+
+struct BenchModel {
+  const char *name;
+  BuildFn build;
+  int unit;                    // # of bodies in one unit
+  const char *about;
+};
+
+extern const BenchModel bench_models[];   // ends with a NULL name
+
+const BenchModel *find_model(const char *);
+
+#endif
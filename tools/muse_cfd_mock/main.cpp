@@ -0,0 +1,228 @@
+/* ----------------------------------------------------------------------
+   MUSE - MUltibody System dynamics Engine
+   https://github.com/zhangh3/MUSE
+
+   Zhang He, zhanghecalt@163.com
+   Science and Technology on Space Physics Laboratory, Beijing
+
+   This software is distributed under the GNU General Public License.
+   Copyright (c) 2023 Zhang He. All rights reserved.
+------------------------------------------------------------------------- */
+
+/* muse_cfd_mock: stand-in for a CFD solver on the "coupling" command
+
+   muse_cfd_mock name [-k K] [-c C] [-r R] [-now] [-cost US] [-spin US]
+                      [-wait S] [-v]
+     -k K         spring stiffness towards the first position seen
+     -c C         linear drag on the centroid velocity
+     -r R         rotational drag on the body-frame angular velocity
+     -now         answer with loads at the time of the state
+                  (default: at the end of the coupling step, from the
+                  state advanced by its velocity, like a staggered
+                  CFD step would)
+     -cost US     busy-wait US microseconds per step, as the CFD work
+     -spin US     poll for the next state US microseconds before
+                  blocking (default 1000, 0 on a single core)
+     -wait S      give up after S seconds without a state (default 60)
+     -v           print one line per exchange
+
+   attaches to the segment once MUSE creates it and answers every
+   exchange until MUSE lets go of the segment */
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "errno.h"
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "coupling_format.h"
+
+#define POLL 10000             // microseconds between looks for the segment
+
+static void usage()
+{
+  fprintf(stderr,"Usage: muse_cfd_mock name [-k K] [-c C] [-r R] [-now] "
+          "[-cost US] [-spin US] [-wait S] [-v]\n");
+  exit(1);
+}
+
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return ts.tv_sec + 1.0e-9*ts.tv_nsec;
+}
+
+/* ----------------------------------------------------------------------
+   wait for MUSE to post to_peer, polling for spin seconds first
+   0 on success, 1 after wait seconds
+------------------------------------------------------------------------- */
+
+static int wait_muse(CplHeader *h, double spin, double wait)
+{
+  double t0 = now();
+  for (int i = 0; ; i++) {
+    if (sem_trywait(&h->to_peer) == 0) return 0;
+    if (i % 64 == 0 && now() - t0 > spin) break;
+  }
+
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME,&ts);
+  double t = ts.tv_nsec*1.0e-9 + wait;
+  ts.tv_sec += (time_t) t;
+  ts.tv_nsec = (long) ((t - (time_t) t)*1.0e9);
+
+  while (sem_timedwait(&h->to_peer,&ts) != 0)
+    if (errno != EINTR) return 1;
+  return 0;
+}
+
+/* ---------------------------------------------------------------------- */
+
+int main(int argc, char **argv)
+{
+  if (argc < 2) usage();
+
+  double k = 0.0;
+  double c = 0.0;
+  double r = 0.0;
+  int ahead = 1;
+  double cost = 0.0;
+  double spin = (sysconf(_SC_NPROCESSORS_ONLN) > 1) ? 1.0e-3 : 0.0;
+  double wait = 60.0;
+  int verbose = 0;
+
+  int iarg = 2;
+  while (iarg < argc) {
+    if (strcmp(argv[iarg],"-k") == 0 && iarg+1 < argc) {
+      k = atof(argv[iarg+1]);
+      iarg += 2;
+    } else if (strcmp(argv[iarg],"-c") == 0 && iarg+1 < argc) {
+      c = atof(argv[iarg+1]);
+      iarg += 2;
+    } else if (strcmp(argv[iarg],"-r") == 0 && iarg+1 < argc) {
+      r = atof(argv[iarg+1]);
+      iarg += 2;
+    } else if (strcmp(argv[iarg],"-now") == 0) {
+      ahead = 0;
+      iarg++;
+    } else if (strcmp(argv[iarg],"-cost") == 0 && iarg+1 < argc) {
+      cost = 1.0e-6*atof(argv[iarg+1]);
+      iarg += 2;
+    } else if (strcmp(argv[iarg],"-spin") == 0 && iarg+1 < argc) {
+      spin = 1.0e-6*atof(argv[iarg+1]);
+      iarg += 2;
+    } else if (strcmp(argv[iarg],"-wait") == 0 && iarg+1 < argc) {
+      wait = atof(argv[iarg+1]);
+      iarg += 2;
+    } else if (strcmp(argv[iarg],"-v") == 0) {
+      verbose = 1;
+      iarg++;
+    } else usage();
+  }
+
+  char name[256];
+  if (argv[1][0] == '/') snprintf(name,256,"%s",argv[1]);
+  else snprintf(name,256,"/%s",argv[1]);
+
+  // the segment may not exist yet, MUSE creates it on its first run
+
+  int fd = -1;
+  struct stat st;
+  double start = now();
+  while (1) {
+    fd = shm_open(name,O_RDWR,0);
+    if (fd >= 0 && fstat(fd,&st) == 0 && st.st_size >= (off_t) sizeof(CplHeader))
+      break;
+    if (fd >= 0) close(fd);
+    if (now() - start > wait) {
+      fprintf(stderr,"ERROR: No coupling segment %s\n",name);
+      return 1;
+    }
+    usleep(POLL);
+  }
+
+  void *ptr = mmap(NULL,st.st_size,PROT_READ | PROT_WRITE,MAP_SHARED,fd,0);
+  if (ptr == MAP_FAILED) {
+    fprintf(stderr,"ERROR: Cannot map shared memory segment %s\n",name);
+    return 1;
+  }
+  char *base = (char *) ptr;
+  CplHeader *h = (CplHeader *) base;
+
+  while (strncmp(h->magic,CPL_MAGIC,8) != 0) {
+    if (now() - start > wait) {
+      fprintf(stderr,"ERROR: %s is not a MUSE coupling segment\n",name);
+      return 1;
+    }
+    usleep(POLL);
+  }
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (h->version != CPL_VERSION || h->load_offset +
+      CPL_LOAD*h->nbody*(int64_t) sizeof(double) > st.st_size) {
+    fprintf(stderr,"ERROR: %s is not a MUSE coupling segment\n",name);
+    return 1;
+  }
+
+  int nbody = h->nbody;
+  const char *names = base + h->name_offset;
+  const double *state = (const double *) (base + h->state_offset);
+  double *load = (double *) (base + h->load_offset);
+  double *pos0 = new double[3*nbody];
+
+  fprintf(stderr,"muse_cfd_mock: attached to %s,",name);
+  for (int i = 0; i < nbody; i++)
+    fprintf(stderr," %.*s",h->namelen,names + i*h->namelen);
+  fprintf(stderr,"\n");
+
+  long long nexchange = 0;
+  double work = 0.0;
+
+  while (1) {
+    if (wait_muse(h,spin,wait)) {
+      fprintf(stderr,"ERROR: No state from MUSE for %g seconds\n",wait);
+      return 1;
+    }
+    if (h->live.load(std::memory_order_acquire) == 0) break;
+
+    double t0 = now();
+
+    // the state is taken as the fluid would see it at the load time
+
+    double step = ahead ? h->every*h->dt : 0.0;
+    for (int i = 0; i < nbody; i++) {
+      const double *s = &state[CPL_STATE*i];
+      double *l = &load[CPL_LOAD*i];
+      if (nexchange == 0)
+        for (int j = 0; j < 3; j++) pos0[3*i+j] = s[j];
+      for (int j = 0; j < 3; j++) {
+        double x = s[j] + step*s[7+j];
+        l[j] = -k*(x - pos0[3*i+j]) - c*s[7+j];
+        l[3+j] = -r*s[10+j];
+      }
+    }
+    h->load_time = h->time + step;
+
+    if (cost > 0.0)
+      while (now() - t0 < cost);
+    work += now() - t0;
+
+    if (verbose)
+      printf("%lld %lld %.17g %.17g\n",(long long) h->exchange,
+             (long long) h->step,h->time,h->load_time);
+
+    nexchange++;
+    sem_post(&h->to_muse);
+  }
+
+  fprintf(stderr,"muse_cfd_mock: %lld exchanges, %.3g us per step\n",
+          nexchange,nexchange ? 1.0e6*work/nexchange : 0.0);
+
+  delete [] pos0;
+  munmap(ptr,st.st_size);
+  close(fd);
+  return 0;
+}
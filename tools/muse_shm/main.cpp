@@ -0,0 +1,145 @@
+/* ----------------------------------------------------------------------
+   MUSE - MUltibody System dynamics Engine
+   https://github.com/zhangh3/MUSE
+
+   Zhang He, zhanghecalt@163.com
+   Science and Technology on Space Physics Laboratory, Beijing
+
+   This software is distributed under the GNU General Public License.
+   Copyright (c) 2023 Zhang He. All rights reserved.
+------------------------------------------------------------------------- */
+
+/* muse_shm: reference reader of "output shm"
+
+   muse_shm name [-a] [-n N]
+     -a           start with the oldest frame still in the ring
+                  (default: the next frame published)
+     -n N         stop after N frames
+
+   maps the segment read-only and prints one line per frame,
+   step time and the frame values, until the publisher lets go of
+   the segment; frames overwritten before they were read are
+   reported as dropped */
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "shm_format.h"
+
+#define POLL 100               // microseconds between polls of head
+
+static void usage()
+{
+  fprintf(stderr,"Usage: muse_shm name [-a] [-n N]\n");
+  exit(1);
+}
+
+/* ---------------------------------------------------------------------- */
+
+int main(int argc, char **argv)
+{
+  if (argc < 2) usage();
+
+  int oldest = 0;
+  long long nmax = -1;
+  int iarg = 2;
+  while (iarg < argc) {
+    if (strcmp(argv[iarg],"-a") == 0) {
+      oldest = 1;
+      iarg++;
+    } else if (strcmp(argv[iarg],"-n") == 0) {
+      if (iarg+2 > argc) usage();
+      nmax = atoll(argv[iarg+1]);
+      iarg += 2;
+    } else usage();
+  }
+
+  char name[256];
+  if (argv[1][0] == '/') snprintf(name,256,"%s",argv[1]);
+  else snprintf(name,256,"/%s",argv[1]);
+
+  int fd = shm_open(name,O_RDONLY,0);
+  if (fd < 0) {
+    fprintf(stderr,"ERROR: Cannot open shared memory segment %s\n",name);
+    return 1;
+  }
+  struct stat st;
+  fstat(fd,&st);
+  if (st.st_size < (off_t) sizeof(ShmHeader)) {
+    fprintf(stderr,"ERROR: Segment %s is not ready\n",name);
+    return 1;
+  }
+  void *ptr = mmap(NULL,st.st_size,PROT_READ,MAP_SHARED,fd,0);
+  if (ptr == MAP_FAILED) {
+    fprintf(stderr,"ERROR: Cannot map shared memory segment %s\n",name);
+    return 1;
+  }
+
+  const char *base = (const char *) ptr;
+  const ShmHeader *h = (const ShmHeader *) base;
+  if (strncmp(h->magic,SHM_MAGIC,8) != 0 || h->version != SHM_VERSION ||
+      h->slot_offset + h->nslot*h->slot_size > st.st_size) {
+    fprintf(stderr,"ERROR: %s is not a MUSE output shm segment\n",name);
+    return 1;
+  }
+  std::atomic_thread_fence(std::memory_order_acquire);
+
+  // column header from the field layout and body names
+
+  const TrajField *field = (const TrajField *) (base + h->field_offset);
+  const char *names = base + h->name_offset;
+  printf("# step time");
+  for (int i = 0; i < h->nfield; i++) {
+    const TrajField *f = &field[i];
+    int nb = f->perbody ? h->nbody : 1;
+    for (int j = 0; j < nb; j++)
+      for (int k = 0; k < f->width; k++) {
+        if (f->perbody)
+          printf(" %.*s.%s[%d]",h->namelen,names + j*h->namelen,f->name,k+1);
+        else printf(" %s",f->name);
+      }
+  }
+  printf("\n");
+
+  double *values = new double[h->ncol];
+  int64_t step;
+  double time;
+  int64_t k = h->head.load(std::memory_order_acquire);
+  if (oldest) k = (k > h->nslot) ? k - h->nslot : 0;
+  long long nread = 0;
+  long long ndrop = 0;
+
+  while (nmax < 0 || nread < nmax) {
+    int flag = shm_read_frame(h,k,values,&step,&time);
+    if (flag == 0) {
+      printf("%lld %.17g",(long long) step,time);
+      for (int i = 0; i < h->ncol; i++) printf(" %.17g",values[i]);
+      printf("\n");
+      nread++;
+      k++;
+    } else if (flag < 0) {
+
+      // fell behind by more than the ring, skip to the oldest frame left
+
+      int64_t head = h->head.load(std::memory_order_acquire);
+      int64_t next = head - h->nslot + 1;
+      if (next <= k) next = k + 1;
+      ndrop += next - k;
+      k = next;
+    } else {
+      if (h->live.load(std::memory_order_acquire) == 0) break;
+      fflush(stdout);
+      usleep(POLL);
+    }
+  }
+
+  if (ndrop) fprintf(stderr,"muse_shm: %lld frames dropped\n",ndrop);
+  delete [] values;
+  munmap(ptr,st.st_size);
+  close(fd);
+  return 0;
+}
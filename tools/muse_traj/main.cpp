@@ -0,0 +1,215 @@
+/* ----------------------------------------------------------------------
+   MUSE - MUltibody System dynamics Engine
+   https://github.com/zhangh3/MUSE
+
+   Zhang He, zhanghecalt@163.com
+   Science and Technology on Space Physics Laboratory, Beijing
+
+   This software is distributed under the GNU General Public License.
+   Copyright (c) 2023 Zhang He. All rights reserved.
+------------------------------------------------------------------------- */
+
+/* muse_traj: inspect or extract from a binary trajectory
+
+   muse_traj file                        print header and frame range
+   muse_traj file [options]              print selected frames as text
+     -t t0 [t1]   frames with t0 <= time <= t1 (default all frames),
+                  the frame nearest to t0 if t1 is not given
+     -b b1 b2 ... bodies by name (default all bodies)
+     -f f1 f2 ... fields by name (default all fields)
+     -n N         print every Nth selected frame
+
+   each printed line holds step, time and then the selected fields,
+   per-body fields repeated for each selected body */
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "math.h"
+#include "muse_traj.h"
+
+using namespace MUSE_NS;
+
+static void usage()
+{
+  fprintf(stderr,"Usage: muse_traj file [-t t0 [t1]] [-b body ...] "
+          "[-f field ...] [-n N]\n");
+  exit(1);
+}
+
+/* ---------------------------------------------------------------------- */
+
+static void info(TrajReader &traj)
+{
+  const TrajHeader *h = traj.header;
+
+  printf("MUSE binary trajectory, version %d\n",h->version);
+  printf("  bodies  %d:",h->nbody);
+  for (int i = 0; i < h->nbody; i++) printf(" %s",traj.body_name(i));
+  printf("\n  fields  %d:",h->nfield);
+  for (int i = 0; i < h->nfield; i++) printf(" %s",traj.field[i].name);
+  printf("\n  columns %d per frame\n",h->ncol);
+  if (h->compress) {
+    printf("  encoded, key frame every %d frames\n",h->keyframe);
+    for (int i = 0; i < h->nfield; i++) {
+      const TrajField *f = &traj.field[i];
+      if (f->quant == TRAJ_FLOAT32) printf("    %s float32",f->name);
+      else if (f->quant == TRAJ_FIXED)
+        printf("    %s fixed %g",f->name,f->scale);
+      else if (f->deadband > 0.0) printf("    %s",f->name);
+      else continue;
+      if (f->deadband > 0.0) printf(" deadband %g",f->deadband);
+      printf("\n");
+    }
+  }
+  printf("  dt      %g, every %d steps\n",h->dt,h->every);
+  printf("  frames  %lld%s\n",(long long) traj.nframe,
+         traj.indexed ? "" : " (no footer index, file was not closed)");
+  if (traj.nframe > 0) {
+    int64_t last = traj.nframe - 1;
+    printf("  steps   %lld to %lld\n",(long long) traj.frame_step(0),
+           (long long) traj.frame_step(last));
+    printf("  time    %g to %g\n",traj.frame_time(0),traj.frame_time(last));
+  }
+}
+
+/* ---------------------------------------------------------------------- */
+
+int main(int argc, char **argv)
+{
+  if (argc < 2) usage();
+
+  TrajReader traj;
+  if (traj.open(argv[1])) {
+    fprintf(stderr,"ERROR: %s: %s\n",traj.errmsg,argv[1]);
+    return 1;
+  }
+
+  if (argc == 2) {
+    info(traj);
+    return 0;
+  }
+
+  const TrajHeader *h = traj.header;
+  int nbody = 0;
+  int *bodies = new int[h->nbody];
+  int nfield = 0;
+  int *fields = new int[h->nfield];
+  int ranged = 0, single = 0;
+  double t0 = 0.0, t1 = 0.0;
+  int nevery = 1;
+
+  int iarg = 2;
+  while (iarg < argc) {
+    if (strcmp(argv[iarg],"-t") == 0) {
+      if (iarg+2 > argc) usage();
+      ranged = single = 1;
+      t0 = t1 = atof(argv[iarg+1]);
+      iarg += 2;
+      if (iarg < argc && argv[iarg][0] != '-') {
+        t1 = atof(argv[iarg++]);
+        single = 0;
+      }
+    } else if (strcmp(argv[iarg],"-b") == 0) {
+      iarg++;
+      while (iarg < argc && argv[iarg][0] != '-') {
+        int ibody = traj.find_body(argv[iarg]);
+        if (ibody < 0) {
+          fprintf(stderr,"ERROR: Unknown body %s\n",argv[iarg]);
+          return 1;
+        }
+        if (nbody < h->nbody) bodies[nbody++] = ibody;
+        iarg++;
+      }
+    } else if (strcmp(argv[iarg],"-f") == 0) {
+      iarg++;
+      while (iarg < argc && argv[iarg][0] != '-') {
+        int ifield = traj.find_field(argv[iarg]);
+        if (ifield < 0) {
+          fprintf(stderr,"ERROR: Field %s is not in the file\n",argv[iarg]);
+          return 1;
+        }
+        if (nfield < h->nfield) fields[nfield++] = ifield;
+        iarg++;
+      }
+    } else if (strcmp(argv[iarg],"-n") == 0) {
+      if (iarg+2 > argc) usage();
+      nevery = atoi(argv[iarg+1]);
+      if (nevery <= 0) usage();
+      iarg += 2;
+    } else usage();
+  }
+
+  if (nbody == 0)
+    for (int i = 0; i < h->nbody; i++) bodies[nbody++] = i;
+  if (nfield == 0)
+    for (int i = 0; i < h->nfield; i++) fields[nfield++] = i;
+
+  // the first and last frame come from a binary search on time,
+  // only the frames in between are touched
+  // stored times carry round-off, so bounds are widened by a small
+  // fraction of the frame spacing, a single time takes the nearest
+  // frame within half a spacing
+
+  int64_t first = 0;
+  int64_t last = traj.nframe;
+  if (ranged) {
+    double spacing = h->dt*h->every;
+    double eps = 1.0e-6*spacing;
+    first = traj.find_time(t0 - eps);
+    if (first < 0) {
+      fprintf(stderr,"ERROR: File has no time information for -t\n");
+      return 1;
+    }
+    if (single) {
+      if (first > 0 && (first == traj.nframe ||
+                        t0 - traj.frame_time(first-1) <
+                        traj.frame_time(first) - t0)) first--;
+      if (first >= traj.nframe ||
+          fabs(traj.frame_time(first) - t0) > 0.5*spacing + eps) {
+        fprintf(stderr,"ERROR: No frame at time %g\n",t0);
+        return 1;
+      }
+      last = first + 1;
+    } else {
+      last = traj.find_time(t1 + eps);
+      if (last < first) last = first;
+      while (last < traj.nframe && traj.frame_time(last) <= t1 + eps) last++;
+    }
+  }
+
+  printf("# step time");
+  for (int i = 0; i < nfield; i++) {
+    const TrajField *f = &traj.field[fields[i]];
+    if (f->perbody)
+      for (int j = 0; j < nbody; j++)
+        for (int k = 0; k < f->width; k++)
+          printf(" %s.%s[%d]",traj.body_name(bodies[j]),f->name,k+1);
+    else
+      for (int k = 0; k < f->width; k++) printf(" %s",f->name);
+  }
+  printf("\n");
+
+  for (int64_t iframe = first; iframe < last; iframe += nevery) {
+    const double *frame = traj.frame(iframe);
+    if (frame == NULL) {
+      fprintf(stderr,"ERROR: %s: frame %lld\n",traj.errmsg,
+              (long long) iframe);
+      return 1;
+    }
+    printf("%lld %.17g",(long long) traj.frame_step(iframe),
+           traj.frame_time(iframe));
+    for (int i = 0; i < nfield; i++) {
+      const TrajField *f = &traj.field[fields[i]];
+      int nb = f->perbody ? nbody : 1;
+      for (int j = 0; j < nb; j++)
+        for (int k = 0; k < f->width; k++)
+          printf(" %.17g",frame[traj.column(fields[i],bodies[j],k)]);
+    }
+    printf("\n");
+  }
+
+  delete [] bodies;
+  delete [] fields;
+  return 0;
+}
@@ -0,0 +1,519 @@
+/* ----------------------------------------------------------------------
+   MUSE - MUltibody System dynamics Engine
+   https://github.com/zhangh3/MUSE
+
+   Zhang He, zhanghecalt@163.com
+   Science and Technology on Space Physics Laboratory, Beijing
+
+   This software is distributed under the GNU General Public License.
+   Copyright (c) 2023 Zhang He. All rights reserved.
+------------------------------------------------------------------------- */
+
+#include "stdlib.h"
+#include "string.h"
+#include "muse_traj.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+using namespace MUSE_NS;
+
+/* ---------------------------------------------------------------------- */
+
+TrajReader::TrajReader()
+{
+  header = NULL;
+  field = NULL;
+  nframe = 0;
+  indexed = 0;
+  errmsg = NULL;
+
+  base = NULL;
+  size = 0;
+  names = NULL;
+  index = NULL;
+  trailer = NULL;
+  itime = istep = -1;
+  offsets = NULL;
+
+  colquant = colrow = NULL;
+  colscale = NULL;
+  nrow = 0;
+  hist1 = hist2 = hist3 = value = NULL;
+  nhist = NULL;
+  current = -1;
+
+#ifdef _WIN32
+  hfile = hmap = NULL;
+#else
+  fd = -1;
+#endif
+}
+
+/* ---------------------------------------------------------------------- */
+
+TrajReader::~TrajReader()
+{
+  close();
+}
+
+/* ----------------------------------------------------------------------
+   map a trajectory file and check its header
+   a missing or damaged trailer is not an error, the complete frames
+   of an unclosed file are still readable
+------------------------------------------------------------------------- */
+
+int TrajReader::open(const char *filename)
+{
+  close();
+  if (map(filename)) {
+    close();
+    return -1;
+  }
+
+  if (size < (int64_t) sizeof(TrajHeader)) {
+    errmsg = "File is too short for a trajectory header";
+    close();
+    return -1;
+  }
+
+  header = (const TrajHeader *) base;
+  if (strncmp(header->magic,TRAJ_MAGIC,8) != 0) {
+    errmsg = "File is not a MUSE binary trajectory";
+    close();
+    return -1;
+  }
+  if (header->version != TRAJ_VERSION) {
+    errmsg = "Unsupported trajectory file version";
+    close();
+    return -1;
+  }
+  int64_t expect = sizeof(TrajHeader) + header->nfield*sizeof(TrajField) +
+    (int64_t) header->nbody*header->namelen;
+  if (header->header_size != expect || header->header_size > size ||
+      header->ncol <= 0) {
+    errmsg = "Corrupt trajectory header";
+    close();
+    return -1;
+  }
+
+  field = (const TrajField *) (base + sizeof(TrajHeader));
+  names = base + sizeof(TrajHeader) + header->nfield*sizeof(TrajField);
+  itime = find_field("time");
+  istep = find_field("step");
+
+  for (int i = 0; i < header->nfield; i++) {
+    int n = field[i].perbody ? field[i].width*header->nbody : field[i].width;
+    if (field[i].offset < 0 || field[i].width < 0 ||
+        field[i].offset + n > header->ncol ||
+        field[i].quant < TRAJ_DOUBLE || field[i].quant > TRAJ_FIXED) {
+      errmsg = "Corrupt trajectory field layout";
+      close();
+      return -1;
+    }
+  }
+
+  if (header->compress) {
+    if (header->keyframe <= 0) {
+      errmsg = "Corrupt trajectory header";
+      close();
+      return -1;
+    }
+    setup_codec();
+    if (open_records()) {
+      close();
+      return -1;
+    }
+    return 0;
+  }
+
+  int64_t framesize = header->ncol * sizeof(double);
+
+  if (size >= header->header_size + (int64_t) sizeof(TrajTrailer)) {
+    const TrajTrailer *t =
+      (const TrajTrailer *) (base + size - sizeof(TrajTrailer));
+    if (strncmp(t->magic,TRAJ_TRAILER_MAGIC,8) == 0 &&
+        t->index_offset == header->header_size + t->nframe*framesize &&
+        t->index_offset + t->nframe*(int64_t) sizeof(TrajIndex) +
+        (int64_t) sizeof(TrajTrailer) == size) {
+      trailer = t;
+      index = (const TrajIndex *) (base + t->index_offset);
+      nframe = t->nframe;
+      indexed = 1;
+    }
+  }
+
+  if (!indexed) nframe = (size - header->header_size) / framesize;
+
+  return 0;
+}
+
+/* ---------------------------------------------------------------------- */
+
+void TrajReader::close()
+{
+  unmap();
+  header = NULL;
+  field = NULL;
+  names = NULL;
+  index = NULL;
+  trailer = NULL;
+  nframe = 0;
+  indexed = 0;
+  itime = istep = -1;
+
+  free(offsets);
+  offsets = NULL;
+  delete [] colquant;
+  delete [] colscale;
+  delete [] colrow;
+  delete [] hist1;
+  delete [] hist2;
+  delete [] hist3;
+  delete [] value;
+  delete [] nhist;
+  colquant = colrow = NULL;
+  colscale = NULL;
+  hist1 = hist2 = hist3 = value = NULL;
+  nhist = NULL;
+  nrow = 0;
+  current = -1;
+}
+
+/* ----------------------------------------------------------------------
+   locate the records of an encoded file
+   from the footer index, or by walking the records one by one
+   if the file was not closed, a partly written last record is dropped
+------------------------------------------------------------------------- */
+
+int TrajReader::open_records()
+{
+  if (size >= header->header_size + (int64_t) sizeof(TrajTrailer)) {
+    const TrajTrailer *t =
+      (const TrajTrailer *) (base + size - sizeof(TrajTrailer));
+    if (strncmp(t->magic,TRAJ_TRAILER_MAGIC,8) == 0 &&
+        t->nframe >= 0 && t->index_offset % 8 == 0 &&
+        t->index_offset >= header->header_size &&
+        t->index_offset + t->nframe*(int64_t) sizeof(TrajIndex) +
+        (int64_t) sizeof(TrajTrailer) == size) {
+      trailer = t;
+      index = (const TrajIndex *) (base + t->index_offset);
+      nframe = t->nframe;
+      indexed = 1;
+      return 0;
+    }
+  }
+
+  int64_t maxframe = 0;
+  int64_t offset = header->header_size;
+  TrajRecord r;
+
+  while (offset + (int64_t) sizeof(TrajRecord) <= size) {
+    memcpy(&r,base + offset,sizeof(TrajRecord));
+    if (r.nbytes < 0 ||
+        offset + (int64_t) sizeof(TrajRecord) + r.nbytes > size) break;
+    if (nframe == maxframe) {
+      maxframe = maxframe ? 2*maxframe : 1024;
+      int64_t *ptr = (int64_t *) realloc(offsets,maxframe*sizeof(int64_t));
+      if (ptr == NULL) {
+        errmsg = "Out of memory indexing trajectory records";
+        return -1;
+      }
+      offsets = ptr;
+    }
+    offsets[nframe++] = offset;
+    offset += sizeof(TrajRecord) + r.nbytes;
+  }
+  return 0;
+}
+
+/* ----------------------------------------------------------------------
+   per-column decoder tables, must match Trajectory::setup_codec()
+------------------------------------------------------------------------- */
+
+void TrajReader::setup_codec()
+{
+  int ncol = header->ncol;
+  int nbody = header->nbody;
+  int i,j,k;
+
+  colquant = new int[ncol];
+  colscale = new double[ncol];
+  colrow = new int[ncol];
+  hist1 = new double[ncol];
+  hist2 = new double[ncol];
+  hist3 = new double[ncol];
+  value = new double[ncol];
+  nhist = new unsigned char[ncol];
+
+  for (k = 0; k < ncol; k++) {
+    colquant[k] = TRAJ_DOUBLE;
+    colscale[k] = 1.0;
+    colrow[k] = -1;
+    value[k] = 0.0;
+  }
+
+  nrow = 0;
+  for (i = 0; i < header->nfield; i++) {
+    const TrajField *f = &field[i];
+    int n = f->perbody ? f->width*nbody : f->width;
+    for (k = 0; k < n; k++) {
+      colquant[f->offset+k] = f->quant;
+      colscale[f->offset+k] = f->scale;
+    }
+    if (f->deadband > 0.0 && f->perbody)
+      for (j = 0; j < nbody; j++, nrow++)
+        for (k = 0; k < f->width; k++)
+          colrow[f->offset+j*f->width+k] = nrow;
+  }
+
+  memset(nhist,0,ncol);
+  current = -1;
+}
+
+/* ---------------------------------------------------------------------- */
+
+int64_t TrajReader::record_offset(int64_t iframe)
+{
+  if (indexed) return index[iframe].offset;
+  return offsets[iframe];
+}
+
+/* ----------------------------------------------------------------------
+   copy the record header of a frame, records need not be aligned
+------------------------------------------------------------------------- */
+
+void TrajReader::record(int64_t iframe, TrajRecord *r)
+{
+  memcpy(r,base + record_offset(iframe),sizeof(TrajRecord));
+}
+
+/* ----------------------------------------------------------------------
+   decode one record on top of the current history
+   return -1 if the payload is corrupt
+------------------------------------------------------------------------- */
+
+int TrajReader::decode(int64_t iframe)
+{
+  TrajRecord r;
+  int64_t offset = record_offset(iframe);
+  if (offset < header->header_size ||
+      offset + (int64_t) sizeof(TrajRecord) > size) return -1;
+  record(iframe,&r);
+  if (r.nbytes < 0 ||
+      offset + (int64_t) sizeof(TrajRecord) + r.nbytes > size) return -1;
+
+  const unsigned char *p =
+    (const unsigned char *) base + offset + sizeof(TrajRecord);
+  const unsigned char *end = p + r.nbytes;
+  const unsigned char *mask = p;
+  int nmask = (nrow + 7) / 8;
+  if (r.nbytes < nmask) return -1;
+  p += nmask;
+
+  if (r.key) memset(nhist,0,header->ncol);
+
+  for (int c = 0; c < header->ncol; c++) {
+    int irow = colrow[c];
+    if (irow >= 0 && !(mask[irow >> 3] & (1 << (irow & 7)))) continue;
+    uint64_t u;
+    if (traj_get_varint(&p,end,&u)) return -1;
+    double pred = traj_predict(colquant[c],hist1[c],hist2[c],hist3[c],
+                               nhist[c]);
+    hist3[c] = hist2[c];
+    hist2[c] = hist1[c];
+    hist1[c] = traj_restore(colquant[c],u,pred);
+    if (nhist[c] < 3) nhist[c]++;
+    value[c] = traj_value(colquant[c],colscale[c],hist1[c]);
+  }
+  return 0;
+}
+
+/* ---------------------------------------------------------------------- */
+
+const char *TrajReader::body_name(int ibody)
+{
+  if (ibody < 0 || ibody >= header->nbody) return NULL;
+  return names + (int64_t) ibody*header->namelen;
+}
+
+/* ---------------------------------------------------------------------- */
+
+int TrajReader::find_body(const char *name)
+{
+  for (int i = 0; i < header->nbody; i++)
+    if (strncmp(body_name(i),name,header->namelen) == 0) return i;
+  return -1;
+}
+
+/* ---------------------------------------------------------------------- */
+
+int TrajReader::find_field(const char *name)
+{
+  for (int i = 0; i < header->nfield; i++)
+    if (strncmp(field[i].name,name,8) == 0) return i;
+  return -1;
+}
+
+/* ----------------------------------------------------------------------
+   column of component k of body ibody in field ifield
+   ibody is ignored for fields that are not per body
+------------------------------------------------------------------------- */
+
+int TrajReader::column(int ifield, int ibody, int k)
+{
+  const TrajField *f = &field[ifield];
+  if (f->perbody) return f->offset + ibody*f->width + k;
+  return f->offset + k;
+}
+
+/* ---------------------------------------------------------------------- */
+
+const double *TrajReader::frame(int64_t iframe)
+{
+  if (iframe < 0 || iframe >= nframe) {
+    errmsg = "Frame out of range";
+    return NULL;
+  }
+
+  if (!header->compress)
+    return (const double *) (base + header->header_size +
+                             iframe*header->ncol*(int64_t) sizeof(double));
+
+  // continue from the frame already decoded if it is on the way
+
+  int64_t start = iframe - iframe % header->keyframe;
+  if (current >= start && current <= iframe) start = current + 1;
+  for (int64_t i = start; i <= iframe; i++)
+    if (decode(i)) {
+      errmsg = "Corrupt encoded trajectory frame";
+      current = -1;
+      return NULL;
+    }
+  current = iframe;
+  return value;
+}
+
+/* ----------------------------------------------------------------------
+   time of a frame from the index, or from the time field
+   returns -1.0 if neither is available
+------------------------------------------------------------------------- */
+
+double TrajReader::frame_time(int64_t iframe)
+{
+  if (indexed) return index[iframe].time;
+  if (header->compress) {
+    TrajRecord r;
+    record(iframe,&r);
+    return r.time;
+  }
+  if (itime >= 0) return frame(iframe)[field[itime].offset];
+  return -1.0;
+}
+
+/* ----------------------------------------------------------------------
+   step of a frame from the index, or from the step field
+   returns -1 if neither is available
+------------------------------------------------------------------------- */
+
+int64_t TrajReader::frame_step(int64_t iframe)
+{
+  if (indexed) return index[iframe].step;
+  if (header->compress) {
+    TrajRecord r;
+    record(iframe,&r);
+    return r.step;
+  }
+  if (istep >= 0) return (int64_t) frame(iframe)[field[istep].offset];
+  return -1;
+}
+
+/* ----------------------------------------------------------------------
+   binary search for the first frame with time >= t, frames are in
+   increasing time, returns nframe if t is past the last frame
+   and -1 if the file has no time information
+------------------------------------------------------------------------- */
+
+int64_t TrajReader::find_time(double t)
+{
+  if (!indexed && !header->compress && itime < 0) return -1;
+
+  int64_t lo = 0;
+  int64_t hi = nframe;
+  while (lo < hi) {
+    int64_t mid = lo + (hi - lo) / 2;
+    if (frame_time(mid) < t) lo = mid + 1;
+    else hi = mid;
+  }
+  return lo;
+}
+
+/* ---------------------------------------------------------------------- */
+
+int TrajReader::map(const char *filename)
+{
+#ifdef _WIN32
+  hfile = CreateFileA(filename,GENERIC_READ,FILE_SHARE_READ,NULL,
+                      OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,NULL);
+  if (hfile == INVALID_HANDLE_VALUE) {
+    hfile = NULL;
+    errmsg = "Cannot open trajectory file";
+    return -1;
+  }
+  LARGE_INTEGER n;
+  GetFileSizeEx((HANDLE) hfile,&n);
+  size = n.QuadPart;
+  if (size == 0) {
+    errmsg = "Trajectory file is empty";
+    return -1;
+  }
+  hmap = CreateFileMappingA((HANDLE) hfile,NULL,PAGE_READONLY,0,0,NULL);
+  if (hmap) base = (const char *) MapViewOfFile((HANDLE) hmap,FILE_MAP_READ,
+                                                0,0,0);
+#else
+  fd = ::open(filename,O_RDONLY);
+  if (fd < 0) {
+    errmsg = "Cannot open trajectory file";
+    return -1;
+  }
+  struct stat st;
+  fstat(fd,&st);
+  size = st.st_size;
+  if (size == 0) {
+    errmsg = "Trajectory file is empty";
+    return -1;
+  }
+  void *ptr = mmap(NULL,size,PROT_READ,MAP_SHARED,fd,0);
+  if (ptr != MAP_FAILED) base = (const char *) ptr;
+#endif
+
+  if (base == NULL) {
+    errmsg = "Cannot map trajectory file";
+    return -1;
+  }
+  return 0;
+}
+
+/* ---------------------------------------------------------------------- */
+
+void TrajReader::unmap()
+{
+#ifdef _WIN32
+  if (base) UnmapViewOfFile(base);
+  if (hmap) CloseHandle((HANDLE) hmap);
+  if (hfile) CloseHandle((HANDLE) hfile);
+  hfile = hmap = NULL;
+#else
+  if (base) munmap((void *) base,size);
+  if (fd >= 0) ::close(fd);
+  fd = -1;
+#endif
+  base = NULL;
+  size = 0;
+}
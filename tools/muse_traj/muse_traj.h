@@ -0,0 +1,92 @@
+/* ----------------------------------------------------------------------
+   MUSE - MUltibody System dynamics Engine
+   https://github.com/zhangh3/MUSE
+
+   Zhang He, zhanghecalt@163.com
+   Science and Technology on Space Physics Laboratory, Beijing
+
+   This software is distributed under the GNU General Public License.
+   Copyright (c) 2023 Zhang He. All rights reserved.
+------------------------------------------------------------------------- */
+
+#ifndef MUSE_TRAJ_H
+#define MUSE_TRAJ_H
+
+#include "trajectory_format.h"
+
+namespace MUSE_NS {
+
+/* read-only view of a binary trajectory file written by
+   "trajectory format binary"
+   the file is memory mapped, frames are pointers into the mapping,
+   so only the pages of frames actually accessed are read from disk
+   time lookup is a binary search over the footer index, or over the
+   time column of the frames if the file was never closed
+   encoded frames (compress yes) are decoded into an internal buffer,
+   starting at the preceding key frame unless the previous call already
+   decoded an earlier frame of the same stretch, so reading forward
+   decodes each frame once; the returned frame is valid until the next
+   call of frame() */
+
+class TrajReader {
+ public:
+  const TrajHeader *header;
+  const TrajField *field;      // header->nfield entries
+  int64_t nframe;              // # of complete frames in the file
+  int indexed;                 // 1 if the footer index is present
+  const char *errmsg;          // reason of the last failed open()
+
+  TrajReader();
+  ~TrajReader();
+  int open(const char *);      // 0 on success, -1 on error
+  void close();
+
+  const char *body_name(int);
+  int find_body(const char *); // body index, -1 if not found
+  int find_field(const char *);// field index, -1 if not found
+  int column(int, int, int);   // frame column of field/body/component
+
+  const double *frame(int64_t); // NULL if out of range or corrupt
+  double frame_time(int64_t);
+  int64_t frame_step(int64_t);
+  int64_t find_time(double);   // first frame at or after a time
+
+ private:
+  const char *base;            // start of the mapping
+  int64_t size;                // size of the mapping in bytes
+  const char *names;           // body names
+  const TrajIndex *index;      // footer index, NULL if not indexed
+  const TrajTrailer *trailer;
+  int itime,istep;             // time/step field, -1 if not logged
+  int64_t *offsets;            // record offsets of an unindexed
+                               // encoded file, found by walking it
+
+  // decoder state, see trajectory_format.h
+
+  int *colquant;               // quant/scale of each column
+  double *colscale;
+  int *colrow;                 // deadband row of each column, -1 = none
+  int nrow;                    // # of deadband rows
+  double *hist1,*hist2,*hist3; // last three stored values of each column
+  unsigned char *nhist;        // # of valid history values, 0 to 3
+  double *value;               // decoded frame
+  int64_t current;             // frame held in value, -1 if none
+
+#ifdef _WIN32
+  void *hfile,*hmap;
+#else
+  int fd;
+#endif
+
+  int map(const char *);
+  void unmap();
+  int open_records();
+  void setup_codec();
+  int64_t record_offset(int64_t);
+  void record(int64_t, TrajRecord *);
+  int decode(int64_t);
+};
+
+}
+
+#endif